@@ -0,0 +1,235 @@
+#include "ecewo.h"
+#include "ecewo-mock.h"
+#include "ecewo-cookie.h"
+#include "ecewo-cors.h"
+#include "ecewo-helmet.h"
+#include "ecewo-session.h"
+#include "ecewo-static.h"
+#include "uv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// HTTP load benchmark of the modules, run against the mock_init() server
+// Usage: modules_bench [--duration ms] [--connections n] [--pipeline n] [--requests n]
+
+#define BENCH_DIR "bench_public"
+#define BENCH_COOKIES 40
+
+static char session_cookie[256];
+static char cookie_header[BENCH_COOKIES * 32];
+
+static void handler_plain(Req *req, Res *res)
+{
+    (void)req;
+    send_text(res, OK, "OK");
+}
+
+static void handler_login(Req *req, Res *res)
+{
+    (void)req;
+    Session *sess = session_create(3600);
+    if (!sess) {
+        send_text(res, INTERNAL_SERVER_ERROR, "Session creation failed");
+        return;
+    }
+
+    session_value_set(sess, "user_id", "12345");
+    session_value_set(sess, "role", "admin");
+    session_send(res, sess, NULL);
+    send_text(res, OK, "Logged in");
+}
+
+static void handler_session(Req *req, Res *res)
+{
+    Session *sess = session_get(req);
+    const char *user_id = sess ? session_value_get_view(sess, "user_id", NULL) : NULL;
+    if (!user_id) {
+        send_text(res, UNAUTHORIZED, "No session");
+        return;
+    }
+
+    send_text(res, OK, user_id);
+}
+
+static void handler_cookie(Req *req, Res *res)
+{
+    // First, middle and last cookie of the header
+    size_t len;
+    const char *first = cookie_get_view(req, "c0", &len);
+    const char *middle = cookie_get_view(req, "c20", &len);
+    const char *last = cookie_get_view(req, "c39", &len);
+
+    send_text(res, first && middle && last ? OK : BAD_REQUEST, "OK");
+}
+
+static int write_file(const char *path, const char *content)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+        return 0;
+
+    fputs(content, file);
+    fclose(file);
+    return 1;
+}
+
+static void setup_bench_routes(void)
+{
+    // Every route runs behind both middlewares, as in a typical API
+    helmet_init(NULL);
+    cors_init(NULL);
+
+    Static options = {
+        .cache_max_bytes = 1024 * 1024,
+    };
+    serve_static("/assets", "./" BENCH_DIR, &options);
+
+    get("/bench/plain", handler_plain);
+    get("/bench/login", handler_login);
+    get("/bench/session", handler_session);
+    get("/bench/cookie", handler_cookie);
+}
+
+static int prepare(void)
+{
+    uv_fs_t req;
+    int result = uv_fs_mkdir(NULL, &req, BENCH_DIR, 0755, NULL);
+    uv_fs_req_cleanup(&req);
+
+    if (result != 0 && result != UV_EEXIST) {
+        fprintf(stderr, "Failed to create %s: %s\n", BENCH_DIR, uv_strerror(result));
+        return 0;
+    }
+
+    static const char rule[] = ".bench { color: #123456; }\n";
+    static char css[4096];
+    size_t css_len = 0;
+    while (css_len + sizeof(rule) < sizeof(css)) {
+        memcpy(css + css_len, rule, sizeof(rule) - 1);
+        css_len += sizeof(rule) - 1;
+    }
+
+    if (!write_file(BENCH_DIR "/bench.css", css))
+        return 0;
+
+    size_t len = 0;
+    for (int i = 0; i < BENCH_COOKIES; i++) {
+        len += (size_t)snprintf(cookie_header + len, sizeof(cookie_header) - len,
+                                "%sc%d=value-%d", i > 0 ? "; " : "", i, i);
+    }
+
+    return 1;
+}
+
+static void cleanup(void)
+{
+    uv_fs_t req;
+    uv_fs_unlink(NULL, &req, BENCH_DIR "/bench.css", NULL);
+    uv_fs_req_cleanup(&req);
+    uv_fs_rmdir(NULL, &req, BENCH_DIR, NULL);
+    uv_fs_req_cleanup(&req);
+}
+
+static int login(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/bench/login",
+    };
+
+    MockResponse res = request(&params);
+    const char *set_cookie = mock_get_header(&res, "Set-Cookie");
+    size_t len = set_cookie ? strcspn(set_cookie, ";") : 0;
+    int ok = res.status_code == 200 && len > 0 && len < sizeof(session_cookie);
+
+    if (ok) {
+        memcpy(session_cookie, set_cookie, len);
+        session_cookie[len] = '\0';
+    }
+
+    free_request(&res);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    MockBench base = {
+        .connections = 8,
+        .pipeline = 1,
+        .duration_ms = 2000,
+    };
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        unsigned long value = strtoul(argv[i + 1], NULL, 10);
+
+        if (strcmp(argv[i], "--duration") == 0)
+            base.duration_ms = (uint32_t)value;
+        else if (strcmp(argv[i], "--connections") == 0)
+            base.connections = (uint32_t)value;
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            base.pipeline = (uint32_t)value;
+        else if (strcmp(argv[i], "--requests") == 0)
+            base.total_requests = value;
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!prepare())
+        return 1;
+
+    session_init();
+
+    if (mock_init(setup_bench_routes) != 0 || !login()) {
+        fprintf(stderr, "Failed to start the benchmark server\n");
+        cleanup();
+        return 1;
+    }
+
+    MockHeaders session_headers[] = {
+        { "Cookie", session_cookie }
+    };
+
+    MockHeaders cookie_headers[] = {
+        { "Cookie", cookie_header }
+    };
+
+    MockHeaders cors_headers[] = {
+        { "Origin", "http://example.com" }
+    };
+
+    struct
+    {
+        const char *name;
+        MockParams params;
+    } workloads[] = {
+        { "helmet+cors", { .method = MOCK_GET, .path = "/bench/plain", .headers = cors_headers, .header_count = 1 } },
+        { "static", { .method = MOCK_GET, .path = "/assets/bench.css" } },
+        { "session", { .method = MOCK_GET, .path = "/bench/session", .headers = session_headers, .header_count = 1 } },
+        { "cookie", { .method = MOCK_GET, .path = "/bench/cookie", .headers = cookie_headers, .header_count = 1 } },
+    };
+
+    printf("%u connections, pipeline %u\n", (unsigned int)base.connections, (unsigned int)base.pipeline);
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        MockBench config = base;
+        config.requests = &workloads[i].params;
+        config.request_count = 1;
+
+        MockBenchResult result;
+        if (mock_bench(&config, &result) != 0 || result.errors > 0 || result.non_2xx > 0)
+            failed = 1;
+
+        mock_bench_print(workloads[i].name, &result);
+    }
+
+    mock_cleanup();
+    static_cleanup();
+    session_cleanup();
+    cleanup();
+
+    return failed;
+}
@@ -0,0 +1,103 @@
+// Includes the module itself to reach its internal functions
+#include "ecewo-cookie.c"
+#include "microbench.h"
+
+#define COOKIE_COUNT 40
+
+static char cookie_header[COOKIE_COUNT * 40];
+
+// A request as the server would hand it to a handler
+static void request_init(Req *req, request_item_t *header, Arena *arena)
+{
+    memset(req, 0, sizeof(*req));
+    header->key = "Cookie";
+    header->value = cookie_header;
+    req->arena = arena;
+    req->method = "GET";
+    req->path = "/";
+    req->headers.items = header;
+    req->headers.count = 1;
+    req->headers.capacity = 1;
+}
+
+// Parse the header and look up 3 cookies, once per request
+static void run_cookie_get(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Arena *arena = arena_borrow();
+        request_item_t header;
+        Req req;
+        request_init(&req, &header, arena);
+
+        MICROBENCH_KEEP(cookie_get(&req, "c0"));
+        MICROBENCH_KEEP(cookie_get(&req, "c20"));
+        MICROBENCH_KEEP(cookie_get(&req, "session"));
+
+        arena_return(arena);
+    }
+}
+
+// Lookups once the header has been parsed
+static void run_cookie_get_view_parsed(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    Arena *arena = arena_borrow();
+    request_item_t header;
+    Req req;
+    request_init(&req, &header, arena);
+    size_t first_len;
+    MICROBENCH_KEEP(cookie_get_view(&req, "c0", &first_len));
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        size_t len;
+        MICROBENCH_KEEP(cookie_get_view(&req, "c37", &len));
+    }
+
+    arena_return(arena);
+}
+
+static void run_url_decode(void *data, uint64_t iterations)
+{
+    const char *value = data;
+    size_t len = strlen(value);
+    Arena *arena = NULL;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        arena = microbench_arena(arena, i);
+        MICROBENCH_KEEP(url_decode(arena, value, len));
+    }
+
+    arena_return(arena);
+}
+
+static void run_url_encode(void *data, uint64_t iterations)
+{
+    const char *value = data;
+    Arena *arena = NULL;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        arena = microbench_arena(arena, i);
+        MICROBENCH_KEEP(url_encode_value(arena, value));
+    }
+
+    arena_return(arena);
+}
+
+void bench_cookie(void)
+{
+    size_t len = 0;
+    for (int i = 0; i < COOKIE_COUNT - 1; i++) {
+        len += (size_t)snprintf(cookie_header + len, sizeof(cookie_header) - len,
+                                "c%d=value-%d-abcdefgh; ", i, i);
+    }
+    snprintf(cookie_header + len, sizeof(cookie_header) - len, "session=%s",
+             "k3JH2s9dLq0PzX7vB4nM1cR8tY6wE5uA");
+
+    microbench_run("cookie/get_40_cookies", run_cookie_get, NULL);
+    microbench_run("cookie/get_view_parsed", run_cookie_get_view_parsed, NULL);
+    microbench_run("cookie/url_decode", run_url_decode, "user%40example.com%3B%20theme%3Ddark%20%E2%9C%93");
+    microbench_run("cookie/url_encode", run_url_encode, "user@example.com; theme=dark \xE2\x9C\x93");
+}
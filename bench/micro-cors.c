@@ -0,0 +1,66 @@
+// Includes the module itself to reach its internal functions
+#include "ecewo-cors.c"
+#include "microbench.h"
+
+#define RESPONSE_HEADER_SLOTS 16
+#define ORIGIN_COUNT 50
+
+static char origin_storage[ORIGIN_COUNT][48];
+static const char *origin_list[ORIGIN_COUNT + 2];
+
+static void next_noop(Req *req, Res *res)
+{
+    (void)req;
+    (void)res;
+}
+
+static void run_cors_middleware(void *data, uint64_t iterations)
+{
+    request_item_t origin = { "Origin", data };
+    Arena *arena = arena_borrow();
+    HttpHeader slots[RESPONSE_HEADER_SLOTS];
+    Req req = { .arena = arena, .method = "GET", .path = "/" };
+    Res res = { .arena = arena, .headers = slots, .header_capacity = RESPONSE_HEADER_SLOTS };
+
+    req.headers.items = &origin;
+    req.headers.count = 1;
+    req.headers.capacity = 1;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        res.header_count = 0;
+        cors_middleware(&req, &res, next_noop);
+        MICROBENCH_KEEP(res.header_count);
+    }
+
+    arena_return(arena);
+}
+
+static void run_preflight_cached(void *data, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++)
+        MICROBENCH_KEEP(check_preflight(data, "PUT", "Content-Type, Authorization"));
+}
+
+void bench_cors(void)
+{
+    for (int i = 0; i < ORIGIN_COUNT; i++) {
+        snprintf(origin_storage[i], sizeof(origin_storage[i]), "https://app%02d.example.com", i);
+        origin_list[i] = origin_storage[i];
+    }
+    origin_list[ORIGIN_COUNT] = "https://*.example.org";
+    origin_list[ORIGIN_COUNT + 1] = "https://*.preview.example.net";
+
+    Cors config = {
+        .origins = origin_list,
+        .origin_count = ORIGIN_COUNT + 2,
+        .methods = "GET, POST, PUT, DELETE",
+        .headers = "Content-Type, Authorization",
+    };
+
+    cors_init(&config);
+
+    microbench_run("cors/middleware_exact_origin", run_cors_middleware, "https://app42.example.com");
+    microbench_run("cors/middleware_wildcard_origin", run_cors_middleware, "https://pr-1234.preview.example.net");
+    microbench_run("cors/middleware_rejected_origin", run_cors_middleware, "https://evil.example.com");
+    microbench_run("cors/preflight_cached", run_preflight_cached, "https://app07.example.com");
+}
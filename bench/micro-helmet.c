@@ -0,0 +1,46 @@
+// Includes the module itself to reach its internal functions
+#include "ecewo-helmet.c"
+#include "microbench.h"
+
+#define RESPONSE_HEADER_SLOTS 16
+
+static void next_noop(Req *req, Res *res)
+{
+    (void)req;
+    (void)res;
+}
+
+static void run_helmet_middleware(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    Arena *arena = arena_borrow();
+    HttpHeader slots[RESPONSE_HEADER_SLOTS];
+    Req req = { .arena = arena, .method = "GET", .path = "/" };
+    Res res = { .arena = arena, .headers = slots, .header_capacity = RESPONSE_HEADER_SLOTS };
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        res.header_count = 0;
+        helmet_middleware(&req, &res, next_noop);
+        MICROBENCH_KEEP(res.header_count);
+    }
+
+    arena_return(arena);
+}
+
+void bench_helmet(void)
+{
+    Helmet config = {
+        .csp = "default-src 'self'",
+        .hsts_max_age = "31536000",
+        .hsts_subdomains = true,
+        .frame_options = "DENY",
+        .referrer_policy = "no-referrer",
+        .xss_protection = "0",
+        .nosniff = true,
+        .ie_no_open = true,
+    };
+
+    helmet_init(&config);
+    microbench_run("helmet/middleware", run_helmet_middleware, NULL);
+}
@@ -0,0 +1,104 @@
+// Includes the module itself to reach its internal functions
+#include "ecewo-session.c"
+#include "microbench.h"
+
+#define SESSION_COUNT 100000
+#define SESSION_KEYS 20
+
+static char (*session_ids)[SESSION_ID_LEN + 1];
+static Session *table_session; // SESSION_KEYS values, as a logged-in user would have
+
+// Overwrite a value that fits in its slot, the common case
+static void run_value_set_in_place(void *data, uint64_t iterations)
+{
+    (void)data;
+    static const char *values[] = { "dark", "light" };
+
+    for (uint64_t i = 0; i < iterations; i++)
+        session_value_set(table_session, "key10", values[i & 1]);
+}
+
+// Add and remove a key, which moves the entries after it
+static void run_value_set_new_key(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        session_value_set(table_session, "csrf_token", "f1d2d2f924e986ac86fdf7b36c94bcdf");
+        session_value_remove(table_session, "csrf_token");
+    }
+}
+
+static void run_value_get_view(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        MICROBENCH_KEEP(session_value_get_view(table_session, "key19", NULL));
+}
+
+static void run_find(void *data, uint64_t iterations)
+{
+    (void)data;
+    uint32_t index = 0;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        // Spread over the whole table, as unrelated users would
+        index = (index + 7919) % SESSION_COUNT;
+        MICROBENCH_KEEP(session_find(session_ids[index]));
+    }
+}
+
+static void run_find_missing(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        MICROBENCH_KEEP(session_find("00000000000000000000000000000000"));
+}
+
+static void run_create_free(void *data, uint64_t iterations)
+{
+    (void)data;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Session *sess = session_create(3600);
+        session_value_set(sess, "user_id", "12345");
+        session_free(sess);
+    }
+}
+
+void bench_session(void)
+{
+    if (!session_init())
+        return;
+
+    session_ids = malloc(SESSION_COUNT * sizeof(*session_ids));
+    if (!session_ids)
+        return;
+
+    for (int i = 0; i < SESSION_COUNT; i++) {
+        Session *sess = session_create(3600);
+        if (!sess)
+            return;
+        session_value_set(sess, "user_id", "12345");
+        memcpy(session_ids[i], sess->id, sizeof(session_ids[i]));
+    }
+
+    table_session = session_find(session_ids[0]);
+    for (int i = 0; i < SESSION_KEYS; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "key%d", i);
+        session_value_set(table_session, key, "some-value");
+    }
+
+    microbench_run("session/value_set_in_place", run_value_set_in_place, NULL);
+    microbench_run("session/value_set_new_key", run_value_set_new_key, NULL);
+    microbench_run("session/value_get_view", run_value_get_view, NULL);
+    microbench_run("session/find_100k", run_find, NULL);
+    microbench_run("session/find_missing", run_find_missing, NULL);
+    microbench_run("session/create_free", run_create_free, NULL);
+
+    session_cleanup();
+    free(session_ids);
+}
@@ -0,0 +1,65 @@
+// Includes the module itself to reach its internal functions
+#include "ecewo-static.c"
+#include "microbench.h"
+
+#define MOUNT_COUNT 64
+
+static const char *const mime_paths[] = {
+    "/assets/js/app.bundle.min.js",
+    "/images/Photo.JPG",
+    "/fonts/inter-var.woff2",
+    "/downloads/archive.tar.gz",
+    "/LICENSE",
+    "/index.html",
+};
+
+#define MIME_PATH_COUNT (sizeof(mime_paths) / sizeof(mime_paths[0]))
+
+static void run_content_type(void *data, uint64_t iterations)
+{
+    const mime_table_t *mount_types = data;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        MICROBENCH_KEEP(get_content_type(mount_types, mime_paths[i % MIME_PATH_COUNT]));
+}
+
+// The mount of the last registered prefix, as a miss-heavy router would see it
+static void run_find_mount(void *data, uint64_t iterations)
+{
+    const char *path = data;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        const char *rel_path;
+        MICROBENCH_KEEP(find_mount(path, &rel_path));
+    }
+}
+
+void bench_static(void)
+{
+    microbench_run("static/content_type_builtin", run_content_type, NULL);
+
+    // Overrides are searched before the built-in table
+    char ext[16];
+    for (int i = 0; i < 50; i++) {
+        snprintf(ext, sizeof(ext), "x%d", i);
+        static_add_mime_type(ext, "application/x-bench");
+    }
+
+    mime_table_t mount_types = { 0 };
+    mime_table_set(&mount_types, "js", "text/javascript");
+    mime_table_set(&mount_types, "woff2", "font/woff2");
+
+    microbench_run("static/content_type_overrides", run_content_type, &mount_types);
+    mime_table_free(&mount_types);
+
+    char mount[32];
+    for (int i = 0; i < MOUNT_COUNT; i++) {
+        snprintf(mount, sizeof(mount), "/mount%02d", i);
+        serve_static(mount, "./public", NULL);
+    }
+
+    microbench_run("static/find_mount_first", run_find_mount, "/mount00/css/site.css");
+    microbench_run("static/find_mount_64", run_find_mount, "/mount63/css/site.css");
+
+    static_cleanup();
+}
@@ -0,0 +1,265 @@
+#include "microbench.h"
+#include "uv.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Micro-benchmarks of the module hot paths
+// Usage: modules_microbench [--json] [--time ms] [--filter text] [--baseline file] [--threshold percent]
+//
+// --json prints one JSON object per benchmark. Saved output can be passed back
+// with --baseline, the run then fails if a benchmark got slower than the
+// threshold (default 10%) or allocates more than in the baseline
+
+#define MICROBENCH_MAX_RESULTS 128
+#define MICROBENCH_CALIBRATION_NS 10000000ULL // 10 ms
+
+typedef struct
+{
+    char name[64];
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op; // Negative if allocations can't be counted
+    double bytes_per_op;
+} microbench_result_t;
+
+static struct
+{
+    bool json;
+    uint64_t target_ns;
+    const char *filter;
+    const char *baseline;
+    double threshold;
+
+    microbench_result_t results[MICROBENCH_MAX_RESULTS];
+    size_t result_count;
+} config = {
+    .target_ns = 200000000ULL, // 200 ms
+    .threshold = 10.0,
+};
+
+volatile uintptr_t microbench_sink = 0;
+
+// Allocation counters. glibc lets the executable replace malloc and friends,
+// the replacements count the calls of the current thread and forward to glibc
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define MICROBENCH_COUNT_ALLOCS 1
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static __thread uint64_t alloc_count;
+static __thread uint64_t alloc_bytes;
+
+void *malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+#else
+#define MICROBENCH_COUNT_ALLOCS 0
+
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+#endif
+
+Arena *microbench_arena(Arena *arena, uint64_t iteration)
+{
+    if (arena && (iteration & 1023) != 1023)
+        return arena;
+
+    if (arena)
+        arena_return(arena);
+
+    return arena_borrow();
+}
+
+static bool filtered_out(const char *name)
+{
+    return config.filter && !strstr(name, config.filter);
+}
+
+void microbench_run(const char *name, microbench_fn fn, void *data)
+{
+    if (filtered_out(name))
+        return;
+
+    if (config.result_count == MICROBENCH_MAX_RESULTS) {
+        fprintf(stderr, "Too many benchmarks, %s skipped\n", name);
+        return;
+    }
+
+    // Double the iterations until a run is long enough to time,
+    // then scale them to the target time
+    uint64_t iterations = 1;
+    uint64_t elapsed = 0;
+
+    for (;;) {
+        uint64_t start = uv_hrtime();
+        fn(data, iterations);
+        elapsed = uv_hrtime() - start;
+
+        if (elapsed >= MICROBENCH_CALIBRATION_NS || iterations >= (UINT64_C(1) << 40))
+            break;
+
+        iterations *= 2;
+    }
+
+    if (elapsed < config.target_ns) {
+        double scale = (double)config.target_ns / (double)(elapsed ? elapsed : 1);
+        iterations = (uint64_t)((double)iterations * scale);
+        if (iterations == 0)
+            iterations = 1;
+    }
+
+    uint64_t allocs_before = alloc_count;
+    uint64_t bytes_before = alloc_bytes;
+    uint64_t start = uv_hrtime();
+
+    fn(data, iterations);
+
+    elapsed = uv_hrtime() - start;
+
+    microbench_result_t *result = &config.results[config.result_count++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->iterations = iterations;
+    result->ns_per_op = (double)elapsed / (double)iterations;
+    result->allocs_per_op = MICROBENCH_COUNT_ALLOCS ? (double)(alloc_count - allocs_before) / (double)iterations : -1.0;
+    result->bytes_per_op = MICROBENCH_COUNT_ALLOCS ? (double)(alloc_bytes - bytes_before) / (double)iterations : -1.0;
+
+    if (config.json) {
+        printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+               result->name, (unsigned long long)result->iterations,
+               result->ns_per_op, result->allocs_per_op, result->bytes_per_op);
+    } else if (MICROBENCH_COUNT_ALLOCS) {
+        printf("%-36s %12.1f ns/op %10.2f allocs/op %10.1f B/op\n",
+               result->name, result->ns_per_op, result->allocs_per_op, result->bytes_per_op);
+    } else {
+        printf("%-36s %12.1f ns/op %10s allocs/op %10s B/op\n",
+               result->name, result->ns_per_op, "n/a", "n/a");
+    }
+
+    fflush(stdout);
+}
+
+static const microbench_result_t *find_result(const char *name)
+{
+    for (size_t i = 0; i < config.result_count; i++) {
+        if (strcmp(config.results[i].name, name) == 0)
+            return &config.results[i];
+    }
+
+    return NULL;
+}
+
+// Returns the number of regressions, or -1 if the baseline can't be read
+static int compare_baseline(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open baseline %s\n", path);
+        return -1;
+    }
+
+    int regressions = 0;
+    char line[512];
+
+    while (fgets(line, sizeof(line), file)) {
+        microbench_result_t base;
+        unsigned long long iterations;
+
+        if (sscanf(line, "{\"name\":\"%63[^\"]\",\"iterations\":%llu,\"ns_per_op\":%lf,\"allocs_per_op\":%lf,\"bytes_per_op\":%lf}",
+                   base.name, &iterations, &base.ns_per_op, &base.allocs_per_op, &base.bytes_per_op) != 5)
+            continue;
+
+        const microbench_result_t *current = find_result(base.name);
+        if (!current)
+            continue;
+
+        double change = base.ns_per_op > 0 ? (current->ns_per_op / base.ns_per_op - 1.0) * 100.0 : 0.0;
+        bool slower = change > config.threshold;
+        bool more_allocs = base.allocs_per_op >= 0 && current->allocs_per_op > base.allocs_per_op + 0.001;
+
+        if (slower || more_allocs) {
+            fprintf(stderr, "REGRESSION %s: %.1f -> %.1f ns/op (%+.1f%%), %.3f -> %.3f allocs/op\n",
+                    base.name, base.ns_per_op, current->ns_per_op, change,
+                    base.allocs_per_op, current->allocs_per_op);
+            regressions++;
+        }
+    }
+
+    fclose(file);
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--json") == 0) {
+            config.json = true;
+        } else if (strcmp(argv[i], "--time") == 0 && value) {
+            config.target_ns = strtoull(value, NULL, 10) * 1000000ULL;
+            i++;
+        } else if (strcmp(argv[i], "--filter") == 0 && value) {
+            config.filter = value;
+            i++;
+        } else if (strcmp(argv[i], "--baseline") == 0 && value) {
+            config.baseline = value;
+            i++;
+        } else if (strcmp(argv[i], "--threshold") == 0 && value) {
+            config.threshold = strtod(value, NULL);
+            i++;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!config.json && !MICROBENCH_COUNT_ALLOCS)
+        printf("Allocations are only counted with glibc\n");
+
+    // Nothing listens, but the middlewares and mounts need the router
+    if (server_init() != 0) {
+        fprintf(stderr, "Failed to initialize server\n");
+        return 1;
+    }
+
+    bench_cookie();
+    bench_cors();
+    bench_helmet();
+    bench_session();
+    bench_static();
+
+    if (config.baseline) {
+        int regressions = compare_baseline(config.baseline);
+        if (regressions != 0)
+            return 1;
+    }
+
+    return 0;
+}
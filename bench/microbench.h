@@ -0,0 +1,30 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "ecewo.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Runs fn(data, iterations) for enough iterations to fill the target time
+// and records ns/op and allocations/op under name
+typedef void (*microbench_fn)(void *data, uint64_t iterations);
+
+void microbench_run(const char *name, microbench_fn fn, void *data);
+
+// Results are stored here so the compiler can't drop the measured calls
+extern volatile uintptr_t microbench_sink;
+
+#define MICROBENCH_KEEP(value) (microbench_sink += (uintptr_t)(value))
+
+// Swaps the arena for a fresh one every 1024 iterations, so loops that
+// allocate from it stay within a few arena blocks
+Arena *microbench_arena(Arena *arena, uint64_t iteration);
+
+// One per module, each in its own translation unit
+void bench_cookie(void);
+void bench_cors(void);
+void bench_helmet(void);
+void bench_session(void);
+void bench_static(void);
+
+#endif
@@ -7,6 +7,7 @@
 #include "uv.h"
 #include "ecewo.h"
 #include "ecewo-cluster.h"
+#include "ecewo-metrics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,8 +16,13 @@
 #include <inttypes.h>
 
 #include <unistd.h>
+#include <sched.h>
+#include <dirent.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
 #include <fcntl.h>
 #include <errno.h>
 
@@ -25,6 +31,35 @@
 #define RESPAWN_THROTTLE_COUNT 3
 #define RESPAWN_THROTTLE_WINDOW 5 // seconds
 
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#define NUMA_MAX_NODES 1024
+
+#define DEFAULT_STATS_INTERVAL_MS 1000
+#define STATS_ALIVE_INTERVALS 3
+
+#define IPC_FD_ENV "ECEWO_CLUSTER_IPC_FD"
+#define STEERING_FD_ENV "ECEWO_CLUSTER_STEERING_FD"
+#define INHERIT_ENV_PREFIX "ECEWO_" // ECEWO_*_FD variables name descriptors workers inherit
+#define INHERIT_ENV_SUFFIX "_FD"
+#define MAX_INHERITED_FDS 8
+#define WORKERS_ENV "ECEWO_CLUSTER_WORKERS"
+#define IPC_MAX_PAYLOAD 256
+#define IPC_MAX_QUEUED (64 * 1024)
+
+#define IPC_MSG_STATS 1
+#define IPC_MSG_READY 2
+#define IPC_MSG_METRIC 3 // MetricsSample: worker values up, cluster totals down
+
+_Static_assert(sizeof(MetricsSample) <= IPC_MAX_PAYLOAD, "MetricsSample must fit in one IPC message");
+
+#define RESPAWN_DELAY_MS 100
+#define DEFAULT_READY_TIMEOUT_MS 10000
+#define READY_CHECK_INTERVAL_MS 1000
+#define DEFAULT_SCALE_COOLDOWN_MS 30000
+
 #ifdef ECEWO_DEBUG
 #define LOG_DEBUG(fmt, ...) \
     fprintf(stderr, "[DEBUG] " fmt "\n", ##__VA_ARGS__)
@@ -35,20 +70,41 @@
 #define LOG_ERROR(fmt, ...) \
     fprintf(stderr, "[ERROR] " fmt "\n", ##__VA_ARGS__)
 
-typedef struct
+typedef struct ipc_channel_s ipc_channel_t;
+
+typedef struct worker_process_s worker_process_t;
+
+// One running process, freed once its handle is closed
+struct worker_process_s
 {
     uv_process_t handle;
+    ipc_channel_t *ipc;
+    ClusterWorkerStats stats;
+    MetricsSample *metrics; // latest report, METRICS_MAX entries once allocated
+    size_t metrics_count;
     uint8_t worker_id;
-    uint16_t port;
     bool active;
+    bool ready; // reported IPC_MSG_READY, its listener is accepting
+
+    time_t start_time;
+    uint64_t spawn_ms; // master loop time
+    int exit_status;
+
+    worker_process_t *next;
+};
+
+// One worker id; a rolling restart briefly runs two processes for it
+typedef struct
+{
+    uint8_t worker_id;
+    worker_process_t *current;
+    worker_process_t *replacement; // not ready yet
 
     time_t restart_times[RESPAWN_THROTTLE_COUNT];
     uint8_t restart_count;
     bool respawn_disabled;
-
-    time_t start_time;
-    int exit_status;
-} worker_process_t;
+    uv_timer_t respawn_timer;
+} worker_slot_t;
 
 static struct
 {
@@ -58,7 +114,11 @@ static struct
     uint16_t base_port;
     uint16_t worker_port;
 
-    worker_process_t *workers;
+    // Slots at and above worker_count were scaled away, they are kept
+    // until the cluster stops since their processes may still drain
+    worker_slot_t **slots;
+    uint8_t slot_count;
+    worker_process_t *processes; // every process not exited yet
     Cluster config;
 
     uv_signal_t sigterm;
@@ -72,10 +132,47 @@ static struct
     bool shutdown_requested;
     bool graceful_restart_requested;
 
+    // Rolling restart: slots below restart_next have been started
+    uint8_t restart_next;
+    uint8_t restart_end;
+    uint8_t restart_pending;
+    bool restart_failed;
+    uv_timer_t ready_timer;
+
+    // CPU worker i is pinned to: cpu_layout[i % cpu_layout_size]
+    uint16_t *cpu_layout;
+    uint16_t cpu_layout_size;
+    int worker_cpu; // -1 if the worker is not pinned
+    int steering_fd; // REUSEPORT_SOCKARRAY shared by all workers, -1 without steering
+    uv_prepare_t worker_setup;
+
+    // Worker side of the IPC channel
+    ipc_channel_t *worker_ipc;
+    uv_timer_t stats_timer;
+    uint64_t requests;
+    uint64_t stats_last_tick;
+    uint64_t stats_last_requests;
+    uint64_t stats_last_cpu_us;
+    uint64_t stats_last_events_waiting;
+
+    // Master side: requests reported by workers that were replaced
+    uint64_t retired_requests;
+    MetricsSample *retired_metrics; // their counters and histograms
+    size_t retired_metrics_count;
+
+    Metric *worker_exits;
+    Metric *worker_crashes;
+    Metric *worker_respawns;
+
+    ClusterAutoscale autoscale;
+    uv_timer_t autoscale_timer;
+    uint64_t last_scale_ms;
+
     bool initialized;
-} cluster_state = { 0 };
+} cluster_state = { .worker_cpu = -1, .steering_fd = -1 };
 
 static void on_exit_cb(uv_process_t *handle, int64_t exit_status, int term_signal);
+static void on_worker_ready(worker_process_t *worker);
 
 static void save_original_args(int argc, char **argv)
 {
@@ -202,20 +299,509 @@ static void free_worker_args(char **args)
     free(args);
 }
 
-static void setup_worker_stdio(uv_process_options_t *options)
+// Every message is a header followed by `length` payload bytes. Master
+// and workers are the same binary, so payloads are plain structs
+typedef struct
+{
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t length;
+} ipc_header_t;
+
+typedef struct
+{
+    uint64_t requests;
+    uint64_t rss_bytes;
+    uint32_t requests_per_sec;
+    uint32_t events_waiting;
+    uint32_t active_handles;
+    uint32_t loop_lag_us;
+    uint16_t cpu_permille;
+} ipc_stats_t;
+
+typedef void (*ipc_message_cb)(ipc_channel_t *ch, uint8_t type, const uint8_t *payload, uint16_t length);
+
+struct ipc_channel_s
+{
+    uv_pipe_t pipe;
+    ipc_message_cb on_message;
+    void *data;
+    bool closing;
+    size_t len;
+    uint8_t buf[2 * (sizeof(ipc_header_t) + IPC_MAX_PAYLOAD)];
+};
+
+typedef struct
+{
+    uv_write_t req;
+    uint8_t data[];
+} ipc_write_t;
+
+static void on_ipc_closed(uv_handle_t *handle)
+{
+    free(handle->data);
+}
+
+static void ipc_close(ipc_channel_t *ch)
+{
+    if (!ch || ch->closing)
+        return;
+
+    ch->closing = true;
+    uv_read_stop((uv_stream_t *)&ch->pipe);
+    uv_close((uv_handle_t *)&ch->pipe, on_ipc_closed);
+}
+
+static ipc_channel_t *ipc_create(uv_loop_t *loop, ipc_message_cb on_message, void *data)
+{
+    ipc_channel_t *ch = calloc(1, sizeof(ipc_channel_t));
+    if (!ch) {
+        LOG_ERROR("Failed to allocate IPC channel");
+        return NULL;
+    }
+
+    int result = uv_pipe_init(loop, &ch->pipe, 0);
+    if (result != 0) {
+        LOG_ERROR("uv_pipe_init failed: %s", uv_strerror(result));
+        free(ch);
+        return NULL;
+    }
+
+    ch->pipe.data = ch;
+    ch->on_message = on_message;
+    ch->data = data;
+    return ch;
+}
+
+static void on_ipc_write(uv_write_t *req, int status)
+{
+    (void)status;
+    free(req);
+}
+
+static int ipc_send(ipc_channel_t *ch, uint8_t type, const void *payload, uint16_t length)
+{
+    if (!ch || ch->closing || length > IPC_MAX_PAYLOAD)
+        return UV_EINVAL;
+
+    // The other side stopped reading, don't pile up messages for it
+    if (uv_stream_get_write_queue_size((uv_stream_t *)&ch->pipe) > IPC_MAX_QUEUED)
+        return UV_EAGAIN;
+
+    ipc_header_t header = { .type = type, .length = length };
+    ipc_write_t *w = malloc(sizeof(ipc_write_t) + sizeof(header) + length);
+    if (!w)
+        return UV_ENOMEM;
+
+    memcpy(w->data, &header, sizeof(header));
+    if (length)
+        memcpy(w->data + sizeof(header), payload, length);
+
+    uv_buf_t buf = uv_buf_init((char *)w->data, (unsigned int)(sizeof(header) + length));
+    int result = uv_write(&w->req, (uv_stream_t *)&ch->pipe, &buf, 1, on_ipc_write);
+    if (result != 0)
+        free(w);
+
+    return result;
+}
+
+static void on_ipc_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
+{
+    (void)suggested_size;
+    ipc_channel_t *ch = (ipc_channel_t *)handle->data;
+
+    buf->base = (char *)ch->buf + ch->len;
+    buf->len = sizeof(ch->buf) - ch->len;
+}
+
+static void on_ipc_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    (void)buf;
+    ipc_channel_t *ch = (ipc_channel_t *)stream->data;
+
+    if (nread < 0) {
+        // Hand EOF to the owner as an empty message so it can clean up
+        ch->on_message(ch, 0, NULL, 0);
+        ipc_close(ch);
+        return;
+    }
+
+    ch->len += (size_t)nread;
+
+    size_t offset = 0;
+    while (!ch->closing && ch->len - offset >= sizeof(ipc_header_t)) {
+        ipc_header_t header;
+        memcpy(&header, ch->buf + offset, sizeof(header));
+
+        if (header.length > IPC_MAX_PAYLOAD) {
+            LOG_ERROR("Invalid IPC message (type %" PRIu8 ", %" PRIu16 " bytes)",
+                      header.type, header.length);
+            ipc_close(ch);
+            return;
+        }
+
+        if (ch->len - offset < sizeof(header) + header.length)
+            break;
+
+        ch->on_message(ch, header.type, ch->buf + offset + sizeof(header), header.length);
+        offset += sizeof(header) + header.length;
+    }
+
+    memmove(ch->buf, ch->buf + offset, ch->len - offset);
+    ch->len -= offset;
+}
+
+// Adds sample to the entry of the same name, or appends it
+static size_t metrics_merge_into(MetricsSample *samples, size_t count, const MetricsSample *sample)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(samples[i].name, sample->name) != 0)
+            continue;
+
+        if (samples[i].type == sample->type)
+            metrics_sample_merge(&samples[i], sample);
+        return count;
+    }
+
+    if (count < METRICS_MAX)
+        samples[count++] = *sample;
+
+    return count;
+}
+
+static void store_worker_metric(worker_process_t *worker, const MetricsSample *sample)
+{
+    if (memchr(sample->name, '\0', METRICS_NAME_MAX) == NULL)
+        return;
+
+    if (!worker->metrics) {
+        worker->metrics = calloc(METRICS_MAX, sizeof(MetricsSample));
+        if (!worker->metrics)
+            return;
+    }
+
+    for (size_t i = 0; i < worker->metrics_count; i++) {
+        if (strcmp(worker->metrics[i].name, sample->name) == 0) {
+            worker->metrics[i] = *sample;
+            return;
+        }
+    }
+
+    if (worker->metrics_count < METRICS_MAX)
+        worker->metrics[worker->metrics_count++] = *sample;
+}
+
+// Counters and histograms of an exited worker stay in the totals
+static void retire_worker_metrics(worker_process_t *worker)
+{
+    if (worker->metrics_count == 0)
+        return;
+
+    if (!cluster_state.retired_metrics) {
+        cluster_state.retired_metrics = calloc(METRICS_MAX, sizeof(MetricsSample));
+        if (!cluster_state.retired_metrics)
+            return;
+    }
+
+    for (size_t i = 0; i < worker->metrics_count; i++) {
+        if (worker->metrics[i].type == METRICS_GAUGE)
+            continue;
+
+        cluster_state.retired_metrics_count = metrics_merge_into(cluster_state.retired_metrics,
+                                                                 cluster_state.retired_metrics_count,
+                                                                 &worker->metrics[i]);
+    }
+}
+
+// Sums the master's own metrics, the retired ones and the latest report
+// of every running worker, and sends the totals to one worker
+static void send_cluster_metrics(worker_process_t *target)
+{
+    if (!target->ipc)
+        return;
+
+    MetricsSample *totals = calloc(METRICS_MAX, sizeof(MetricsSample));
+    if (!totals)
+        return;
+
+    size_t count = 0;
+    MetricsSample sample;
+
+    for (size_t i = 0; metrics_sample(i, &sample); i++)
+        count = metrics_merge_into(totals, count, &sample);
+
+    for (size_t i = 0; i < cluster_state.retired_metrics_count; i++)
+        count = metrics_merge_into(totals, count, &cluster_state.retired_metrics[i]);
+
+    for (worker_process_t *worker = cluster_state.processes; worker; worker = worker->next) {
+        for (size_t i = 0; i < worker->metrics_count; i++)
+            count = metrics_merge_into(totals, count, &worker->metrics[i]);
+    }
+
+    for (size_t i = 0; i < count; i++)
+        ipc_send(target->ipc, IPC_MSG_METRIC, &totals[i], sizeof(MetricsSample));
+
+    free(totals);
+}
+
+// Master side: keeps the latest report of each worker
+static void on_master_message(ipc_channel_t *ch, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    worker_process_t *worker = (worker_process_t *)ch->data;
+
+    if (type == 0) {
+        if (worker->ipc == ch)
+            worker->ipc = NULL;
+        return;
+    }
+
+    if (type == IPC_MSG_READY) {
+        if (!worker->ready) {
+            worker->ready = true;
+            on_worker_ready(worker);
+        }
+        return;
+    }
+
+    if (type == IPC_MSG_METRIC && length == sizeof(MetricsSample)) {
+        MetricsSample sample;
+        memcpy(&sample, payload, sizeof(sample));
+        store_worker_metric(worker, &sample);
+        return;
+    }
+
+    if (type != IPC_MSG_STATS || length != sizeof(ipc_stats_t))
+        return;
+
+    ipc_stats_t sample;
+    memcpy(&sample, payload, sizeof(sample));
+
+    ClusterWorkerStats *stats = &worker->stats;
+    stats->requests = sample.requests;
+    stats->requests_per_sec = sample.requests_per_sec;
+    stats->events_waiting = sample.events_waiting;
+    stats->active_handles = sample.active_handles;
+    stats->rss_bytes = sample.rss_bytes;
+    stats->loop_lag_us = sample.loop_lag_us;
+    stats->cpu_permille = sample.cpu_permille;
+    stats->updated_ms = uv_now(uv_default_loop());
+
+    // Workers send their metrics right before the stats, so the
+    // totals they get back already include this round
+    send_cluster_metrics(worker);
+}
+
+static uint64_t cpu_time_us(void)
+{
+    uv_rusage_t usage;
+    if (uv_getrusage(&usage) != 0)
+        return 0;
+
+    return (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static void count_active_handle(uv_handle_t *handle, void *arg)
+{
+    if (uv_is_active(handle) && !uv_is_closing(handle))
+        (*(uint32_t *)arg)++;
+}
+
+static void on_stats_timer(uv_timer_t *handle)
+{
+    uint64_t now = uv_hrtime();
+    uint64_t elapsed_ns = now - cluster_state.stats_last_tick;
+    uint64_t interval_ns = (uint64_t)cluster_state.config.stats_interval_ms * 1000000;
+    uint64_t cpu_us = cpu_time_us();
+
+    if (elapsed_ns == 0)
+        return;
+
+    ipc_stats_t sample = { 0 };
+    sample.requests = cluster_state.requests;
+    sample.requests_per_sec = (uint32_t)((cluster_state.requests - cluster_state.stats_last_requests) *
+                                         1000000000ULL / elapsed_ns);
+    sample.loop_lag_us = elapsed_ns > interval_ns ? (uint32_t)((elapsed_ns - interval_ns) / 1000) : 0;
+    sample.cpu_permille = (uint16_t)((cpu_us - cluster_state.stats_last_cpu_us) * 1000000 / elapsed_ns);
+
+    // libuv keeps a running total, the stats show the last interval
+    uv_metrics_t loop_metrics;
+    if (uv_metrics_info(handle->loop, &loop_metrics) == 0) {
+        sample.events_waiting = (uint32_t)(loop_metrics.events_waiting - cluster_state.stats_last_events_waiting);
+        cluster_state.stats_last_events_waiting = loop_metrics.events_waiting;
+    }
+
+    uv_walk(handle->loop, count_active_handle, &sample.active_handles);
+
+    size_t rss = 0;
+    if (uv_resident_set_memory(&rss) == 0)
+        sample.rss_bytes = rss;
+
+    cluster_state.stats_last_tick = now;
+    cluster_state.stats_last_requests = cluster_state.requests;
+    cluster_state.stats_last_cpu_us = cpu_us;
+
+    MetricsSample metric;
+    for (size_t i = 0; metrics_sample(i, &metric); i++)
+        ipc_send(cluster_state.worker_ipc, IPC_MSG_METRIC, &metric, sizeof(metric));
+
+    ipc_send(cluster_state.worker_ipc, IPC_MSG_STATS, &sample, sizeof(sample));
+}
+
+// Worker side: the master sends cluster-wide metric totals, EOF means it is gone
+static void on_worker_message(ipc_channel_t *ch, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    if (type == IPC_MSG_METRIC && length == sizeof(MetricsSample)) {
+        MetricsSample sample;
+        memcpy(&sample, payload, sizeof(sample));
+        metrics_set_cluster_sample(&sample);
+        return;
+    }
+
+    if (type != 0)
+        return;
+
+    LOG_DEBUG("Lost connection to master");
+    if (cluster_state.worker_ipc == ch)
+        cluster_state.worker_ipc = NULL;
+    uv_timer_stop(&cluster_state.stats_timer);
+}
+
+static void start_worker_ipc(void)
+{
+    static bool started = false;
+
+    if (started)
+        return;
+
+    const char *fd_env = getenv(IPC_FD_ENV);
+    uv_loop_t *loop = get_loop();
+    if (!fd_env || !loop)
+        return;
+
+    started = true;
+
+    ipc_channel_t *ch = ipc_create(loop, on_worker_message, NULL);
+    if (!ch)
+        return;
+
+    int result = uv_pipe_open(&ch->pipe, atoi(fd_env));
+    if (result == 0)
+        result = uv_read_start((uv_stream_t *)&ch->pipe, on_ipc_alloc, on_ipc_read);
+
+    if (result != 0) {
+        LOG_ERROR("Failed to open IPC channel: %s", uv_strerror(result));
+        ipc_close(ch);
+        return;
+    }
+
+    // The server keeps the loop alive, not the channel to the master
+    uv_unref((uv_handle_t *)&ch->pipe);
+    cluster_state.worker_ipc = ch;
+
+    uv_timer_init(loop, &cluster_state.stats_timer);
+    uv_unref((uv_handle_t *)&cluster_state.stats_timer);
+
+    cluster_state.stats_last_tick = uv_hrtime();
+    cluster_state.stats_last_cpu_us = cpu_time_us();
+    uv_timer_start(&cluster_state.stats_timer, on_stats_timer,
+                   cluster_state.config.stats_interval_ms,
+                   cluster_state.config.stats_interval_ms);
+}
+
+void cluster_track_requests(Req *req, Res *res, Next next)
+{
+    cluster_state.requests++;
+    next(req, res);
+}
+
+// Descriptors a worker starts with. Each one is placed at its index in the
+// stdio array and announced under that number, so none of them can land on
+// a descriptor number another one already uses in the worker
+typedef struct
+{
+    uv_stdio_container_t stdio[3 + 2 + MAX_INHERITED_FDS];
+    int count;
+    char env[2 + MAX_INHERITED_FDS][128];
+    int env_count;
+} worker_stdio_t;
+
+// Matches ECEWO_*_FD=<fd> entries exported by other modules, such as the
+// shared session segment, but not the ones the cluster sets itself
+static int inherited_fd_env(const char *entry, size_t *name_len)
+{
+    const char *eq = strchr(entry, '=');
+    if (!eq)
+        return -1;
+
+    size_t len = (size_t)(eq - entry);
+    size_t prefix = sizeof(INHERIT_ENV_PREFIX) - 1;
+    size_t suffix = sizeof(INHERIT_ENV_SUFFIX) - 1;
+    if (len <= prefix + suffix
+        || strncmp(entry, INHERIT_ENV_PREFIX, prefix) != 0
+        || strncmp(eq - suffix, INHERIT_ENV_SUFFIX, suffix) != 0)
+        return -1;
+
+    if ((len == sizeof(IPC_FD_ENV) - 1 && strncmp(entry, IPC_FD_ENV, len) == 0)
+        || (len == sizeof(STEERING_FD_ENV) - 1 && strncmp(entry, STEERING_FD_ENV, len) == 0))
+        return -1;
+
+    char *end;
+    long fd = strtol(eq + 1, &end, 10);
+    if (end == eq + 1 || *end || fd < 0 || fd > INT32_MAX || fcntl((int)fd, F_GETFD) < 0)
+        return -1;
+
+    *name_len = len;
+    return (int)fd;
+}
+
+static void stdio_add(worker_stdio_t *fds, const char *env, size_t env_len, int fd)
 {
-    static uv_stdio_container_t stdio[3];
+    int index = fds->count++;
+    fds->stdio[index].flags = UV_INHERIT_FD;
+    fds->stdio[index].data.fd = fd;
+
+    snprintf(fds->env[fds->env_count++], sizeof(fds->env[0]), "%.*s=%d", (int)env_len, env, index);
+}
+
+static void setup_worker_stdio(worker_stdio_t *fds, ipc_channel_t *ipc)
+{
+    extern char **environ;
+
+    memset(fds, 0, sizeof(*fds));
+
+    fds->stdio[0].flags = UV_IGNORE;
+
+    fds->stdio[1].flags = UV_INHERIT_FD;
+    fds->stdio[1].data.fd = 1;
 
-    stdio[0].flags = UV_IGNORE;
+    fds->stdio[2].flags = UV_INHERIT_FD;
+    fds->stdio[2].data.fd = 2;
 
-    stdio[1].flags = UV_INHERIT_FD;
-    stdio[1].data.fd = 1;
+    fds->count = 3;
 
-    stdio[2].flags = UV_INHERIT_FD;
-    stdio[2].data.fd = 2;
+    int index = fds->count++;
+    fds->stdio[index].flags = UV_CREATE_PIPE | UV_READABLE_PIPE | UV_WRITABLE_PIPE;
+    fds->stdio[index].data.stream = (uv_stream_t *)&ipc->pipe;
+    snprintf(fds->env[fds->env_count++], sizeof(fds->env[0]), IPC_FD_ENV "=%d", index);
 
-    options->stdio_count = 3;
-    options->stdio = stdio;
+    if (cluster_state.steering_fd >= 0)
+        stdio_add(fds, STEERING_FD_ENV, sizeof(STEERING_FD_ENV) - 1, cluster_state.steering_fd);
+
+    int inherited = 0;
+    for (char **env = environ; *env; env++) {
+        size_t name_len;
+        int fd = inherited_fd_env(*env, &name_len);
+        if (fd < 0)
+            continue;
+
+        if (inherited++ == MAX_INHERITED_FDS) {
+            LOG_ERROR("Too many inherited descriptors, %.*s not passed to workers", (int)name_len, *env);
+            continue;
+        }
+
+        stdio_add(fds, *env, name_len, fd);
+    }
 }
 
 static void apply_config(const Cluster *config)
@@ -236,8 +822,23 @@ static void apply_config(const Cluster *config)
         cluster_state.config.respawn = config->respawn;
         cluster_state.config.on_start = config->on_start;
         cluster_state.config.on_exit = config->on_exit;
+        cluster_state.config.pin_workers = config->pin_workers;
+        cluster_state.config.numa_local = config->numa_local;
+        cluster_state.config.reuseport_steering = config->reuseport_steering;
+        cluster_state.config.stats_interval_ms = config->stats_interval_ms;
+        cluster_state.config.restart_batch = config->restart_batch;
+        cluster_state.config.ready_timeout_ms = config->ready_timeout_ms;
     }
 
+    if (!cluster_state.config.stats_interval_ms)
+        cluster_state.config.stats_interval_ms = DEFAULT_STATS_INTERVAL_MS;
+
+    if (!cluster_state.config.restart_batch)
+        cluster_state.config.restart_batch = 1;
+
+    if (!cluster_state.config.ready_timeout_ms)
+        cluster_state.config.ready_timeout_ms = DEFAULT_READY_TIMEOUT_MS;
+
     uint8_t cpu_count = cluster_cpus();
     if (cluster_state.worker_count > cpu_count * 2)
         LOG_DEBUG("WARNING: %" PRIu8 " workers > 2x CPU count (%" PRIu8 ") - may cause contention",
@@ -245,30 +846,30 @@ static void apply_config(const Cluster *config)
                   cpu_count);
 }
 
-static bool should_respawn_worker(worker_process_t *worker)
+static bool should_respawn_worker(worker_slot_t *slot)
 {
-    if (!cluster_state.config.respawn || worker->respawn_disabled)
+    if (!cluster_state.config.respawn || slot->respawn_disabled)
         return false;
 
     time_t now = time(NULL);
 
-    if (worker->restart_count >= RESPAWN_THROTTLE_COUNT) {
+    if (slot->restart_count >= RESPAWN_THROTTLE_COUNT) {
         for (int i = 0; i < RESPAWN_THROTTLE_COUNT - 1; i++) {
-            worker->restart_times[i] = worker->restart_times[i + 1];
+            slot->restart_times[i] = slot->restart_times[i + 1];
         }
 
-        worker->restart_count = RESPAWN_THROTTLE_COUNT - 1;
+        slot->restart_count = RESPAWN_THROTTLE_COUNT - 1;
     }
 
-    worker->restart_times[worker->restart_count++] = now;
+    slot->restart_times[slot->restart_count++] = now;
 
-    if (worker->restart_count >= RESPAWN_THROTTLE_COUNT) {
-        time_t window = now - worker->restart_times[0];
+    if (slot->restart_count >= RESPAWN_THROTTLE_COUNT) {
+        time_t window = now - slot->restart_times[0];
         if (window < RESPAWN_THROTTLE_WINDOW) {
             LOG_ERROR("Worker %" PRIu8 " crashing too fast (%d times in %lds), disabling respawn",
-                      worker->worker_id, RESPAWN_THROTTLE_COUNT, (long)window);
+                      slot->worker_id, RESPAWN_THROTTLE_COUNT, (long)window);
 
-            worker->respawn_disabled = true;
+            slot->respawn_disabled = true;
             return false;
         }
     }
@@ -276,32 +877,61 @@ static bool should_respawn_worker(worker_process_t *worker)
     return true;
 }
 
-static int spawn_worker(uint8_t worker_id, uint16_t port)
+static void on_process_closed(uv_handle_t *handle)
+{
+    worker_process_t *worker = (worker_process_t *)handle->data;
+    free(worker->metrics);
+    free(worker);
+}
+
+static void unlink_process(worker_process_t *worker)
+{
+    worker_process_t **link = &cluster_state.processes;
+
+    while (*link && *link != worker)
+        link = &(*link)->next;
+
+    if (*link)
+        *link = worker->next;
+
+    worker->next = NULL;
+}
+
+static worker_process_t *spawn_worker(uint8_t worker_id)
 {
     if (worker_id >= cluster_state.worker_count) {
         LOG_ERROR("Invalid worker ID: %" PRIu8, worker_id);
-        return -1;
+        return NULL;
     }
 
     if (!cluster_state.original_argv) {
         LOG_ERROR("Original arguments not saved");
-        return -1;
+        return NULL;
     }
 
-    worker_process_t *worker = &cluster_state.workers[worker_id];
+    worker_process_t *worker = calloc(1, sizeof(worker_process_t));
+    if (!worker) {
+        LOG_ERROR("Failed to allocate worker %" PRIu8, worker_id);
+        return NULL;
+    }
 
-    memset(worker, 0, sizeof(worker_process_t));
     worker->worker_id = worker_id;
-    worker->port = port;
-    worker->active = false;
-    worker->respawn_disabled = false;
-    worker->restart_count = 0;
     worker->start_time = time(NULL);
+    worker->spawn_ms = uv_now(uv_default_loop());
+    worker->stats.worker_id = worker_id;
 
-    char **args = build_worker_args(worker_id, port);
+    char **args = build_worker_args(worker_id, cluster_state.base_port);
     if (!args) {
         LOG_ERROR("Failed to build worker arguments");
-        return -1;
+        free(worker);
+        return NULL;
+    }
+
+    ipc_channel_t *ipc = ipc_create(uv_default_loop(), on_master_message, worker);
+    if (!ipc) {
+        free_worker_args(args);
+        free(worker);
+        return NULL;
     }
 
     uv_process_options_t options = { 0 };
@@ -309,7 +939,10 @@ static int spawn_worker(uint8_t worker_id, uint16_t port)
     options.args = args;
     options.exit_cb = on_exit_cb;
 
-    setup_worker_stdio(&options);
+    worker_stdio_t fds;
+    setup_worker_stdio(&fds, ipc);
+    options.stdio = fds.stdio;
+    options.stdio_count = fds.count;
 
     extern char **environ;
 
@@ -317,13 +950,25 @@ static int spawn_worker(uint8_t worker_id, uint16_t port)
     while (environ[env_count])
         env_count++;
 
-    char *new_env[env_count + 2];
+    char *new_env[env_count + 3 + fds.env_count];
+    int n = 0;
 
-    for (int i = 0; i < env_count; i++)
-        new_env[i] = environ[i];
+    // Descriptor variables are replaced by the numbers the worker sees
+    for (int i = 0; i < env_count; i++) {
+        size_t name_len;
+        if (inherited_fd_env(environ[i], &name_len) < 0)
+            new_env[n++] = environ[i];
+    }
+
+    // Workers started after scaling see the current count
+    char workers_env[sizeof(WORKERS_ENV) + 8];
+    snprintf(workers_env, sizeof(workers_env), WORKERS_ENV "=%" PRIu8, cluster_state.worker_count);
 
-    new_env[env_count] = "ECEWO_WORKER=1";
-    new_env[env_count + 1] = NULL;
+    new_env[n++] = "ECEWO_WORKER=1";
+    new_env[n++] = workers_env;
+    for (int i = 0; i < fds.env_count; i++)
+        new_env[n++] = fds.env[i];
+    new_env[n] = NULL;
 
     options.env = new_env;
     options.flags = UV_PROCESS_DETACHED;
@@ -337,217 +982,842 @@ static int spawn_worker(uint8_t worker_id, uint16_t port)
 
     if (result != 0) {
         LOG_ERROR("Failed to spawn worker %" PRIu8 ": %s", worker_id, uv_strerror(result));
-        return -1;
+        ipc_close(ipc);
+        // The handle is initialized even if the spawn failed
+        uv_close((uv_handle_t *)handle, on_process_closed);
+        return NULL;
     }
 
     worker->active = true;
+    worker->stats.pid = handle->pid;
+    worker->next = cluster_state.processes;
+    cluster_state.processes = worker;
+
+    result = uv_read_start((uv_stream_t *)&ipc->pipe, on_ipc_alloc, on_ipc_read);
+    if (result != 0) {
+        LOG_ERROR("Failed to read from worker %" PRIu8 ": %s", worker_id, uv_strerror(result));
+        ipc_close(ipc);
+    } else {
+        worker->ipc = ipc;
+    }
 
     if (cluster_state.config.on_start)
         cluster_state.config.on_start(worker_id);
 
-    return 0;
+    return worker;
 }
 
-static void on_exit_cb(uv_process_t *handle, int64_t exit_status, int term_signal)
+static void on_respawn_timer(uv_timer_t *handle)
 {
-    worker_process_t *worker = (worker_process_t *)handle->data;
+    worker_slot_t *slot = (worker_slot_t *)handle->data;
 
-    if (!worker || !cluster_state.is_master)
+    if (cluster_state.shutdown_requested || slot->current || slot->replacement)
         return;
 
-    uint8_t worker_id = worker->worker_id;
-    time_t uptime = time(NULL) - worker->start_time;
+    slot->current = spawn_worker(slot->worker_id);
+    if (!slot->current)
+        LOG_ERROR("Failed to respawn worker %" PRIu8, slot->worker_id);
+    else
+        metrics_inc(cluster_state.worker_respawns);
+}
 
-    worker->active = false;
-    worker->exit_status = (int)exit_status;
+static void restart_advance(void);
 
-    bool is_crash = !cluster_state.shutdown_requested && !cluster_state.graceful_restart_requested && exit_status != 0;
+// Stops a rolling restart from replacing further workers; the batch
+// already started still completes
+static void restart_abort(const char *reason, uint8_t worker_id)
+{
+    LOG_ERROR("Rolling restart aborted: worker %" PRIu8 " %s", worker_id, reason);
+
+    cluster_state.restart_failed = true;
+    cluster_state.restart_next = cluster_state.restart_end;
+}
+
+static void restart_advance(void)
+{
+    // Workers added by cluster_scale() meanwhile already run the new code
+    if (cluster_state.restart_end > cluster_state.worker_count)
+        cluster_state.restart_end = cluster_state.worker_count;
+
+    if (cluster_state.shutdown_requested)
+        cluster_state.restart_next = cluster_state.restart_end;
+
+    while (cluster_state.restart_pending < cluster_state.config.restart_batch &&
+           cluster_state.restart_next < cluster_state.restart_end) {
+        worker_slot_t *slot = cluster_state.slots[cluster_state.restart_next++];
+
+        slot->replacement = spawn_worker(slot->worker_id);
+        if (!slot->replacement) {
+            restart_abort("could not be spawned", slot->worker_id);
+            break;
+        }
+
+        cluster_state.restart_pending++;
+    }
+
+    if (cluster_state.restart_pending > 0)
+        return;
+
+    uv_timer_stop(&cluster_state.ready_timer);
+    cluster_state.graceful_restart_requested = false;
+
+    if (!cluster_state.restart_failed)
+        LOG_DEBUG("Rolling restart completed");
+}
+
+static void on_worker_ready(worker_process_t *worker)
+{
+    worker_slot_t *slot = cluster_state.slots[worker->worker_id];
+
+    LOG_DEBUG("Worker %" PRIu8 " ready (pid %d)", worker->worker_id, worker->stats.pid);
+
+    if (slot->replacement != worker)
+        return;
+
+    worker_process_t *old = slot->current;
+
+    slot->current = worker;
+    slot->replacement = NULL;
+    slot->respawn_disabled = false;
+    slot->restart_count = 0;
+
+    // The replacement accepts connections on the same port by now, so the
+    // old process can stop listening and finish its requests
+    if (old && old->active)
+        uv_process_kill(&old->handle, WORKER_STOP_SIGNAL);
+
+    cluster_state.restart_pending--;
+    restart_advance();
+}
+
+// Kills replacements that never reported ready
+static void on_ready_timer(uv_timer_t *handle)
+{
+    uint64_t now = uv_now(handle->loop);
+
+    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
+        worker_process_t *worker = cluster_state.slots[i]->replacement;
+
+        if (worker && worker->active &&
+            now - worker->spawn_ms > cluster_state.config.ready_timeout_ms) {
+            LOG_ERROR("Worker %" PRIu8 " not ready after %" PRIu32 " ms, killing it",
+                      i, cluster_state.config.ready_timeout_ms);
+            uv_process_kill(&worker->handle, SIGKILL);
+        }
+    }
+}
+
+static void on_exit_cb(uv_process_t *handle, int64_t exit_status, int term_signal)
+{
+    worker_process_t *worker = (worker_process_t *)handle->data;
+
+    if (!worker || !cluster_state.is_master)
+        return;
+
+    uint8_t worker_id = worker->worker_id;
+    worker_slot_t *slot = cluster_state.slots[worker_id];
+    time_t uptime = time(NULL) - worker->start_time;
+
+    worker->active = false;
+    worker->exit_status = (int)exit_status;
+
+    ipc_close(worker->ipc);
+    worker->ipc = NULL;
+
+    unlink_process(worker);
+
+    // Keeps the cluster-wide request total from dropping
+    cluster_state.retired_requests += worker->stats.requests;
+    retire_worker_metrics(worker);
+    worker->metrics_count = 0;
+
+    bool is_current = slot->current == worker;
+    bool is_crash = is_current && !cluster_state.shutdown_requested &&
+                    (exit_status != 0 || term_signal != 0);
+
+    if (term_signal == SIGTERM || term_signal == SIGINT)
+        is_crash = false;
+
+    if (is_crash) {
+        LOG_ERROR("Worker %" PRIu8 " crashed after %ld seconds (exit: %d, signal: %d)",
+                  worker_id, (long)uptime, (int)exit_status, term_signal);
+        metrics_inc(cluster_state.worker_crashes);
+    }
+
+    if (!cluster_state.shutdown_requested)
+        metrics_inc(cluster_state.worker_exits);
+
+    if (cluster_state.config.on_exit)
+        cluster_state.config.on_exit(worker_id, (int)exit_status);
+
+    uv_close((uv_handle_t *)handle, on_process_closed);
+
+    if (slot->replacement == worker) {
+        slot->replacement = NULL;
+        cluster_state.restart_pending--;
+
+        if (!cluster_state.shutdown_requested)
+            restart_abort("exited before it was ready", worker_id);
+
+        restart_advance();
+        return;
+    }
+
+    // A retired process finished draining
+    if (!is_current)
+        return;
+
+    slot->current = NULL;
+
+    if (worker_id >= cluster_state.worker_count)
+        return;
+
+    if (is_crash && should_respawn_worker(slot))
+        uv_timer_start(&slot->respawn_timer, on_respawn_timer, RESPAWN_DELAY_MS, 0);
+}
+
+static void stop_all_workers(void)
+{
+    for (worker_process_t *w = cluster_state.processes; w; w = w->next)
+        uv_process_kill(&w->handle, WORKER_STOP_SIGNAL);
+
+    for (uint8_t i = 0; i < cluster_state.slot_count; i++)
+        uv_timer_stop(&cluster_state.slots[i]->respawn_timer);
+
+    uv_timer_stop(&cluster_state.autoscale_timer);
+}
+
+static void on_sigterm(uv_signal_t *handle, int signum)
+{
+    (void)handle;
+    (void)signum;
+
+    if (!cluster_state.is_master)
+        return;
+
+    if (cluster_state.shutdown_requested)
+        return;
+
+    LOG_DEBUG("Shutdown requested (SIGTERM)");
+    cluster_state.shutdown_requested = true;
+    stop_all_workers();
+}
+
+static void on_sigint(uv_signal_t *handle, int signum)
+{
+    (void)handle;
+    (void)signum;
+
+    if (!cluster_state.is_master)
+        return;
+
+    if (cluster_state.shutdown_requested)
+        return;
+
+    LOG_DEBUG("\nShutdown requested (SIGINT)...");
+    cluster_state.shutdown_requested = true;
+    stop_all_workers();
+}
+
+// Rolling restart: each worker is replaced by a new process, which has to
+// report ready before the old one is stopped, so capacity never drops
+static void on_sigusr2(uv_signal_t *handle, int signum)
+{
+    (void)handle;
+    (void)signum;
+
+    if (!cluster_state.is_master)
+        return;
+
+    if (cluster_state.graceful_restart_requested || cluster_state.shutdown_requested)
+        return;
+
+    LOG_DEBUG("Rolling restart requested (SIGUSR2)");
+
+    cluster_state.graceful_restart_requested = true;
+    cluster_state.restart_failed = false;
+    cluster_state.restart_next = 0;
+    cluster_state.restart_end = cluster_state.worker_count;
+    cluster_state.restart_pending = 0;
+
+    uv_timer_start(&cluster_state.ready_timer, on_ready_timer,
+                   READY_CHECK_INTERVAL_MS, READY_CHECK_INTERVAL_MS);
+    restart_advance();
+}
+
+static void setup_signal_handlers(void)
+{
+    if (!cluster_state.is_master)
+        return;
+
+    uv_signal_init(uv_default_loop(), &cluster_state.sigterm);
+    uv_signal_start(&cluster_state.sigterm, on_sigterm, SIGTERM);
+
+    uv_signal_init(uv_default_loop(), &cluster_state.sigint);
+    uv_signal_start(&cluster_state.sigint, on_sigint, SIGINT);
+
+    uv_signal_init(uv_default_loop(), &cluster_state.sigusr2);
+    uv_signal_start(&cluster_state.sigusr2, on_sigusr2, SIGUSR2);
+}
+
+static void cleanup_signal_handlers(void)
+{
+    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigterm)) {
+        uv_signal_stop(&cluster_state.sigterm);
+        uv_close((uv_handle_t *)&cluster_state.sigterm, NULL);
+    }
+
+    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigint)) {
+        uv_signal_stop(&cluster_state.sigint);
+        uv_close((uv_handle_t *)&cluster_state.sigint, NULL);
+    }
+
+    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigusr2)) {
+        uv_signal_stop(&cluster_state.sigusr2);
+        uv_close((uv_handle_t *)&cluster_state.sigusr2, NULL);
+    }
+}
+
+static void close_handle_cb(uv_handle_t *handle, void *arg)
+{
+    (void)arg;
+
+    if (uv_is_closing(handle))
+        return;
+
+    if (handle->type == UV_SIGNAL) {
+        uv_signal_stop((uv_signal_t *)handle);
+        uv_close(handle, NULL);
+    } else if (handle->type == UV_PROCESS) {
+        uv_close(handle, on_process_closed);
+    } else {
+        uv_close(handle, NULL);
+    }
+}
+
+static void cluster_cleanup(void)
+{
+    if (!cluster_state.initialized)
+        return;
+
+    free(cluster_state.cpu_layout);
+    cluster_state.cpu_layout = NULL;
+    cluster_state.cpu_layout_size = 0;
+
+    if (cluster_state.steering_fd >= 0) {
+        close(cluster_state.steering_fd);
+        cluster_state.steering_fd = -1;
+    }
+
+    cleanup_original_args();
+    uv_loop_t *loop = uv_default_loop();
+    cleanup_signal_handlers();
+    uv_walk(loop, close_handle_cb, NULL);
+    cluster_state.processes = NULL;
+
+    int iterations = 0;
+    while (uv_loop_alive(loop) && iterations < 50) {
+        uv_run(loop, UV_RUN_NOWAIT);
+        uv_sleep(100);
+        iterations++;
+    }
+
+    int result = uv_loop_close(loop);
+    if (result != 0) {
+        uv_walk(loop, close_handle_cb, NULL);
+        uv_run(loop, UV_RUN_NOWAIT);
+        uv_loop_close(loop);
+    }
+
+    // Freed after the loop, their timers were still registered with it
+    if (cluster_state.slots) {
+        for (uint8_t i = 0; i < cluster_state.slot_count; i++)
+            free(cluster_state.slots[i]);
+
+        free(cluster_state.slots);
+        cluster_state.slots = NULL;
+        cluster_state.slot_count = 0;
+    }
+
+    free(cluster_state.retired_metrics);
+    cluster_state.retired_metrics = NULL;
+    cluster_state.retired_metrics_count = 0;
+
+    cluster_state.initialized = false;
+}
+
+static int read_cpu_topology(int cpu, const char *name)
+{
+    char path[256];
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    uv_fs_t open_req;
+    int fd = uv_fs_open(NULL, &open_req, path, O_RDONLY, 0, NULL);
+    uv_fs_req_cleanup(&open_req);
+
+    if (fd < 0)
+        return -1;
+
+    char buf[32];
+    uv_buf_t uv_buf = uv_buf_init(buf, sizeof(buf) - 1);
+
+    uv_fs_t read_req;
+    int nread = uv_fs_read(NULL, &read_req, fd, &uv_buf, 1, 0, NULL);
+    uv_fs_req_cleanup(&read_req);
+
+    uv_fs_t close_req;
+    uv_fs_close(NULL, &close_req, fd, NULL);
+    uv_fs_req_cleanup(&close_req);
+
+    if (nread <= 0)
+        return -1;
+
+    buf[nread] = '\0';
+    return atoi(buf);
+}
+
+// Worker i runs on cpu_layout[i % cpu_layout_size]. Without a cpuset,
+// every CPU the process may use is listed, the first hyperthread of each
+// physical core ahead of its siblings, so workers get a core of their
+// own before any two of them share one
+static bool build_cpu_layout(const Cluster *config)
+{
+    if (config->cpuset && config->cpuset_size > 0) {
+        cluster_state.cpu_layout = malloc(config->cpuset_size * sizeof(uint16_t));
+        if (!cluster_state.cpu_layout) {
+            LOG_ERROR("Failed to allocate CPU layout");
+            return false;
+        }
+
+        for (uint16_t i = 0; i < config->cpuset_size; i++) {
+            if (config->cpuset[i] >= CPU_SETSIZE) {
+                LOG_ERROR("Invalid CPU in cpuset: %" PRIu16, config->cpuset[i]);
+                free(cluster_state.cpu_layout);
+                cluster_state.cpu_layout = NULL;
+                return false;
+            }
+            cluster_state.cpu_layout[i] = config->cpuset[i];
+        }
+
+        cluster_state.cpu_layout_size = config->cpuset_size;
+        return true;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        LOG_ERROR("sched_getaffinity failed: %s", strerror(errno));
+        return false;
+    }
+
+    int count = CPU_COUNT(&allowed);
+    uint16_t *layout = malloc(count * 2 * sizeof(uint16_t));
+    long *cores = malloc(count * sizeof(long));
+    if (!layout || !cores) {
+        LOG_ERROR("Failed to allocate CPU layout");
+        free(layout);
+        free(cores);
+        return false;
+    }
+
+    uint16_t *siblings = layout + count;
+    int primary_count = 0;
+    int sibling_count = 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && primary_count + sibling_count < count; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+
+        int core_id = read_cpu_topology(cpu, "core_id");
+        int package_id = read_cpu_topology(cpu, "physical_package_id");
+        bool seen = false;
+
+        if (core_id >= 0) {
+            long core = ((long)package_id << 20) | core_id;
+            for (int i = 0; i < primary_count && !seen; i++)
+                seen = cores[i] == core;
+            if (!seen)
+                cores[primary_count] = core;
+        } else {
+            cores[primary_count] = -1 - cpu;
+        }
+
+        if (seen)
+            siblings[sibling_count++] = (uint16_t)cpu;
+        else
+            layout[primary_count++] = (uint16_t)cpu;
+    }
+
+    memmove(layout + primary_count, siblings, sibling_count * sizeof(uint16_t));
+    free(cores);
+
+    cluster_state.cpu_layout = layout;
+    cluster_state.cpu_layout_size = (uint16_t)(primary_count + sibling_count);
+    return cluster_state.cpu_layout_size > 0;
+}
+
+static int cpu_numa_node(uint16_t cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%" PRIu16, cpu);
+
+    DIR *dir = opendir(path);
+    if (!dir)
+        return -1;
+
+    int node = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1)
+            break;
+        node = -1;
+    }
+
+    closedir(dir);
+    return node;
+}
+
+// MPOL_PREFERRED rather than MPOL_BIND: a worker whose node runs out
+// of memory keeps running on remote memory instead of being OOM-killed
+static void prefer_numa_node(uint16_t cpu)
+{
+    int node = cpu_numa_node(cpu);
+    if (node < 0 || node >= NUMA_MAX_NODES) {
+        LOG_DEBUG("No NUMA node found for CPU %" PRIu16, cpu);
+        return;
+    }
+
+    unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, NUMA_MAX_NODES) != 0)
+        LOG_ERROR("Failed to prefer NUMA node %d: %s", node, strerror(errno));
+}
+
+static void pin_worker(void)
+{
+    if (!cluster_state.cpu_layout_size)
+        return;
+
+    uint16_t cpu = cluster_state.cpu_layout[cluster_state.worker_id % cluster_state.cpu_layout_size];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        LOG_ERROR("Failed to pin worker %" PRIu8 " to CPU %" PRIu16 ": %s",
+                  cluster_state.worker_id, cpu, strerror(errno));
+        return;
+    }
+
+    cluster_state.worker_cpu = cpu;
+
+    if (cluster_state.config.numa_local)
+        prefer_numa_node(cpu);
+}
+
+int cluster_steering_worker(const uint16_t *cpus, uint16_t cpu_count, uint8_t workers, uint16_t cpu)
+{
+    if (!cpus || cpu_count == 0)
+        return -1;
+
+    for (uint8_t w = 0; w < workers; w++) {
+        if (cpus[w % cpu_count] == cpu)
+            return w;
+    }
+
+    return -1;
+}
+
+#ifdef SO_ATTACH_REUSEPORT_EBPF
+// The listeners of all workers share a REUSEPORT_SOCKARRAY indexed by CPU.
+// Each worker puts its own socket at the slot of the CPU it is pinned to,
+// and the kernel empties the slot when that socket closes, so the mapping
+// survives respawns, rolling restarts and scaling without being rebuilt.
+// CPUs without a socket are left to the kernel's hash
+static long sys_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+// Runs in the master, before any worker starts
+static void create_steering_map(void)
+{
+    uint16_t max_cpu = 0;
+    for (uint16_t i = 0; i < cluster_state.cpu_layout_size; i++) {
+        if (cluster_state.cpu_layout[i] > max_cpu)
+            max_cpu = cluster_state.cpu_layout[i];
+    }
 
-    if (term_signal == SIGTERM || term_signal == SIGINT)
-        is_crash = false;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_REUSEPORT_SOCKARRAY;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint64_t);
+    attr.max_entries = (uint32_t)max_cpu + 1;
 
-    if (is_crash) {
-        LOG_ERROR("Worker %" PRIu8 " crashed after %ld seconds (exit: %d)",
-                  worker_id, (long)uptime, (int)exit_status);
+    long fd = sys_bpf(BPF_MAP_CREATE, &attr);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create steering map, connection steering disabled: %s", strerror(errno));
+        return;
     }
 
-    if (cluster_state.config.on_exit)
-        cluster_state.config.on_exit(worker_id, (int)exit_status);
+    cluster_state.steering_fd = (int)fd;
+}
 
-    uv_close((uv_handle_t *)handle, NULL);
+// SK_REUSEPORT program: bpf_sk_select_reuseport(ctx, map, &cpu, 0), where
+// cpu is the one that received the connection. SK_PASS without a selected
+// socket falls back to the hash
+static int build_steering_program(struct bpf_insn *code, int map_fd)
+{
+    int n = 0;
+
+    // r6 = ctx
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_6, .src_reg = BPF_REG_1 };
+    // r0 = bpf_get_smp_processor_id(), *(u32 *)(r10 - 4) = r0
+    code[n++] = (struct bpf_insn){ .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_get_smp_processor_id };
+    code[n++] = (struct bpf_insn){ .code = BPF_STX | BPF_MEM | BPF_W, .dst_reg = BPF_REG_10, .src_reg = BPF_REG_0, .off = -4 };
+    // r1 = ctx, r2 = map, r3 = r10 - 4, r4 = 0
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_1, .src_reg = BPF_REG_6 };
+    code[n++] = (struct bpf_insn){ .code = BPF_LD | BPF_DW | BPF_IMM, .dst_reg = BPF_REG_2, .src_reg = BPF_PSEUDO_MAP_FD, .imm = map_fd };
+    code[n++] = (struct bpf_insn){ 0 };
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_MOV | BPF_X, .dst_reg = BPF_REG_3, .src_reg = BPF_REG_10 };
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_ADD | BPF_K, .dst_reg = BPF_REG_3, .imm = -4 };
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_4, .imm = 0 };
+    code[n++] = (struct bpf_insn){ .code = BPF_JMP | BPF_CALL, .imm = BPF_FUNC_sk_select_reuseport };
+    // return SK_PASS
+    code[n++] = (struct bpf_insn){ .code = BPF_ALU64 | BPF_MOV | BPF_K, .dst_reg = BPF_REG_0, .imm = SK_PASS };
+    code[n++] = (struct bpf_insn){ .code = BPF_JMP | BPF_EXIT };
+
+    return n;
+}
+
+static int load_steering_program(int map_fd)
+{
+    struct bpf_insn code[16];
+    char log[4096] = { 0 };
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_SK_REUSEPORT;
+    attr.insns = (uint64_t)(uintptr_t)code;
+    attr.insn_cnt = (uint32_t)build_steering_program(code, map_fd);
+    attr.license = (uint64_t)(uintptr_t)"Dual MIT/GPL";
+
+    long fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (fd >= 0)
+        return (int)fd;
+
+    int error = errno;
+
+    // Once more with the verifier log, to say why
+    attr.log_buf = (uint64_t)(uintptr_t)log;
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    sys_bpf(BPF_PROG_LOAD, &attr);
+
+    LOG_ERROR("Failed to load steering program: %s %s", strerror(error), log);
+    return -1;
+}
 
-    // Respawn logic
-    bool should_respawn = false;
+static void attach_steering(uv_os_fd_t fd)
+{
+    int reuseport = 0;
+    socklen_t len = sizeof(int);
 
-    if (cluster_state.graceful_restart_requested) {
-        should_respawn = true;
-    } else if (is_crash && should_respawn_worker(worker)) {
-        should_respawn = true;
+    if (getsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuseport, &len) != 0 || !reuseport) {
+        LOG_ERROR("Listener is not using SO_REUSEPORT, connection steering disabled");
+        return;
     }
 
-    if (should_respawn) {
-        uv_sleep(100);
+    int owner = cluster_steering_worker(cluster_state.cpu_layout, cluster_state.cpu_layout_size,
+                                        cluster_state.worker_count, (uint16_t)cluster_state.worker_cpu);
 
-        if (spawn_worker(worker_id, worker->port) != 0) {
-            LOG_ERROR("Failed to respawn worker %" PRIu8, worker_id);
-        }
-    }
+    // A worker sharing its CPU with a lower id only gets hashed connections
+    if (owner == cluster_state.worker_id) {
+        uint32_t key = (uint32_t)cluster_state.worker_cpu;
+        uint64_t value = (uint64_t)fd;
 
-    if (cluster_state.graceful_restart_requested) {
-        bool all_active = true;
-        for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-            if (!cluster_state.workers[i].active) {
-                all_active = false;
-                break;
-            }
-        }
+        union bpf_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (uint32_t)cluster_state.steering_fd;
+        attr.key = (uint64_t)(uintptr_t)&key;
+        attr.value = (uint64_t)(uintptr_t)&value;
+        attr.flags = BPF_ANY;
 
-        if (all_active) {
-            cluster_state.graceful_restart_requested = false;
-            LOG_DEBUG("Graceful restart completed\n");
+        if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) != 0) {
+            LOG_ERROR("Failed to add listener to steering map: %s", strerror(errno));
+            return;
         }
     }
+
+    // Every worker attaches the same program, the last one wins
+    int prog_fd = load_steering_program(cluster_state.steering_fd);
+    if (prog_fd < 0)
+        return;
+
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &prog_fd, sizeof(prog_fd)) != 0)
+        LOG_ERROR("Failed to attach steering program: %s", strerror(errno));
+
+    // The socket holds its own reference
+    close(prog_fd);
 }
 
-static void on_sigterm(uv_signal_t *handle, int signum)
+#endif
+
+static void find_listener_cb(uv_handle_t *handle, void *arg)
 {
-    (void)handle;
-    (void)signum;
+    int *listeners = (int *)arg;
 
-    if (!cluster_state.is_master)
+    if (handle->type != UV_TCP || uv_is_closing(handle))
         return;
 
-    if (cluster_state.shutdown_requested)
+    uv_os_fd_t fd;
+    if (uv_fileno(handle, &fd) != 0)
         return;
 
-    LOG_DEBUG("Shutdown requested (SIGTERM)");
-    cluster_state.shutdown_requested = true;
+    int listening = 0;
+    socklen_t len = sizeof(int);
 
-    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-        if (cluster_state.workers[i].active)
-            uv_process_kill(&cluster_state.workers[i].handle, WORKER_STOP_SIGNAL);
-    }
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0 || !listening)
+        return;
+
+    (*listeners)++;
+
+#ifdef SO_ATTACH_REUSEPORT_EBPF
+    if (cluster_state.steering_fd >= 0 && cluster_state.worker_cpu >= 0)
+        attach_steering(fd);
+#endif
 }
 
-static void on_sigint(uv_signal_t *handle, int signum)
+// The listener only exists once server_listen() returned, so the worker
+// looks for it on each loop iteration until it is found, then tells the
+// master it is ready
+static void on_worker_setup(uv_prepare_t *handle)
 {
-    (void)handle;
-    (void)signum;
-
-    if (!cluster_state.is_master)
-        return;
+    int listeners = 0;
+    uv_walk(handle->loop, find_listener_cb, &listeners);
 
-    if (cluster_state.shutdown_requested)
+    if (listeners == 0)
         return;
 
-    LOG_DEBUG("\nShutdown requested (SIGINT)...");
-    cluster_state.shutdown_requested = true;
+    uv_prepare_stop(handle);
+    uv_close((uv_handle_t *)handle, NULL);
 
-    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-        if (cluster_state.workers[i].active)
-            uv_process_kill(&cluster_state.workers[i].handle, WORKER_STOP_SIGNAL);
-    }
+    ipc_send(cluster_state.worker_ipc, IPC_MSG_READY, NULL, 0);
 }
 
-static void on_sigusr2(uv_signal_t *handle, int signum)
+static void schedule_worker_setup(void)
 {
-    (void)handle;
-    (void)signum;
+    static bool scheduled = false;
 
-    if (!cluster_state.is_master)
+    if (scheduled)
         return;
 
-    if (cluster_state.graceful_restart_requested || cluster_state.shutdown_requested)
+    uv_loop_t *loop = get_loop();
+    if (!loop) {
+        LOG_ERROR("Worker setup needs server_init() before cluster_get_port()");
         return;
+    }
 
-    cluster_state.graceful_restart_requested = true;
+    scheduled = true;
 
-    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-        if (cluster_state.workers[i].active)
-            uv_process_kill(&cluster_state.workers[i].handle, SIGTERM);
-    }
+#ifndef SO_ATTACH_REUSEPORT_EBPF
+    if (cluster_state.config.reuseport_steering && cluster_state.worker_cpu >= 0)
+        LOG_ERROR("Connection steering is not supported by this kernel");
+#endif
+
+    uv_prepare_init(loop, &cluster_state.worker_setup);
+    uv_prepare_start(&cluster_state.worker_setup, on_worker_setup);
+    // The server keeps the loop alive
+    uv_unref((uv_handle_t *)&cluster_state.worker_setup);
 }
 
-static void setup_signal_handlers(void)
+static bool grow_slots(uint8_t count)
 {
-    if (!cluster_state.is_master)
-        return;
+    if (count <= cluster_state.slot_count)
+        return true;
 
-    uv_signal_init(uv_default_loop(), &cluster_state.sigterm);
-    uv_signal_start(&cluster_state.sigterm, on_sigterm, SIGTERM);
+    worker_slot_t **slots = realloc(cluster_state.slots, count * sizeof(worker_slot_t *));
+    if (!slots) {
+        LOG_ERROR("Failed to allocate worker array");
+        return false;
+    }
 
-    uv_signal_init(uv_default_loop(), &cluster_state.sigint);
-    uv_signal_start(&cluster_state.sigint, on_sigint, SIGINT);
+    cluster_state.slots = slots;
 
-    uv_signal_init(uv_default_loop(), &cluster_state.sigusr2);
-    uv_signal_start(&cluster_state.sigusr2, on_sigusr2, SIGUSR2);
+    while (cluster_state.slot_count < count) {
+        worker_slot_t *slot = calloc(1, sizeof(worker_slot_t));
+        if (!slot) {
+            LOG_ERROR("Failed to allocate worker array");
+            return false;
+        }
+
+        slot->worker_id = cluster_state.slot_count;
+        uv_timer_init(uv_default_loop(), &slot->respawn_timer);
+        slot->respawn_timer.data = slot;
+        slots[cluster_state.slot_count++] = slot;
+    }
+
+    return true;
 }
 
-static void cleanup_signal_handlers(void)
+static uint8_t count_ready_workers(void)
 {
-    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigterm)) {
-        uv_signal_stop(&cluster_state.sigterm);
-        uv_close((uv_handle_t *)&cluster_state.sigterm, NULL);
-    }
+    uint8_t ready = 0;
 
-    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigint)) {
-        uv_signal_stop(&cluster_state.sigint);
-        uv_close((uv_handle_t *)&cluster_state.sigint, NULL);
+    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
+        const worker_process_t *worker = cluster_state.slots[i]->current;
+        if (worker && worker->ready)
+            ready++;
     }
 
-    if (!uv_is_closing((uv_handle_t *)&cluster_state.sigusr2)) {
-        uv_signal_stop(&cluster_state.sigusr2);
-        uv_close((uv_handle_t *)&cluster_state.sigusr2, NULL);
-    }
+    return ready;
 }
 
-static void close_handle_cb(uv_handle_t *handle, void *arg)
+static bool respawn_pending(void)
 {
-    (void)arg;
+    for (uint8_t i = 0; i < cluster_state.slot_count; i++) {
+        if (uv_is_active((uv_handle_t *)&cluster_state.slots[i]->respawn_timer))
+            return true;
+    }
 
-    if (uv_is_closing(handle))
-        return;
+    return false;
+}
 
-    if (handle->type == UV_SIGNAL) {
-        uv_signal_stop((uv_signal_t *)handle);
-        uv_close(handle, NULL);
-    } else if (handle->type == UV_PROCESS) {
-        uv_close(handle, NULL);
-    } else {
-        uv_close(handle, NULL);
-    }
+static void on_startup_timeout(uv_timer_t *handle)
+{
+    (void)handle;
 }
 
-static void cluster_cleanup(void)
+// Runs the master loop until every worker reported ready, so the
+// server is accepting on all of them when cluster_init() returns
+static void wait_workers_ready(void)
 {
-    if (!cluster_state.initialized)
-        return;
+    uv_loop_t *loop = uv_default_loop();
+    uv_timer_t timeout;
 
-    if (cluster_state.workers) {
-        free(cluster_state.workers);
-        cluster_state.workers = NULL;
-    }
+    uv_update_time(loop);
+    uint64_t deadline = uv_now(loop) + cluster_state.config.ready_timeout_ms;
 
-    cleanup_original_args();
-    uv_loop_t *loop = uv_default_loop();
-    cleanup_signal_handlers();
-    uv_walk(loop, close_handle_cb, NULL);
+    uv_timer_init(loop, &timeout);
+    uv_timer_start(&timeout, on_startup_timeout, cluster_state.config.ready_timeout_ms, 0);
 
-    int iterations = 0;
-    while (uv_loop_alive(loop) && iterations < 50) {
-        uv_run(loop, UV_RUN_NOWAIT);
-        uv_sleep(100);
-        iterations++;
+    while (!cluster_state.shutdown_requested &&
+           count_ready_workers() < cluster_state.worker_count &&
+           uv_now(loop) < deadline &&
+           (cluster_state.processes || respawn_pending())) {
+        uv_run(loop, UV_RUN_ONCE);
     }
 
-    int result = uv_loop_close(loop);
-    if (result != 0) {
-        uv_walk(loop, close_handle_cb, NULL);
-        uv_run(loop, UV_RUN_NOWAIT);
-        uv_loop_close(loop);
-    }
+    uv_close((uv_handle_t *)&timeout, NULL);
+    uv_run(loop, UV_RUN_NOWAIT);
 
-    cluster_state.initialized = false;
+    uint8_t ready = count_ready_workers();
+    if (ready < cluster_state.worker_count)
+        LOG_ERROR("%" PRIu8 " of %" PRIu8 " workers ready after startup",
+                  ready, cluster_state.worker_count);
 }
 
 bool cluster_init(const Cluster *config, int argc, char **argv)
@@ -567,6 +1837,12 @@ bool cluster_init(const Cluster *config, int argc, char **argv)
     apply_config(config);
     cluster_state.base_port = config->port;
 
+    if (config->pin_workers && !build_cpu_layout(config))
+        LOG_ERROR("CPU layout unavailable, workers will not be pinned");
+
+    if (config->reuseport_steering && !config->pin_workers)
+        LOG_DEBUG("reuseport_steering has no effect without pin_workers");
+
     char **args = uv_setup_args(argc, argv);
 
     cluster_state.is_master = true;
@@ -578,11 +1854,21 @@ bool cluster_init(const Cluster *config, int argc, char **argv)
             cluster_state.worker_id = (uint8_t)atoi(args[i + 1]);
             cluster_state.worker_port = (uint16_t)atoi(args[i + 2]);
 
+            const char *workers_env = getenv(WORKERS_ENV);
+            if (workers_env && atoi(workers_env) > 0)
+                cluster_state.worker_count = (uint8_t)atoi(workers_env);
+
             char title[64];
             snprintf(title, sizeof(title), "ecewo:worker-%" PRIu8,
                      cluster_state.worker_id);
             uv_set_process_title(title);
 
+            pin_worker();
+
+            const char *steering_env = getenv(STEERING_FD_ENV);
+            if (steering_env && cluster_state.config.reuseport_steering)
+                cluster_state.steering_fd = atoi(steering_env);
+
             cluster_state.initialized = true;
             return false; // Worker returns false
         }
@@ -597,37 +1883,49 @@ bool cluster_init(const Cluster *config, int argc, char **argv)
 
     uv_set_process_title("ecewo:master");
 
+#ifdef SO_ATTACH_REUSEPORT_EBPF
+    // Created once, so workers started later share it
+    if (config->reuseport_steering && cluster_state.cpu_layout_size && cluster_state.steering_fd < 0)
+        create_steering_map();
+#endif
+
+    // Reported to the workers along with their own metrics
+    cluster_state.worker_exits = metrics_counter("ecewo_cluster_worker_exits_total", "Workers that exited while the cluster was running");
+    cluster_state.worker_crashes = metrics_counter("ecewo_cluster_worker_crashes_total", "Workers that exited with an error or were killed");
+    cluster_state.worker_respawns = metrics_counter("ecewo_cluster_worker_respawns_total", "Crashed workers started again");
+
     setup_signal_handlers();
 
-    cluster_state.workers = calloc(cluster_state.worker_count, sizeof(worker_process_t));
-    if (!cluster_state.workers) {
-        LOG_ERROR("Failed to allocate worker array");
+    if (!grow_slots(cluster_state.worker_count)) {
         cleanup_original_args();
         return false;
     }
 
+    uv_timer_init(uv_default_loop(), &cluster_state.ready_timer);
+    uv_timer_init(uv_default_loop(), &cluster_state.autoscale_timer);
+    uv_unref((uv_handle_t *)&cluster_state.autoscale_timer);
+
     int failed_count = 0;
     for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-        uint16_t port = cluster_state.base_port;
+        cluster_state.slots[i]->current = spawn_worker(i);
 
-        if (spawn_worker(i, port) != 0) {
+        if (!cluster_state.slots[i]->current) {
             LOG_ERROR("Failed to spawn worker %" PRIu8, i);
             failed_count++;
 
             if (failed_count > cluster_state.worker_count / 2) {
                 LOG_ERROR("Too many spawn failures, aborting");
+                stop_all_workers();
                 cleanup_original_args();
                 return false;
             }
         }
-
-        uv_sleep(100);
     }
 
-    uv_sleep(500);
-
     cluster_state.initialized = true;
 
+    wait_workers_ready();
+
     printf("Server listening on http://localhost:%" PRIu16 " (Cluster: %d workers)\n",
            cluster_state.base_port, cluster_state.worker_count);
 
@@ -642,6 +1940,8 @@ uint16_t cluster_get_port(void)
     if (cluster_state.is_master)
         return cluster_state.base_port;
 
+    start_worker_ipc();
+    schedule_worker_setup();
     return cluster_state.worker_port;
 }
 
@@ -665,6 +1965,11 @@ uint8_t cluster_worker_count(void)
     return cluster_state.worker_count;
 }
 
+int cluster_worker_cpu(void)
+{
+    return cluster_state.worker_cpu;
+}
+
 static long count_physical_cores(void)
 {
     int max_cpu = sysconf(_SC_NPROCESSORS_ONLN);
@@ -675,35 +1980,11 @@ static long count_physical_cores(void)
     int unique_cores = 0;
 
     for (int cpu = 0; cpu < max_cpu; cpu++) {
-        char path[256];
-        snprintf(path, sizeof(path),
-                 "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
-
-        uv_fs_t open_req;
-        int fd = uv_fs_open(NULL, &open_req, path, O_RDONLY, 0, NULL);
-        uv_fs_req_cleanup(&open_req);
-
-        if (fd >= 0) {
-            char buf[32];
-            uv_buf_t uv_buf = uv_buf_init(buf, sizeof(buf) - 1);
-
-            uv_fs_t read_req;
-            int nread = uv_fs_read(NULL, &read_req, fd, &uv_buf, 1, 0, NULL);
-            uv_fs_req_cleanup(&read_req);
+        int core_id = read_cpu_topology(cpu, "core_id");
 
-            if (nread > 0) {
-                buf[nread] = '\0';
-                int core_id = atoi(buf);
-
-                if (core_id >= 0 && core_id < 1024 && !core_seen[core_id]) {
-                    core_seen[core_id] = true;
-                    unique_cores++;
-                }
-            }
-
-            uv_fs_t close_req;
-            uv_fs_close(NULL, &close_req, fd, NULL);
-            uv_fs_req_cleanup(&close_req);
+        if (core_id >= 0 && core_id < 1024 && !core_seen[core_id]) {
+            core_seen[core_id] = true;
+            unique_cores++;
         }
     }
 
@@ -798,10 +2079,228 @@ void cluster_signal_workers(int signal)
         return;
     }
 
-    for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-        if (cluster_state.workers[i].active)
-            uv_process_kill(&cluster_state.workers[i].handle, signal);
+    for (worker_process_t *w = cluster_state.processes; w; w = w->next)
+        uv_process_kill(&w->handle, signal);
+}
+
+static bool worker_alive(const worker_process_t *worker, uint64_t now)
+{
+    return worker && worker->active && worker->stats.updated_ms &&
+           now - worker->stats.updated_ms <= (uint64_t)cluster_state.config.stats_interval_ms * STATS_ALIVE_INTERVALS;
+}
+
+bool cluster_worker_stats(uint8_t worker_id, ClusterWorkerStats *stats)
+{
+    if (!cluster_state.is_master || !cluster_state.initialized || !stats) {
+        LOG_ERROR("Only master can read worker stats");
+        return false;
+    }
+
+    if (worker_id >= cluster_state.worker_count)
+        return false;
+
+    const worker_process_t *worker = cluster_state.slots[worker_id]->current;
+    if (worker)
+        *stats = worker->stats;
+    else
+        memset(stats, 0, sizeof(*stats));
+
+    stats->worker_id = worker_id;
+    stats->alive = worker_alive(worker, uv_now(uv_default_loop()));
+    return true;
+}
+
+bool cluster_stats(ClusterStats *stats)
+{
+    if (!cluster_state.is_master || !cluster_state.initialized || !stats) {
+        LOG_ERROR("Only master can read cluster stats");
+        return false;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->workers = cluster_state.worker_count;
+    stats->requests = cluster_state.retired_requests;
+
+    uint64_t now = uv_now(uv_default_loop());
+
+    // Includes replacements and workers still draining
+    for (const worker_process_t *worker = cluster_state.processes; worker; worker = worker->next) {
+        stats->requests += worker->stats.requests;
+
+        if (!worker_alive(worker, now))
+            continue;
+
+        stats->alive++;
+        stats->requests_per_sec += worker->stats.requests_per_sec;
+        stats->events_waiting += worker->stats.events_waiting;
+        stats->active_handles += worker->stats.active_handles;
+        stats->rss_bytes += worker->stats.rss_bytes;
+        stats->cpu_permille += worker->stats.cpu_permille;
+        if (worker->stats.loop_lag_us > stats->max_loop_lag_us)
+            stats->max_loop_lag_us = worker->stats.loop_lag_us;
+    }
+
+    return true;
+}
+
+bool cluster_scale(uint8_t workers)
+{
+    if (!cluster_state.is_master || !cluster_state.initialized) {
+        LOG_ERROR("Only master can scale workers");
+        return false;
+    }
+
+    if (workers < 1) {
+        LOG_ERROR("Invalid worker count: %" PRIu8 " must be >= 1", workers);
+        return false;
     }
+
+    if (cluster_state.shutdown_requested || !grow_slots(workers))
+        return false;
+
+    uint8_t previous = cluster_state.worker_count;
+    cluster_state.worker_count = workers;
+
+    // Removes the highest ids, so the remaining ones stay contiguous.
+    // Their processes drain like the ones retired by a rolling restart
+    for (uint8_t i = workers; i < previous; i++) {
+        worker_slot_t *slot = cluster_state.slots[i];
+
+        uv_timer_stop(&slot->respawn_timer);
+
+        if (slot->replacement) {
+            uv_process_kill(&slot->replacement->handle, WORKER_STOP_SIGNAL);
+            slot->replacement = NULL;
+            cluster_state.restart_pending--;
+        }
+
+        if (slot->current) {
+            uv_process_kill(&slot->current->handle, WORKER_STOP_SIGNAL);
+            slot->current = NULL;
+        }
+    }
+
+    bool spawned = true;
+    for (uint8_t i = previous; i < workers; i++) {
+        worker_slot_t *slot = cluster_state.slots[i];
+
+        slot->respawn_disabled = false;
+        slot->restart_count = 0;
+        slot->current = spawn_worker(i);
+
+        if (!slot->current) {
+            LOG_ERROR("Failed to spawn worker %" PRIu8, i);
+            cluster_state.worker_count = i;
+            spawned = false;
+            break;
+        }
+    }
+
+    if (cluster_state.graceful_restart_requested)
+        restart_advance();
+
+    LOG_DEBUG("Scaled from %" PRIu8 " to %" PRIu8 " workers", previous, cluster_state.worker_count);
+    return spawned;
+}
+
+static void on_autoscale_timer(uv_timer_t *handle)
+{
+    const ClusterAutoscale *policy = &cluster_state.autoscale;
+    uint64_t now = uv_now(handle->loop);
+
+    if (cluster_state.shutdown_requested || cluster_state.graceful_restart_requested)
+        return;
+
+    if (now - cluster_state.last_scale_ms < policy->cooldown_ms)
+        return;
+
+    uint8_t count = cluster_state.worker_count;
+    uint32_t max_lag = 0;
+    uint32_t cpu = 0;
+
+    // Decides on a fresh report from every worker only
+    for (uint8_t i = 0; i < count; i++) {
+        const worker_process_t *worker = cluster_state.slots[i]->current;
+
+        if (!worker_alive(worker, now) || !worker->ready)
+            return;
+
+        if (worker->stats.loop_lag_us > max_lag)
+            max_lag = worker->stats.loop_lag_us;
+        cpu += worker->stats.cpu_permille;
+    }
+
+    bool overloaded = (policy->target_lag_us && max_lag > policy->target_lag_us) ||
+                      (policy->target_cpu_permille && cpu / count > policy->target_cpu_permille);
+
+    // Removing a worker must leave the others below the targets
+    bool underloaded = count > 1 &&
+                       (!policy->target_lag_us || max_lag < policy->target_lag_us / 2) &&
+                       (!policy->target_cpu_permille || cpu / (count - 1) < policy->target_cpu_permille);
+
+    uint8_t target = count;
+    if (overloaded && count < policy->max_workers)
+        target = count + 1;
+    else if (!overloaded && underloaded && count > policy->min_workers)
+        target = count - 1;
+
+    if (target == count)
+        return;
+
+    LOG_DEBUG("Autoscale: lag %" PRIu32 " us, cpu %" PRIu32 " permille per worker",
+              max_lag, cpu / count);
+
+    cluster_scale(target);
+    cluster_state.last_scale_ms = now;
+}
+
+bool cluster_autoscale(const ClusterAutoscale *policy)
+{
+    if (!cluster_state.is_master || !cluster_state.initialized) {
+        LOG_ERROR("Only master can autoscale workers");
+        return false;
+    }
+
+    if (!policy) {
+        uv_timer_stop(&cluster_state.autoscale_timer);
+        return true;
+    }
+
+    ClusterAutoscale config = *policy;
+
+    if (!config.min_workers)
+        config.min_workers = 1;
+
+    if (!config.max_workers)
+        config.max_workers = cluster_cpus();
+
+    if (!config.cooldown_ms)
+        config.cooldown_ms = DEFAULT_SCALE_COOLDOWN_MS;
+
+    if (config.min_workers > config.max_workers) {
+        LOG_ERROR("Invalid autoscale policy: min_workers > max_workers");
+        return false;
+    }
+
+    if (!config.target_lag_us && !config.target_cpu_permille) {
+        LOG_ERROR("Invalid autoscale policy: no target_lag_us or target_cpu_permille");
+        return false;
+    }
+
+    cluster_state.autoscale = config;
+
+    uint8_t count = cluster_state.worker_count;
+    if (count < config.min_workers)
+        cluster_scale(config.min_workers);
+    else if (count > config.max_workers)
+        cluster_scale(config.max_workers);
+
+    // The first step waits for a cooldown, once workers reported their load
+    cluster_state.last_scale_ms = uv_now(uv_default_loop());
+    uv_timer_start(&cluster_state.autoscale_timer, on_autoscale_timer,
+                   cluster_state.config.stats_interval_ms,
+                   cluster_state.config.stats_interval_ms);
+    return true;
 }
 
 void cluster_wait_workers(void)
@@ -815,13 +2314,7 @@ void cluster_wait_workers(void)
     uint64_t shutdown_start_time = 0;
 
     while (1) {
-        bool any_active = false;
-        for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-            if (cluster_state.workers[i].active) {
-                any_active = true;
-                break;
-            }
-        }
+        bool any_active = cluster_state.processes || respawn_pending();
 
         if (!any_active)
             break;
@@ -835,10 +2328,8 @@ void cluster_wait_workers(void)
             // Forcekill after 30 seconds
             if (elapsed > 30000) {
                 LOG_DEBUG("Force killing remaining workers...");
-                for (uint8_t i = 0; i < cluster_state.worker_count; i++) {
-                    if (cluster_state.workers[i].active)
-                        uv_process_kill(&cluster_state.workers[i].handle, SIGKILL);
-                }
+                for (worker_process_t *w = cluster_state.processes; w; w = w->next)
+                    uv_process_kill(&w->handle, SIGKILL);
                 break;
             }
         }
@@ -5,6 +5,7 @@
 extern "C" {
 #endif
 
+#include "ecewo.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -15,8 +16,53 @@ typedef struct
     uint16_t port;
     void (*on_start)(uint8_t worker_id);
     void (*on_exit)(uint8_t worker_id, int status);
+    bool pin_workers;        // pin each worker to its own CPU
+    const uint16_t *cpuset;  // CPUs to pin to, in worker order (default: physical cores first)
+    uint16_t cpuset_size;
+    bool numa_local;         // prefer memory from the NUMA node of the worker's CPU
+    bool reuseport_steering; // hand each connection to the worker pinned to the CPU that received it
+    uint32_t stats_interval_ms; // how often workers report their stats (default 1000)
+    uint8_t restart_batch;      // workers replaced at a time by a rolling restart (default 1)
+    uint32_t ready_timeout_ms;  // how long a new worker may take to start serving (default 10000)
 } Cluster;
 
+typedef struct
+{
+    uint8_t worker_id;
+    int pid;
+    bool alive;                // reported within the last three intervals
+    uint64_t requests;         // counted by cluster_track_requests()
+    uint32_t requests_per_sec;
+    uint32_t events_waiting;   // I/O events that were already waiting when the loop polled, per interval
+    uint32_t active_handles;   // active libuv handles, mostly client connections
+    uint64_t rss_bytes;
+    uint32_t loop_lag_us;      // how late the worker's stats timer fired
+    uint16_t cpu_permille;     // CPU time per second, 1000 = one full core
+    uint64_t updated_ms;       // master loop time of the last report
+} ClusterWorkerStats;
+
+typedef struct
+{
+    uint8_t workers;
+    uint8_t alive;
+    uint64_t requests;
+    uint32_t requests_per_sec;
+    uint32_t events_waiting;
+    uint32_t active_handles;
+    uint64_t rss_bytes;
+    uint32_t max_loop_lag_us;
+    uint32_t cpu_permille;
+} ClusterStats;
+
+typedef struct
+{
+    uint8_t min_workers;           // default 1
+    uint8_t max_workers;           // default cluster_cpus()
+    uint32_t target_lag_us;        // add a worker above this loop lag (0 = ignore lag)
+    uint16_t target_cpu_permille;  // add a worker above this average CPU share (0 = ignore CPU)
+    uint32_t cooldown_ms;          // minimum time between two scaling steps (default 30000)
+} ClusterAutoscale;
+
 bool cluster_init(const Cluster *config, int argc, char **argv);
 uint16_t cluster_get_port(void);
 bool cluster_is_master(void);
@@ -25,9 +71,30 @@ uint8_t cluster_worker_id(void);
 uint8_t cluster_worker_count(void);
 uint8_t cluster_cpus(void);
 uint8_t cluster_cpus_physical(void);
+int cluster_worker_cpu(void);
+
+// Worker that reuseport_steering hands the connections received on cpu to,
+// when worker i is pinned to cpus[i % cpu_count]: the lowest worker id on
+// that CPU, or -1 if none is, which leaves the choice to the kernel's hash
+int cluster_steering_worker(const uint16_t *cpus, uint16_t cpu_count, uint8_t workers, uint16_t cpu);
 void cluster_signal_workers(int signal);
 void cluster_wait_workers(void);
 
+// Master only: latest stats reported by the workers
+bool cluster_stats(ClusterStats *stats);
+bool cluster_worker_stats(uint8_t worker_id, ClusterWorkerStats *stats);
+
+// Master only: start or stop workers until n are running
+// Removed workers finish their requests before they exit
+bool cluster_scale(uint8_t workers);
+
+// Master only: adjust the worker count to the reported load, one worker
+// per cooldown_ms; NULL turns the autoscaler off
+bool cluster_autoscale(const ClusterAutoscale *policy);
+
+// Middleware counting the requests a worker handles
+void cluster_track_requests(Req *req, Res *res, Next next);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@
 #include <ctype.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "ecewo-cookie.h"
 
 // RFC 6265 Cookie size limits
@@ -186,83 +187,211 @@ static char *generate_expires(Arena *arena, int max_age_seconds)
     return expires;
 }
 
-char *cookie_get(Req *req, const char *name)
+// ============================================================================
+// PARSED COOKIES
+// ============================================================================
+
+// The Cookie header is parsed once per request, on the first cookie_get(),
+// into slices of the header stored in the request context. Every lookup
+// after that hashes the name instead of scanning the header again
+
+#define COOKIE_CONTEXT_KEY "ecewo-cookie"
+#define COOKIE_INDEX_SIZE 64 // Power of two above MAX_COOKIES_PER_REQUEST
+
+typedef struct
 {
-    if (!req || !req->arena || !name)
-        return NULL;
+    const char *name; // Slices of the Cookie header, not NUL-terminated
+    size_t name_len;
+    const char *value; // Without the quotes
+    size_t value_len;
+    bool encoded;  // Contains '%', decoded on the first cookie_get()
+    char *decoded; // cookie_get() result, NULL until it is first asked for
+} parsed_cookie_t;
+
+typedef struct
+{
+    parsed_cookie_t *cookies;
+    uint8_t count;
+    uint8_t index[COOKIE_INDEX_SIZE]; // Position + 1, 0 for an empty slot
+} cookie_jar_t;
 
-    if (!is_valid_cookie_name(name)) {
-        fprintf(stderr, "Invalid cookie name: %s (must be RFC 6265 token)\n", name);
-        return NULL;
+// FNV-1a
+static uint32_t hash_name(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
     }
 
-    const char *cookie_header = get_header(req, "Cookie");
-    if (!cookie_header)
-        return NULL;
+    return hash;
+}
+
+static parsed_cookie_t *jar_find(cookie_jar_t *jar, const char *name, size_t name_len)
+{
+    uint32_t slot = hash_name(name, name_len) & (COOKIE_INDEX_SIZE - 1);
+
+    while (jar->index[slot]) {
+        parsed_cookie_t *cookie = &jar->cookies[jar->index[slot] - 1];
+
+        if (cookie->name_len == name_len && memcmp(cookie->name, name, name_len) == 0)
+            return cookie;
 
-    size_t name_len = strlen(name);
-    const char *pos = cookie_header;
-    int cookie_count = 0;
+        slot = (slot + 1) & (COOKIE_INDEX_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+// Splits the header in one pass: memchr() finds each ';' and '=' with the
+// vectorized scan of the C library instead of testing every byte here
+static cookie_jar_t *parse_cookies(Req *req, const char *header)
+{
+    parsed_cookie_t cookies[MAX_COOKIES_PER_REQUEST];
+    uint8_t count = 0;
+
+    const char *pos = header;
+    const char *header_end = header + strlen(header);
 
-    while (pos && cookie_count < MAX_COOKIES_PER_REQUEST) {
-        // Skip whitespace
-        while (*pos && isspace((unsigned char)*pos))
+    while (pos < header_end) {
+        while (pos < header_end && isspace((unsigned char)*pos))
             pos++;
 
-        if (!*pos)
+        if (pos == header_end)
             break;
 
-        cookie_count++;
+        if (count == MAX_COOKIES_PER_REQUEST) {
+            fprintf(stderr, "Too many cookies in request\n");
+            break;
+        }
+
+        const char *cookie_end = memchr(pos, ';', (size_t)(header_end - pos));
+        if (!cookie_end)
+            cookie_end = header_end;
 
-        const char *cookie_end = strchr(pos, ';');
-        size_t cookie_len = cookie_end ? (size_t)(cookie_end - pos) : strlen(pos);
+        size_t cookie_len = (size_t)(cookie_end - pos);
+        const char *segment = pos;
+        pos = cookie_end + 1;
 
         if (cookie_len > MAX_COOKIE_SIZE) {
             fprintf(stderr, "Cookie too large: %zu bytes\n", cookie_len);
-            pos = cookie_end ? cookie_end + 1 : NULL;
             continue;
         }
 
-        const char *eq = memchr(pos, '=', cookie_len);
-        if (!eq) {
-            pos = cookie_end ? cookie_end + 1 : NULL;
+        const char *eq = memchr(segment, '=', cookie_len);
+        if (!eq)
             continue;
+
+        parsed_cookie_t *cookie = &cookies[count];
+
+        cookie->name = segment;
+        cookie->name_len = (size_t)(eq - segment);
+        trim_whitespace(&cookie->name, &cookie->name_len);
+
+        cookie->value = eq + 1;
+        cookie->value_len = (size_t)(cookie_end - eq - 1);
+        trim_whitespace(&cookie->value, &cookie->value_len);
+
+        if (cookie->value_len >= 2 && cookie->value[0] == '"' && cookie->value[cookie->value_len - 1] == '"') {
+            cookie->value++;
+            cookie->value_len -= 2;
         }
 
-        const char *current_name = pos;
-        size_t current_name_len = (size_t)(eq - pos);
-        trim_whitespace(&current_name, &current_name_len);
+        cookie->encoded = memchr(cookie->value, '%', cookie->value_len) != NULL;
+        cookie->decoded = NULL;
+        count++;
+    }
 
-        if (current_name_len == name_len && strncmp(current_name, name, name_len) == 0) {
+    cookie_jar_t *jar = arena_alloc(req->arena, sizeof(cookie_jar_t));
+    if (!jar)
+        return NULL;
 
-            const char *value_start = eq + 1;
-            size_t value_len = cookie_len - (size_t)(eq - pos) - 1;
-            trim_whitespace(&value_start, &value_len);
+    memset(jar->index, 0, sizeof(jar->index));
+    jar->count = count;
+    jar->cookies = count ? arena_alloc(req->arena, count * sizeof(parsed_cookie_t)) : NULL;
 
-            if (value_len == 0) {
-                char *result = arena_alloc(req->arena, 1);
-                if (result)
-                    result[0] = '\0';
-                return result;
-            }
+    if (count && !jar->cookies)
+        return NULL;
 
-            if (value_len >= 2 && value_start[0] == '"' && value_start[value_len - 1] == '"') {
-                value_start++; // Skip opening quote
-                value_len -= 2; // Remove both quotes
-            }
+    for (uint8_t i = 0; i < count; i++) {
+        jar->cookies[i] = cookies[i];
 
-            char *decoded = url_decode(req->arena, value_start, value_len);
-            return decoded;
-        }
+        // The first of two cookies with the same name wins
+        if (jar_find(jar, cookies[i].name, cookies[i].name_len))
+            continue;
+
+        uint32_t slot = hash_name(cookies[i].name, cookies[i].name_len) & (COOKIE_INDEX_SIZE - 1);
+        while (jar->index[slot])
+            slot = (slot + 1) & (COOKIE_INDEX_SIZE - 1);
 
-        pos = cookie_end ? cookie_end + 1 : NULL;
+        jar->index[slot] = (uint8_t)(i + 1);
     }
 
-    if (cookie_count >= MAX_COOKIES_PER_REQUEST) {
-        fprintf(stderr, "Too many cookies in request\n");
+    return jar;
+}
+
+static parsed_cookie_t *find_cookie(Req *req, const char *name)
+{
+    if (!req || !req->arena || !name)
+        return NULL;
+
+    if (!is_valid_cookie_name(name)) {
+        fprintf(stderr, "Invalid cookie name: %s (must be RFC 6265 token)\n", name);
+        return NULL;
     }
 
-    return NULL;
+    cookie_jar_t *jar = get_context(req, COOKIE_CONTEXT_KEY);
+
+    if (!jar) {
+        const char *cookie_header = get_header(req, "Cookie");
+        if (!cookie_header)
+            return NULL;
+
+        jar = parse_cookies(req, cookie_header);
+        if (!jar)
+            return NULL;
+
+        set_context(req, COOKIE_CONTEXT_KEY, jar);
+    }
+
+    return jar_find(jar, name, strlen(name));
+}
+
+static char *decoded_value(Req *req, parsed_cookie_t *cookie)
+{
+    if (!cookie->decoded)
+        cookie->decoded = url_decode(req->arena, cookie->value, cookie->value_len);
+
+    return cookie->decoded;
+}
+
+char *cookie_get(Req *req, const char *name)
+{
+    parsed_cookie_t *cookie = find_cookie(req, name);
+    return cookie ? decoded_value(req, cookie) : NULL;
+}
+
+const char *cookie_get_view(Req *req, const char *name, size_t *len)
+{
+    // Without the length the view can't be read safely
+    if (!len)
+        return NULL;
+
+    parsed_cookie_t *cookie = find_cookie(req, name);
+    if (!cookie)
+        return NULL;
+
+    if (!cookie->encoded) {
+        *len = cookie->value_len;
+        return cookie->value;
+    }
+
+    char *decoded = decoded_value(req, cookie);
+    if (decoded)
+        *len = strlen(decoded);
+
+    return decoded;
 }
 
 void cookie_set(Res *res, const char *name, const char *value, Cookie *options)
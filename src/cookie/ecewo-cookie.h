@@ -18,7 +18,15 @@ typedef struct
     bool secure; // HTTPS only (required for SameSite=None)
 } Cookie;
 
+// Returns the decoded value, or NULL if the cookie is not set
+// The Cookie header is parsed on the first call for a request
 char *cookie_get(Req *req, const char *name);
+
+// Same as cookie_get() without a copy: returns len bytes of the header,
+// not NUL-terminated, unless the value has to be decoded. len is required,
+// NULL if it is not given
+const char *cookie_get_view(Req *req, const char *name, size_t *len);
+
 void cookie_set(Res *res, const char *name, const char *value, Cookie *options);
 
 #ifdef __cplusplus
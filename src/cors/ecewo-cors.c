@@ -1,9 +1,56 @@
 #include "ecewo.h"
 #include "ecewo-cors.h"
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
 
+#define CORS_HEADER_COUNT 5
+#define PREFLIGHT_HEADER_COUNT 7
+#define DEFAULT_PREFLIGHT_CACHE_SIZE 64
+#define PREFLIGHT_KEY_MAX 256
+
+// Origins in the allowlist are matched exactly with a hash set,
+// "*.example.com" patterns with a trie of their reversed suffixes:
+// the origin is walked once from its end, whatever the number of patterns
+
+typedef struct
+{
+    char c;
+    int32_t child;    // First child
+    int32_t sibling;  // Next child of the same parent
+    int32_t wildcard; // First pattern ending here, -1 if none
+} trie_node_t;
+
+typedef struct
+{
+    const char *scheme; // e.g. "https", NULL for any
+    size_t scheme_len;
+    int32_t next; // Next pattern with the same suffix
+} wildcard_t;
+
+typedef enum
+{
+    PREFLIGHT_ALLOWED,
+    PREFLIGHT_BAD_ORIGIN,
+    PREFLIGHT_BAD_REQUEST, // Method or headers not allowed
+} preflight_result_t;
+
+// Preflight results, keyed by origin, requested method and headers
+typedef struct preflight_entry_s
+{
+    uint32_t hash;
+    preflight_result_t result;
+    size_t key_len;
+    char key[PREFLIGHT_KEY_MAX];
+
+    struct preflight_entry_s *prev; // Recency list, most recent first
+    struct preflight_entry_s *next;
+    struct preflight_entry_s *chain; // Same bucket
+} preflight_entry_t;
+
 static struct
 {
     const char *origin;
@@ -12,6 +59,32 @@ static struct
     const char *credentials;
     const char *max_age;
     bool enabled;
+    bool any_origin;
+
+    // Exact origins, open addressing
+    const char **origin_set;
+    size_t origin_set_mask;
+
+    trie_node_t *nodes;
+    int32_t node_count;
+    int32_t node_capacity;
+    wildcard_t *wildcards;
+    int32_t wildcard_count;
+
+    preflight_entry_t *cache;
+    preflight_entry_t **cache_buckets;
+    size_t cache_mask;
+    preflight_entry_t *cache_head; // Most recently used
+    preflight_entry_t *cache_tail; // Evicted first
+    uint16_t cache_size;
+    uint16_t cache_used;
+
+    // Built once by cors_init(), only Access-Control-Allow-Origin
+    // changes per request if the origins are restricted
+    HttpHeader response_headers[CORS_HEADER_COUNT];
+    HttpHeader preflight_headers[PREFLIGHT_HEADER_COUNT];
+    uint16_t response_header_count;
+    uint16_t preflight_header_count;
 } cors_state = { 0 };
 
 // DEFAULTS
@@ -35,60 +108,562 @@ static void cors_set_defaults(void)
         cors_state.max_age = DEFAULT_MAX_AGE;
 }
 
+// FNV-1a
+static uint32_t hash_bytes(uint32_t hash, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+#define HASH_INIT 2166136261u
+
+// ============================================================================
+// ORIGIN MATCHING
+// ============================================================================
+
+static void cors_free_origins(void)
+{
+    free(cors_state.origin_set);
+    free(cors_state.nodes);
+    free(cors_state.wildcards);
+
+    cors_state.origin_set = NULL;
+    cors_state.origin_set_mask = 0;
+    cors_state.nodes = NULL;
+    cors_state.node_count = 0;
+    cors_state.node_capacity = 0;
+    cors_state.wildcards = NULL;
+    cors_state.wildcard_count = 0;
+}
+
+static void origin_set_add(const char *origin)
+{
+    size_t i = hash_bytes(HASH_INIT, origin, strlen(origin)) & cors_state.origin_set_mask;
+
+    while (cors_state.origin_set[i]) {
+        if (strcmp(cors_state.origin_set[i], origin) == 0)
+            return;
+        i = (i + 1) & cors_state.origin_set_mask;
+    }
+
+    cors_state.origin_set[i] = origin;
+}
+
+static bool origin_set_contains(const char *origin, size_t len)
+{
+    if (!cors_state.origin_set)
+        return false;
+
+    size_t i = hash_bytes(HASH_INIT, origin, len) & cors_state.origin_set_mask;
+
+    while (cors_state.origin_set[i]) {
+        if (strcmp(cors_state.origin_set[i], origin) == 0)
+            return true;
+        i = (i + 1) & cors_state.origin_set_mask;
+    }
+
+    return false;
+}
+
+static int32_t trie_new_node(char c)
+{
+    if (cors_state.node_count == cors_state.node_capacity) {
+        int32_t capacity = cors_state.node_capacity ? cors_state.node_capacity * 2 : 64;
+        trie_node_t *nodes = realloc(cors_state.nodes, (size_t)capacity * sizeof(trie_node_t));
+        if (!nodes)
+            return -1;
+
+        cors_state.nodes = nodes;
+        cors_state.node_capacity = capacity;
+    }
+
+    int32_t index = cors_state.node_count++;
+    cors_state.nodes[index].c = c;
+    cors_state.nodes[index].child = -1;
+    cors_state.nodes[index].sibling = -1;
+    cors_state.nodes[index].wildcard = -1;
+    return index;
+}
+
+static int32_t trie_child(int32_t node, char c)
+{
+    for (int32_t child = cors_state.nodes[node].child; child >= 0; child = cors_state.nodes[child].sibling) {
+        if (cors_state.nodes[child].c == c)
+            return child;
+    }
+
+    return -1;
+}
+
+// "*.example.com" or "https://*.example.com"
+static bool trie_add_wildcard(const char *pattern, int32_t index)
+{
+    const char *star = strstr(pattern, "*.");
+    const char *suffix = star + 1; // Keeps the dot
+
+    if (strchr(suffix, '*') || suffix[1] == '\0')
+        return false;
+
+    wildcard_t *wildcard = &cors_state.wildcards[index];
+    wildcard->scheme = NULL;
+    wildcard->scheme_len = 0;
+
+    if (star != pattern) {
+        size_t prefix_len = (size_t)(star - pattern);
+        if (prefix_len < 4 || strncmp(star - 3, "://", 3) != 0)
+            return false;
+
+        wildcard->scheme = pattern;
+        wildcard->scheme_len = prefix_len - 3;
+    }
+
+    int32_t node = 0;
+    for (size_t i = strlen(suffix); i > 0; i--) {
+        int32_t child = trie_child(node, suffix[i - 1]);
+
+        if (child < 0) {
+            child = trie_new_node(suffix[i - 1]);
+            if (child < 0)
+                return false;
+
+            cors_state.nodes[child].sibling = cors_state.nodes[node].child;
+            cors_state.nodes[node].child = child;
+        }
+
+        node = child;
+    }
+
+    wildcard->next = cors_state.nodes[node].wildcard;
+    cors_state.nodes[node].wildcard = index;
+    return true;
+}
+
+static bool wildcard_match(const char *origin, size_t len)
+{
+    if (cors_state.wildcard_count == 0)
+        return false;
+
+    const char *separator = strstr(origin, "://");
+    if (!separator)
+        return false;
+
+    size_t scheme_len = (size_t)(separator - origin);
+    size_t host_start = scheme_len + 3;
+
+    // An origin is only scheme, host and port
+    if (strpbrk(origin + host_start, "/@?#"))
+        return false;
+
+    int32_t node = 0;
+
+    // The wildcard matches at least one character of the host
+    for (size_t i = len; i > host_start + 1; i--) {
+        node = trie_child(node, origin[i - 1]);
+        if (node < 0)
+            return false;
+
+        for (int32_t w = cors_state.nodes[node].wildcard; w >= 0; w = cors_state.wildcards[w].next) {
+            const wildcard_t *wildcard = &cors_state.wildcards[w];
+
+            if (!wildcard->scheme ||
+                (wildcard->scheme_len == scheme_len && strncmp(wildcard->scheme, origin, scheme_len) == 0))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static bool cors_compile_origins(const char *const *origins, size_t count)
+{
+    size_t wildcard_count = 0;
+    size_t exact_count = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (!origins[i])
+            continue;
+
+        if (strcmp(origins[i], "*") == 0)
+            cors_state.any_origin = true;
+        else if (strstr(origins[i], "*."))
+            wildcard_count++;
+        else
+            exact_count++;
+    }
+
+    if (exact_count > 0) {
+        size_t capacity = 8;
+        while (capacity < exact_count * 2)
+            capacity *= 2;
+
+        cors_state.origin_set = calloc(capacity, sizeof(const char *));
+        if (!cors_state.origin_set)
+            return false;
+
+        cors_state.origin_set_mask = capacity - 1;
+    }
+
+    if (wildcard_count > 0) {
+        cors_state.wildcards = calloc(wildcard_count, sizeof(wildcard_t));
+        if (!cors_state.wildcards || trie_new_node('\0') < 0)
+            return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *origin = origins[i];
+
+        if (!origin || strcmp(origin, "*") == 0)
+            continue;
+
+        if (!strstr(origin, "*.")) {
+            if (strchr(origin, '*')) {
+                fprintf(stderr, "cors_init: Invalid origin '%s'\n", origin);
+                continue;
+            }
+
+            origin_set_add(origin);
+            continue;
+        }
+
+        if (!trie_add_wildcard(origin, cors_state.wildcard_count)) {
+            fprintf(stderr, "cors_init: Invalid origin pattern '%s'\n", origin);
+            continue;
+        }
+
+        cors_state.wildcard_count++;
+    }
+
+    return true;
+}
+
 static bool is_origin_allowed(const char *request_origin)
 {
-    if (!request_origin || !cors_state.origin)
+    if (!request_origin)
         return false;
 
-    if (strcmp(cors_state.origin, "*") == 0)
+    if (cors_state.any_origin)
         return true;
 
-    return strcmp(request_origin, cors_state.origin) == 0;
+    size_t len = strlen(request_origin);
+    return origin_set_contains(request_origin, len) || wildcard_match(request_origin, len);
+}
+
+// ============================================================================
+// PREFLIGHT
+// ============================================================================
+
+// Whether token appears in a comma separated list, case-insensitive
+static bool list_contains(const char *list, const char *token, size_t token_len)
+{
+    const char *p = list;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+
+        const char *start = p;
+        while (*p && *p != ',')
+            p++;
+
+        const char *end = p;
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t'))
+            end--;
+
+        if ((size_t)(end - start) == token_len && strncasecmp(start, token, token_len) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static bool is_method_allowed(const char *method)
+{
+    if (!method)
+        return true;
+
+    // CORS-safelisted methods need no permission
+    if (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0 || strcmp(method, "POST") == 0)
+        return true;
+
+    return list_contains(cors_state.methods, method, strlen(method));
+}
+
+static bool are_headers_allowed(const char *headers)
+{
+    if (!headers || strcmp(cors_state.headers, "*") == 0)
+        return true;
+
+    const char *p = headers;
+
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+
+        const char *start = p;
+        while (*p && *p != ',' && *p != ' ' && *p != '\t')
+            p++;
+
+        if (p > start && !list_contains(cors_state.headers, start, (size_t)(p - start)))
+            return false;
+
+        while (*p && *p != ',')
+            p++;
+    }
+
+    return true;
+}
+
+static void cors_free_cache(void)
+{
+    free(cors_state.cache);
+    free(cors_state.cache_buckets);
+
+    cors_state.cache = NULL;
+    cors_state.cache_buckets = NULL;
+    cors_state.cache_mask = 0;
+    cors_state.cache_head = NULL;
+    cors_state.cache_tail = NULL;
+    cors_state.cache_used = 0;
+}
+
+static void cors_init_cache(uint16_t size)
+{
+    cors_state.cache_size = size;
+    if (size == 0)
+        return;
+
+    size_t buckets = 16;
+    while (buckets < (size_t)size * 2)
+        buckets *= 2;
+
+    cors_state.cache = calloc(size, sizeof(preflight_entry_t));
+    cors_state.cache_buckets = calloc(buckets, sizeof(preflight_entry_t *));
+
+    if (!cors_state.cache || !cors_state.cache_buckets) {
+        fprintf(stderr, "cors_init: Preflight cache allocation failed\n");
+        cors_free_cache();
+        cors_state.cache_size = 0;
+        return;
+    }
+
+    cors_state.cache_mask = buckets - 1;
+}
+
+static void lru_unlink(preflight_entry_t *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        cors_state.cache_head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        cors_state.cache_tail = entry->prev;
+}
+
+static void lru_push_front(preflight_entry_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = cors_state.cache_head;
+
+    if (cors_state.cache_head)
+        cors_state.cache_head->prev = entry;
+    else
+        cors_state.cache_tail = entry;
+
+    cors_state.cache_head = entry;
+}
+
+static void bucket_remove(preflight_entry_t *entry)
+{
+    preflight_entry_t **link = &cors_state.cache_buckets[entry->hash & cors_state.cache_mask];
+
+    while (*link && *link != entry)
+        link = &(*link)->chain;
+
+    if (*link)
+        *link = entry->chain;
+}
+
+// The key is "origin\nmethod\nheaders"; returns 0 if it doesn't fit
+static size_t preflight_key(char *key, const char *origin, const char *method, const char *headers)
+{
+    int n = snprintf(key, PREFLIGHT_KEY_MAX, "%s\n%s\n%s", origin, method ? method : "", headers ? headers : "");
+
+    if (n < 0 || n >= PREFLIGHT_KEY_MAX)
+        return 0;
+
+    return (size_t)n;
+}
+
+static preflight_entry_t *cache_lookup(const char *key, size_t key_len, uint32_t hash)
+{
+    preflight_entry_t *entry = cors_state.cache_buckets[hash & cors_state.cache_mask];
+
+    for (; entry; entry = entry->chain) {
+        if (entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0) {
+            lru_unlink(entry);
+            lru_push_front(entry);
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void cache_insert(const char *key, size_t key_len, uint32_t hash, preflight_result_t result)
+{
+    preflight_entry_t *entry;
+
+    if (cors_state.cache_used < cors_state.cache_size) {
+        entry = &cors_state.cache[cors_state.cache_used++];
+    } else {
+        entry = cors_state.cache_tail;
+        lru_unlink(entry);
+        bucket_remove(entry);
+    }
+
+    entry->hash = hash;
+    entry->result = result;
+    entry->key_len = key_len;
+    memcpy(entry->key, key, key_len);
+
+    preflight_entry_t **bucket = &cors_state.cache_buckets[hash & cors_state.cache_mask];
+    entry->chain = *bucket;
+    *bucket = entry;
+
+    lru_push_front(entry);
+}
+
+static preflight_result_t check_preflight(const char *origin, const char *method, const char *headers)
+{
+    char key[PREFLIGHT_KEY_MAX];
+    size_t key_len = cors_state.cache_size ? preflight_key(key, origin, method, headers) : 0;
+    uint32_t hash = 0;
+
+    if (key_len > 0) {
+        hash = hash_bytes(HASH_INIT, key, key_len);
+
+        preflight_entry_t *entry = cache_lookup(key, key_len, hash);
+        if (entry)
+            return entry->result;
+    }
+
+    preflight_result_t result = PREFLIGHT_ALLOWED;
+
+    if (!is_origin_allowed(origin))
+        result = PREFLIGHT_BAD_ORIGIN;
+    else if (!is_method_allowed(method) || !are_headers_allowed(headers))
+        result = PREFLIGHT_BAD_REQUEST;
+
+    if (key_len > 0)
+        cache_insert(key, key_len, hash, result);
+
+    return result;
+}
+
+// ============================================================================
+// MIDDLEWARE
+// ============================================================================
+
+static void cors_build_headers(void)
+{
+    HttpHeader headers[] = {
+        { "Access-Control-Allow-Origin", cors_state.origin },
+        { "Access-Control-Allow-Methods", cors_state.methods },
+        { "Access-Control-Allow-Headers", cors_state.headers },
+        { "Access-Control-Allow-Credentials", cors_state.credentials },
+        { "Access-Control-Max-Age", cors_state.max_age },
+        { "Content-Type", "text/plain" },
+        { "Vary", "Origin" },
+    };
+
+    if (cors_state.any_origin)
+        headers[0].value = "*";
+
+    memcpy(cors_state.response_headers, headers, 4 * sizeof(HttpHeader));
+    memcpy(cors_state.preflight_headers, headers, 6 * sizeof(HttpHeader));
+
+    // The response depends on the Origin unless every origin is allowed
+    cors_state.response_header_count = 4;
+    cors_state.preflight_header_count = 6;
+
+    if (!cors_state.any_origin) {
+        cors_state.response_headers[cors_state.response_header_count++] = headers[6];
+        cors_state.preflight_headers[cors_state.preflight_header_count++] = headers[6];
+    }
+}
+
+static void add_headers(Res *res, const HttpHeader *headers, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+        set_header(res, headers[i].name, headers[i].value);
+}
+
+// "Vary: Origin" only, for responses without CORS headers
+static void add_vary(Res *res)
+{
+    if (!cors_state.any_origin)
+        add_headers(res, &cors_state.response_headers[cors_state.response_header_count - 1], 1);
 }
 
 static void cors_middleware(Req *req, Res *res, Next next)
 {
-    if (!cors_state.enabled)
+    if (!cors_state.enabled) {
         next(req, res);
+        return;
+    }
 
     const char *request_origin = get_header(req, "Origin");
 
     if (req->method && strcmp(req->method, "OPTIONS") == 0) {
-        if (request_origin && !is_origin_allowed(request_origin)) {
-            send_text(res, 403, "CORS: Origin not allowed");
+        if (!request_origin) {
+            // Same as below without Access-Control-Allow-Origin
+            add_headers(res, cors_state.preflight_headers + 1, cors_state.preflight_header_count - 1);
+            reply(res, 204, "", 0);
             return;
         }
 
-        if (strcmp(cors_state.origin, "*") == 0) {
-            set_header(res, "Access-Control-Allow-Origin", "*");
-        } else if (request_origin) {
-            set_header(res, "Access-Control-Allow-Origin", request_origin);
+        const char *method = get_header(req, "Access-Control-Request-Method");
+        const char *headers = get_header(req, "Access-Control-Request-Headers");
+
+        preflight_result_t result = check_preflight(request_origin, method, headers);
+
+        if (result != PREFLIGHT_ALLOWED) {
+            add_vary(res);
+            send_text(res, 403, result == PREFLIGHT_BAD_ORIGIN
+                                    ? "CORS: Origin not allowed"
+                                    : "CORS: Method or headers not allowed");
+            return;
         }
 
-        set_header(res, "Access-Control-Allow-Methods", cors_state.methods);
-        set_header(res, "Access-Control-Allow-Headers", cors_state.headers);
-        set_header(res, "Access-Control-Allow-Credentials", cors_state.credentials);
-        set_header(res, "Access-Control-Max-Age", cors_state.max_age);
+        HttpHeader preflight[PREFLIGHT_HEADER_COUNT];
+        memcpy(preflight, cors_state.preflight_headers, sizeof(preflight));
+
+        // Request headers outlive reply(), which serializes the response
+        if (!cors_state.any_origin)
+            preflight[0].value = request_origin;
 
-        set_header(res, "Content-Type", "text/plain");
+        add_headers(res, preflight, cors_state.preflight_header_count);
         reply(res, 204, "", 0);
         return;
     }
 
-    bool should_add = false;
-
-    if (strcmp(cors_state.origin, "*") == 0) {
-        set_header(res, "Access-Control-Allow-Origin", "*");
-        should_add = true;
-    } else if (request_origin && is_origin_allowed(request_origin)) {
-        set_header(res, "Access-Control-Allow-Origin", request_origin);
-        should_add = true;
-    }
+    if (cors_state.any_origin) {
+        add_headers(res, cors_state.response_headers, cors_state.response_header_count);
+    } else if (is_origin_allowed(request_origin)) {
+        HttpHeader headers[CORS_HEADER_COUNT];
+        memcpy(headers, cors_state.response_headers, sizeof(headers));
+        headers[0].value = request_origin;
 
-    if (should_add) {
-        set_header(res, "Access-Control-Allow-Methods", cors_state.methods);
-        set_header(res, "Access-Control-Allow-Headers", cors_state.headers);
-        set_header(res, "Access-Control-Allow-Credentials", cors_state.credentials);
+        add_headers(res, headers, cors_state.response_header_count);
+    } else {
+        add_vary(res);
     }
 
     next(req, res);
@@ -97,6 +672,14 @@ static void cors_middleware(Req *req, Res *res, Next next)
 void cors_init(const Cors *config)
 {
     cors_state.enabled = false;
+    cors_state.any_origin = false;
+
+    cors_free_origins();
+    cors_free_cache();
+
+    const char *const *origins = NULL;
+    size_t origin_count = 0;
+    uint16_t cache_size = DEFAULT_PREFLIGHT_CACHE_SIZE;
 
     if (config) {
         cors_state.origin = config->origin;
@@ -104,6 +687,12 @@ void cors_init(const Cors *config)
         cors_state.headers = config->headers;
         cors_state.credentials = config->credentials;
         cors_state.max_age = config->max_age;
+
+        origins = config->origins;
+        origin_count = config->origin_count;
+
+        if (config->preflight_cache_size > 0)
+            cache_size = config->preflight_cache_size;
     } else {
         cors_state.origin = NULL;
         cors_state.methods = NULL;
@@ -113,6 +702,27 @@ void cors_init(const Cors *config)
     }
 
     cors_set_defaults();
-    use(cors_middleware);
+
+    // A single origin is an allowlist of one
+    if (!origins || origin_count == 0) {
+        origins = &cors_state.origin;
+        origin_count = 1;
+    }
+
+    if (!cors_compile_origins(origins, origin_count)) {
+        fprintf(stderr, "cors_init: Memory allocation failed\n");
+        cors_free_origins();
+    }
+
+    cors_init_cache(cache_size);
+    cors_build_headers();
+
+    // Calling it again replaces the config, the middleware is added once
+    static bool registered = false;
+    if (!registered) {
+        use(cors_middleware);
+        registered = true;
+    }
+
     cors_state.enabled = true;
 }
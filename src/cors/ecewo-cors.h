@@ -5,6 +5,9 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef struct
 {
     const char *origin; // Default: "*"
@@ -12,6 +15,13 @@ typedef struct
     const char *headers; // Default: "Content-Type"
     const char *credentials; // Default: "false"
     const char *max_age; // Default: "3600"
+
+    // Allowed origins, replaces origin if set
+    // e.g. "https://example.com", "*.example.com", "https://*.example.com"
+    const char *const *origins;
+    size_t origin_count;
+
+    uint16_t preflight_cache_size; // Default: 64 preflight results
 } Cors;
 
 void cors_init(const Cors *config);
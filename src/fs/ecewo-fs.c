@@ -1,10 +1,47 @@
+#if defined(__linux__) && defined(ECEWO_FS_IO_URING)
+#define _GNU_SOURCE
+#define FS_HAVE_IO_URING
+#endif
+
 #include "ecewo-fs.h"
 #include "ecewo.h" // Only for get_loop()
+#include "ecewo-metrics.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-typedef struct
+#include <stdint.h>
+
+#ifdef FS_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// uv_buf_t lengths are unsigned int on Windows, so larger files are read in pieces
+#define READ_CHUNK_MAX ((size_t)1 << 30)
+
+#define REQUEST_POOL_MAX 64 // Idle requests kept for reuse
+#define INLINE_PATH_MAX 128 // Shorter paths are stored in the request
+#define ERROR_MSG_MAX 128
+
+#define STREAM_CHUNK_SIZE (64 * 1024)
+#define STREAM_POOL_MAX 16 // Idle chunks kept for the next streams
+
+struct fs_file_s
+{
+    uv_file fd;
+    unsigned int pending; // operations in progress
+    bool closing;
+    fs_write_callback_t close_callback;
+    void *close_data;
+};
+
+typedef struct fs_request_s
 {
     uv_fs_t fs_req;
     void *user_data;
@@ -21,409 +58,2076 @@ typedef struct
 
     // Internal
     uv_file file;
-    size_t file_size;
-    char *path;
+    size_t file_size; // Bytes to read
+    int64_t offset; // Where reading starts
+    size_t length; // Requested length, SIZE_MAX for the rest of the file
+    char *path; // Points to path_buf unless the path is longer
+
+    // File handle operations
+    fs_file_t *handle;
+    fs_open_callback_t open_callback;
+    uv_buf_t *bufs; // Copy of the caller's buffers, advanced by short writes
+    unsigned int nbufs;
+    unsigned int buf_index;
+
+    // Batch operations
+    fs_batch_t *batch;
+    int op;
+    char *new_path;
+    bool failed;
+
+    char error[ERROR_MSG_MAX];
+    char path_buf[INLINE_PATH_MAX];
+    uint64_t start_ns; // For the latency histogram
+    struct fs_request_s *next; // Free list
 } fs_request_t;
 
-static char *make_error_msg(int errcode)
+// Every request has its own buffer, so errors in flight at the same time
+// don't overwrite each other
+static char *make_error_msg(char *buf, int errcode)
 {
-    static char buf[256];
-    snprintf(buf, sizeof(buf), "%s: %s", uv_err_name(errcode), uv_strerror(errcode));
+    snprintf(buf, ERROR_MSG_MAX, "%s: %s", uv_err_name(errcode), uv_strerror(errcode));
     return buf;
 }
 
-static void fs_request_cleanup(fs_request_t *req, bool free_data)
+// ============================================================================
+// BACKEND
+// ============================================================================
+
+// On Linux builds with ECEWO_FS_IO_URING, file operations are submitted to
+// an io_uring instead of the libuv thread pool. Each backend_*() call has the
+// signature of its uv_fs_*() counterpart and completes the same uv_fs_t, so
+// the callbacks can't tell the two apart. Anything the ring can't do, because
+// the kernel lacks the opcode or the ring is full, goes to uv_fs_*()
+
+#ifdef FS_HAVE_IO_URING
+
+#define URING_ENTRIES 256
+#define URING_FIXED_FILES 64
+#define URING_OP_POOL_MAX 256
+
+// struct statx, declared here since <linux/stat.h> conflicts with <sys/stat.h>
+typedef struct
 {
-    if (!req)
-        return;
+    int64_t tv_sec;
+    uint32_t tv_nsec;
+    int32_t reserved;
+} fs_statx_timestamp_t;
 
-    if (req->path)
-        free(req->path);
+typedef struct
+{
+    uint32_t stx_mask;
+    uint32_t stx_blksize;
+    uint64_t stx_attributes;
+    uint32_t stx_nlink;
+    uint32_t stx_uid;
+    uint32_t stx_gid;
+    uint16_t stx_mode;
+    uint16_t spare0;
+    uint64_t stx_ino;
+    uint64_t stx_size;
+    uint64_t stx_blocks;
+    uint64_t stx_attributes_mask;
+    fs_statx_timestamp_t stx_atime;
+    fs_statx_timestamp_t stx_btime;
+    fs_statx_timestamp_t stx_ctime;
+    fs_statx_timestamp_t stx_mtime;
+    uint32_t stx_rdev_major;
+    uint32_t stx_rdev_minor;
+    uint32_t stx_dev_major;
+    uint32_t stx_dev_minor;
+    uint64_t spare2[14];
+} fs_statx_t;
+
+#define FS_STATX_ALL 0xfffU // STATX_BASIC_STATS | STATX_BTIME
+
+typedef struct uring_op_s
+{
+    uv_fs_t *req;
+    uv_fs_cb cb;
+    uv_fs_type fs_type;
 
-    if (free_data && req->data)
-        free(req->data);
+    // The kernel may read these after io_uring_enter() returned,
+    // so they live until the completion
+    char *path;
+    char *new_path;
+    struct iovec iov_small[4];
+    struct iovec *iov;
+    fs_statx_t statx;
 
-    free(req);
+    struct uring_op_s *next; // Free list
+} uring_op_t;
+
+static struct
+{
+    bool initialized;
+    bool available;
+    uv_loop_t *loop;
+    int fd;
+    unsigned int features;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    unsigned int sq_entries;
+    struct io_uring_sqe *sqes;
+
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    unsigned int cq_entries;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    unsigned int queued;   // Filled in, not submitted yet
+    unsigned int inflight; // Submitted or queued, not completed yet
+
+    uv_poll_t poll;      // The ring fd is readable while completions are waiting
+    uv_prepare_t submit; // One io_uring_enter() per loop iteration
+
+    uint8_t supported[IORING_OP_LAST];
+
+    // Fixed files: descriptors of fs_open() handles, indexed by slot
+    bool files_registered;
+    int files[URING_FIXED_FILES];
+
+    // Registered buffers: the stream chunks, one iovec each
+    char *chunks;
+    char *free_chunks[STREAM_POOL_MAX];
+    int free_chunk_count;
+
+    uring_op_t *free_ops;
+    int free_op_count;
+} uring = { .fd = -1 };
+
+static int uring_register(unsigned int opcode, const void *arg, unsigned int nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, uring.fd, opcode, arg, nr_args);
 }
 
-static void read_close_cb(uv_fs_t *req)
+static int uring_enter(unsigned int to_submit)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    return (int)syscall(__NR_io_uring_enter, uring.fd, to_submit, 0, 0, NULL, 0);
+}
 
-    uv_fs_req_cleanup(req);
+static void uring_reap(void);
 
-    fs_req->read_callback(NULL, fs_req->data, fs_req->size, fs_req->user_data);
+static void uring_flush(void)
+{
+    while (uring.queued > 0) {
+        int submitted = uring_enter(uring.queued);
 
-    // Cleanup but don't free data, user owns it now
-    fs_request_cleanup(fs_req, false);
+        if (submitted < 0 && errno == EINTR)
+            continue;
+
+        // The completion queue is full, free it up and try again
+        if (submitted < 0 && (errno == EAGAIN || errno == EBUSY)) {
+            uring_reap();
+            submitted = uring_enter(uring.queued);
+        }
+
+        if (submitted <= 0)
+            break;
+
+        uring.queued -= (unsigned int)submitted;
+    }
 }
 
-static void read_data_cb(uv_fs_t *req)
+static void on_uring_submit(uv_prepare_t *handle)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    (void)handle;
+    uring_flush();
+}
 
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
-        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+static void statx_to_uv(const fs_statx_t *stx, uv_stat_t *st)
+{
+    memset(st, 0, sizeof(uv_stat_t));
+    st->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    st->st_mode = stx->stx_mode;
+    st->st_nlink = stx->stx_nlink;
+    st->st_uid = stx->stx_uid;
+    st->st_gid = stx->stx_gid;
+    st->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    st->st_ino = stx->stx_ino;
+    st->st_size = stx->stx_size;
+    st->st_blksize = stx->stx_blksize;
+    st->st_blocks = stx->stx_blocks;
+    st->st_atim.tv_sec = stx->stx_atime.tv_sec;
+    st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    st->st_mtim.tv_sec = stx->stx_mtime.tv_sec;
+    st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    st->st_ctim.tv_sec = stx->stx_ctime.tv_sec;
+    st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+    st->st_birthtim.tv_sec = stx->stx_btime.tv_sec;
+    st->st_birthtim.tv_nsec = stx->stx_btime.tv_nsec;
+}
 
-        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
-        fs_request_cleanup(fs_req, true);
-        return;
-    }
+static uring_op_t *uring_op_acquire(void)
+{
+    uring_op_t *op = uring.free_ops;
 
-    fs_req->size = (size_t)req->result;
-    fs_req->data[fs_req->size] = '\0';
+    if (op) {
+        uring.free_ops = op->next;
+        uring.free_op_count--;
+        return op;
+    }
 
-    uv_fs_req_cleanup(req);
-    uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, read_close_cb);
+    return malloc(sizeof(uring_op_t));
 }
 
-static void read_open_cb(uv_fs_t *req)
+static void uring_op_release(uring_op_t *op)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    free(op->path);
+    free(op->new_path);
 
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
+    if (op->iov != op->iov_small)
+        free(op->iov);
 
-        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
-        fs_request_cleanup(fs_req, false);
+    if (uring.free_op_count >= URING_OP_POOL_MAX) {
+        free(op);
         return;
     }
 
-    fs_req->file = (uv_file)req->result;
-    uv_fs_req_cleanup(req);
-
-    fs_req->data = malloc(fs_req->file_size + 1);
-    if (!fs_req->data) {
-        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+    op->next = uring.free_ops;
+    uring.free_ops = op;
+    uring.free_op_count++;
+}
 
-        fs_req->read_callback("Memory allocation failed", NULL, 0, fs_req->user_data);
-        fs_request_cleanup(fs_req, false);
-        return;
+static void uring_complete(uring_op_t *op, int res)
+{
+    uv_fs_t *req = op->req;
+    uv_fs_cb cb = op->cb;
+    void *data = req->data;
+
+    // Looks like a finished libuv request, uv_fs_req_cleanup() included
+    memset(req, 0, sizeof(uv_fs_t));
+    req->data = data;
+    req->type = UV_FS;
+    req->fs_type = op->fs_type;
+    req->loop = uring.loop;
+    req->result = res;
+
+    if (op->fs_type == UV_FS_STAT && res == 0) {
+        statx_to_uv(&op->statx, &req->statbuf);
+        req->ptr = &req->statbuf;
     }
 
-    uv_buf_t buf = uv_buf_init(fs_req->data, (unsigned int)fs_req->file_size);
-    uv_fs_read(get_loop(), &fs_req->fs_req, fs_req->file, &buf, 1, 0, read_data_cb);
+    uring_op_release(op);
+    cb(req);
 }
 
-static void read_stat_cb(uv_fs_t *req)
+static void uring_reap(void)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    unsigned int head = *uring.cq_head;
 
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
+    while (head != __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+        uring_op_t *op = (uring_op_t *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
 
-        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
-        fs_request_cleanup(fs_req, false);
-        return;
+        __atomic_store_n(uring.cq_head, ++head, __ATOMIC_RELEASE);
+        uring.inflight--;
+
+        // May queue the next operation
+        uring_complete(op, res);
+        head = *uring.cq_head;
     }
 
-    fs_req->file_size = (size_t)req->statbuf.st_size;
-    uv_fs_req_cleanup(req);
+    if (uring.inflight == 0)
+        uv_unref((uv_handle_t *)&uring.poll);
+}
 
-    uv_fs_open(get_loop(), &fs_req->fs_req, fs_req->path,
-               UV_FS_O_RDONLY, 0, read_open_cb);
+static void on_uring_readable(uv_poll_t *handle, int status, int events)
+{
+    (void)handle;
+    (void)status;
+    (void)events;
+    uring_reap();
 }
 
-void fs_read_file(const char *path, fs_read_callback_t callback, void *user_data)
+static bool uring_map(const struct io_uring_params *params)
 {
-    if (!path || !callback) {
-        fprintf(stderr, "fs_read_file: Invalid arguments\n");
-        return;
-    }
+    uring.sq_ring_size = params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+    uring.cq_ring_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
 
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req) {
-        fprintf(stderr, "fs_read_file: Memory allocation failed\n");
-        return;
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring.cq_ring_size > uring.sq_ring_size)
+            uring.sq_ring_size = uring.cq_ring_size;
+        uring.cq_ring_size = uring.sq_ring_size;
     }
 
-    fs_req->user_data = user_data;
-    fs_req->read_callback = callback;
-    fs_req->path = strdup(path);
-    fs_req->fs_req.data = fs_req;
-
-    if (!fs_req->path) {
-        free(fs_req);
-        return;
+    uring.sq_ring = mmap(NULL, uring.sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQ_RING);
+    if (uring.sq_ring == MAP_FAILED)
+        return false;
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        uring.cq_ring = uring.sq_ring;
+    } else {
+        uring.cq_ring = mmap(NULL, uring.cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_CQ_RING);
+        if (uring.cq_ring == MAP_FAILED)
+            return false;
     }
 
-    int result = uv_fs_stat(get_loop(), &fs_req->fs_req, fs_req->path, read_stat_cb);
-    if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, NULL, 0, user_data);
-        free(fs_req->path);
-        free(fs_req);
-    }
+    uring.sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    uring.sqes = mmap(NULL, uring.sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQES);
+    if (uring.sqes == MAP_FAILED)
+        return false;
+
+    char *sq = (char *)uring.sq_ring;
+    uring.sq_head = (unsigned int *)(sq + params->sq_off.head);
+    uring.sq_tail = (unsigned int *)(sq + params->sq_off.tail);
+    uring.sq_mask = (unsigned int *)(sq + params->sq_off.ring_mask);
+    uring.sq_array = (unsigned int *)(sq + params->sq_off.array);
+    uring.sq_entries = params->sq_entries;
+
+    char *cq = (char *)uring.cq_ring;
+    uring.cq_head = (unsigned int *)(cq + params->cq_off.head);
+    uring.cq_tail = (unsigned int *)(cq + params->cq_off.tail);
+    uring.cq_mask = (unsigned int *)(cq + params->cq_off.ring_mask);
+    uring.cqes = (struct io_uring_cqe *)(cq + params->cq_off.cqes);
+    uring.cq_entries = params->cq_entries;
+
+    return true;
 }
 
-static void write_close_cb(uv_fs_t *req)
+static bool uring_probe(void)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
-    uv_fs_req_cleanup(req);
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe)
+        return false;
 
-    fs_req->write_callback(NULL, fs_req->user_data);
-    fs_request_cleanup(fs_req, true);
+    // Kernels before 5.6 have no probe, and not the opcodes needed here either
+    bool ok = uring_register(IORING_REGISTER_PROBE, probe, 256) == 0;
+
+    for (unsigned int i = 0; ok && i < probe->ops_len && i < IORING_OP_LAST; i++)
+        uring.supported[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+
+    free(probe);
+    return ok && uring.supported[IORING_OP_READ] && uring.supported[IORING_OP_WRITE];
 }
 
-static void write_data_cb(uv_fs_t *req)
+static void uring_register_resources(void)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    for (int i = 0; i < URING_FIXED_FILES; i++)
+        uring.files[i] = -1;
 
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
-        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+    uring.files_registered = uring_register(IORING_REGISTER_FILES, uring.files, URING_FIXED_FILES) == 0;
 
-        fs_req->write_callback(error, fs_req->user_data);
-        fs_request_cleanup(fs_req, true);
+    // Needs locked memory on kernels before 5.12, streams still work without
+    if (posix_memalign((void **)&uring.chunks, 4096, (size_t)STREAM_POOL_MAX * STREAM_CHUNK_SIZE) != 0) {
+        uring.chunks = NULL;
         return;
     }
 
-    fs_req->size = (size_t)req->result;
-    uv_fs_req_cleanup(req);
-    uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, write_close_cb);
+    struct iovec iov[STREAM_POOL_MAX];
+    for (int i = 0; i < STREAM_POOL_MAX; i++) {
+        iov[i].iov_base = uring.chunks + (size_t)i * STREAM_CHUNK_SIZE;
+        iov[i].iov_len = STREAM_CHUNK_SIZE;
+    }
+
+    if (uring_register(IORING_REGISTER_BUFFERS, iov, STREAM_POOL_MAX) != 0) {
+        free(uring.chunks);
+        uring.chunks = NULL;
+        return;
+    }
+
+    for (int i = 0; i < STREAM_POOL_MAX; i++)
+        uring.free_chunks[uring.free_chunk_count++] = (char *)iov[i].iov_base;
 }
 
-static void write_open_cb(uv_fs_t *req)
+static void uring_teardown(void)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
-
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
+    if (uring.sqes && uring.sqes != MAP_FAILED)
+        munmap(uring.sqes, uring.sqes_size);
 
-        fs_req->write_callback(error, fs_req->user_data);
-        fs_request_cleanup(fs_req, true);
-        return;
-    }
+    if (uring.cq_ring && uring.cq_ring != MAP_FAILED && uring.cq_ring != uring.sq_ring)
+        munmap(uring.cq_ring, uring.cq_ring_size);
 
-    fs_req->file = (uv_file)req->result;
-    uv_fs_req_cleanup(req);
+    if (uring.sq_ring && uring.sq_ring != MAP_FAILED)
+        munmap(uring.sq_ring, uring.sq_ring_size);
 
-    uv_buf_t buf = uv_buf_init(fs_req->data, (unsigned int)fs_req->size);
-    uv_fs_write(get_loop(), &fs_req->fs_req, fs_req->file, &buf, 1, 0, write_data_cb);
+    close(uring.fd);
+    uring.fd = -1;
 }
 
-static void fs_write_internal(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data, int flags)
+static void uring_init(uv_loop_t *loop)
 {
-    if (!path || !data || !callback) {
-        fprintf(stderr, "fs_write: Invalid arguments\n");
+    uring.initialized = true;
+
+    const char *env = getenv("ECEWO_FS_IO_URING");
+    if (env && strcmp(env, "0") == 0)
         return;
-    }
 
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req)
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    // Unavailable in many containers and on old kernels
+    uring.fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (uring.fd < 0)
         return;
 
-    fs_req->user_data = user_data;
-    fs_req->write_callback = callback;
-    fs_req->path = strdup(path);
-    fs_req->data = malloc(size);
-    fs_req->size = size;
-    fs_req->fs_req.data = fs_req;
+    uring.features = params.features;
 
-    if (!fs_req->path || !fs_req->data) {
-        fs_request_cleanup(fs_req, true);
+    if (!uring_map(&params) || !uring_probe()) {
+        uring_teardown();
         return;
     }
 
-    memcpy(fs_req->data, data, size);
+    uring_register_resources();
 
-    int result = uv_fs_open(get_loop(), &fs_req->fs_req, fs_req->path,
-                            flags, 0644, write_open_cb);
+    uv_poll_init(loop, &uring.poll, uring.fd);
+    uv_poll_start(&uring.poll, UV_READABLE, on_uring_readable);
+    uv_unref((uv_handle_t *)&uring.poll);
 
-    if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, user_data);
-        fs_request_cleanup(fs_req, true);
-    }
+    uv_prepare_init(loop, &uring.submit);
+    uv_prepare_start(&uring.submit, on_uring_submit);
+    uv_unref((uv_handle_t *)&uring.submit);
+
+    uring.loop = loop;
+    uring.available = true;
 }
 
-void fs_write_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data)
+static bool uring_ready(uv_loop_t *loop, int opcode)
 {
-    fs_write_internal(path, data, size, callback, user_data,
-                      UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC);
+    if (!uring.initialized)
+        uring_init(loop);
+
+    // Completions beyond the queue size would be buffered by the kernel,
+    // going to the thread pool instead keeps the latency bounded
+    return uring.available && loop == uring.loop && uring.supported[opcode] &&
+           uring.inflight < uring.cq_entries;
 }
 
-void fs_append_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data)
+static struct io_uring_sqe *uring_get_sqe(void)
 {
-    fs_write_internal(path, data, size, callback, user_data,
-                      UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_APPEND);
+    unsigned int tail = *uring.sq_tail;
+
+    if (tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE) >= uring.sq_entries) {
+        uring_flush();
+        if (tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE) >= uring.sq_entries)
+            return NULL;
+    }
+
+    unsigned int index = tail & *uring.sq_mask;
+    struct io_uring_sqe *sqe = &uring.sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    uring.sq_array[index] = index;
+    return sqe;
 }
 
-static void stat_cb(uv_fs_t *req)
+static int uring_queue(struct io_uring_sqe *sqe, uring_op_t *op, uv_fs_t *req, uv_fs_type fs_type, uv_fs_cb cb)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    op->req = req;
+    op->cb = cb;
+    op->fs_type = fs_type;
+    sqe->user_data = (uint64_t)(uintptr_t)op;
 
-    if (req->result < 0) {
-        char *error = make_error_msg((int)req->result);
-        uv_fs_req_cleanup(req);
+    __atomic_store_n(uring.sq_tail, *uring.sq_tail + 1, __ATOMIC_RELEASE);
+    uring.queued++;
 
-        fs_req->stat_callback(error, NULL, fs_req->user_data);
-        fs_request_cleanup(fs_req, false);
-        return;
-    }
+    if (uring.inflight++ == 0)
+        uv_ref((uv_handle_t *)&uring.poll);
 
-    fs_req->stat = req->statbuf;
-    uv_fs_req_cleanup(req);
+    return 0;
+}
 
-    // Success
-    fs_req->stat_callback(NULL, &fs_req->stat, fs_req->user_data);
-    fs_request_cleanup(fs_req, false);
+// The op and the SQE are only taken once the operation can't fail anymore
+static uring_op_t *uring_prepare_op(void)
+{
+    uring_op_t *op = uring_op_acquire();
+    if (!op)
+        return NULL;
+
+    op->path = NULL;
+    op->new_path = NULL;
+    op->iov = op->iov_small;
+    return op;
 }
 
-void fs_stat(const char *path, fs_stat_callback_t callback, void *user_data)
+static int uring_fixed_file(uv_file file)
 {
-    if (!path || !callback)
-        return;
+    if (!uring.files_registered)
+        return -1;
 
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req)
-        return;
+    for (int i = 0; i < URING_FIXED_FILES; i++) {
+        if (uring.files[i] == file)
+            return i;
+    }
 
-    fs_req->user_data = user_data;
-    fs_req->stat_callback = callback;
-    fs_req->path = strdup(path);
-    fs_req->fs_req.data = fs_req;
+    return -1;
+}
+
+static bool uring_update_file(int slot, int fd)
+{
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = (uint32_t)slot;
+    update.fds = (uint64_t)(uintptr_t)&fd;
+
+    if (uring_register(IORING_REGISTER_FILES_UPDATE, &update, 1) != 1)
+        return false;
 
-    if (!fs_req->path) {
-        free(fs_req);
+    uring.files[slot] = fd;
+    return true;
+}
+
+static void uring_register_file(uv_file file)
+{
+    if (!uring.available || !uring.files_registered)
         return;
-    }
 
-    int result = uv_fs_stat(get_loop(), &fs_req->fs_req, fs_req->path, stat_cb);
-    if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, NULL, user_data);
-        free(fs_req->path);
-        free(fs_req);
-    }
+    int slot = uring_fixed_file(-1);
+    if (slot >= 0)
+        uring_update_file(slot, file);
 }
 
-static void simple_op_cb(uv_fs_t *req)
+static void uring_unregister_file(uv_file file)
 {
-    fs_request_t *fs_req = (fs_request_t *)req->data;
+    int slot = uring_fixed_file(file);
+    if (slot >= 0)
+        uring_update_file(slot, -1);
+}
 
-    char *error = NULL;
-    if (req->result < 0)
-        error = make_error_msg((int)req->result);
+// Index of the registered buffer holding ptr, or -1
+static int uring_chunk_index(const char *ptr)
+{
+    if (!uring.chunks || ptr < uring.chunks ||
+        ptr >= uring.chunks + (size_t)STREAM_POOL_MAX * STREAM_CHUNK_SIZE)
+        return -1;
 
-    uv_fs_req_cleanup(req);
+    return (int)((ptr - uring.chunks) / STREAM_CHUNK_SIZE);
+}
 
-    fs_req->write_callback(error, fs_req->user_data);
-    fs_request_cleanup(fs_req, false);
+static char *uring_chunk_acquire(void)
+{
+    if (uring.free_chunk_count == 0)
+        return NULL;
+
+    return uring.free_chunks[--uring.free_chunk_count];
 }
 
-typedef int (*uv_fs_op_t)(uv_loop_t *, uv_fs_t *, const char *, uv_fs_cb);
-typedef int (*uv_fs_op_mode_t)(uv_loop_t *, uv_fs_t *, const char *, int, uv_fs_cb);
+static bool uring_chunk_release(char *chunk)
+{
+    if (uring_chunk_index(chunk) < 0)
+        return false;
 
-static void fs_simple_op(const char *path, fs_write_callback_t callback, void *user_data, uv_fs_op_t op_fn)
+    uring.free_chunks[uring.free_chunk_count++] = chunk;
+    return true;
+}
+
+static int uring_rw(uv_loop_t *loop, uv_fs_t *req, uv_file file, const uv_buf_t bufs[],
+                    unsigned int nbufs, int64_t offset, uv_fs_cb cb, bool write)
 {
-    if (!path || !callback)
-        return;
+    bool vectored = nbufs > 1;
+    int opcode = vectored ? (write ? IORING_OP_WRITEV : IORING_OP_READV)
+                          : (write ? IORING_OP_WRITE : IORING_OP_READ);
+
+    if (!uring_ready(loop, opcode))
+        return UV_ENOSYS;
+
+    // -1 (the current position) needs kernel support
+    if (offset < 0 && !(uring.features & IORING_FEAT_RW_CUR_POS))
+        return UV_ENOSYS;
+
+    int buf_index = vectored ? -1 : uring_chunk_index(bufs[0].base);
+    if (buf_index >= 0)
+        opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+
+    uring_op_t *op = uring_prepare_op();
+    if (!op)
+        return UV_ENOSYS;
+
+    if (vectored && nbufs > 4) {
+        op->iov = malloc(nbufs * sizeof(struct iovec));
+        if (!op->iov) {
+            op->iov = op->iov_small;
+            uring_op_release(op);
+            return UV_ENOSYS;
+        }
+    }
 
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req)
-        return;
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe) {
+        uring_op_release(op);
+        return UV_ENOSYS;
+    }
 
-    fs_req->user_data = user_data;
-    fs_req->write_callback = callback;
-    fs_req->path = strdup(path);
-    fs_req->fs_req.data = fs_req;
+    sqe->opcode = (uint8_t)opcode;
+    sqe->off = (uint64_t)offset;
 
-    if (!fs_req->path) {
-        free(fs_req);
-        return;
+    if (vectored) {
+        for (unsigned int i = 0; i < nbufs; i++) {
+            op->iov[i].iov_base = bufs[i].base;
+            op->iov[i].iov_len = bufs[i].len;
+        }
+
+        sqe->addr = (uint64_t)(uintptr_t)op->iov;
+        sqe->len = nbufs;
+    } else {
+        sqe->addr = (uint64_t)(uintptr_t)bufs[0].base;
+        sqe->len = (uint32_t)bufs[0].len;
     }
 
-    int result = op_fn(get_loop(), &fs_req->fs_req, fs_req->path, simple_op_cb);
-    if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, user_data);
-        free(fs_req->path);
-        free(fs_req);
+    if (buf_index >= 0)
+        sqe->buf_index = (uint16_t)buf_index;
+
+    int slot = uring_fixed_file(file);
+    if (slot >= 0) {
+        sqe->fd = slot;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = file;
     }
+
+    return uring_queue(sqe, op, req, write ? UV_FS_WRITE : UV_FS_READ, cb);
 }
 
-static void fs_simple_op_mode(const char *path, fs_write_callback_t callback, void *user_data, int mode, uv_fs_op_mode_t op_fn)
+// Operations taking a path: open, stat, unlink, rename
+static int uring_path_op(uv_loop_t *loop, uv_fs_t *req, int opcode, uv_fs_type fs_type,
+                         const char *path, const char *new_path, int flags, int mode, uv_fs_cb cb)
 {
-    if (!path || !callback)
-        return;
+    if (!uring_ready(loop, opcode))
+        return UV_ENOSYS;
 
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req)
-        return;
+    uring_op_t *op = uring_prepare_op();
+    if (!op)
+        return UV_ENOSYS;
 
-    fs_req->user_data = user_data;
-    fs_req->write_callback = callback;
-    fs_req->path = strdup(path);
-    fs_req->fs_req.data = fs_req;
+    op->path = strdup(path);
+    op->new_path = new_path ? strdup(new_path) : NULL;
 
-    if (!fs_req->path) {
-        free(fs_req);
-        return;
+    struct io_uring_sqe *sqe = NULL;
+    if (op->path && (!new_path || op->new_path))
+        sqe = uring_get_sqe();
+
+    if (!sqe) {
+        uring_op_release(op);
+        return UV_ENOSYS;
     }
 
-    int result = op_fn(get_loop(), &fs_req->fs_req, fs_req->path, mode, simple_op_cb);
-    if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, user_data);
-        free(fs_req->path);
-        free(fs_req);
+    sqe->opcode = (uint8_t)opcode;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uint64_t)(uintptr_t)op->path;
+
+    switch (opcode) {
+    case IORING_OP_OPENAT:
+        sqe->len = (uint32_t)mode;
+        sqe->open_flags = (uint32_t)(flags | O_CLOEXEC);
+        break;
+    case IORING_OP_STATX:
+        sqe->len = FS_STATX_ALL;
+        sqe->addr2 = (uint64_t)(uintptr_t)&op->statx;
+        break;
+    case IORING_OP_RENAMEAT:
+        sqe->len = (uint32_t)AT_FDCWD;
+        sqe->addr2 = (uint64_t)(uintptr_t)op->new_path;
+        break;
     }
+
+    return uring_queue(sqe, op, req, fs_type, cb);
 }
 
-void fs_unlink(const char *path, fs_write_callback_t callback, void *user_data)
+static int uring_close(uv_loop_t *loop, uv_fs_t *req, uv_file file, uv_fs_cb cb)
 {
-    fs_simple_op(path, callback, user_data, uv_fs_unlink);
+    if (!uring_ready(loop, IORING_OP_CLOSE))
+        return UV_ENOSYS;
+
+    uring_op_t *op = uring_prepare_op();
+    if (!op)
+        return UV_ENOSYS;
+
+    struct io_uring_sqe *sqe = uring_get_sqe();
+    if (!sqe) {
+        uring_op_release(op);
+        return UV_ENOSYS;
+    }
+
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = file;
+    return uring_queue(sqe, op, req, UV_FS_CLOSE, cb);
 }
 
-void fs_mkdir(const char *path, fs_write_callback_t callback, void *user_data)
+#endif // FS_HAVE_IO_URING
+
+// Synchronous calls (cb == NULL) always go to libuv
+static int backend_open(uv_loop_t *loop, uv_fs_t *req, const char *path, int flags, int mode, uv_fs_cb cb)
 {
-    fs_simple_op_mode(path, callback, user_data, 0755, uv_fs_mkdir);
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_path_op(loop, req, IORING_OP_OPENAT, UV_FS_OPEN, path, NULL, flags, mode, cb) == 0)
+        return 0;
+#endif
+    return uv_fs_open(loop, req, path, flags, mode, cb);
 }
 
-void fs_rmdir(const char *path, fs_write_callback_t callback, void *user_data)
+static int backend_close(uv_loop_t *loop, uv_fs_t *req, uv_file file, uv_fs_cb cb)
 {
-    fs_simple_op(path, callback, user_data, uv_fs_rmdir);
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_close(loop, req, file, cb) == 0)
+        return 0;
+#endif
+    return uv_fs_close(loop, req, file, cb);
 }
 
-void fs_rename(const char *old_path, const char *new_path, fs_write_callback_t callback, void *user_data)
+static int backend_read(uv_loop_t *loop, uv_fs_t *req, uv_file file, const uv_buf_t bufs[],
+                        unsigned int nbufs, int64_t offset, uv_fs_cb cb)
 {
-    if (!old_path || !new_path || !callback)
-        return;
-
-    fs_request_t *fs_req = calloc(1, sizeof(fs_request_t));
-    if (!fs_req)
-        return;
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_rw(loop, req, file, bufs, nbufs, offset, cb, false) == 0)
+        return 0;
+#endif
+    return uv_fs_read(loop, req, file, bufs, nbufs, offset, cb);
+}
 
-    fs_req->user_data = user_data;
-    fs_req->write_callback = callback;
-    fs_req->path = strdup(new_path);
-    fs_req->fs_req.data = fs_req;
+static int backend_write(uv_loop_t *loop, uv_fs_t *req, uv_file file, const uv_buf_t bufs[],
+                         unsigned int nbufs, int64_t offset, uv_fs_cb cb)
+{
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_rw(loop, req, file, bufs, nbufs, offset, cb, true) == 0)
+        return 0;
+#endif
+    return uv_fs_write(loop, req, file, bufs, nbufs, offset, cb);
+}
 
-    if (!fs_req->path) {
-        free(fs_req);
+static int backend_stat(uv_loop_t *loop, uv_fs_t *req, const char *path, uv_fs_cb cb)
+{
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_path_op(loop, req, IORING_OP_STATX, UV_FS_STAT, path, NULL, 0, 0, cb) == 0)
+        return 0;
+#endif
+    return uv_fs_stat(loop, req, path, cb);
+}
+
+static int backend_unlink(uv_loop_t *loop, uv_fs_t *req, const char *path, uv_fs_cb cb)
+{
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_path_op(loop, req, IORING_OP_UNLINKAT, UV_FS_UNLINK, path, NULL, 0, 0, cb) == 0)
+        return 0;
+#endif
+    return uv_fs_unlink(loop, req, path, cb);
+}
+
+static int backend_rename(uv_loop_t *loop, uv_fs_t *req, const char *path, const char *new_path, uv_fs_cb cb)
+{
+#ifdef FS_HAVE_IO_URING
+    if (cb && uring_path_op(loop, req, IORING_OP_RENAMEAT, UV_FS_RENAME, path, new_path, 0, 0, cb) == 0)
+        return 0;
+#endif
+    return uv_fs_rename(loop, req, path, new_path, cb);
+}
+
+const char *fs_backend(void)
+{
+#ifdef FS_HAVE_IO_URING
+    uv_loop_t *loop = get_loop();
+    if (loop && uring_ready(loop, IORING_OP_READ))
+        return "io_uring";
+#endif
+    return "libuv";
+}
+
+// Requests are recycled instead of freed, the loop thread is the only user
+static fs_request_t *request_pool = NULL;
+static int request_pool_count = 0;
+
+static Metric *fs_latency = NULL;
+
+static fs_request_t *fs_request_alloc(void)
+{
+    static bool registered = false;
+    if (!registered) {
+        registered = true;
+        fs_latency = metrics_histogram("ecewo_fs_op_seconds", "Time from starting a file operation to its callback");
+    }
+
+    fs_request_t *req = request_pool;
+
+    if (req) {
+        request_pool = req->next;
+        request_pool_count--;
+        memset(req, 0, sizeof(fs_request_t));
+    } else {
+        req = calloc(1, sizeof(fs_request_t));
+        if (!req)
+            return NULL;
+    }
+
+    req->fs_req.data = req;
+    req->start_ns = metrics_now();
+    return req;
+}
+
+static bool fs_request_set_path(fs_request_t *req, const char *path)
+{
+    size_t len = strlen(path);
+
+    if (len < INLINE_PATH_MAX) {
+        memcpy(req->path_buf, path, len + 1);
+        req->path = req->path_buf;
+        return true;
+    }
+
+    req->path = strdup(path);
+    return req->path != NULL;
+}
+
+static void fs_request_cleanup(fs_request_t *req, bool free_data)
+{
+    if (!req)
+        return;
+
+    metrics_observe(fs_latency, metrics_now() - req->start_ns);
+
+    if (req->path && req->path != req->path_buf)
+        free(req->path);
+
+    if (req->new_path)
+        free(req->new_path);
+
+    if (req->bufs)
+        free(req->bufs);
+
+    if (free_data && req->data)
+        free(req->data);
+
+    if (request_pool_count >= REQUEST_POOL_MAX) {
+        free(req);
+        return;
+    }
+
+    req->next = request_pool;
+    request_pool = req;
+    request_pool_count++;
+}
+
+static void read_close_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    uv_fs_req_cleanup(req);
+
+    fs_req->read_callback(NULL, fs_req->data, fs_req->size, fs_req->user_data);
+
+    // Cleanup but don't free data, user owns it now
+    fs_request_cleanup(fs_req, false);
+}
+
+static void read_data_cb(uv_fs_t *req);
+
+static int read_next_chunk(fs_request_t *fs_req)
+{
+    size_t remaining = fs_req->file_size - fs_req->size;
+    size_t len = remaining < READ_CHUNK_MAX ? remaining : READ_CHUNK_MAX;
+
+    uv_buf_t buf = uv_buf_init(fs_req->data + fs_req->size, (unsigned int)len);
+    return backend_read(get_loop(), &fs_req->fs_req, fs_req->file, &buf, 1,
+                        fs_req->offset + (int64_t)fs_req->size, read_data_cb);
+}
+
+// A read that could not be submitted never calls back, finish it here
+static void read_fail(fs_request_t *fs_req, int result)
+{
+    uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+
+    fs_req->read_callback(make_error_msg(fs_req->error, result), NULL, 0, fs_req->user_data);
+    fs_request_cleanup(fs_req, true);
+}
+
+static void read_data_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+
+        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+        return;
+    }
+
+    size_t nread = (size_t)req->result;
+    fs_req->size += nread;
+    uv_fs_req_cleanup(req);
+
+    // Short reads are legal, keep going until EOF or the stat size
+    if (nread > 0 && fs_req->size < fs_req->file_size) {
+        int result = read_next_chunk(fs_req);
+        if (result < 0)
+            read_fail(fs_req, result);
+        return;
+    }
+
+    fs_req->data[fs_req->size] = '\0';
+
+    // Closed synchronously on the same request if it can't be queued
+    if (backend_close(get_loop(), &fs_req->fs_req, fs_req->file, read_close_cb) < 0) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+        read_close_cb(&fs_req->fs_req);
+    }
+}
+
+static void read_open_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    fs_req->file = (uv_file)req->result;
+    uv_fs_req_cleanup(req);
+
+    fs_req->data = malloc(fs_req->file_size + 1);
+    if (!fs_req->data) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+
+        fs_req->read_callback("Memory allocation failed", NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    int result = read_next_chunk(fs_req);
+    if (result < 0)
+        read_fail(fs_req, result);
+}
+
+static void read_stat_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    uint64_t st_size = req->statbuf.st_size;
+    uv_fs_req_cleanup(req);
+
+    // Clamp the window to the file
+    uint64_t available = (uint64_t)fs_req->offset < st_size ? st_size - (uint64_t)fs_req->offset : 0;
+    fs_req->file_size = (size_t)(available < fs_req->length ? available : fs_req->length);
+
+    int result = backend_open(get_loop(), &fs_req->fs_req, fs_req->path, UV_FS_O_RDONLY, 0, read_open_cb);
+    if (result < 0) {
+        fs_req->read_callback(make_error_msg(fs_req->error, result), NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+void fs_read_file(const char *path, fs_read_callback_t callback, void *user_data)
+{
+    if (!path || !callback) {
+        fprintf(stderr, "fs_read_file: Invalid arguments\n");
+        return;
+    }
+
+    fs_read_range(path, 0, SIZE_MAX, callback, user_data);
+}
+
+void fs_read_range(const char *path, int64_t offset, size_t length, fs_read_callback_t callback, void *user_data)
+{
+    if (!path || !callback || offset < 0) {
+        fprintf(stderr, "fs_read_range: Invalid arguments\n");
+        return;
+    }
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req) {
+        fprintf(stderr, "fs_read_range: Memory allocation failed\n");
+        return;
+    }
+
+    fs_req->offset = offset;
+    fs_req->length = length;
+    fs_req->user_data = user_data;
+    fs_req->read_callback = callback;
+
+    // Kept for the open after the stat
+    if (!fs_request_set_path(fs_req, path)) {
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    int result = backend_stat(get_loop(), &fs_req->fs_req, fs_req->path, read_stat_cb);
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, NULL, 0, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+static void write_close_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+    uv_fs_req_cleanup(req);
+
+    fs_req->write_callback(NULL, fs_req->user_data);
+    fs_request_cleanup(fs_req, true);
+}
+
+static void write_data_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+
+        fs_req->write_callback(error, fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+        return;
+    }
+
+    fs_req->size = (size_t)req->result;
+    uv_fs_req_cleanup(req);
+
+    if (backend_close(get_loop(), &fs_req->fs_req, fs_req->file, write_close_cb) < 0) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+        write_close_cb(&fs_req->fs_req);
+    }
+}
+
+static void write_open_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->write_callback(error, fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+        return;
+    }
+
+    fs_req->file = (uv_file)req->result;
+    uv_fs_req_cleanup(req);
+
+    uv_buf_t buf = uv_buf_init(fs_req->data, (unsigned int)fs_req->size);
+    int result = backend_write(get_loop(), &fs_req->fs_req, fs_req->file, &buf, 1, 0, write_data_cb);
+    if (result < 0) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, fs_req->file, NULL);
+
+        fs_req->write_callback(make_error_msg(fs_req->error, result), fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+    }
+}
+
+static void fs_write_internal(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data, int flags)
+{
+    if (!path || !data || !callback) {
+        fprintf(stderr, "fs_write: Invalid arguments\n");
+        return;
+    }
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return;
+
+    fs_req->user_data = user_data;
+    fs_req->write_callback = callback;
+    fs_req->data = malloc(size);
+    fs_req->size = size;
+
+    if (!fs_req->data) {
+        fs_request_cleanup(fs_req, true);
+        return;
+    }
+
+    memcpy(fs_req->data, data, size);
+
+    // libuv keeps its own copy of the path
+    int result = backend_open(get_loop(), &fs_req->fs_req, path,
+                            flags, 0644, write_open_cb);
+
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, user_data);
+        fs_request_cleanup(fs_req, true);
+    }
+}
+
+void fs_write_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data)
+{
+    fs_write_internal(path, data, size, callback, user_data,
+                      UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC);
+}
+
+void fs_append_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data)
+{
+    fs_write_internal(path, data, size, callback, user_data,
+                      UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_APPEND);
+}
+
+static void stat_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->stat_callback(error, NULL, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    fs_req->stat = req->statbuf;
+    uv_fs_req_cleanup(req);
+
+    // Success
+    fs_req->stat_callback(NULL, &fs_req->stat, fs_req->user_data);
+    fs_request_cleanup(fs_req, false);
+}
+
+void fs_stat(const char *path, fs_stat_callback_t callback, void *user_data)
+{
+    if (!path || !callback)
+        return;
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return;
+
+    fs_req->user_data = user_data;
+    fs_req->stat_callback = callback;
+
+    int result = backend_stat(get_loop(), &fs_req->fs_req, path, stat_cb);
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, NULL, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+static void simple_op_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    char *error = NULL;
+    if (req->result < 0)
+        error = make_error_msg(fs_req->error, (int)req->result);
+
+    uv_fs_req_cleanup(req);
+
+    fs_req->write_callback(error, fs_req->user_data);
+    fs_request_cleanup(fs_req, false);
+}
+
+typedef int (*uv_fs_op_t)(uv_loop_t *, uv_fs_t *, const char *, uv_fs_cb);
+typedef int (*uv_fs_op_mode_t)(uv_loop_t *, uv_fs_t *, const char *, int, uv_fs_cb);
+
+static void fs_simple_op(const char *path, fs_write_callback_t callback, void *user_data, uv_fs_op_t op_fn)
+{
+    if (!path || !callback)
+        return;
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return;
+
+    fs_req->user_data = user_data;
+    fs_req->write_callback = callback;
+
+    int result = op_fn(get_loop(), &fs_req->fs_req, path, simple_op_cb);
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+static void fs_simple_op_mode(const char *path, fs_write_callback_t callback, void *user_data, int mode, uv_fs_op_mode_t op_fn)
+{
+    if (!path || !callback)
+        return;
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return;
+
+    fs_req->user_data = user_data;
+    fs_req->write_callback = callback;
+
+    int result = op_fn(get_loop(), &fs_req->fs_req, path, mode, simple_op_cb);
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+void fs_unlink(const char *path, fs_write_callback_t callback, void *user_data)
+{
+    fs_simple_op(path, callback, user_data, backend_unlink);
+}
+
+void fs_mkdir(const char *path, fs_write_callback_t callback, void *user_data)
+{
+    fs_simple_op_mode(path, callback, user_data, 0755, uv_fs_mkdir);
+}
+
+void fs_rmdir(const char *path, fs_write_callback_t callback, void *user_data)
+{
+    fs_simple_op(path, callback, user_data, uv_fs_rmdir);
+}
+
+void fs_rename(const char *old_path, const char *new_path, fs_write_callback_t callback, void *user_data)
+{
+    if (!old_path || !new_path || !callback)
+        return;
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return;
+
+    fs_req->user_data = user_data;
+    fs_req->write_callback = callback;
+
+    int result = backend_rename(get_loop(), &fs_req->fs_req, old_path,
+                              new_path, simple_op_cb);
+
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+// ============================================================================
+// FILE HANDLES
+// ============================================================================
+
+static void file_close_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+    fs_file_t *file = fs_req->handle;
+
+    char *error = NULL;
+    if (req->result < 0)
+        error = make_error_msg(fs_req->error, (int)req->result);
+
+    uv_fs_req_cleanup(req);
+
+    if (file->close_callback)
+        file->close_callback(error, file->close_data);
+
+    free(file);
+    fs_request_cleanup(fs_req, false);
+}
+
+static void file_close_now(fs_file_t *file)
+{
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req) {
+#ifdef FS_HAVE_IO_URING
+        uring_unregister_file(file->fd);
+#endif
+
+        // Closed synchronously rather than leaking the descriptor
+        uv_fs_t req;
+        uv_fs_close(NULL, &req, file->fd, NULL);
+        uv_fs_req_cleanup(&req);
+
+        if (file->close_callback)
+            file->close_callback(NULL, file->close_data);
+
+        free(file);
+        return;
+    }
+
+#ifdef FS_HAVE_IO_URING
+    uring_unregister_file(file->fd);
+#endif
+
+    fs_req->handle = file;
+    if (backend_close(get_loop(), &fs_req->fs_req, file->fd, file_close_cb) < 0) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, file->fd, NULL);
+        file_close_cb(&fs_req->fs_req);
+    }
+}
+
+static bool file_acquire(fs_file_t *file)
+{
+    if (file->closing)
+        return false;
+
+    file->pending++;
+    return true;
+}
+
+static void file_release(fs_file_t *file)
+{
+    if (--file->pending == 0 && file->closing)
+        file_close_now(file);
+}
+
+static void open_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->open_callback(error, NULL, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    uv_file fd = (uv_file)req->result;
+    uv_fs_req_cleanup(req);
+
+    fs_file_t *file = calloc(1, sizeof(fs_file_t));
+    if (!file) {
+        uv_fs_close(get_loop(), &fs_req->fs_req, fd, NULL);
+
+        fs_req->open_callback("Memory allocation failed", NULL, fs_req->user_data);
+        fs_request_cleanup(fs_req, false);
+        return;
+    }
+
+    file->fd = fd;
+
+#ifdef FS_HAVE_IO_URING
+    // Saves the kernel a descriptor lookup on every read and write
+    uring_register_file(fd);
+#endif
+
+    fs_req->open_callback(NULL, file, fs_req->user_data);
+    fs_request_cleanup(fs_req, false);
+}
+
+void fs_open(const char *path, int flags, int mode, fs_open_callback_t callback, void *user_data)
+{
+    if (!path || !callback) {
+        fprintf(stderr, "fs_open: Invalid arguments\n");
+        return;
+    }
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req) {
+        callback("Memory allocation failed", NULL, user_data);
+        return;
+    }
+
+    fs_req->user_data = user_data;
+    fs_req->open_callback = callback;
+
+    int result = backend_open(get_loop(), &fs_req->fs_req, path, flags, mode, open_cb);
+    if (result < 0) {
+        char *error = make_error_msg(fs_req->error, result);
+        callback(error, NULL, user_data);
+        fs_request_cleanup(fs_req, false);
+    }
+}
+
+void fs_close(fs_file_t *file, fs_write_callback_t callback, void *user_data)
+{
+    if (!file || file->closing)
+        return;
+
+    file->closing = true;
+    file->close_callback = callback;
+    file->close_data = user_data;
+
+    if (file->pending == 0)
+        file_close_now(file);
+}
+
+uv_file fs_file_fd(const fs_file_t *file)
+{
+    return file ? file->fd : -1;
+}
+
+static void pread_data_cb(uv_fs_t *req);
+
+static int pread_next_chunk(fs_request_t *fs_req)
+{
+    size_t remaining = fs_req->length - fs_req->size;
+    size_t len = remaining < READ_CHUNK_MAX ? remaining : READ_CHUNK_MAX;
+
+    uv_buf_t buf = uv_buf_init(fs_req->data + fs_req->size, (unsigned int)len);
+    return backend_read(get_loop(), &fs_req->fs_req, fs_req->handle->fd, &buf, 1,
+                      fs_req->offset + (int64_t)fs_req->size, pread_data_cb);
+}
+
+static void pread_data_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+    fs_file_t *file = fs_req->handle;
+
+    if (req->result < 0) {
+        char *error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+
+        fs_req->read_callback(error, NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+        file_release(file);
+        return;
+    }
+
+    size_t nread = (size_t)req->result;
+    fs_req->size += nread;
+    uv_fs_req_cleanup(req);
+
+    // Stops early at the end of the file
+    if (nread > 0 && fs_req->size < fs_req->length) {
+        int result = pread_next_chunk(fs_req);
+        if (result == 0)
+            return;
+
+        fs_req->read_callback(make_error_msg(fs_req->error, result), NULL, 0, fs_req->user_data);
+        fs_request_cleanup(fs_req, true);
+        file_release(file);
+        return;
+    }
+
+    fs_req->data[fs_req->size] = '\0';
+    fs_req->read_callback(NULL, fs_req->data, fs_req->size, fs_req->user_data);
+
+    // User owns the data now
+    fs_request_cleanup(fs_req, false);
+    file_release(file);
+}
+
+void fs_pread(fs_file_t *file, int64_t offset, size_t length, fs_read_callback_t callback, void *user_data)
+{
+    if (!file || !callback || offset < 0 || length == SIZE_MAX) {
+        fprintf(stderr, "fs_pread: Invalid arguments\n");
+        return;
+    }
+
+    if (!file_acquire(file)) {
+        callback("File is closing", NULL, 0, user_data);
         return;
     }
 
-    char *old_copy = strdup(old_path);
-    if (!old_copy) {
+    fs_request_t *fs_req = fs_request_alloc();
+    if (fs_req)
+        fs_req->data = malloc(length + 1);
+
+    if (!fs_req || !fs_req->data) {
         fs_request_cleanup(fs_req, false);
+        callback("Memory allocation failed", NULL, 0, user_data);
+        file_release(file);
         return;
     }
 
-    int result = uv_fs_rename(get_loop(), &fs_req->fs_req, old_copy,
-                              fs_req->path, simple_op_cb);
-    free(old_copy);
+    fs_req->handle = file;
+    fs_req->offset = offset;
+    fs_req->length = length;
+    fs_req->user_data = user_data;
+    fs_req->read_callback = callback;
+
+    if (length == 0) {
+        fs_req->data[0] = '\0';
+        callback(NULL, fs_req->data, 0, user_data);
+        fs_request_cleanup(fs_req, false);
+        file_release(file);
+        return;
+    }
 
+    int result = pread_next_chunk(fs_req);
     if (result < 0) {
-        char *error = make_error_msg(result);
-        callback(error, user_data);
+        callback(make_error_msg(fs_req->error, result), NULL, 0, user_data);
+        fs_request_cleanup(fs_req, true);
+        file_release(file);
+    }
+}
+
+static void pwrite_data_cb(uv_fs_t *req);
+
+static int pwrite_next_chunk(fs_request_t *fs_req)
+{
+    if (fs_req->bufs) {
+        return backend_write(get_loop(), &fs_req->fs_req, fs_req->handle->fd,
+                           fs_req->bufs + fs_req->buf_index,
+                           fs_req->nbufs - fs_req->buf_index,
+                           fs_req->offset, pwrite_data_cb);
+    }
+
+    size_t remaining = fs_req->length - fs_req->size;
+    size_t len = remaining < READ_CHUNK_MAX ? remaining : READ_CHUNK_MAX;
+
+    uv_buf_t buf = uv_buf_init(fs_req->data + fs_req->size, (unsigned int)len);
+    return backend_write(get_loop(), &fs_req->fs_req, fs_req->handle->fd, &buf, 1,
+                       fs_req->offset, pwrite_data_cb);
+}
+
+static bool pwrite_advance(fs_request_t *fs_req, size_t written)
+{
+    if (fs_req->offset >= 0)
+        fs_req->offset += (int64_t)written;
+
+    if (!fs_req->bufs) {
+        fs_req->size += written;
+        return fs_req->size >= fs_req->length;
+    }
+
+    while (fs_req->buf_index < fs_req->nbufs) {
+        uv_buf_t *buf = &fs_req->bufs[fs_req->buf_index];
+
+        if (written < buf->len) {
+            buf->base += written;
+            buf->len -= written;
+            break;
+        }
+
+        written -= buf->len;
+        fs_req->buf_index++;
+    }
+
+    return fs_req->buf_index >= fs_req->nbufs;
+}
+
+static void pwrite_data_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+    fs_file_t *file = fs_req->handle;
+    const char *error = NULL;
+
+    if (req->result < 0) {
+        error = make_error_msg(fs_req->error, (int)req->result);
+        uv_fs_req_cleanup(req);
+    } else {
+        size_t written = (size_t)req->result;
+        uv_fs_req_cleanup(req);
+
+        // Short writes are legal, write the rest
+        if (!pwrite_advance(fs_req, written)) {
+            int result = written > 0 ? pwrite_next_chunk(fs_req) : UV_EIO;
+            if (result == 0)
+                return;
+
+            error = make_error_msg(fs_req->error, result);
+        }
+    }
+
+    fs_req->write_callback(error, fs_req->user_data);
+
+    // The data belongs to the caller
+    fs_request_cleanup(fs_req, false);
+    file_release(file);
+}
+
+static void fs_pwrite_internal(fs_file_t *file, int64_t offset, const void *data, size_t size,
+                               const uv_buf_t *bufs, unsigned int nbufs,
+                               fs_write_callback_t callback, void *user_data)
+{
+    if (!file_acquire(file)) {
+        callback("File is closing", user_data);
+        return;
+    }
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (fs_req && bufs) {
+        fs_req->bufs = malloc(nbufs * sizeof(uv_buf_t));
+        if (fs_req->bufs)
+            memcpy(fs_req->bufs, bufs, nbufs * sizeof(uv_buf_t));
+    }
+
+    if (!fs_req || (bufs && !fs_req->bufs)) {
+        fs_request_cleanup(fs_req, false);
+        callback("Memory allocation failed", user_data);
+        file_release(file);
+        return;
+    }
+
+    fs_req->handle = file;
+    fs_req->offset = offset;
+    fs_req->data = (char *)data;
+    fs_req->length = size;
+    fs_req->nbufs = nbufs;
+    fs_req->user_data = user_data;
+    fs_req->write_callback = callback;
+
+    // Skips leading empty buffers, nothing to write if all are empty
+    if (pwrite_advance(fs_req, 0)) {
+        callback(NULL, user_data);
+        fs_request_cleanup(fs_req, false);
+        file_release(file);
+        return;
+    }
+
+    int result = pwrite_next_chunk(fs_req);
+    if (result < 0) {
+        callback(make_error_msg(fs_req->error, result), user_data);
+        fs_request_cleanup(fs_req, false);
+        file_release(file);
+    }
+}
+
+void fs_pwrite(fs_file_t *file, int64_t offset, const void *data, size_t size, fs_write_callback_t callback, void *user_data)
+{
+    if (!file || (!data && size > 0) || !callback || offset < -1) {
+        fprintf(stderr, "fs_pwrite: Invalid arguments\n");
+        return;
+    }
+
+    fs_pwrite_internal(file, offset, data, size, NULL, 0, callback, user_data);
+}
+
+void fs_pwritev(fs_file_t *file, int64_t offset, const uv_buf_t *bufs, unsigned int nbufs, fs_write_callback_t callback, void *user_data)
+{
+    if (!file || !bufs || nbufs == 0 || !callback || offset < -1) {
+        fprintf(stderr, "fs_pwritev: Invalid arguments\n");
+        return;
+    }
+
+    fs_pwrite_internal(file, offset, NULL, 0, bufs, nbufs, callback, user_data);
+}
+
+// ============================================================================
+// STREAMING
+// ============================================================================
+
+// Chunks of finished streams are kept for the next ones
+static char *chunk_pool[STREAM_POOL_MAX];
+static int chunk_pool_count = 0;
+
+static char *chunk_acquire(void)
+{
+#ifdef FS_HAVE_IO_URING
+    // Registered with the ring, so reads into them skip the page pinning
+    char *registered = uring_chunk_acquire();
+    if (registered)
+        return registered;
+#endif
+
+    if (chunk_pool_count > 0)
+        return chunk_pool[--chunk_pool_count];
+
+    return malloc(STREAM_CHUNK_SIZE);
+}
+
+static void chunk_release(char *chunk)
+{
+    if (!chunk)
+        return;
+
+#ifdef FS_HAVE_IO_URING
+    if (uring_chunk_release(chunk))
+        return;
+#endif
+
+    if (chunk_pool_count < STREAM_POOL_MAX)
+        chunk_pool[chunk_pool_count++] = chunk;
+    else
+        free(chunk);
+}
+
+// Two chunks per stream: the next one is read while the callback
+// handles the previous one
+typedef struct
+{
+    uv_fs_t fs_req;
+    fs_file_t *file;
+    bool owns_file; // Opened by fs_read_stream()
+    bool reading;
+    bool stopped;
+
+    char *chunks[2];
+    int current; // Chunk being read into
+    int64_t offset;
+    size_t remaining;
+
+    fs_chunk_callback_t callback;
+    void *user_data;
+    char error[ERROR_MSG_MAX];
+} fs_stream_request_t;
+
+static void stream_finish(fs_stream_request_t *stream)
+{
+    fs_file_t *file = stream->file;
+    bool owns_file = stream->owns_file;
+
+    chunk_release(stream->chunks[0]);
+    chunk_release(stream->chunks[1]);
+    free(stream);
+
+    if (!file)
+        return;
+
+    file_release(file);
+
+    if (owns_file)
+        fs_close(file, NULL, NULL);
+}
+
+static void stream_read_cb(uv_fs_t *req);
+
+static int stream_read_next(fs_stream_request_t *stream)
+{
+    size_t len = stream->remaining < STREAM_CHUNK_SIZE ? stream->remaining : STREAM_CHUNK_SIZE;
+    uv_buf_t buf = uv_buf_init(stream->chunks[stream->current], (unsigned int)len);
+
+    int result = backend_read(get_loop(), &stream->fs_req, stream->file->fd, &buf, 1,
+                            stream->offset, stream_read_cb);
+    stream->reading = result == 0;
+    return result;
+}
+
+static void stream_read_cb(uv_fs_t *req)
+{
+    fs_stream_request_t *stream = (fs_stream_request_t *)req->data;
+    ssize_t result = req->result;
+
+    uv_fs_req_cleanup(req);
+    stream->reading = false;
+
+    if (stream->stopped) {
+        stream_finish(stream);
+        return;
+    }
+
+    if (result <= 0) {
+        // 0 is the end of the file
+        stream->callback(result < 0 ? make_error_msg(stream->error, (int)result) : NULL, NULL, 0, stream->user_data);
+        stream_finish(stream);
+        return;
+    }
+
+    char *chunk = stream->chunks[stream->current];
+    size_t size = (size_t)result;
+
+    stream->offset += (int64_t)size;
+    stream->remaining -= size;
+
+    int next = 0;
+    if (stream->remaining > 0) {
+        stream->current ^= 1;
+        next = stream_read_next(stream);
+    }
+
+    if (!stream->callback(NULL, chunk, size, stream->user_data))
+        stream->stopped = true;
+
+    if (!stream->stopped && next < 0) {
+        stream->callback(make_error_msg(stream->error, next), NULL, 0, stream->user_data);
+        stream->stopped = true;
+    } else if (!stream->stopped && stream->remaining == 0) {
+        stream->callback(NULL, NULL, 0, stream->user_data);
+        stream->stopped = true;
+    }
+
+    // A read still in flight finishes the stream when it completes
+    if (stream->stopped && !stream->reading)
+        stream_finish(stream);
+}
+
+static void stream_start(fs_stream_request_t *stream)
+{
+    stream->chunks[0] = chunk_acquire();
+    stream->chunks[1] = chunk_acquire();
+
+    if (!stream->chunks[0] || !stream->chunks[1]) {
+        stream->callback("Memory allocation failed", NULL, 0, stream->user_data);
+        stream_finish(stream);
+        return;
+    }
+
+    if (stream->remaining == 0) {
+        stream->callback(NULL, NULL, 0, stream->user_data);
+        stream_finish(stream);
+        return;
+    }
+
+    int result = stream_read_next(stream);
+    if (result < 0) {
+        stream->callback(make_error_msg(stream->error, result), NULL, 0, stream->user_data);
+        stream_finish(stream);
+    }
+}
+
+static fs_stream_request_t *stream_create(int64_t offset, size_t length, fs_chunk_callback_t callback, void *user_data)
+{
+    fs_stream_request_t *stream = calloc(1, sizeof(fs_stream_request_t));
+    if (!stream)
+        return NULL;
+
+    stream->offset = offset;
+    stream->remaining = length;
+    stream->callback = callback;
+    stream->user_data = user_data;
+    stream->fs_req.data = stream;
+    return stream;
+}
+
+void fs_stream(fs_file_t *file, int64_t offset, size_t length, fs_chunk_callback_t callback, void *user_data)
+{
+    if (!file || !callback || offset < 0) {
+        fprintf(stderr, "fs_stream: Invalid arguments\n");
+        return;
+    }
+
+    if (!file_acquire(file)) {
+        callback("File is closing", NULL, 0, user_data);
+        return;
+    }
+
+    fs_stream_request_t *stream = stream_create(offset, length, callback, user_data);
+    if (!stream) {
+        callback("Memory allocation failed", NULL, 0, user_data);
+        file_release(file);
+        return;
+    }
+
+    stream->file = file;
+    stream_start(stream);
+}
+
+static void stream_open_cb(const char *error, fs_file_t *file, void *user_data)
+{
+    fs_stream_request_t *stream = (fs_stream_request_t *)user_data;
+
+    if (error) {
+        stream->callback(error, NULL, 0, stream->user_data);
+        stream_finish(stream);
+        return;
+    }
+
+    file_acquire(file);
+    stream->file = file;
+    stream->owns_file = true;
+    stream_start(stream);
+}
+
+void fs_read_stream(const char *path, int64_t offset, size_t length, fs_chunk_callback_t callback, void *user_data)
+{
+    if (!path || !callback || offset < 0) {
+        fprintf(stderr, "fs_read_stream: Invalid arguments\n");
+        return;
+    }
+
+    fs_stream_request_t *stream = stream_create(offset, length, callback, user_data);
+    if (!stream) {
+        fprintf(stderr, "fs_read_stream: Memory allocation failed\n");
+        return;
+    }
+
+    fs_open(path, UV_FS_O_RDONLY, 0, stream_open_cb, stream);
+}
+
+// ============================================================================
+// BATCHES
+// ============================================================================
+
+enum
+{
+    BATCH_STAT = 1,
+    BATCH_UNLINK,
+    BATCH_RENAME,
+};
+
+struct fs_batch_s
+{
+    fs_request_t **ops;
+    size_t count;
+    size_t capacity;
+    size_t pending;
+    size_t failed;
+    bool submitted;
+
+    fs_batch_callback_t callback;
+    void *user_data;
+};
+
+fs_batch_t *fs_batch_create(void)
+{
+    fs_batch_t *batch = calloc(1, sizeof(fs_batch_t));
+    if (!batch)
+        fprintf(stderr, "fs_batch_create: Memory allocation failed\n");
+
+    return batch;
+}
+
+static fs_request_t *batch_add(fs_batch_t *batch, int op, const char *path)
+{
+    if (!batch || !path || batch->submitted) {
+        fprintf(stderr, "fs_batch: Invalid arguments\n");
+        return NULL;
+    }
+
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity * 2 : 8;
+        fs_request_t **ops = realloc(batch->ops, capacity * sizeof(fs_request_t *));
+        if (!ops)
+            return NULL;
+
+        batch->ops = ops;
+        batch->capacity = capacity;
+    }
+
+    fs_request_t *fs_req = fs_request_alloc();
+    if (!fs_req)
+        return NULL;
+
+    // Submitted later, so the path has to outlive the caller's
+    if (!fs_request_set_path(fs_req, path)) {
+        fs_request_cleanup(fs_req, false);
+        return NULL;
+    }
+
+    fs_req->batch = batch;
+    fs_req->op = op;
+    batch->ops[batch->count++] = fs_req;
+    return fs_req;
+}
+
+int fs_batch_stat(fs_batch_t *batch, const char *path)
+{
+    return batch_add(batch, BATCH_STAT, path) ? 0 : -1;
+}
+
+int fs_batch_unlink(fs_batch_t *batch, const char *path)
+{
+    return batch_add(batch, BATCH_UNLINK, path) ? 0 : -1;
+}
+
+int fs_batch_rename(fs_batch_t *batch, const char *old_path, const char *new_path)
+{
+    if (!new_path) {
+        fprintf(stderr, "fs_batch: Invalid arguments\n");
+        return -1;
+    }
+
+    fs_request_t *fs_req = batch_add(batch, BATCH_RENAME, old_path);
+    if (!fs_req)
+        return -1;
+
+    fs_req->new_path = strdup(new_path);
+    if (!fs_req->new_path) {
+        // The failed rename is the last one added
+        batch->count--;
         fs_request_cleanup(fs_req, false);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void batch_finish(fs_batch_t *batch)
+{
+    batch->callback(batch, batch->failed, batch->user_data);
+
+    for (size_t i = 0; i < batch->count; i++)
+        fs_request_cleanup(batch->ops[i], false);
+
+    free(batch->ops);
+    free(batch);
+}
+
+static void batch_fail(fs_request_t *fs_req, int errcode)
+{
+    make_error_msg(fs_req->error, errcode);
+    fs_req->failed = true;
+    fs_req->batch->failed++;
+}
+
+static void batch_op_cb(uv_fs_t *req)
+{
+    fs_request_t *fs_req = (fs_request_t *)req->data;
+    fs_batch_t *batch = fs_req->batch;
+
+    if (req->result < 0)
+        batch_fail(fs_req, (int)req->result);
+    else if (fs_req->op == BATCH_STAT)
+        fs_req->stat = req->statbuf;
+
+    uv_fs_req_cleanup(req);
+
+    if (--batch->pending == 0)
+        batch_finish(batch);
+}
+
+void fs_batch_submit(fs_batch_t *batch, fs_batch_callback_t callback, void *user_data)
+{
+    if (!batch || !callback || batch->submitted) {
+        fprintf(stderr, "fs_batch_submit: Invalid arguments\n");
+        return;
+    }
+
+    batch->submitted = true;
+    batch->callback = callback;
+    batch->user_data = user_data;
+    batch->pending = batch->count;
+
+    uv_loop_t *loop = get_loop();
+    uint64_t now = metrics_now();
+
+    // The thread pool runs as many of them in parallel as it has threads
+    for (size_t i = 0; i < batch->count; i++) {
+        fs_request_t *fs_req = batch->ops[i];
+        int result = UV_EINVAL;
+
+        fs_req->start_ns = now; // Queued operations wait for the submit
+
+        switch (fs_req->op) {
+        case BATCH_STAT:
+            result = backend_stat(loop, &fs_req->fs_req, fs_req->path, batch_op_cb);
+            break;
+        case BATCH_UNLINK:
+            result = backend_unlink(loop, &fs_req->fs_req, fs_req->path, batch_op_cb);
+            break;
+        case BATCH_RENAME:
+            result = backend_rename(loop, &fs_req->fs_req, fs_req->path, fs_req->new_path, batch_op_cb);
+            break;
+        }
+
+        if (result < 0) {
+            batch_fail(fs_req, result);
+            batch->pending--;
+        }
     }
+
+    if (batch->pending == 0)
+        batch_finish(batch);
+}
+
+size_t fs_batch_size(const fs_batch_t *batch)
+{
+    return batch ? batch->count : 0;
+}
+
+const char *fs_batch_error(const fs_batch_t *batch, size_t index)
+{
+    if (!batch || index >= batch->count)
+        return NULL;
+
+    return batch->ops[index]->failed ? batch->ops[index]->error : NULL;
+}
+
+const uv_stat_t *fs_batch_stat_result(const fs_batch_t *batch, size_t index)
+{
+    if (!batch || index >= batch->count)
+        return NULL;
+
+    const fs_request_t *fs_req = batch->ops[index];
+    if (fs_req->op != BATCH_STAT || fs_req->failed)
+        return NULL;
+
+    return &fs_req->stat;
 }
@@ -2,6 +2,8 @@
 #define ECEWO_FS_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "uv.h"
 
 #ifdef __cplusplus
@@ -12,7 +14,18 @@ typedef void (*fs_read_callback_t)(const char *error, const char *data, size_t s
 typedef void (*fs_write_callback_t)(const char *error, void *user_data);
 typedef void (*fs_stat_callback_t)(const char *error, const uv_stat_t *stat, void *user_data);
 
+typedef struct fs_file_s fs_file_t;
+typedef void (*fs_open_callback_t)(const char *error, fs_file_t *file, void *user_data);
+
+// data is only valid during the callback, size 0 without an error is the end
+// Return false to stop the stream, the callback is not called again
+typedef bool (*fs_chunk_callback_t)(const char *error, const char *data, size_t size, void *user_data);
+
+typedef struct fs_batch_s fs_batch_t;
+typedef void (*fs_batch_callback_t)(fs_batch_t *batch, size_t failed, void *user_data);
+
 void fs_read_file(const char *path, fs_read_callback_t callback, void *user_data);
+void fs_read_range(const char *path, int64_t offset, size_t length, fs_read_callback_t callback, void *user_data);
 void fs_write_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data);
 void fs_append_file(const char *path, const void *data, size_t size, fs_write_callback_t callback, void *user_data);
 void fs_stat(const char *path, fs_stat_callback_t callback, void *user_data);
@@ -21,6 +34,47 @@ void fs_rename(const char *old_path, const char *new_path, fs_write_callback_t c
 void fs_mkdir(const char *path, fs_write_callback_t callback, void *user_data);
 void fs_rmdir(const char *path, fs_write_callback_t callback, void *user_data);
 
+// Open a file for repeated reads and writes; flags are UV_FS_O_* flags,
+// mode is used if the file is created
+void fs_open(const char *path, int flags, int mode, fs_open_callback_t callback, void *user_data);
+
+// Close after pending operations on the file complete; callback may be NULL
+void fs_close(fs_file_t *file, fs_write_callback_t callback, void *user_data);
+
+// Descriptor of an open file, for calls the module doesn't wrap such as
+// uv_fs_sendfile(); those bypass the io_uring backend
+uv_file fs_file_fd(const fs_file_t *file);
+
+// Read up to length bytes at offset into a buffer the callback owns
+void fs_pread(fs_file_t *file, int64_t offset, size_t length, fs_read_callback_t callback, void *user_data);
+
+// Write all bytes at offset, or at the current position if offset is -1
+// data is not copied and must stay valid until the callback runs
+void fs_pwrite(fs_file_t *file, int64_t offset, const void *data, size_t size, fs_write_callback_t callback, void *user_data);
+void fs_pwritev(fs_file_t *file, int64_t offset, const uv_buf_t *bufs, unsigned int nbufs, fs_write_callback_t callback, void *user_data);
+
+// Read length bytes at offset (SIZE_MAX for the rest of the file) in chunks
+void fs_stream(fs_file_t *file, int64_t offset, size_t length, fs_chunk_callback_t callback, void *user_data);
+void fs_read_stream(const char *path, int64_t offset, size_t length, fs_chunk_callback_t callback, void *user_data);
+
+// Queue stat/unlink/rename operations and run them with one callback
+// Operations are added with fs_batch_*() and return 0, or -1 on failure
+fs_batch_t *fs_batch_create(void);
+int fs_batch_stat(fs_batch_t *batch, const char *path);
+int fs_batch_unlink(fs_batch_t *batch, const char *path);
+int fs_batch_rename(fs_batch_t *batch, const char *old_path, const char *new_path);
+
+// Start every queued operation at once; the batch is freed after the callback
+void fs_batch_submit(fs_batch_t *batch, fs_batch_callback_t callback, void *user_data);
+
+// Results inside the callback, index is the order the operations were added in
+size_t fs_batch_size(const fs_batch_t *batch);
+const char *fs_batch_error(const fs_batch_t *batch, size_t index);           // NULL on success
+const uv_stat_t *fs_batch_stat_result(const fs_batch_t *batch, size_t index); // NULL unless a successful stat
+
+// "io_uring" when file operations go through the kernel ring, otherwise "libuv"
+const char *fs_backend(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2,6 +2,7 @@
 #include "ecewo-helmet.h"
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 static struct
@@ -16,6 +17,11 @@ static struct
     bool nosniff;
     bool ie_no_open;
     bool enabled;
+
+    // Built once by helmet_init(), the values point to the config strings
+    char hsts[128];
+    HttpHeader headers[7];
+    uint16_t header_count;
 } helmet_state = { 0 };
 
 static const char *DEFAULT_CSP = NULL;
@@ -40,40 +46,51 @@ static void helmet_set_defaults(void)
     // nosniff and ie_no_open are true by default
 }
 
-static void helmet_middleware(Req *req, Res *res, Next next)
+static void helmet_add(const char *name, const char *value)
+{
+    helmet_state.headers[helmet_state.header_count].name = name;
+    helmet_state.headers[helmet_state.header_count].value = value;
+    helmet_state.header_count++;
+}
+
+static void helmet_build_headers(void)
 {
-    if (!helmet_state.enabled)
-        next(req, res);
+    helmet_state.header_count = 0;
 
     if (helmet_state.csp)
-        set_header(res, "Content-Security-Policy", helmet_state.csp);
+        helmet_add("Content-Security-Policy", helmet_state.csp);
 
     if (helmet_state.hsts_max_age) {
-        char *hsts = arena_sprintf(req->arena, "max-age=%s", helmet_state.hsts_max_age);
-
-        if (helmet_state.hsts_subdomains)
-            hsts = arena_sprintf(req->arena, "%s; includeSubDomains", hsts);
+        snprintf(helmet_state.hsts, sizeof(helmet_state.hsts), "max-age=%s%s%s",
+                 helmet_state.hsts_max_age,
+                 helmet_state.hsts_subdomains ? "; includeSubDomains" : "",
+                 helmet_state.hsts_preload ? "; preload" : "");
 
-        if (helmet_state.hsts_preload)
-            hsts = arena_sprintf(req->arena, "%s; preload", hsts);
-
-        set_header(res, "Strict-Transport-Security", hsts);
+        helmet_add("Strict-Transport-Security", helmet_state.hsts);
     }
 
     if (helmet_state.frame_options)
-        set_header(res, "X-Frame-Options", helmet_state.frame_options);
+        helmet_add("X-Frame-Options", helmet_state.frame_options);
 
     if (helmet_state.nosniff)
-        set_header(res, "X-Content-Type-Options", "nosniff");
+        helmet_add("X-Content-Type-Options", "nosniff");
 
     if (helmet_state.xss_protection)
-        set_header(res, "X-XSS-Protection", helmet_state.xss_protection);
+        helmet_add("X-XSS-Protection", helmet_state.xss_protection);
 
     if (helmet_state.referrer_policy)
-        set_header(res, "Referrer-Policy", helmet_state.referrer_policy);
+        helmet_add("Referrer-Policy", helmet_state.referrer_policy);
 
     if (helmet_state.ie_no_open)
-        set_header(res, "X-Download-Options", "noopen");
+        helmet_add("X-Download-Options", "noopen");
+}
+
+static void helmet_middleware(Req *req, Res *res, Next next)
+{
+    if (helmet_state.enabled) {
+        for (uint16_t i = 0; i < helmet_state.header_count; i++)
+            set_header(res, helmet_state.headers[i].name, helmet_state.headers[i].value);
+    }
 
     next(req, res);
 }
@@ -105,6 +122,7 @@ void helmet_init(const Helmet *config)
     }
 
     helmet_set_defaults();
+    helmet_build_headers();
     use(helmet_middleware);
     helmet_state.enabled = true;
 }
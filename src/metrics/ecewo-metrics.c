@@ -0,0 +1,363 @@
+#include "ecewo-metrics.h"
+#include "uv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ATOMIC_ADD(p, n) _InterlockedExchangeAdd64((volatile __int64 *)(p), (__int64)(n))
+#define ATOMIC_STORE(p, v) _InterlockedExchange64((volatile __int64 *)(p), (__int64)(v))
+#define ATOMIC_LOAD(p) _InterlockedOr64((volatile __int64 *)(p), 0)
+#else
+#define ATOMIC_ADD(p, n) __atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#define ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#endif
+
+#define PROMETHEUS_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+struct Metric
+{
+    char name[METRICS_NAME_MAX];
+    const char *help;
+    MetricsType type;
+    int64_t value;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[METRICS_BUCKETS];
+};
+
+// Upper bounds in nanoseconds, the last bucket has none
+static const uint64_t bucket_bounds[METRICS_BUCKETS - 1] = {
+    50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+    100000000, 250000000, 500000000, 1000000000, 2500000000,
+};
+
+static const char *const bucket_labels[METRICS_BUCKETS] = {
+    "5e-05", "0.0001", "0.00025", "0.0005",
+    "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05",
+    "0.1", "0.25", "0.5", "1", "2.5", "+Inf",
+};
+
+// Registered at startup from the loop thread, never removed
+static struct
+{
+    Metric metrics[METRICS_MAX];
+    size_t count;
+
+    MetricsSample *cluster; // totals from the master, by name
+    size_t cluster_count;
+    size_t cluster_capacity;
+} registry;
+
+static MetricsTracer tracer;
+
+static bool valid_name(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len >= METRICS_NAME_MAX)
+        return false;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':';
+        if (!alpha && !(i > 0 && c >= '0' && c <= '9'))
+            return false;
+    }
+
+    return true;
+}
+
+static Metric *metrics_register(const char *name, const char *help, MetricsType type)
+{
+    if (!name || !valid_name(name)) {
+        fprintf(stderr, "Invalid metric name: %s\n", name ? name : "(null)");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < registry.count; i++) {
+        Metric *metric = &registry.metrics[i];
+        if (strcmp(metric->name, name) == 0)
+            return metric->type == type ? metric : NULL;
+    }
+
+    if (registry.count >= METRICS_MAX) {
+        fprintf(stderr, "Metric limit reached, %s is not recorded\n", name);
+        return NULL;
+    }
+
+    Metric *metric = &registry.metrics[registry.count++];
+    memset(metric, 0, sizeof(*metric));
+    strcpy(metric->name, name);
+    metric->help = help;
+    metric->type = type;
+    return metric;
+}
+
+Metric *metrics_counter(const char *name, const char *help)
+{
+    return metrics_register(name, help, METRICS_COUNTER);
+}
+
+Metric *metrics_gauge(const char *name, const char *help)
+{
+    return metrics_register(name, help, METRICS_GAUGE);
+}
+
+Metric *metrics_histogram(const char *name, const char *help)
+{
+    return metrics_register(name, help, METRICS_HISTOGRAM);
+}
+
+void metrics_inc(Metric *metric)
+{
+    if (metric)
+        ATOMIC_ADD(&metric->value, 1);
+}
+
+void metrics_add(Metric *metric, uint64_t n)
+{
+    if (metric)
+        ATOMIC_ADD(&metric->value, (int64_t)n);
+}
+
+void metrics_set(Metric *metric, int64_t value)
+{
+    if (metric)
+        ATOMIC_STORE(&metric->value, value);
+}
+
+void metrics_gauge_add(Metric *metric, int64_t delta)
+{
+    if (metric)
+        ATOMIC_ADD(&metric->value, delta);
+}
+
+void metrics_observe(Metric *metric, uint64_t ns)
+{
+    if (!metric)
+        return;
+
+    size_t bucket = 0;
+    while (bucket < METRICS_BUCKETS - 1 && ns > bucket_bounds[bucket])
+        bucket++;
+
+    ATOMIC_ADD(&metric->buckets[bucket], 1);
+    ATOMIC_ADD(&metric->sum, ns);
+    ATOMIC_ADD(&metric->count, 1);
+}
+
+uint64_t metrics_now(void)
+{
+    return uv_hrtime();
+}
+
+size_t metrics_count(void)
+{
+    return registry.count;
+}
+
+bool metrics_sample(size_t index, MetricsSample *sample)
+{
+    if (index >= registry.count || !sample)
+        return false;
+
+    Metric *metric = &registry.metrics[index];
+
+    memset(sample, 0, sizeof(*sample));
+    strcpy(sample->name, metric->name);
+    sample->type = (uint8_t)metric->type;
+    sample->value = ATOMIC_LOAD(&metric->value);
+    sample->count = ATOMIC_LOAD(&metric->count);
+    sample->sum = ATOMIC_LOAD(&metric->sum);
+    for (size_t i = 0; i < METRICS_BUCKETS; i++)
+        sample->buckets[i] = ATOMIC_LOAD(&metric->buckets[i]);
+
+    return true;
+}
+
+void metrics_sample_merge(MetricsSample *a, const MetricsSample *b)
+{
+    a->value += b->value;
+    a->count += b->count;
+    a->sum += b->sum;
+    for (size_t i = 0; i < METRICS_BUCKETS; i++)
+        a->buckets[i] += b->buckets[i];
+}
+
+void metrics_set_cluster_sample(const MetricsSample *sample)
+{
+    if (!sample || memchr(sample->name, '\0', METRICS_NAME_MAX) == NULL)
+        return;
+
+    for (size_t i = 0; i < registry.cluster_count; i++) {
+        if (strcmp(registry.cluster[i].name, sample->name) == 0) {
+            registry.cluster[i] = *sample;
+            return;
+        }
+    }
+
+    if (registry.cluster_count == registry.cluster_capacity) {
+        size_t capacity = registry.cluster_capacity ? registry.cluster_capacity * 2 : 16;
+        MetricsSample *cluster = realloc(registry.cluster, capacity * sizeof(MetricsSample));
+        if (!cluster)
+            return;
+
+        registry.cluster = cluster;
+        registry.cluster_capacity = capacity;
+    }
+
+    registry.cluster[registry.cluster_count++] = *sample;
+}
+
+static const char *help_of(const char *name)
+{
+    for (size_t i = 0; i < registry.count; i++) {
+        if (strcmp(registry.metrics[i].name, name) == 0)
+            return registry.metrics[i].help;
+    }
+
+    return NULL;
+}
+
+// HELP text escapes backslashes and line breaks, at most doubling its length
+static size_t escape_help(char *out, size_t size, const char *help)
+{
+    size_t n = 0;
+
+    for (const char *c = help; *c; c++) {
+        const char *escaped = *c == '\\' ? "\\\\" : *c == '\n' ? "\\n" : NULL;
+        size_t len = escaped ? 2 : 1;
+
+        if (n + len >= size)
+            return 0;
+
+        memcpy(out + n, escaped ? escaped : c, len);
+        n += len;
+    }
+
+    return n;
+}
+
+static size_t render_sample(char *out, size_t size, const MetricsSample *sample, const char *help)
+{
+    static const char *const type_names[] = { "", "counter", "gauge", "histogram" };
+
+    if (sample->type < METRICS_COUNTER || sample->type > METRICS_HISTOGRAM)
+        return 0;
+
+    size_t n = 0;
+
+#define APPEND(...)                                                  \
+    do {                                                             \
+        int written = snprintf(out + n, size - n, __VA_ARGS__);     \
+        if (written < 0 || (size_t)written >= size - n)              \
+            return 0;                                                \
+        n += (size_t)written;                                        \
+    } while (0)
+
+    if (help) {
+        APPEND("# HELP %s ", sample->name);
+
+        size_t written = escape_help(out + n, size - n, help);
+        if (written == 0 && *help)
+            return 0;
+        n += written;
+
+        APPEND("\n");
+    }
+    APPEND("# TYPE %s %s\n", sample->name, type_names[sample->type]);
+
+    if (sample->type != METRICS_HISTOGRAM) {
+        APPEND("%s %" PRId64 "\n", sample->name, sample->value);
+        return n;
+    }
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < METRICS_BUCKETS; i++) {
+        cumulative += sample->buckets[i];
+        APPEND("%s_bucket{le=\"%s\"} %" PRIu64 "\n", sample->name, bucket_labels[i], cumulative);
+    }
+
+    APPEND("%s_sum %.9f\n", sample->name, (double)sample->sum / 1e9);
+    APPEND("%s_count %" PRIu64 "\n", sample->name, sample->count);
+
+#undef APPEND
+
+    return n;
+}
+
+// Enough for the buckets of a histogram plus its escaped HELP line
+static size_t render_bound(const char *help)
+{
+    return (METRICS_BUCKETS + 4) * (METRICS_NAME_MAX + 48) + (help ? 2 * strlen(help) : 0);
+}
+
+char *metrics_render(Arena *arena, size_t *len)
+{
+    bool cluster = registry.cluster_count > 0;
+    size_t count = cluster ? registry.cluster_count : registry.count;
+
+    size_t size = 1;
+    for (size_t i = 0; i < count; i++)
+        size += render_bound(cluster ? help_of(registry.cluster[i].name) : registry.metrics[i].help);
+
+    char *out = arena_alloc(arena, size);
+    if (!out)
+        return NULL;
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (cluster) {
+            const MetricsSample *sample = &registry.cluster[i];
+            n += render_sample(out + n, size - n, sample, help_of(sample->name));
+        } else {
+            MetricsSample sample;
+            metrics_sample(i, &sample);
+            n += render_sample(out + n, size - n, &sample, registry.metrics[i].help);
+        }
+    }
+
+    out[n] = '\0';
+    if (len)
+        *len = n;
+    return out;
+}
+
+void metrics_handler(Req *req, Res *res)
+{
+    size_t len = 0;
+    char *body = metrics_render(req->arena, &len);
+    if (!body) {
+        send_text(res, 500, "Memory allocation failed");
+        return;
+    }
+
+    set_header(res, "Content-Type", PROMETHEUS_CONTENT_TYPE);
+    reply(res, 200, body, len);
+}
+
+void metrics_set_tracer(const MetricsTracer *t)
+{
+    if (t)
+        tracer = *t;
+    else
+        memset(&tracer, 0, sizeof(tracer));
+}
+
+void *metrics_trace_begin(const char *span, const char *detail)
+{
+    if (!tracer.begin)
+        return NULL;
+
+    return tracer.begin(span, detail, tracer.user_data);
+}
+
+void metrics_trace_end(const char *span, void *token, bool ok)
+{
+    if (tracer.end)
+        tracer.end(span, token, ok, tracer.user_data);
+}
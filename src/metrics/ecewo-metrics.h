@@ -0,0 +1,88 @@
+#ifndef ECEWO_METRICS_H
+#define ECEWO_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ecewo.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_MAX 64
+#define METRICS_NAME_MAX 64
+#define METRICS_BUCKETS 16 // 15 latency bounds from 50us to 2.5s, and +Inf
+
+typedef enum
+{
+    METRICS_COUNTER = 1,
+    METRICS_GAUGE,
+    METRICS_HISTOGRAM,
+} MetricsType;
+
+typedef struct Metric Metric;
+
+// Registering a name twice returns the same metric; NULL once METRICS_MAX
+// metrics exist or for a name of another type. Updates on NULL do nothing
+Metric *metrics_counter(const char *name, const char *help);
+Metric *metrics_gauge(const char *name, const char *help);
+Metric *metrics_histogram(const char *name, const char *help);
+
+// Lock-free, safe from any thread of the process
+void metrics_inc(Metric *metric);
+void metrics_add(Metric *metric, uint64_t n);
+void metrics_set(Metric *metric, int64_t value);
+void metrics_gauge_add(Metric *metric, int64_t delta);
+void metrics_observe(Metric *metric, uint64_t ns);
+
+// Monotonic time in nanoseconds, for metrics_observe()
+uint64_t metrics_now(void);
+
+// Current values in Prometheus text format, allocated in the arena
+char *metrics_render(Arena *arena, size_t *len);
+
+// GET handler serving metrics_render()
+void metrics_handler(Req *req, Res *res);
+
+// Trace hooks: begin() runs when a span starts and returns a token that is
+// handed to end() when the span finishes. Span names are "static.send_file",
+// "postgres.query" and "session.lookup"; detail is a path, the query text
+// or NULL. Set the tracer before the server starts, NULL removes it
+typedef struct
+{
+    void *(*begin)(const char *span, const char *detail, void *user_data);
+    void (*end)(const char *span, void *token, bool ok, void *user_data);
+    void *user_data;
+} MetricsTracer;
+
+void metrics_set_tracer(const MetricsTracer *tracer);
+void *metrics_trace_begin(const char *span, const char *detail);
+void metrics_trace_end(const char *span, void *token, bool ok);
+
+// Snapshots exchanged between cluster workers and the master
+typedef struct
+{
+    char name[METRICS_NAME_MAX];
+    uint8_t type; // MetricsType
+    int64_t value; // counter or gauge
+    uint64_t count; // histogram
+    uint64_t sum;
+    uint64_t buckets[METRICS_BUCKETS];
+} MetricsSample;
+
+size_t metrics_count(void);
+bool metrics_sample(size_t index, MetricsSample *sample);
+
+// Adds the counters and histograms of b to a; gauges are added as well
+void metrics_sample_merge(MetricsSample *a, const MetricsSample *b);
+
+// Cluster-wide totals received from the master; once a worker has any,
+// metrics_render() reports them instead of its own values
+void metrics_set_cluster_sample(const MetricsSample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
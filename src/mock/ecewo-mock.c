@@ -3,10 +3,11 @@
 #include "uv.h"
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h> // strcasecmp in mock_get_header
+#include <string.h> // strcasecmp in mock_get_header, strncasecmp in response_complete
 
 #ifdef _WIN32
 #define strcasecmp _stricmp
+#define strncasecmp _strnicmp
 #else
 #include <strings.h>
 #endif
@@ -35,6 +36,7 @@ typedef struct
     size_t response_len;
     size_t response_capacity;
     bool done;
+    bool head; // The response to a HEAD request has no body
     int status;
     uv_loop_t *loop;
 } http_client_t;
@@ -114,6 +116,28 @@ static void alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *b
 #endif
 }
 
+// Headers are complete and, when Content-Length is present, so is the body
+static bool response_complete(const char *buffer, size_t len, bool head)
+{
+    const char *header_end = strstr(buffer, "\r\n\r\n");
+    if (!header_end)
+        return false;
+
+    if (head)
+        return true;
+
+    size_t header_len = (size_t)(header_end - buffer) + 4;
+
+    for (const char *line = buffer; line < header_end; line++) {
+        if (strncasecmp(line, "\r\nContent-Length:", 18) == 0) {
+            size_t content_length = strtoull(line + 18, NULL, 10);
+            return len >= header_len + content_length;
+        }
+    }
+
+    return true;
+}
+
 static void on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
 {
     (void)buf;
@@ -137,7 +161,7 @@ static void on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
     client->response_buffer[client->response_len] = '\0';
 
     // Check if we have complete HTTP response
-    if (strstr(client->response_buffer, "\r\n\r\n")) {
+    if (response_complete(client->response_buffer, client->response_len, client->head)) {
         uv_read_stop(stream);
         uv_shutdown(&client->shutdown_req, stream, on_shutdown);
         client->shutdown_req.data = client;
@@ -186,7 +210,7 @@ static void on_connect(uv_connect_t *req, int status)
     }
 }
 
-static char *build_http_request(MockParams *params)
+static char *build_http_request(const MockParams *params, bool keep_alive)
 {
     size_t body_len = (params->body) ? strlen(params->body) : 0;
     size_t headers_estimate = 512;
@@ -225,13 +249,16 @@ static char *build_http_request(MockParams *params)
     case MOCK_OPTIONS:
         method = "OPTIONS";
         break;
+    case MOCK_HEAD:
+        method = "HEAD";
+        break;
     }
 
     len += snprintf(request + len, buffer_size - len,
                     "%s %s HTTP/1.1\r\n"
                     "Host: localhost:%d\r\n"
-                    "Connection: close\r\n",
-                    method, params->path, TEST_PORT);
+                    "Connection: %s\r\n",
+                    method, params->path, TEST_PORT, keep_alive ? "keep-alive" : "close");
 
     if (params->headers && params->header_count > 0) {
         for (size_t i = 0; i < params->header_count; i++) {
@@ -356,12 +383,13 @@ static void parse_response(http_client_t *client)
 
     // Parse body
     body_start += 4;
-    size_t body_len = strlen(body_start);
+    size_t body_len = client->response_len - (size_t)(body_start - client->response_buffer);
 
     if (body_len > 0) {
         client->response->body = malloc(body_len + 1);
         if (client->response->body) {
-            strcpy(client->response->body, body_start);
+            memcpy(client->response->body, body_start, body_len);
+            client->response->body[body_len] = '\0';
             client->response->body_len = body_len;
         }
     }
@@ -421,7 +449,7 @@ MockResponse request(MockParams *params)
 
     MockResponse response = { 0 };
 
-    char *request_data = build_http_request(params);
+    char *request_data = build_http_request(params, false);
     if (!request_data) {
         response.status_code = -1;
         return response;
@@ -440,6 +468,7 @@ MockResponse request(MockParams *params)
     client.loop = &loop;
     client.response = &response;
     client.request_data = request_data;
+    client.head = params->method == MOCK_HEAD;
     client.response_capacity = BUFFER_SIZE;
     client.response_buffer = malloc(client.response_capacity);
     client.done = false;
@@ -605,3 +634,631 @@ const char *mock_get_header(MockResponse *res, const char *key)
 
     return NULL;
 }
+
+// Load generator: keep-alive connections on a private loop, each keeping up to
+// `pipeline` requests in flight. Latencies go into a log-linear histogram
+// (1024 linear sub-buckets per power of two, < 0.1% error), as HdrHistogram does
+
+#define BENCH_HIST_SUB_BITS 11
+#define BENCH_HIST_SUB_COUNT (1u << BENCH_HIST_SUB_BITS)
+#define BENCH_HIST_HALF (BENCH_HIST_SUB_COUNT / 2)
+#define BENCH_HIST_MAX_SHIFT 32 // Up to 2^43 ns, longer latencies count as the maximum
+#define BENCH_HIST_SIZE (BENCH_HIST_SUB_COUNT + BENCH_HIST_MAX_SHIFT * BENCH_HIST_HALF)
+#define BENCH_DEFAULT_CONNECTIONS 8
+#define BENCH_DEFAULT_DURATION_MS 1000
+#define BENCH_DRAIN_TIMEOUT_MS 5000
+#define BENCH_READ_SIZE 65536
+#define BENCH_MAX_HEADER_SIZE 65536
+
+typedef struct bench_s bench_t;
+
+typedef struct
+{
+    uv_tcp_t tcp;
+    uv_connect_t connect_req;
+    uv_write_t write_req;
+    bench_t *bench;
+    char *in; // Received bytes not yet parsed
+    size_t in_len;
+    size_t in_cap;
+    char *out; // Requests being written, sized for a full pipeline
+    uint64_t *sent_at; // Ring of send times of the requests in flight
+    uint32_t head;
+    uint32_t inflight;
+    size_t next; // Next request of the workload
+    bool open; // The handle is initialized and not closed yet
+    bool writing;
+} bench_conn_t;
+
+struct bench_s
+{
+    uv_loop_t loop;
+    uv_timer_t timer;
+    struct sockaddr_in addr;
+
+    char **requests;
+    size_t *request_lens;
+    size_t request_count;
+    size_t max_request_len;
+
+    bench_conn_t *conns;
+    uint32_t conn_count;
+    uint32_t open_count; // Connection handles not closed yet
+    uint32_t pipeline;
+    uint64_t limit; // 0 for a fixed duration
+
+    uint64_t *histogram;
+    uint64_t issued;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t non_2xx;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t sum_ns;
+    uint64_t start_ns;
+    uint64_t last_ns; // Time of the last response
+
+    bool stopping;
+    bool failed;
+};
+
+static int msb64(uint64_t value)
+{
+    int msb = 0;
+    while (value >>= 1)
+        msb++;
+    return msb;
+}
+
+static uint32_t bench_hist_index(uint64_t value)
+{
+    if (value < BENCH_HIST_SUB_COUNT)
+        return (uint32_t)value;
+
+    uint32_t shift = (uint32_t)(msb64(value) - BENCH_HIST_SUB_BITS + 1);
+    if (shift > BENCH_HIST_MAX_SHIFT)
+        return BENCH_HIST_SIZE - 1;
+
+    return BENCH_HIST_SUB_COUNT + (shift - 1) * BENCH_HIST_HALF + (uint32_t)((value >> shift) - BENCH_HIST_HALF);
+}
+
+// Highest value that falls into the bucket
+static uint64_t bench_hist_value(uint32_t index)
+{
+    if (index < BENCH_HIST_SUB_COUNT)
+        return index;
+
+    uint32_t offset = index - BENCH_HIST_SUB_COUNT;
+    uint32_t shift = offset / BENCH_HIST_HALF + 1;
+    uint64_t sub = offset % BENCH_HIST_HALF + BENCH_HIST_HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+static uint64_t bench_percentile(const bench_t *bench, double quantile)
+{
+    if (bench->completed == 0)
+        return 0;
+
+    double target = quantile * (double)bench->completed;
+    uint64_t rank = (uint64_t)target;
+    if ((double)rank < target)
+        rank++;
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BENCH_HIST_SIZE; i++) {
+        seen += bench->histogram[i];
+        if (seen >= rank) {
+            uint64_t value = bench_hist_value(i);
+            return value < bench->max_ns ? value : bench->max_ns;
+        }
+    }
+
+    return bench->max_ns;
+}
+
+static const char *find_header_end(const char *data, size_t len)
+{
+    const char *p = data;
+    const char *end = data + len;
+
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        if (end - p < 3)
+            return NULL;
+        if (p[1] == '\r' && p[2] == '\n')
+            return p + 3;
+        p++;
+    }
+
+    return NULL;
+}
+
+// Length of the complete response at the start of data,
+// 0 if more bytes are needed, -1 if it isn't a valid response
+static long bench_response_length(const char *data, size_t len, int *status)
+{
+    const char *body = find_header_end(data, len);
+    if (!body)
+        return len > BENCH_MAX_HEADER_SIZE ? -1 : 0;
+
+    if (len < 12 || memcmp(data, "HTTP/1.", 7) != 0)
+        return -1;
+
+    *status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+
+    size_t content_length = 0;
+    bool chunked = false;
+
+    for (const char *line = memchr(data, '\n', (size_t)(body - data)); line && line + 1 < body;
+         line = memchr(line + 1, '\n', (size_t)(body - line - 1))) {
+        const char *name = line + 1;
+        size_t rest = (size_t)(body - name);
+
+        if (rest > 15 && strncasecmp(name, "Content-Length:", 15) == 0)
+            content_length = strtoull(name + 15, NULL, 10);
+        else if (rest > 18 && strncasecmp(name, "Transfer-Encoding:", 18) == 0) {
+            const char *value = name + 18;
+            while (*value == ' ')
+                value++;
+            chunked = strncasecmp(value, "chunked", 7) == 0;
+        }
+    }
+
+    size_t pos = (size_t)(body - data);
+
+    if (!chunked)
+        return pos + content_length <= len ? (long)(pos + content_length) : 0;
+
+    for (;;) {
+        const char *line_end = memchr(data + pos, '\n', len - pos);
+        if (!line_end)
+            return 0;
+
+        size_t size = 0;
+        for (const char *c = data + pos; c < line_end; c++) {
+            int digit;
+            if (*c >= '0' && *c <= '9')
+                digit = *c - '0';
+            else if (*c >= 'a' && *c <= 'f')
+                digit = *c - 'a' + 10;
+            else if (*c >= 'A' && *c <= 'F')
+                digit = *c - 'A' + 10;
+            else
+                break;
+            size = size * 16 + (size_t)digit;
+        }
+
+        pos = (size_t)(line_end - data) + 1;
+
+        if (size == 0) // Last chunk, no trailers expected
+            return pos + 2 <= len ? (long)(pos + 2) : 0;
+
+        pos += size + 2;
+        if (pos > len)
+            return 0;
+    }
+}
+
+static void bench_conn_start(bench_conn_t *conn);
+static void bench_stop(bench_t *bench);
+
+static void bench_check_done(bench_t *bench)
+{
+    if (bench->limit > 0 && bench->completed + bench->errors >= bench->limit)
+        bench_stop(bench);
+}
+
+static void bench_on_timer_closed(uv_handle_t *handle)
+{
+    (void)handle;
+}
+
+static void bench_on_conn_closed(uv_handle_t *handle)
+{
+    bench_conn_t *conn = (bench_conn_t *)handle->data;
+    bench_t *bench = conn->bench;
+
+    bench->errors += conn->inflight;
+    conn->inflight = 0;
+    conn->head = 0;
+    conn->in_len = 0;
+    conn->writing = false;
+    conn->open = false;
+    bench->open_count--;
+
+    bench_check_done(bench);
+
+    // The server closed a keep-alive connection, open a new one
+    if (!bench->stopping && !bench->failed) {
+        bench_conn_start(conn);
+        return;
+    }
+
+    if (bench->open_count == 0 && !uv_is_closing((uv_handle_t *)&bench->timer))
+        uv_close((uv_handle_t *)&bench->timer, bench_on_timer_closed);
+}
+
+static void bench_conn_close(bench_conn_t *conn)
+{
+    if (conn->open && !uv_is_closing((uv_handle_t *)&conn->tcp))
+        uv_close((uv_handle_t *)&conn->tcp, bench_on_conn_closed);
+}
+
+static bool bench_accepting(const bench_t *bench)
+{
+    return !bench->stopping && (bench->limit == 0 || bench->issued < bench->limit);
+}
+
+static void bench_on_write(uv_write_t *req, int status);
+
+static void bench_conn_fill(bench_conn_t *conn)
+{
+    bench_t *bench = conn->bench;
+    if (conn->writing)
+        return;
+
+    size_t len = 0;
+    uint64_t now = uv_hrtime();
+
+    while (conn->inflight < bench->pipeline && bench_accepting(bench)) {
+        memcpy(conn->out + len, bench->requests[conn->next], bench->request_lens[conn->next]);
+        len += bench->request_lens[conn->next];
+        conn->next = (conn->next + 1) % bench->request_count;
+
+        conn->sent_at[(conn->head + conn->inflight) % bench->pipeline] = now;
+        conn->inflight++;
+        bench->issued++;
+    }
+
+    if (len == 0)
+        return;
+
+    uv_buf_t buf = uv_buf_init(conn->out, (unsigned int)len);
+    int result = uv_write(&conn->write_req, (uv_stream_t *)&conn->tcp, &buf, 1, bench_on_write);
+    if (result < 0) {
+        LOG_ERROR("Bench write error: %s", uv_strerror(result));
+        bench_conn_close(conn);
+        return;
+    }
+
+    conn->writing = true;
+}
+
+static void bench_on_write(uv_write_t *req, int status)
+{
+    bench_conn_t *conn = (bench_conn_t *)req->data;
+    conn->writing = false;
+
+    if (status < 0) {
+        bench_conn_close(conn);
+        return;
+    }
+
+    bench_conn_fill(conn);
+}
+
+static void bench_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf)
+{
+    (void)suggested_size;
+    bench_conn_t *conn = (bench_conn_t *)handle->data;
+
+    if (conn->in_cap - conn->in_len < BENCH_READ_SIZE) {
+        size_t new_cap = conn->in_cap * 2;
+        if (new_cap < conn->in_len + BENCH_READ_SIZE)
+            new_cap = conn->in_len + BENCH_READ_SIZE;
+
+        char *new_in = realloc(conn->in, new_cap);
+        if (new_in) {
+            conn->in = new_in;
+            conn->in_cap = new_cap;
+        }
+    }
+
+    buf->base = conn->in + conn->in_len;
+#ifdef _WIN32
+    buf->len = (unsigned long)(conn->in_cap - conn->in_len);
+#else
+    buf->len = conn->in_cap - conn->in_len;
+#endif
+}
+
+static void bench_record(bench_t *bench, bench_conn_t *conn, int status, uint64_t now)
+{
+    uint64_t latency = now - conn->sent_at[conn->head];
+    conn->head = (conn->head + 1) % bench->pipeline;
+    conn->inflight--;
+
+    bench->completed++;
+    bench->histogram[bench_hist_index(latency)]++;
+    bench->sum_ns += latency;
+    if (latency < bench->min_ns)
+        bench->min_ns = latency;
+    if (latency > bench->max_ns)
+        bench->max_ns = latency;
+    if (status < 200 || status > 299)
+        bench->non_2xx++;
+
+    bench->last_ns = now;
+}
+
+static void bench_on_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
+{
+    (void)buf;
+    bench_conn_t *conn = (bench_conn_t *)stream->data;
+    bench_t *bench = conn->bench;
+
+    if (nread < 0) {
+        bench_conn_close(conn);
+        return;
+    }
+
+    conn->in_len += (size_t)nread;
+
+    uint64_t now = uv_hrtime();
+    size_t offset = 0;
+
+    for (;;) {
+        int status = 0;
+        long len = bench_response_length(conn->in + offset, conn->in_len - offset, &status);
+        if (len == 0)
+            break;
+
+        if (len < 0 || conn->inflight == 0) {
+            LOG_ERROR("Bench received an invalid response");
+            bench_conn_close(conn);
+            return;
+        }
+
+        bench_record(bench, conn, status, now);
+        offset += (size_t)len;
+    }
+
+    if (offset > 0) {
+        memmove(conn->in, conn->in + offset, conn->in_len - offset);
+        conn->in_len -= offset;
+    }
+
+    bench_check_done(bench);
+
+    if (bench->stopping) {
+        if (conn->inflight == 0)
+            bench_conn_close(conn);
+        return;
+    }
+
+    bench_conn_fill(conn);
+}
+
+static void bench_on_connect(uv_connect_t *req, int status)
+{
+    bench_conn_t *conn = (bench_conn_t *)req->data;
+    bench_t *bench = conn->bench;
+
+    if (bench->stopping) {
+        bench_conn_close(conn); // Already closing if the connect was canceled
+        return;
+    }
+
+    if (status < 0) {
+        LOG_ERROR("Bench connection error: %s", uv_strerror(status));
+        bench->failed = true;
+        bench_conn_close(conn);
+        bench_stop(bench);
+        return;
+    }
+
+    uv_tcp_nodelay(&conn->tcp, 1);
+
+    int result = uv_read_start((uv_stream_t *)&conn->tcp, bench_alloc, bench_on_read);
+    if (result < 0) {
+        LOG_ERROR("Bench read start error: %s", uv_strerror(result));
+        bench_conn_close(conn);
+        return;
+    }
+
+    bench_conn_fill(conn);
+}
+
+static void bench_conn_start(bench_conn_t *conn)
+{
+    bench_t *bench = conn->bench;
+
+    if (uv_tcp_init(&bench->loop, &conn->tcp) != 0) {
+        bench->failed = true;
+        bench_stop(bench);
+        return;
+    }
+
+    bench->open_count++;
+    conn->open = true;
+    conn->tcp.data = conn;
+    conn->connect_req.data = conn;
+    conn->write_req.data = conn;
+
+    int result = uv_tcp_connect(&conn->connect_req, &conn->tcp,
+                                (const struct sockaddr *)&bench->addr, bench_on_connect);
+    if (result < 0) {
+        LOG_ERROR("Bench connection error: %s", uv_strerror(result));
+        bench->failed = true;
+        bench_conn_close(conn);
+        bench_stop(bench);
+    }
+}
+
+static void bench_on_timer(uv_timer_t *handle)
+{
+    bench_t *bench = (bench_t *)handle->data;
+
+    if (!bench->stopping) {
+        bench_stop(bench);
+        return;
+    }
+
+    // Drain timeout, drop whatever is still in flight
+    for (uint32_t i = 0; i < bench->conn_count; i++)
+        bench_conn_close(&bench->conns[i]);
+}
+
+static void bench_stop(bench_t *bench)
+{
+    if (bench->stopping)
+        return;
+
+    bench->stopping = true;
+
+    if (!uv_is_closing((uv_handle_t *)&bench->timer))
+        uv_timer_start(&bench->timer, bench_on_timer, BENCH_DRAIN_TIMEOUT_MS, 0);
+
+    for (uint32_t i = 0; i < bench->conn_count; i++) {
+        bench_conn_t *conn = &bench->conns[i];
+        if (conn->inflight == 0)
+            bench_conn_close(conn);
+    }
+
+    if (bench->open_count == 0 && !uv_is_closing((uv_handle_t *)&bench->timer))
+        uv_close((uv_handle_t *)&bench->timer, bench_on_timer_closed);
+}
+
+static void bench_free(bench_t *bench)
+{
+    if (bench->requests) {
+        for (size_t i = 0; i < bench->request_count; i++)
+            free(bench->requests[i]);
+    }
+
+    if (bench->conns) {
+        for (uint32_t i = 0; i < bench->conn_count; i++) {
+            free(bench->conns[i].in);
+            free(bench->conns[i].out);
+            free(bench->conns[i].sent_at);
+        }
+    }
+
+    free(bench->requests);
+    free(bench->request_lens);
+    free(bench->conns);
+    free(bench->histogram);
+    free(bench);
+}
+
+static int bench_prepare(bench_t *bench, const MockBench *config)
+{
+    bench->request_count = config->request_count;
+    bench->requests = calloc(config->request_count, sizeof(char *));
+    bench->request_lens = calloc(config->request_count, sizeof(size_t));
+    bench->conns = calloc(bench->conn_count, sizeof(bench_conn_t));
+    bench->histogram = calloc(BENCH_HIST_SIZE, sizeof(uint64_t));
+
+    if (!bench->requests || !bench->request_lens || !bench->conns || !bench->histogram)
+        return -1;
+
+    for (size_t i = 0; i < config->request_count; i++) {
+        bench->requests[i] = build_http_request(&config->requests[i], true);
+        if (!bench->requests[i])
+            return -1;
+
+        bench->request_lens[i] = strlen(bench->requests[i]);
+        if (bench->request_lens[i] > bench->max_request_len)
+            bench->max_request_len = bench->request_lens[i];
+    }
+
+    for (uint32_t i = 0; i < bench->conn_count; i++) {
+        bench_conn_t *conn = &bench->conns[i];
+        conn->bench = bench;
+        conn->next = i % config->request_count; // Connections start at different requests
+        conn->out = malloc(bench->max_request_len * bench->pipeline);
+        conn->sent_at = malloc(sizeof(uint64_t) * bench->pipeline);
+        if (!conn->out || !conn->sent_at)
+            return -1;
+    }
+
+    return 0;
+}
+
+int mock_bench(const MockBench *config, MockBenchResult *result)
+{
+    if (!config || !config->requests || config->request_count == 0 || !result) {
+        LOG_ERROR("mock_bench: requests and result are required");
+        return -1;
+    }
+
+    memset(result, 0, sizeof(*result));
+
+    bench_t *bench = calloc(1, sizeof(bench_t));
+    if (!bench)
+        return -1;
+
+    bench->conn_count = config->connections ? config->connections : BENCH_DEFAULT_CONNECTIONS;
+    bench->pipeline = config->pipeline ? config->pipeline : 1;
+    bench->limit = config->total_requests;
+    bench->min_ns = UINT64_MAX;
+
+    uint32_t duration_ms = config->duration_ms;
+    if (duration_ms == 0 && bench->limit == 0)
+        duration_ms = BENCH_DEFAULT_DURATION_MS;
+
+    if (bench_prepare(bench, config) != 0 || uv_ip4_addr("127.0.0.1", TEST_PORT, &bench->addr) != 0) {
+        LOG_ERROR("mock_bench: setup failed");
+        bench_free(bench);
+        return -1;
+    }
+
+    if (uv_loop_init(&bench->loop) != 0) {
+        bench_free(bench);
+        return -1;
+    }
+
+    uv_timer_init(&bench->loop, &bench->timer);
+    bench->timer.data = bench;
+
+    bench->start_ns = uv_hrtime();
+    bench->last_ns = bench->start_ns;
+
+    if (duration_ms > 0)
+        uv_timer_start(&bench->timer, bench_on_timer, duration_ms, 0);
+
+    for (uint32_t i = 0; i < bench->conn_count && !bench->failed; i++)
+        bench_conn_start(&bench->conns[i]);
+
+    uv_run(&bench->loop, UV_RUN_DEFAULT);
+    uv_loop_close(&bench->loop);
+
+    result->requests = bench->completed;
+    result->errors = bench->errors;
+    result->non_2xx = bench->non_2xx;
+    result->seconds = (double)(bench->last_ns - bench->start_ns) / 1e9;
+    if (result->seconds > 0)
+        result->requests_per_sec = (double)bench->completed / result->seconds;
+
+    if (bench->completed > 0) {
+        result->min_ns = bench->min_ns;
+        result->mean_ns = bench->sum_ns / bench->completed;
+        result->p50_ns = bench_percentile(bench, 0.50);
+        result->p90_ns = bench_percentile(bench, 0.90);
+        result->p99_ns = bench_percentile(bench, 0.99);
+        result->p999_ns = bench_percentile(bench, 0.999);
+        result->max_ns = bench->max_ns;
+    }
+
+    int rc = bench->failed ? -1 : 0;
+    bench_free(bench);
+    return rc;
+}
+
+void mock_bench_print(const char *name, const MockBenchResult *result)
+{
+    if (!result)
+        return;
+
+    printf("%-16s %10.0f req/s  p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %8.1f us  (%llu requests, %llu errors, %llu non-2xx)\n",
+           name ? name : "bench",
+           result->requests_per_sec,
+           (double)result->p50_ns / 1000.0,
+           (double)result->p99_ns / 1000.0,
+           (double)result->p999_ns / 1000.0,
+           (double)result->max_ns / 1000.0,
+           (unsigned long long)result->requests,
+           (unsigned long long)result->errors,
+           (unsigned long long)result->non_2xx);
+}
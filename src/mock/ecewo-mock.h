@@ -13,7 +13,8 @@ typedef enum {
     MOCK_PUT,
     MOCK_DELETE,
     MOCK_PATCH,
-    MOCK_OPTIONS
+    MOCK_OPTIONS,
+    MOCK_HEAD
 } MockMethod;
 
 typedef struct
@@ -40,6 +41,32 @@ typedef struct
     size_t header_count;
 } MockParams;
 
+typedef struct
+{
+    const MockParams *requests; // Workload, sent round-robin
+    size_t request_count;
+    uint32_t connections; // Keep-alive connections, default: 8
+    uint32_t pipeline; // Requests in flight per connection, default: 1
+    uint32_t duration_ms; // Run time, default: 1000 unless total_requests is set
+    uint64_t total_requests; // Stop after N responses, default: 0 (run for duration_ms)
+} MockBench;
+
+typedef struct
+{
+    uint64_t requests; // Responses received
+    uint64_t errors; // Requests lost to closed connections
+    uint64_t non_2xx; // Responses with a status outside 200-299
+    double seconds; // From the first request to the last response
+    double requests_per_sec;
+    uint64_t min_ns;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} MockBenchResult;
+
 #define TEST_PORT 8888
 typedef void (*test_routes_cb_t)(void);
 
@@ -51,6 +78,13 @@ void mock_cleanup(void);
 
 const char *mock_get_header(MockResponse *res, const char *key);
 
+// Load the mock_init() server with the requests of config
+// returns 0 on success, -1 if the server could not be reached
+int mock_bench(const MockBench *config, MockBenchResult *result);
+
+// Print result as one line: req/s and latency percentiles
+void mock_bench_print(const char *name, const MockBenchResult *result);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,5 +1,6 @@
 #include "ecewo-postgres.h"
 #include "ecewo.h"
+#include "ecewo-metrics.h"
 #include "uv.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,15 +9,74 @@
 #define LOG_ERROR(fmt, ...) \
     fprintf(stderr, "[ERROR] [ecewo-postgres]" fmt "\n", ##__VA_ARGS__)
 
+#define POOL_DEFAULT_MAX_SIZE 10
+#define POOL_DEFAULT_RECONNECT_DELAY_MS 1000
+#define POOL_HEALTH_INTERVAL_MS 5000
+#define POOL_DEFAULT_STATEMENT_CACHE 64
+
+#define STMT_NAME_PREFIX "ecewo_s"
+#define STMT_NAME_MAX 24
+
+#define TRACE_SPAN "postgres.query"
+
+#ifdef _WIN32
+#define POLL_INTERVAL_MS 10
+#endif
+
+typedef struct pool_conn_s pool_conn_t;
+
 struct pg_query_s {
     char *sql;
     char **params;
     int param_count;
+    // Set by query_queue_params()
+    Oid *types;
+    int *lengths;
+    int *formats;
+    int result_format;
+    int rows_per_batch;
     pg_result_cb_t result_cb;
     void *data;
+    int sync_after; // ends a pipeline segment
+    int prepared;   // queued with query_queue_prepared()
+    uint32_t stmt_id;
+    int skip_groups; // prepare/deallocate results preceding the query's own
+    uint32_t timeout_ms;
+    uint64_t queued_at;       // uv_hrtime()
+    uint64_t first_result_at; // uv_hrtime()
     pg_query_t *next;
 };
 
+typedef enum {
+    STEP_DEALLOCATE,
+    STEP_PREPARE,
+    STEP_EXECUTE,
+} query_step_t;
+
+typedef struct stmt_entry_s stmt_entry_t;
+
+struct stmt_entry_s {
+    uint64_t hash;
+    uint32_t id;
+    char *sql;
+    stmt_entry_t *chain;
+    stmt_entry_t *lru_prev;
+    stmt_entry_t *lru_next;
+    int type_count;
+    Oid types[]; // Part of the key: the same SQL prepared with other types is another statement
+};
+
+// Statements prepared on one connection, most recently used first
+typedef struct {
+    stmt_entry_t **buckets;
+    size_t bucket_count;
+    stmt_entry_t *lru_head;
+    stmt_entry_t *lru_tail;
+    int count;
+    int capacity;
+    uint32_t next_id;
+} stmt_cache_t;
+
 struct pg_async_s {
     PGconn *conn;
     Arena *arena;
@@ -29,295 +89,1987 @@ struct pg_async_s {
     pg_query_t *query_queue_tail;
     pg_query_t *current_query;
 
+    // Pipeline mode: queued queries are sent in one batch
+    int pipeline;
+    int pending_syncs;
+    int query_started;
+
+    // Sequential mode: what current_query is waiting for
+    query_step_t step;
+    uint32_t evicted_id;
+
+    // Set by query_create_pooled(); conn is borrowed from pool_conn
+    pg_pool_t *pool;
+    pool_conn_t *pool_conn;
+    PGquery *wait_next;
+
+    // Deadline of the whole execution (uv_now() based, 0 = none) and
+    // the timer enforcing it or the current query's timeout
+    uint32_t timeout_ms;
+    uint64_t deadline;
+    uv_timer_t *deadline_timer;
+    int timed_out;
+    pg_query_t *timed_out_query;
+
+    // Per-query timings, see query_on_timing()
+    pg_timing_cb_t timing_cb;
+    void *timing_data;
+    uint64_t sent_at;
+    uint64_t flushed_at;
+
+    // Trace span of one query_execute(), ended when the execution does
+    void *span;
+    int traced;
+    int completed; // the queue ran to the end
+
     int handle_initialized;
+    uv_poll_t poll;
 #ifdef _WIN32
+    // Fallback for sockets libuv can't poll
     uv_timer_t timer;
-#else
-    uv_poll_t poll;
+    int use_timer;
+#endif
+};
+
+typedef enum {
+    POOL_CONN_CONNECTING,
+    POOL_CONN_IDLE,
+    POOL_CONN_BUSY,
+    POOL_CONN_RETRY,
+} pool_conn_state_t;
+
+struct pool_conn_s {
+    pg_pool_t *pool;
+    PGconn *conn;
+    PGquery *query;
+    pool_conn_state_t state;
+    uint64_t last_used;
+    int broken;
+    stmt_cache_t stmts;
+
+    // Reconnect delay, and the polling fallback on Windows
+    uv_timer_t timer;
+#ifdef _WIN32
+    int use_timer;
 #endif
+    // Heap-allocated because libpq may switch sockets while connecting
+    // and a uv_poll_t cannot be rebound before its close callback runs
+    uv_poll_t *poll;
+    int poll_fd;
+
+    pool_conn_t *next;
+    pool_conn_t *idle_next;
+};
+
+struct pg_pool_s {
+    char *conninfo;
+    int min_size;
+    int max_size;
+    uint64_t idle_timeout_ms;
+    uint64_t reconnect_delay_ms;
+    int statement_cache_size;
+
+    pool_conn_t *conns;
+    pool_conn_t *idle;
+    int size;
+
+    PGquery *wait_head;
+    PGquery *wait_tail;
+    int wait_count;
+
+    uv_timer_t reaper;
+    int closing;
 };
 
+// Registered by the first pool or execution
+static struct
+{
+    int registered;
+    Metric *query_time;
+    Metric *queue_wait;
+    Metric *timeouts;
+    Metric *pool_waiting;
+} pg_metrics;
+
+static void pg_metrics_register(void)
+{
+    if (pg_metrics.registered)
+        return;
+
+    pg_metrics.registered = 1;
+    pg_metrics.query_time = metrics_histogram("ecewo_pg_query_seconds", "Time from sending a query to its last result");
+    pg_metrics.queue_wait = metrics_histogram("ecewo_pg_queue_wait_seconds", "Time queries waited in the queue before they were sent");
+    pg_metrics.timeouts = metrics_counter("ecewo_pg_timeouts_total", "Queries that hit their timeout or deadline");
+    pg_metrics.pool_waiting = metrics_gauge("ecewo_pg_pool_waiting", "Executions waiting for a pooled connection");
+}
+
 static void execute_next_query(PGquery *pg);
 static void cleanup_and_destroy(PGquery *pg);
+static void pool_release(PGquery *pg);
+static int pool_conn_watch(pool_conn_t *pc, int events);
+static void pool_conn_unwatch(pool_conn_t *pc);
+static void pool_wait_remove(pg_pool_t *pool, PGquery *pg);
+static void watch_stop(PGquery *pg);
 
+static void on_poll(uv_poll_t *handle, int status, int events);
 #ifdef _WIN32
 static void on_timer(uv_timer_t *handle);
+#endif
+
+// libpq hands out the SOCKET as an int on Windows
+static int poll_init(uv_poll_t *handle, int sock)
+{
+#ifdef _WIN32
+    return uv_poll_init_socket(get_loop(), handle, (uv_os_sock_t)sock);
 #else
-static void on_poll(uv_poll_t *handle, int status, int events);
+    return uv_poll_init(get_loop(), handle, sock);
 #endif
+}
 
-static void on_handle_closed(uv_handle_t *handle)
+// ============================================================================
+// PREPARED STATEMENT CACHE
+// ============================================================================
+
+static Oid query_param_type(const pg_query_t *query, int i)
 {
-    if (!handle || !handle->data)
+    return query->types ? query->types[i] : 0;
+}
+
+static uint64_t stmt_hash(const pg_query_t *query)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)query->sql; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+
+    for (int i = 0; i < query->param_count; i++) {
+        hash ^= query_param_type(query, i);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool stmt_matches(const stmt_entry_t *entry, const pg_query_t *query)
+{
+    if (entry->type_count != query->param_count || strcmp(entry->sql, query->sql) != 0)
+        return false;
+
+    for (int i = 0; i < entry->type_count; i++) {
+        if (entry->types[i] != query_param_type(query, i))
+            return false;
+    }
+    return true;
+}
+
+static void stmt_name(char *buf, uint32_t id)
+{
+    snprintf(buf, STMT_NAME_MAX, STMT_NAME_PREFIX "%u", id);
+}
+
+static void stmt_lru_unlink(stmt_cache_t *cache, stmt_entry_t *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
+
+static void stmt_lru_push(stmt_cache_t *cache, stmt_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail)
+        cache->lru_tail = entry;
+}
+
+static void stmt_cache_unlink(stmt_cache_t *cache, stmt_entry_t *entry)
+{
+    size_t slot = entry->hash & (cache->bucket_count - 1);
+    for (stmt_entry_t **link = &cache->buckets[slot]; *link; link = &(*link)->chain) {
+        if (*link == entry) {
+            *link = entry->chain;
+            break;
+        }
+    }
+
+    stmt_lru_unlink(cache, entry);
+    cache->count--;
+    free(entry->sql);
+    free(entry);
+}
+
+static int stmt_cache_init(stmt_cache_t *cache, int capacity)
+{
+    memset(cache, 0, sizeof(*cache));
+    if (capacity <= 0)
+        return 0;
+
+    size_t buckets = 8;
+    while (buckets < (size_t)capacity * 2)
+        buckets <<= 1;
+
+    cache->buckets = calloc(buckets, sizeof(stmt_entry_t *));
+    if (!cache->buckets)
+        return -1;
+
+    cache->bucket_count = buckets;
+    cache->capacity = capacity;
+    cache->next_id = 1;
+    return 0;
+}
+
+// Forget every statement; the server drops them with the session
+static void stmt_cache_clear(stmt_cache_t *cache)
+{
+    while (cache->lru_head)
+        stmt_cache_unlink(cache, cache->lru_head);
+}
+
+static void stmt_cache_free(stmt_cache_t *cache)
+{
+    stmt_cache_clear(cache);
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->bucket_count = 0;
+    cache->capacity = 0;
+}
+
+static stmt_entry_t *stmt_cache_find(stmt_cache_t *cache, const pg_query_t *query, uint64_t hash)
+{
+    stmt_entry_t *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+    for (; entry; entry = entry->chain) {
+        if (entry->hash == hash && stmt_matches(entry, query))
+            return entry;
+    }
+    return NULL;
+}
+
+// Drops a statement that turned out not to exist on the server
+static void stmt_cache_invalidate(stmt_cache_t *cache, const pg_query_t *query)
+{
+    if (!cache || !cache->capacity || !query->stmt_id)
         return;
 
-    PGquery *pg = (PGquery *)handle->data;
-    pg->handle_initialized = 0;
+    stmt_entry_t *entry = stmt_cache_find(cache, query, stmt_hash(query));
+    if (entry && entry->id == query->stmt_id)
+        stmt_cache_unlink(cache, entry);
 }
 
-static void cancel_execution(PGquery *pg)
+// Decides how a query is sent on its connection. A cached statement is
+// executed directly; otherwise it is prepared first, after deallocating
+// the least recently used statement if the cache is full
+static query_step_t stmt_plan(stmt_cache_t *cache, pg_query_t *query, uint32_t *evicted_id)
 {
-    if (!pg)
+    query->stmt_id = 0;
+    *evicted_id = 0;
+
+    if (!query->prepared || !cache || !cache->capacity)
+        return STEP_EXECUTE;
+
+    uint64_t hash = stmt_hash(query);
+    stmt_entry_t *entry = stmt_cache_find(cache, query, hash);
+    if (entry) {
+        stmt_lru_unlink(cache, entry);
+        stmt_lru_push(cache, entry);
+        query->stmt_id = entry->id;
+        return STEP_EXECUTE;
+    }
+
+    entry = calloc(1, sizeof(stmt_entry_t) + (size_t)query->param_count * sizeof(Oid));
+    if (!entry)
+        return STEP_EXECUTE;
+
+    entry->type_count = query->param_count;
+    for (int i = 0; i < query->param_count; i++)
+        entry->types[i] = query_param_type(query, i);
+
+    size_t len = strlen(query->sql);
+    entry->sql = malloc(len + 1);
+    if (!entry->sql) {
+        free(entry);
+        return STEP_EXECUTE;
+    }
+    memcpy(entry->sql, query->sql, len + 1);
+
+    if (cache->count >= cache->capacity) {
+        *evicted_id = cache->lru_tail->id;
+        stmt_cache_unlink(cache, cache->lru_tail);
+    }
+
+    entry->hash = hash;
+    entry->id = cache->next_id++;
+    if (!cache->next_id)
+        cache->next_id = 1;
+
+    size_t slot = hash & (cache->bucket_count - 1);
+    entry->chain = cache->buckets[slot];
+    cache->buckets[slot] = entry;
+    stmt_lru_push(cache, entry);
+    cache->count++;
+
+    query->stmt_id = entry->id;
+    return *evicted_id ? STEP_DEALLOCATE : STEP_PREPARE;
+}
+
+static stmt_cache_t *query_stmt_cache(PGquery *pg)
+{
+    return pg->pool_conn ? &pg->pool_conn->stmts : NULL;
+}
+
+static int send_step(PGquery *pg, pg_query_t *query, query_step_t step, uint32_t evicted_id)
+{
+    char name[STMT_NAME_MAX];
+
+    switch (step) {
+    case STEP_DEALLOCATE: {
+        char sql[sizeof("DEALLOCATE ") + STMT_NAME_MAX];
+        stmt_name(name, evicted_id);
+        snprintf(sql, sizeof(sql), "DEALLOCATE %s", name);
+        return PQsendQueryParams(pg->conn, sql, 0, NULL, NULL, NULL, NULL, 0);
+    }
+
+    case STEP_PREPARE:
+        stmt_name(name, query->stmt_id);
+        return PQsendPrepare(pg->conn, name, query->sql, query->param_count, query->types);
+
+    default:
+        break;
+    }
+
+    if (query->stmt_id) {
+        stmt_name(name, query->stmt_id);
+        return PQsendQueryPrepared(pg->conn,
+                                   name,
+                                   query->param_count,
+                                   (const char **)query->params,
+                                   query->lengths,
+                                   query->formats,
+                                   query->result_format);
+    }
+
+    if (query->param_count > 0 || query->result_format || pg->pipeline) {
+        // PQsendQuery() is not allowed in pipeline mode
+        return PQsendQueryParams(pg->conn,
+                                 query->sql,
+                                 query->param_count,
+                                 query->types,
+                                 (const char **)query->params,
+                                 query->lengths,
+                                 query->formats,
+                                 query->result_format);
+    }
+
+    return PQsendQuery(pg->conn, query->sql);
+}
+
+// Has to run before libpq reads the first result of the query; if the
+// mode can't be set, all rows simply arrive in one PGresult
+static void set_rows_mode(PGquery *pg, pg_query_t *query)
+{
+    if (!query || query->rows_per_batch <= 0)
         return;
 
-    if (pg->is_executing && pg->handle_initialized) {
-#ifdef _WIN32
-        uv_timer_stop(&pg->timer);
-        if (!uv_is_closing((uv_handle_t *)&pg->timer)) {
-            uv_close((uv_handle_t *)&pg->timer, on_handle_closed);
-        }
-#else
-        uv_poll_stop(&pg->poll);
-        if (!uv_is_closing((uv_handle_t *)&pg->poll)) {
-            uv_close((uv_handle_t *)&pg->poll, on_handle_closed);
-        }
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (query->rows_per_batch > 1) {
+        PQsetChunkedRowsMode(pg->conn, query->rows_per_batch);
+        return;
+    }
+#endif
+
+    PQsetSingleRowMode(pg->conn);
+}
+
+static int result_ok(ExecStatusType status)
+{
+    switch (status) {
+    case PGRES_TUPLES_OK:
+    case PGRES_COMMAND_OK:
+    case PGRES_SINGLE_TUPLE:
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    case PGRES_TUPLES_CHUNK:
 #endif
+        return 1;
+    default:
+        return 0;
     }
+}
 
-    if (pg->conn && pg->is_executing) {
-        PGcancel *cancel = PQgetCancel(pg->conn);
-        if (cancel) {
-            char errbuf[256];
-            PQcancel(cancel, errbuf, sizeof(errbuf));
-            PQfreeCancel(cancel);
-        }
+// ============================================================================
+// CANCELLATION
+// ============================================================================
+
+// A cancel request travels over its own connection to the server, so it
+// is fire-and-forget: the canceled query simply fails with SQLSTATE 57014
+
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+typedef struct {
+    PGcancelConn *cancel;
+    uv_poll_t *poll;
+    int poll_fd;
+} canceler_t;
+
+static void canceler_step(canceler_t *c);
+
+static void on_cancel_poll_closed(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void canceler_finish(canceler_t *c)
+{
+    if (c->poll) {
+        uv_poll_stop(c->poll);
+        uv_close((uv_handle_t *)c->poll, on_cancel_poll_closed);
     }
 
-    pg->is_executing = 0;
+    PQcancelFinish(c->cancel);
+    free(c);
 }
 
-static void cleanup_and_destroy(PGquery *pg)
+static void on_cancel_poll(uv_poll_t *handle, int status, int events)
 {
-    if (!pg)
+    (void)events;
+    canceler_t *c = (canceler_t *)handle->data;
+
+    if (status < 0) {
+        LOG_ERROR("Cancel poll error: %s", uv_strerror(status));
+        canceler_finish(c);
         return;
+    }
 
-    cancel_execution(pg);
-    // PGquery is in the arena - caller manages its memory
+    canceler_step(c);
 }
 
-#ifdef _WIN32
-static void on_timer(uv_timer_t *handle)
+static void canceler_watch(canceler_t *c, int events)
 {
-    if (!handle || !handle->data)
+    int sock = PQcancelSocket(c->cancel);
+    if (sock < 0) {
+        LOG_ERROR("Invalid cancel socket");
+        canceler_finish(c);
         return;
+    }
 
-    PGquery *pg = (PGquery *)handle->data;
+    if (c->poll && c->poll_fd != sock) {
+        uv_poll_stop(c->poll);
+        uv_close((uv_handle_t *)c->poll, on_cancel_poll_closed);
+        c->poll = NULL;
+    }
 
-    if (!server_is_running()) {
-        uv_timer_stop(&pg->timer);
-        if (!uv_is_closing((uv_handle_t *)&pg->timer)) {
-            uv_close((uv_handle_t *)&pg->timer, on_handle_closed);
+    if (!c->poll) {
+        c->poll = malloc(sizeof(uv_poll_t));
+        if (!c->poll || poll_init(c->poll, sock) != 0) {
+            LOG_ERROR("Failed to watch cancel socket");
+            free(c->poll);
+            c->poll = NULL;
+            canceler_finish(c);
+            return;
         }
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
+
+        c->poll->data = c;
+        c->poll_fd = sock;
+    }
+
+    uv_poll_start(c->poll, events, on_cancel_poll);
+}
+
+static void canceler_step(canceler_t *c)
+{
+    switch (PQcancelPoll(c->cancel)) {
+    case PGRES_POLLING_READING:
+        canceler_watch(c, UV_READABLE);
+        return;
+    case PGRES_POLLING_WRITING:
+        canceler_watch(c, UV_WRITABLE);
+        return;
+    case PGRES_POLLING_OK:
+        canceler_finish(c);
+        return;
+    default:
+        LOG_ERROR("Cancel request failed: %s", PQcancelErrorMessage(c->cancel));
+        canceler_finish(c);
         return;
     }
+}
 
-    if (!PQconsumeInput(pg->conn)) {
-        LOG_ERROR("PQconsumeInput failed: %s", PQerrorMessage(pg->conn));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
+static void cancel_start(PGconn *conn)
+{
+    canceler_t *c = calloc(1, sizeof(canceler_t));
+    if (!c) {
+        LOG_ERROR("Failed to allocate cancel request");
         return;
     }
 
-    if (PQisBusy(pg->conn))
+    c->poll_fd = -1;
+    c->cancel = PQcancelCreate(conn);
+    if (!c->cancel || !PQcancelStart(c->cancel)) {
+        LOG_ERROR("Failed to start cancel request: %s",
+                  c->cancel ? PQcancelErrorMessage(c->cancel) : "out of memory");
+        if (c->cancel)
+            PQcancelFinish(c->cancel);
+        free(c);
         return;
+    }
+
+    // libpq: start as if PQcancelPoll() had returned PGRES_POLLING_WRITING
+    canceler_watch(c, UV_WRITABLE);
+}
+#else
+// Before libpq 17 PQcancel() is the only way and it blocks until the
+// server answers, so it runs on the thread pool instead of the loop
+typedef struct {
+    uv_work_t work;
+    PGcancel *cancel;
+    int ok;
+    char errbuf[256];
+} canceler_t;
+
+static void cancel_work(uv_work_t *req)
+{
+    canceler_t *c = (canceler_t *)req->data;
+    c->ok = PQcancel(c->cancel, c->errbuf, sizeof(c->errbuf));
+}
 
-    uv_timer_stop(&pg->timer);
+static void cancel_after_work(uv_work_t *req, int status)
+{
+    canceler_t *c = (canceler_t *)req->data;
 
-    PGresult *result;
-    while ((result = PQgetResult(pg->conn)) != NULL) {
-        ExecStatusType result_status = PQresultStatus(result);
+    if (status == 0 && !c->ok)
+        LOG_ERROR("Cancel request failed: %s", c->errbuf);
 
-        if (result_status != PGRES_TUPLES_OK && result_status != PGRES_COMMAND_OK) {
-            LOG_ERROR("Query failed: %s", PQresultErrorMessage(result));
-            PQclear(result);
-            pg->current_query = NULL;
-            pg->is_executing = 0;
-            decrement_async_work();
-            cleanup_and_destroy(pg);
-            return;
-        }
+    PQfreeCancel(c->cancel);
+    free(c);
+}
 
-        if (pg->current_query && pg->current_query->result_cb) {
-            pg->current_query->result_cb(pg, result, pg->current_query->data);
-        }
+static void cancel_start(PGconn *conn)
+{
+    canceler_t *c = calloc(1, sizeof(canceler_t));
+    if (!c) {
+        LOG_ERROR("Failed to allocate cancel request");
+        return;
+    }
 
-        PQclear(result);
+    c->cancel = PQgetCancel(conn);
+    if (!c->cancel) {
+        LOG_ERROR("Failed to create cancel request");
+        free(c);
+        return;
     }
 
-    pg->current_query = NULL;
-    execute_next_query(pg);
+    c->work.data = c;
+    int queue_result = uv_queue_work(get_loop(), &c->work, cancel_work, cancel_after_work);
+    if (queue_result != 0) {
+        LOG_ERROR("uv_queue_work failed: %s", uv_strerror(queue_result));
+        PQfreeCancel(c->cancel);
+        free(c);
+    }
 }
-#else
-static void on_poll(uv_poll_t *handle, int status, int events)
+#endif
+
+// ============================================================================
+// DEADLINES AND TIMINGS
+// ============================================================================
+
+static void report_timing(PGquery *pg, pg_query_t *query, bool timed_out)
 {
-    if (!handle || !handle->data)
+    if (!query)
+        return;
+
+    uint64_t now = uv_hrtime();
+    // A query that timed out waiting for a connection was never sent
+    uint64_t sent = pg->sent_at ? pg->sent_at : now;
+
+    metrics_observe(pg_metrics.queue_wait, sent - query->queued_at);
+    if (pg->sent_at)
+        metrics_observe(pg_metrics.query_time, now - sent);
+    if (timed_out)
+        metrics_inc(pg_metrics.timeouts);
+
+    if (!pg->timing_cb)
+        return;
+
+    PGtiming timing = {
+        .sql = query->sql,
+        .queue_wait_ns = sent - query->queued_at,
+        .send_ns = pg->flushed_at ? pg->flushed_at - sent : 0,
+        .first_byte_ns = query->first_result_at ? query->first_result_at - sent : 0,
+        .total_ns = now - sent,
+        .timed_out = timed_out,
+    };
+
+    pg->timing_cb(pg, &timing, pg->timing_data);
+}
+
+static void mark_flushed(PGquery *pg)
+{
+    if (!pg->flushed_at)
+        pg->flushed_at = uv_hrtime();
+}
+
+static void on_deadline_closed(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void deadline_disarm(PGquery *pg)
+{
+    if (!pg->deadline_timer)
         return;
 
+    uv_timer_stop(pg->deadline_timer);
+    uv_close((uv_handle_t *)pg->deadline_timer, on_deadline_closed);
+    pg->deadline_timer = NULL;
+}
+
+// Ends the execution right away; the timed out query's callback gets a
+// NULL result, like any other query that could not be answered
+static void finish_timeout(PGquery *pg, pg_query_t *query)
+{
+    report_timing(pg, query, true);
+
+    pg->current_query = NULL;
+    pg->query_queue = NULL;
+    pg->query_queue_tail = NULL;
+    pg->is_executing = 0;
+    decrement_async_work();
+    cleanup_and_destroy(pg);
+
+    if (query && query->result_cb)
+        query->result_cb(pg, NULL, query->data);
+}
+
+static void on_deadline(uv_timer_t *handle)
+{
     PGquery *pg = (PGquery *)handle->data;
+    pg_query_t *query = pg->current_query ? pg->current_query : pg->query_queue;
 
-    if (!server_is_running()) {
-        uv_poll_stop(&pg->poll);
-        if (!uv_is_closing((uv_handle_t *)&pg->poll)) {
-            uv_close((uv_handle_t *)&pg->poll, on_handle_closed);
-        }
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
+    if (pg->timed_out)
+        return;
+
+    LOG_ERROR("Query timed out: %s", query ? query->sql : "");
+
+    // Still waiting for a pooled connection, nothing to cancel
+    if (pg->pool && !pg->pool_conn) {
+        pool_wait_remove(pg->pool, pg);
+        finish_timeout(pg, query);
+        return;
+    }
+
+    cancel_start(pg->conn);
+
+    // A pooled connection is replaced instead of waiting for the cancel
+    // to land, which also keeps it from hitting the next borrower
+    if (pg->pool_conn) {
+        pg->pool_conn->broken = 1;
+        watch_stop(pg);
+        finish_timeout(pg, query);
+        return;
+    }
+
+    // The caller's own connection has to be drained before it can be
+    // used again; process_input() finishes once the cancel took effect
+    pg->timed_out = 1;
+    pg->timed_out_query = query;
+}
+
+// Runs whenever a query becomes current, so its own timeout starts when
+// it is sent (or, in a pipeline, when the one before it completed)
+static void deadline_arm(PGquery *pg)
+{
+    if (pg->timed_out)
+        return;
+
+    uint64_t now = uv_now(get_loop());
+    uint64_t due = pg->deadline;
+    pg_query_t *query = pg->current_query;
+
+    if (query && query->timeout_ms) {
+        uint64_t query_due = now + query->timeout_ms;
+        if (!due || query_due < due)
+            due = query_due;
+    }
+
+    if (!due) {
+        if (pg->deadline_timer)
+            uv_timer_stop(pg->deadline_timer);
+        return;
+    }
+
+    if (!pg->deadline_timer) {
+        pg->deadline_timer = malloc(sizeof(uv_timer_t));
+        if (!pg->deadline_timer) {
+            LOG_ERROR("Failed to allocate deadline timer");
+            return;
+        }
+
+        uv_timer_init(get_loop(), pg->deadline_timer);
+        pg->deadline_timer->data = pg;
+    }
+
+    uv_timer_start(pg->deadline_timer, on_deadline, due > now ? due - now : 0, 0);
+}
+
+static void on_handle_closed(uv_handle_t *handle)
+{
+    if (!handle || !handle->data)
+        return;
+
+    PGquery *pg = (PGquery *)handle->data;
+    pg->handle_initialized = 0;
+#ifdef _WIN32
+    pg->use_timer = 0;
+#endif
+}
+
+static uv_handle_t *watch_handle(PGquery *pg)
+{
+#ifdef _WIN32
+    if (pg->use_timer)
+        return (uv_handle_t *)&pg->timer;
+#endif
+    return (uv_handle_t *)&pg->poll;
+}
+
+static void watch_close(PGquery *pg)
+{
+    uv_handle_t *handle = watch_handle(pg);
+
+    watch_stop(pg);
+    if (!uv_is_closing(handle)) {
+        uv_close(handle, on_handle_closed);
+    }
+}
+
+static void cancel_execution(PGquery *pg)
+{
+    if (!pg)
+        return;
+
+    if (pg->is_executing && pg->handle_initialized) {
+        watch_close(pg);
+    }
+
+    if (pg->conn && pg->is_executing)
+        cancel_start(pg->conn);
+
+    pg->is_executing = 0;
+}
+
+static void trace_finish(PGquery *pg)
+{
+    if (!pg->traced)
+        return;
+
+    pg->traced = 0;
+    metrics_trace_end(TRACE_SPAN, pg->span, pg->completed);
+}
+
+static void cleanup_and_destroy(PGquery *pg)
+{
+    if (!pg)
+        return;
+
+    trace_finish(pg);
+    deadline_disarm(pg);
+
+    if (pg->pool) {
+        pool_release(pg);
+        return;
+    }
+
+    cancel_execution(pg);
+    // PGquery is in the arena - caller manages its memory
+}
+
+static int watch_start(PGquery *pg, int events)
+{
+    if (pg->pool_conn)
+        return pool_conn_watch(pg->pool_conn, events);
+
+    if (!pg->handle_initialized) {
+        int sock = PQsocket(pg->conn);
+        if (sock < 0) {
+            LOG_ERROR("Invalid PostgreSQL socket");
+            return UV_EBADF;
+        }
+
+        int init_result = poll_init(&pg->poll, sock);
+#ifdef _WIN32
+        if (init_result != 0) {
+            // Not pollable through libuv, check libpq on a timer instead
+            init_result = uv_timer_init(get_loop(), &pg->timer);
+            pg->use_timer = init_result == 0;
+        }
+#endif
+        if (init_result != 0) {
+            LOG_ERROR("uv_poll_init failed: %s", uv_strerror(init_result));
+            return init_result;
+        }
+
+        pg->handle_initialized = 1;
+        pg->poll.data = pg;
+#ifdef _WIN32
+        pg->timer.data = pg;
+#endif
+    }
+
+#ifdef _WIN32
+    if (pg->use_timer) {
+        if (uv_is_active((uv_handle_t *)&pg->timer))
+            return 0;
+
+        int timer_result = uv_timer_start(&pg->timer, on_timer, POLL_INTERVAL_MS, POLL_INTERVAL_MS);
+        if (timer_result != 0)
+            LOG_ERROR("uv_timer_start failed: %s", uv_strerror(timer_result));
+
+        return timer_result;
+    }
+#endif
+
+    int start_result = uv_poll_start(&pg->poll, events, on_poll);
+    if (start_result != 0)
+        LOG_ERROR("uv_poll_start failed: %s", uv_strerror(start_result));
+
+    return start_result;
+}
+
+static void watch_stop(PGquery *pg)
+{
+    if (pg->pool_conn) {
+        pool_conn_unwatch(pg->pool_conn);
+        return;
+    }
+
+#ifdef _WIN32
+    if (pg->use_timer) {
+        uv_timer_stop(&pg->timer);
+        return;
+    }
+#endif
+
+    uv_poll_stop(&pg->poll);
+}
+
+// Nonblocking connections may keep part of the output buffered;
+// only ask for writability while there is something left to send
+static int flush_and_watch(PGquery *pg)
+{
+    int flushed = PQflush(pg->conn);
+    if (flushed < 0) {
+        LOG_ERROR("PQflush failed: %s", PQerrorMessage(pg->conn));
+        return -1;
+    }
+
+    if (flushed == 0)
+        mark_flushed(pg);
+
+    int events = flushed ? UV_READABLE | UV_WRITABLE : UV_READABLE;
+    return watch_start(pg, events) == 0 ? 0 : -1;
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+static void execute_pipeline(PGquery *pg);
+static void process_pipeline_input(PGquery *pg);
+#endif
+
+// Flushes pending output, reads the server's reply and hands every
+// complete result to its callback before moving on to the next query
+static void process_input(PGquery *pg, int events)
+{
+    if (events & UV_WRITABLE) {
+        int flushed = PQflush(pg->conn);
+        if (flushed < 0) {
+            LOG_ERROR("PQflush failed: %s", PQerrorMessage(pg->conn));
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            return;
+        }
+
+        if (flushed == 0)
+            mark_flushed(pg);
+
+        // Whole query is on the wire, only wait for the reply from now on
+        if (flushed == 0 && watch_start(pg, UV_READABLE) != 0) {
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            return;
+        }
+    }
+
+    if (!PQconsumeInput(pg->conn)) {
+        LOG_ERROR("PQconsumeInput failed: %s", PQerrorMessage(pg->conn));
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (PQpipelineStatus(pg->conn) != PQ_PIPELINE_OFF) {
+        process_pipeline_input(pg);
+        return;
+    }
+#endif
+
+    for (;;) {
+        // PQgetResult() would block here, wait for more input instead
+        if (PQisBusy(pg->conn))
+            return;
+
+        PGresult *result = PQgetResult(pg->conn);
+        if (!result)
+            break;
+
+        ExecStatusType result_status = PQresultStatus(result);
+
+        if (pg->current_query && !pg->current_query->first_result_at)
+            pg->current_query->first_result_at = uv_hrtime();
+
+        // After a timeout only the connection has to be drained; the
+        // cancel error is expected and handled once the result ends
+        if (pg->timed_out) {
+            PQclear(result);
+            continue;
+        }
+
+        if (!result_ok(result_status)) {
+            LOG_ERROR("Query failed: %s", PQresultErrorMessage(result));
+
+            // 26000: the statement is gone, prepare it again next time
+            const char *sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+            if (pg->current_query &&
+                (pg->step == STEP_PREPARE ||
+                 (sqlstate && strcmp(sqlstate, "26000") == 0))) {
+                stmt_cache_invalidate(query_stmt_cache(pg), pg->current_query);
+            }
+
+            PQclear(result);
+            watch_stop(pg);
+            report_timing(pg, pg->current_query, false);
+            pg->current_query = NULL;
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            return;
+        }
+
+        if (pg->step == STEP_EXECUTE && pg->current_query && pg->current_query->result_cb) {
+            pg->current_query->result_cb(pg, result, pg->current_query->data);
+        }
+
+        PQclear(result);
+    }
+
+    if (pg->timed_out) {
+        watch_stop(pg);
+        finish_timeout(pg, pg->timed_out_query);
+        return;
+    }
+
+    if (pg->step != STEP_EXECUTE && pg->current_query) {
+        pg->step = pg->step == STEP_DEALLOCATE ? STEP_PREPARE : STEP_EXECUTE;
+
+        if (!send_step(pg, pg->current_query, pg->step, 0)) {
+            LOG_ERROR("Failed to send query: %s", PQerrorMessage(pg->conn));
+            stmt_cache_invalidate(query_stmt_cache(pg), pg->current_query);
+            watch_stop(pg);
+            pg->current_query = NULL;
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            return;
+        }
+
+        if (pg->step == STEP_EXECUTE)
+            set_rows_mode(pg, pg->current_query);
+
+        if (flush_and_watch(pg) != 0) {
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+        }
+        return;
+    }
+
+    watch_stop(pg);
+    report_timing(pg, pg->current_query, false);
+    pg->current_query = NULL;
+    execute_next_query(pg);
+}
+
+#ifdef _WIN32
+static void on_timer(uv_timer_t *handle)
+{
+    if (!handle || !handle->data)
+        return;
+
+    PGquery *pg = (PGquery *)handle->data;
+
+    if (!server_is_running()) {
+        watch_close(pg);
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    process_input(pg, UV_READABLE | UV_WRITABLE);
+}
+#endif
+
+static void on_poll(uv_poll_t *handle, int status, int events)
+{
+    if (!handle || !handle->data)
+        return;
+
+    PGquery *pg = (PGquery *)handle->data;
+
+    if (!server_is_running()) {
+        watch_close(pg);
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    if (status < 0) {
+        LOG_ERROR("Poll error: %s", uv_strerror(status));
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    process_input(pg, events);
+}
+
+static void execute_next_query(PGquery *pg)
+{
+    if (!pg->query_queue) {
+        pg->completed = 1;
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    if (!server_is_running()) {
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (pg->pipeline) {
+        execute_pipeline(pg);
+        return;
+    }
+#endif
+
+    pg->current_query = pg->query_queue;
+    pg->query_queue = pg->query_queue->next;
+    if (!pg->query_queue) {
+        pg->query_queue_tail = NULL;
+    }
+
+    pg->sent_at = uv_hrtime();
+    pg->flushed_at = 0;
+    pg->current_query->first_result_at = 0;
+    deadline_arm(pg);
+
+    pg->step = stmt_plan(query_stmt_cache(pg), pg->current_query, &pg->evicted_id);
+
+    if (!send_step(pg, pg->current_query, pg->step, pg->evicted_id)) {
+        LOG_ERROR("Failed to send query: %s", PQerrorMessage(pg->conn));
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    if (pg->step == STEP_EXECUTE)
+        set_rows_mode(pg, pg->current_query);
+
+    if (flush_and_watch(pg) != 0) {
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+// Sends the whole queue at once. Every segment ends with a sync point,
+// so an error only aborts the queries up to the next sync
+static void execute_pipeline(PGquery *pg)
+{
+    if (PQpipelineStatus(pg->conn) == PQ_PIPELINE_OFF && !PQenterPipelineMode(pg->conn)) {
+        LOG_ERROR("Failed to enter pipeline mode: %s", PQerrorMessage(pg->conn));
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+
+    // Queries queued from result callbacks form the next batch
+    pg->current_query = pg->query_queue;
+    pg->query_queue = NULL;
+    pg->query_queue_tail = NULL;
+    pg->pending_syncs = 0;
+    pg->query_started = 0;
+    pg->sent_at = uv_hrtime();
+    pg->flushed_at = 0;
+    deadline_arm(pg);
+
+    for (pg_query_t *query = pg->current_query; query; query = query->next) {
+        query->first_result_at = 0;
+
+        uint32_t evicted_id;
+        query_step_t step = stmt_plan(query_stmt_cache(pg), query, &evicted_id);
+        int sent = 1;
+
+        // Statement preparation is pipelined too; its results are
+        // consumed without reaching the callback
+        query->skip_groups = 0;
+        if (step == STEP_DEALLOCATE) {
+            sent = send_step(pg, query, STEP_DEALLOCATE, evicted_id);
+            query->skip_groups++;
+        }
+        if (sent && step != STEP_EXECUTE) {
+            sent = send_step(pg, query, STEP_PREPARE, 0);
+            query->skip_groups++;
+        }
+        if (sent)
+            sent = send_step(pg, query, STEP_EXECUTE, 0);
+
+        if (!sent) {
+            LOG_ERROR("Failed to send query: %s", PQerrorMessage(pg->conn));
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            return;
+        }
+
+        if (query->sync_after || !query->next) {
+            if (!PQpipelineSync(pg->conn)) {
+                LOG_ERROR("PQpipelineSync failed: %s", PQerrorMessage(pg->conn));
+                pg->is_executing = 0;
+                decrement_async_work();
+                cleanup_and_destroy(pg);
+                return;
+            }
+            pg->pending_syncs++;
+        }
+    }
+
+    if (pg->current_query->skip_groups == 0)
+        set_rows_mode(pg, pg->current_query);
+
+    if (flush_and_watch(pg) != 0) {
+        pg->is_executing = 0;
+        decrement_async_work();
+        cleanup_and_destroy(pg);
+        return;
+    }
+}
+
+static void process_pipeline_input(PGquery *pg)
+{
+    for (;;) {
+        if (PQisBusy(pg->conn))
+            return;
+
+        PGresult *result = PQgetResult(pg->conn);
+
+        if (!result) {
+            // NULL ends the results of one command
+            if (pg->query_started && pg->current_query) {
+                if (pg->current_query->skip_groups > 0) {
+                    pg->current_query->skip_groups--;
+                } else {
+                    if (!pg->timed_out)
+                        report_timing(pg, pg->current_query, false);
+                    pg->current_query = pg->current_query->next;
+                    deadline_arm(pg);
+                }
+                pg->query_started = 0;
+
+                if (pg->current_query && pg->current_query->skip_groups == 0)
+                    set_rows_mode(pg, pg->current_query);
+            }
+            continue;
+        }
+
+        ExecStatusType result_status = PQresultStatus(result);
+
+        if (result_status != PGRES_PIPELINE_SYNC &&
+            pg->current_query && !pg->current_query->first_result_at)
+            pg->current_query->first_result_at = uv_hrtime();
+
+        if (result_status != PGRES_PIPELINE_SYNC &&
+            pg->current_query && pg->current_query->skip_groups > 0) {
+            pg->query_started = 1;
+            if (result_status != PGRES_COMMAND_OK) {
+                if (result_status != PGRES_PIPELINE_ABORTED)
+                    LOG_ERROR("Query failed: %s", PQresultErrorMessage(result));
+                stmt_cache_invalidate(query_stmt_cache(pg), pg->current_query);
+            }
+            PQclear(result);
+            continue;
+        }
+
+        switch (result_status) {
+        case PGRES_PIPELINE_SYNC:
+            PQclear(result);
+            if (--pg->pending_syncs > 0) {
+                if (pg->current_query && pg->current_query->skip_groups == 0)
+                    set_rows_mode(pg, pg->current_query);
+                continue;
+            }
+
+            watch_stop(pg);
+            pg->current_query = NULL;
+
+            if (!PQexitPipelineMode(pg->conn)) {
+                LOG_ERROR("Failed to exit pipeline mode: %s", PQerrorMessage(pg->conn));
+                pg->is_executing = 0;
+                decrement_async_work();
+                cleanup_and_destroy(pg);
+                return;
+            }
+
+            if (pg->timed_out) {
+                finish_timeout(pg, pg->timed_out_query);
+                return;
+            }
+
+            execute_next_query(pg);
+            return;
+
+        case PGRES_PIPELINE_ABORTED:
+            // Skipped because an earlier query in the segment failed
+            pg->query_started = 1;
+            break;
+
+        case PGRES_TUPLES_OK:
+        case PGRES_COMMAND_OK:
+        case PGRES_SINGLE_TUPLE:
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        case PGRES_TUPLES_CHUNK:
+#endif
+            pg->query_started = 1;
+            if (!pg->timed_out && pg->current_query && pg->current_query->result_cb) {
+                pg->current_query->result_cb(pg, result, pg->current_query->data);
+            }
+            break;
+
+        default: {
+            pg->query_started = 1;
+            if (!pg->timed_out)
+                LOG_ERROR("Query failed: %s", PQresultErrorMessage(result));
+
+            const char *sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+            if (pg->current_query && sqlstate && strcmp(sqlstate, "26000") == 0) {
+                stmt_cache_invalidate(query_stmt_cache(pg), pg->current_query);
+            }
+            break;
+        }
+        }
+
+        PQclear(result);
+    }
+}
+#endif
+
+// ============================================================================
+// CONNECTION POOL
+// ============================================================================
+
+static void pool_conn_connect(pool_conn_t *pc);
+static void pool_conn_io(pool_conn_t *pc, int events);
+
+static void on_pool_conn_timer(uv_timer_t *handle)
+{
+    pool_conn_t *pc = (pool_conn_t *)handle->data;
+
+    if (pc->state == POOL_CONN_RETRY) {
+        pool_conn_connect(pc);
+        return;
+    }
+
+#ifdef _WIN32
+    if (pc->use_timer)
+        pool_conn_io(pc, UV_READABLE | UV_WRITABLE);
+#endif
+}
+
+static void on_pool_poll_closed(uv_handle_t *handle)
+{
+    free(handle);
+}
+
+static void on_pool_conn_poll(uv_poll_t *handle, int status, int events)
+{
+    pool_conn_t *pc = (pool_conn_t *)handle->data;
+
+    if (status < 0) {
+        LOG_ERROR("Pool poll error: %s", uv_strerror(status));
+        events = UV_READABLE | UV_WRITABLE;
+        pc->broken = 1;
+    }
+
+    pool_conn_io(pc, events);
+}
+
+static void pool_conn_drop_poll(pool_conn_t *pc)
+{
+    if (!pc->poll)
+        return;
+
+    uv_poll_stop(pc->poll);
+    uv_close((uv_handle_t *)pc->poll, on_pool_poll_closed);
+    pc->poll = NULL;
+    pc->poll_fd = -1;
+}
+
+static int pool_conn_watch(pool_conn_t *pc, int events)
+{
+#ifdef _WIN32
+    if (pc->use_timer) {
+        if (uv_is_active((uv_handle_t *)&pc->timer))
+            return 0;
+
+        return uv_timer_start(&pc->timer, on_pool_conn_timer, POLL_INTERVAL_MS, POLL_INTERVAL_MS);
+    }
+#endif
+
+    int sock = PQsocket(pc->conn);
+    if (sock < 0) {
+        LOG_ERROR("Invalid PostgreSQL socket");
+        return UV_EBADF;
+    }
+
+    if (pc->poll && pc->poll_fd != sock) {
+        pool_conn_drop_poll(pc);
+    } else if (pc->poll && pc->state == POOL_CONN_CONNECTING) {
+        // libpq may have closed and reopened the same descriptor number
+        // on a new address; re-register it instead of modifying it
+        uv_poll_stop(pc->poll);
+    }
+
+    if (!pc->poll) {
+        pc->poll = malloc(sizeof(uv_poll_t));
+        if (!pc->poll)
+            return UV_ENOMEM;
+
+        int init_result = poll_init(pc->poll, sock);
+        if (init_result != 0) {
+            free(pc->poll);
+            pc->poll = NULL;
+#ifdef _WIN32
+            // Not pollable through libuv, check libpq on the timer instead
+            pc->use_timer = 1;
+            return uv_timer_start(&pc->timer, on_pool_conn_timer, POLL_INTERVAL_MS, POLL_INTERVAL_MS);
+#else
+            return init_result;
+#endif
+        }
+
+        // Pooled connections must not keep the loop alive on their own
+        uv_unref((uv_handle_t *)pc->poll);
+        pc->poll->data = pc;
+        pc->poll_fd = sock;
+    }
+
+    return uv_poll_start(pc->poll, events, on_pool_conn_poll);
+}
+
+static void pool_conn_unwatch(pool_conn_t *pc)
+{
+#ifdef _WIN32
+    if (pc->use_timer) {
+        uv_timer_stop(&pc->timer);
+        return;
+    }
+#endif
+
+    if (pc->poll)
+        uv_poll_stop(pc->poll);
+}
+
+static void pool_conn_close(pool_conn_t *pc)
+{
+#ifdef _WIN32
+    if (pc->use_timer)
+        uv_timer_stop(&pc->timer);
+    pc->use_timer = 0;
+#endif
+
+    // The socket must not be closed while it is still being polled
+    pool_conn_drop_poll(pc);
+
+    if (pc->conn) {
+        PQfinish(pc->conn);
+        pc->conn = NULL;
+    }
+
+    // Prepared statements belong to the session that was just closed
+    stmt_cache_clear(&pc->stmts);
+    pc->broken = 0;
+}
+
+static void on_pool_conn_closed(uv_handle_t *handle)
+{
+    pool_conn_t *pc = (pool_conn_t *)handle->data;
+    stmt_cache_free(&pc->stmts);
+    free(pc);
+}
+
+static void pool_conn_destroy(pool_conn_t *pc)
+{
+    pg_pool_t *pool = pc->pool;
+
+    for (pool_conn_t **link = &pool->conns; *link; link = &(*link)->next) {
+        if (*link == pc) {
+            *link = pc->next;
+            pool->size--;
+            break;
+        }
+    }
+
+    pool_conn_close(pc);
+    uv_timer_stop(&pc->timer);
+    uv_close((uv_handle_t *)&pc->timer, on_pool_conn_closed);
+}
+
+static void pool_idle_remove(pg_pool_t *pool, pool_conn_t *pc)
+{
+    for (pool_conn_t **link = &pool->idle; *link; link = &(*link)->idle_next) {
+        if (*link == pc) {
+            *link = pc->idle_next;
+            pc->idle_next = NULL;
+            return;
+        }
+    }
+}
+
+static void pool_wait_remove(pg_pool_t *pool, PGquery *pg)
+{
+    PGquery *prev = NULL;
+    for (PGquery *it = pool->wait_head; it; prev = it, it = it->wait_next) {
+        if (it != pg)
+            continue;
+
+        if (prev)
+            prev->wait_next = it->wait_next;
+        else
+            pool->wait_head = it->wait_next;
+        if (pool->wait_tail == it)
+            pool->wait_tail = prev;
+
+        pool->wait_count--;
+        metrics_gauge_add(pg_metrics.pool_waiting, -1);
+        it->wait_next = NULL;
+        return;
+    }
+}
+
+static int pool_count(const pg_pool_t *pool, pool_conn_state_t state)
+{
+    int count = 0;
+    for (const pool_conn_t *pc = pool->conns; pc; pc = pc->next) {
+        if (pc->state == state)
+            count++;
+    }
+    return count;
+}
+
+// Queries that can no longer be served get a NULL result, the same way
+// callers already have to handle a missing result
+static void pool_fail_waiters(pg_pool_t *pool)
+{
+    PGquery *pg = pool->wait_head;
+
+    pool->wait_head = NULL;
+    pool->wait_tail = NULL;
+    metrics_gauge_add(pg_metrics.pool_waiting, -(int64_t)pool->wait_count);
+    pool->wait_count = 0;
+
+    while (pg) {
+        PGquery *next = pg->wait_next;
+        pg_query_t *query = pg->query_queue;
+
+        deadline_disarm(pg);
+        pg->wait_next = NULL;
+        pg->query_queue = NULL;
+        pg->query_queue_tail = NULL;
+        pg->is_executing = 0;
+        decrement_async_work();
+        trace_finish(pg);
+
+        if (query && query->result_cb)
+            query->result_cb(pg, NULL, query->data);
+
+        pg = next;
+    }
+}
+
+static void pool_dispatch(pool_conn_t *pc, PGquery *pg)
+{
+    pc->state = POOL_CONN_BUSY;
+    pc->query = pg;
+    pg->pool_conn = pc;
+    pg->conn = pc->conn;
+
+    pool_conn_unwatch(pc);
+    execute_next_query(pg);
+}
+
+// Hands a ready connection to the oldest waiter, or parks it as idle
+static void pool_conn_put(pool_conn_t *pc)
+{
+    pg_pool_t *pool = pc->pool;
+    PGquery *pg = pool->wait_head;
+
+    if (pg) {
+        pool->wait_head = pg->wait_next;
+        if (!pool->wait_head)
+            pool->wait_tail = NULL;
+        pool->wait_count--;
+        metrics_gauge_add(pg_metrics.pool_waiting, -1);
+        pg->wait_next = NULL;
+
+        pool_dispatch(pc, pg);
+        return;
+    }
+
+    pc->state = POOL_CONN_IDLE;
+    pc->query = NULL;
+    pc->last_used = uv_now(get_loop());
+    pc->idle_next = pool->idle;
+    pool->idle = pc;
+
+#ifdef _WIN32
+    // The timer fallback leaves idle connections to the reaper
+    if (pc->use_timer) {
+        uv_timer_stop(&pc->timer);
+        return;
+    }
+#endif
+
+    // Watch idle sockets so a server-side close is noticed right away
+    int watch_result = pool_conn_watch(pc, UV_READABLE);
+    if (watch_result != 0)
+        LOG_ERROR("Pool idle watch failed: %s", uv_strerror(watch_result));
+}
+
+static void pool_conn_failed(pool_conn_t *pc)
+{
+    pg_pool_t *pool = pc->pool;
+
+    pool_conn_close(pc);
+
+    if (pool->closing || pool->size > pool->min_size) {
+        pool_conn_destroy(pc);
+    } else {
+        pc->state = POOL_CONN_RETRY;
+        uv_timer_start(&pc->timer, on_pool_conn_timer, pool->reconnect_delay_ms, 0);
+    }
+
+    if (pool->wait_head &&
+        pool_count(pool, POOL_CONN_IDLE) + pool_count(pool, POOL_CONN_BUSY) +
+        pool_count(pool, POOL_CONN_CONNECTING) == 0) {
+        pool_fail_waiters(pool);
+    }
+}
+
+static void pool_conn_ready(pool_conn_t *pc)
+{
+    if (PQsetnonblocking(pc->conn, 1) != 0) {
+        LOG_ERROR("Failed to set pool connection to nonblocking mode");
+        pool_conn_failed(pc);
+        return;
+    }
+
+    pool_conn_put(pc);
+}
+
+static void pool_conn_connect(pool_conn_t *pc)
+{
+    pc->state = POOL_CONN_CONNECTING;
+    pc->conn = PQconnectStart(pc->pool->conninfo);
+
+    if (!pc->conn || PQstatus(pc->conn) == CONNECTION_BAD) {
+        LOG_ERROR("Pool connection failed: %s",
+                  pc->conn ? PQerrorMessage(pc->conn) : "out of memory");
+        pool_conn_failed(pc);
+        return;
+    }
+
+    // libpq: start as if PQconnectPoll() had returned PGRES_POLLING_WRITING
+    int watch_result = pool_conn_watch(pc, UV_WRITABLE);
+    if (watch_result != 0) {
+        LOG_ERROR("Pool connection watch failed: %s", uv_strerror(watch_result));
+        pool_conn_failed(pc);
+    }
+}
+
+static void pool_conn_continue_connect(pool_conn_t *pc)
+{
+    int watch_result;
+
+    switch (PQconnectPoll(pc->conn)) {
+    case PGRES_POLLING_READING:
+        watch_result = pool_conn_watch(pc, UV_READABLE);
+        break;
+    case PGRES_POLLING_WRITING:
+        watch_result = pool_conn_watch(pc, UV_WRITABLE);
+        break;
+    case PGRES_POLLING_OK:
+        pool_conn_ready(pc);
+        return;
+    default:
+        LOG_ERROR("Pool connection failed: %s", PQerrorMessage(pc->conn));
+        pool_conn_failed(pc);
+        return;
+    }
+
+    if (watch_result != 0) {
+        LOG_ERROR("Pool connection watch failed: %s", uv_strerror(watch_result));
+        pool_conn_failed(pc);
+    }
+}
+
+// Drops a broken connection and immediately dials a replacement;
+// pool_conn_failed() applies the reconnect delay if that fails too
+static void pool_conn_reset(pool_conn_t *pc)
+{
+    pool_conn_close(pc);
+    pool_conn_connect(pc);
+}
+
+static void pool_conn_check_idle(pool_conn_t *pc)
+{
+    if (PQconsumeInput(pc->conn) && PQstatus(pc->conn) == CONNECTION_OK) {
+        PGnotify *notify;
+        while ((notify = PQnotifies(pc->conn)) != NULL)
+            PQfreemem(notify);
+        return;
+    }
+
+    LOG_ERROR("Pool connection lost: %s", PQerrorMessage(pc->conn));
+    pool_idle_remove(pc->pool, pc);
+    pool_conn_reset(pc);
+}
+
+static void pool_conn_io(pool_conn_t *pc, int events)
+{
+    switch (pc->state) {
+    case POOL_CONN_CONNECTING:
+        pool_conn_continue_connect(pc);
+        break;
+
+    case POOL_CONN_IDLE:
+        pool_conn_check_idle(pc);
+        break;
+
+    case POOL_CONN_BUSY: {
+        PGquery *pg = pc->query;
+        if (!pg)
+            break;
+
+        if (!server_is_running() || pc->broken) {
+            pg->is_executing = 0;
+            decrement_async_work();
+            cleanup_and_destroy(pg);
+            break;
+        }
+
+        process_input(pg, events);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+// A connection is only reused if it is back at a clean idle state;
+// anything else (lost socket, unfinished result, open transaction) is
+// replaced, which also makes the server roll back what was left open
+static int pool_conn_reusable(pool_conn_t *pc)
+{
+    if (pc->broken || PQstatus(pc->conn) != CONNECTION_OK)
+        return 0;
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (PQpipelineStatus(pc->conn) != PQ_PIPELINE_OFF)
+        return 0;
+#endif
+
+    PGresult *result;
+    while (!PQisBusy(pc->conn) && (result = PQgetResult(pc->conn)) != NULL)
+        PQclear(result);
+
+    return PQtransactionStatus(pc->conn) == PQTRANS_IDLE;
+}
+
+static void pool_release(PGquery *pg)
+{
+    pool_conn_t *pc = pg->pool_conn;
+    if (!pc)
+        return;
+
+    pg->pool_conn = NULL;
+    pg->conn = NULL;
+    pc->query = NULL;
+    pool_conn_unwatch(pc);
+
+    if (!pool_conn_reusable(pc)) {
+        pool_conn_reset(pc);
         return;
     }
 
-    if (status < 0) {
-        LOG_ERROR("Poll error: %s", uv_strerror(status));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    pool_conn_put(pc);
+}
+
+static int pool_conn_spawn(pg_pool_t *pool)
+{
+    pool_conn_t *pc = calloc(1, sizeof(pool_conn_t));
+    if (!pc) {
+        LOG_ERROR("pool: Failed to allocate connection");
+        return -1;
     }
 
-    if (!PQconsumeInput(pg->conn)) {
-        LOG_ERROR("PQconsumeInput failed: %s", PQerrorMessage(pg->conn));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    pc->pool = pool;
+    pc->poll_fd = -1;
+
+    if (stmt_cache_init(&pc->stmts, pool->statement_cache_size) != 0) {
+        LOG_ERROR("pool: Failed to allocate statement cache");
+        free(pc);
+        return -1;
     }
 
-    if (PQisBusy(pg->conn))
-        return;
+    int init_result = uv_timer_init(get_loop(), &pc->timer);
+    if (init_result != 0) {
+        LOG_ERROR("pool: uv_timer_init failed: %s", uv_strerror(init_result));
+        stmt_cache_free(&pc->stmts);
+        free(pc);
+        return -1;
+    }
 
-    uv_poll_stop(&pg->poll);
+    uv_unref((uv_handle_t *)&pc->timer);
+    pc->timer.data = pc;
 
-    PGresult *result;
-    while ((result = PQgetResult(pg->conn)) != NULL) {
-        ExecStatusType result_status = PQresultStatus(result);
+    pc->next = pool->conns;
+    pool->conns = pc;
+    pool->size++;
 
-        if (result_status != PGRES_TUPLES_OK && result_status != PGRES_COMMAND_OK) {
-            LOG_ERROR("Query failed: %s", PQresultErrorMessage(result));
-            PQclear(result);
-            pg->current_query = NULL;
-            pg->is_executing = 0;
-            decrement_async_work();
-            cleanup_and_destroy(pg);
-            return;
-        }
+    pool_conn_connect(pc);
+    return 0;
+}
 
-        if (pg->current_query && pg->current_query->result_cb) {
-            pg->current_query->result_cb(pg, result, pg->current_query->data);
+static void pool_acquire(PGquery *pg)
+{
+    pg_pool_t *pool = pg->pool;
+    pool_conn_t *pc = pool->idle;
+    if (pc) {
+        pool->idle = pc->idle_next;
+        pc->idle_next = NULL;
+        pool_dispatch(pc, pg);
+        return;
+    }
+
+    pg->wait_next = NULL;
+    if (pool->wait_tail)
+        pool->wait_tail->wait_next = pg;
+    else
+        pool->wait_head = pg;
+    pool->wait_tail = pg;
+    pool->wait_count++;
+    metrics_gauge_add(pg_metrics.pool_waiting, 1);
+
+    // Grow only as far as there are waiters not already covered by a
+    // connection that is still being established
+    if (pool->size < pool->max_size &&
+        pool_count(pool, POOL_CONN_CONNECTING) < pool->wait_count) {
+        if (pool_conn_spawn(pool) != 0 && pool->size == 0)
+            pool_fail_waiters(pool);
+    }
+}
+
+static void on_pool_reap(uv_timer_t *handle)
+{
+    pg_pool_t *pool = (pg_pool_t *)handle->data;
+    uint64_t now = uv_now(get_loop());
+
+    pool_conn_t *pc = pool->conns;
+    while (pc) {
+        pool_conn_t *next = pc->next;
+
+        if (pc->state == POOL_CONN_IDLE) {
+            if (pool->idle_timeout_ms &&
+                pool->size > pool->min_size &&
+                now - pc->last_used >= pool->idle_timeout_ms) {
+                pool_idle_remove(pool, pc);
+                pool_conn_destroy(pc);
+            } else {
+                pool_conn_check_idle(pc);
+            }
         }
 
-        PQclear(result);
+        pc = next;
     }
+}
 
-    pg->current_query = NULL;
-    execute_next_query(pg);
+static void on_pool_closed(uv_handle_t *handle)
+{
+    pg_pool_t *pool = (pg_pool_t *)handle->data;
+    free(pool->conninfo);
+    free(pool);
 }
-#endif
 
-static void execute_next_query(PGquery *pg)
+pg_pool_t *pg_pool_create(const PGPool *config)
 {
-    if (!pg->query_queue) {
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    if (!config || !config->conninfo) {
+        LOG_ERROR("pg_pool_create: conninfo is required");
+        return NULL;
     }
 
-    if (!server_is_running()) {
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
-    }
+    pg_metrics_register();
 
-    pg->current_query = pg->query_queue;
-    pg->query_queue = pg->query_queue->next;
-    if (!pg->query_queue) {
-        pg->query_queue_tail = NULL;
-    }
+    int max_size = config->max_size > 0 ? config->max_size : POOL_DEFAULT_MAX_SIZE;
+    int min_size = config->min_size > 0 ? config->min_size : 0;
 
-    int result;
-    if (pg->current_query->param_count > 0) {
-        result = PQsendQueryParams(
-            pg->conn,
-            pg->current_query->sql,
-            pg->current_query->param_count,
-            NULL,
-            (const char **)pg->current_query->params,
-            NULL,
-            NULL,
-            0);
-    } else {
-        result = PQsendQuery(pg->conn, pg->current_query->sql);
+    // Every worker process builds its own pool, so the configured
+    // limits are what the whole cluster may open against the server
+    if (config->workers > 1) {
+        max_size /= config->workers;
+        min_size /= config->workers;
+        if (max_size < 1)
+            max_size = 1;
     }
 
-    if (!result) {
-        LOG_ERROR("Failed to send query: %s", PQerrorMessage(pg->conn));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    if (min_size > max_size)
+        min_size = max_size;
+
+    pg_pool_t *pool = calloc(1, sizeof(pg_pool_t));
+    if (!pool) {
+        LOG_ERROR("pg_pool_create: Failed to allocate pool");
+        return NULL;
     }
 
-#ifdef _WIN32
-    if (!pg->handle_initialized) {
-        int init_result = uv_timer_init(get_loop(), &pg->timer);
-        if (init_result != 0) {
-            LOG_ERROR("uv_timer_init failed: %s", uv_strerror(init_result));
-            pg->is_executing = 0;
-            decrement_async_work();
-            cleanup_and_destroy(pg);
-            return;
-        }
-        pg->handle_initialized = 1;
-        pg->timer.data = pg;
+    size_t len = strlen(config->conninfo);
+    pool->conninfo = malloc(len + 1);
+    if (!pool->conninfo) {
+        LOG_ERROR("pg_pool_create: Failed to copy conninfo");
+        free(pool);
+        return NULL;
+    }
+    memcpy(pool->conninfo, config->conninfo, len + 1);
+
+    pool->min_size = min_size;
+    pool->max_size = max_size;
+    pool->idle_timeout_ms = config->idle_timeout_ms;
+    pool->reconnect_delay_ms = config->reconnect_delay_ms
+                                   ? config->reconnect_delay_ms
+                                   : POOL_DEFAULT_RECONNECT_DELAY_MS;
+    pool->statement_cache_size = config->statement_cache_size > 0
+                                     ? config->statement_cache_size
+                                     : POOL_DEFAULT_STATEMENT_CACHE;
+
+    int init_result = uv_timer_init(get_loop(), &pool->reaper);
+    if (init_result != 0) {
+        LOG_ERROR("pg_pool_create: uv_timer_init failed: %s", uv_strerror(init_result));
+        free(pool->conninfo);
+        free(pool);
+        return NULL;
     }
 
-    int start_result = uv_timer_start(&pg->timer, on_timer, 10, 10);
-    if (start_result != 0) {
-        LOG_ERROR("uv_timer_start failed: %s", uv_strerror(start_result));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    pool->reaper.data = pool;
+    uv_unref((uv_handle_t *)&pool->reaper);
+
+    uint64_t interval = POOL_HEALTH_INTERVAL_MS;
+    if (pool->idle_timeout_ms && pool->idle_timeout_ms / 2 < interval)
+        interval = pool->idle_timeout_ms / 2 ? pool->idle_timeout_ms / 2 : 1;
+    uv_timer_start(&pool->reaper, on_pool_reap, interval, interval);
+
+    for (int i = 0; i < min_size; i++) {
+        if (pool_conn_spawn(pool) != 0)
+            break;
     }
-#else
-    int sock = PQsocket(pg->conn);
 
-    if (sock < 0) {
-        LOG_ERROR("Invalid PostgreSQL socket");
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
+    return pool;
+}
+
+void pg_pool_destroy(pg_pool_t *pool)
+{
+    if (!pool || pool->closing)
         return;
-    }
 
-    if (!pg->handle_initialized) {
-        int init_result = uv_poll_init(get_loop(), &pg->poll, sock);
-        if (init_result != 0) {
-            LOG_ERROR("uv_poll_init failed: %s", uv_strerror(init_result));
+    pool->closing = 1;
+    pool_fail_waiters(pool);
+
+    while (pool->conns) {
+        pool_conn_t *pc = pool->conns;
+        PGquery *pg = pc->query;
+
+        if (pg) {
+            deadline_disarm(pg);
+            pc->query = NULL;
+            pg->pool_conn = NULL;
+            pg->conn = NULL;
+            pg->current_query = NULL;
             pg->is_executing = 0;
             decrement_async_work();
-            cleanup_and_destroy(pg);
-            return;
         }
 
-        pg->handle_initialized = 1;
-        pg->poll.data = pg;
+        pool->idle = NULL;
+        pool_conn_destroy(pc);
     }
 
-    int start_result = uv_poll_start(&pg->poll, UV_READABLE | UV_WRITABLE, on_poll);
-    if (start_result != 0) {
-        LOG_ERROR("uv_poll_start failed: %s", uv_strerror(start_result));
-        pg->is_executing = 0;
-        decrement_async_work();
-        cleanup_and_destroy(pg);
-        return;
+    uv_timer_stop(&pool->reaper);
+    uv_close((uv_handle_t *)&pool->reaper, on_pool_closed);
+}
+
+PGquery *query_create_pooled(pg_pool_t *pool, Arena *arena)
+{
+    if (!pool || !arena) {
+        LOG_ERROR("query_create_pooled failed: pool or arena is NULL");
+        return NULL;
     }
-#endif
+
+    if (pool->closing) {
+        LOG_ERROR("query_create_pooled failed: Pool is closing");
+        return NULL;
+    }
+
+    PGquery *pg = arena_alloc(arena, sizeof(PGquery));
+    if (!pg) {
+        LOG_ERROR("query_create_pooled failed: Failed to allocate from arena");
+        return NULL;
+    }
+
+    memset(pg, 0, sizeof(PGquery));
+    pg->pool = pool;
+    pg->arena = arena;
+    pg->is_connected = 1;
+
+    return pg;
 }
 
 PGquery *query_create(PGconn *conn, Arena *arena)
@@ -348,31 +2100,30 @@ PGquery *query_create(PGconn *conn, Arena *arena)
     pg->query_queue_tail = NULL;
     pg->current_query = NULL;
 
+    pg->poll.data = pg;
 #ifdef _WIN32
     pg->timer.data = pg;
-#else
-    pg->poll.data = pg;
 #endif
 
     return pg;
 }
 
-int query_queue(PGquery *pg,
-                const char *sql,
-                int param_count,
-                const char **params,
-                pg_result_cb_t result_cb,
-                void *query_data)
+static pg_query_t *queue_query(PGquery *pg,
+                               const char *sql,
+                               int param_count,
+                               const char **params,
+                               pg_result_cb_t result_cb,
+                               void *query_data)
 {
     if (!pg || !sql) {
-        LOG_ERROR("query_queue: Invalid parameters");        
-        return -1;
+        LOG_ERROR("query_queue: Invalid parameters");
+        return NULL;
     }
 
     pg_query_t *query = arena_alloc(pg->arena, sizeof(pg_query_t));
     if (!query) {
         LOG_ERROR("query_queue: Failed to allocate query");
-        return -1;
+        return NULL;
     }
 
     memset(query, 0, sizeof(pg_query_t));
@@ -381,14 +2132,14 @@ int query_queue(PGquery *pg,
     query->sql = arena_strdup(pg->arena, sql);
     if (!query->sql) {
         LOG_ERROR("query_queue: Failed to copy SQL");
-        return -1;
+        return NULL;
     }
 
     if (param_count > 0 && params) {
         query->params = arena_alloc(pg->arena, param_count * sizeof(char *));
         if (!query->params) {
             LOG_ERROR("query_queue: Failed to allocate params");
-            return -1;
+            return NULL;
         }
 
         for (int i = 0; i < param_count; i++) {
@@ -396,7 +2147,7 @@ int query_queue(PGquery *pg,
                 query->params[i] = arena_strdup(pg->arena, params[i]);
                 if (!query->params[i]) {
                     LOG_ERROR("query_queue: Failed to allocate a param");
-                    return -1;
+                    return NULL;
                 }
             } else {
                 query->params[i] = NULL;
@@ -409,6 +2160,7 @@ int query_queue(PGquery *pg,
     query->param_count = param_count;
     query->result_cb = result_cb;
     query->data = query_data;
+    query->queued_at = uv_hrtime();
 
     if (!pg->query_queue) {
         pg->query_queue = pg->query_queue_tail = query;
@@ -417,6 +2169,182 @@ int query_queue(PGquery *pg,
         pg->query_queue_tail = query;
     }
 
+    return query;
+}
+
+int query_queue(PGquery *pg,
+                const char *sql,
+                int param_count,
+                const char **params,
+                pg_result_cb_t result_cb,
+                void *query_data)
+{
+    return queue_query(pg, sql, param_count, params, result_cb, query_data) ? 0 : -1;
+}
+
+int query_queue_prepared(PGquery *pg,
+                         const char *sql,
+                         int param_count,
+                         const char **params,
+                         pg_result_cb_t result_cb,
+                         void *query_data)
+{
+    pg_query_t *query = queue_query(pg, sql, param_count, params, result_cb, query_data);
+    if (!query)
+        return -1;
+
+    query->prepared = 1;
+    return 0;
+}
+
+int query_queue_params(PGquery *pg,
+                       const char *sql,
+                       int param_count,
+                       const PGparam *params,
+                       int flags,
+                       pg_result_cb_t result_cb,
+                       void *query_data)
+{
+    if (!pg || !sql || param_count < 0 || (param_count > 0 && !params)) {
+        LOG_ERROR("query_queue_params: Invalid parameters");
+        return -1;
+    }
+
+    char **values = NULL;
+    Oid *types = NULL;
+    int *lengths = NULL;
+    int *formats = NULL;
+
+    // One block for the four arrays libpq expects
+    if (param_count > 0) {
+        size_t block = (size_t)param_count * (sizeof(char *) + sizeof(Oid) + 2 * sizeof(int));
+        char *mem = arena_alloc(pg->arena, block);
+        if (!mem) {
+            LOG_ERROR("query_queue_params: Failed to allocate params");
+            return -1;
+        }
+
+        values = (char **)mem;
+        types = (Oid *)(values + param_count);
+        lengths = (int *)(types + param_count);
+        formats = lengths + param_count;
+
+        for (int i = 0; i < param_count; i++) {
+            types[i] = params[i].type;
+            lengths[i] = params[i].length;
+            formats[i] = params[i].format;
+
+            // Copied like query_queue() does, binary values by their length
+            values[i] = NULL;
+            if (!params[i].value)
+                continue;
+
+            if (params[i].format == 1) {
+                if (params[i].length < 0) {
+                    LOG_ERROR("query_queue_params: Binary param %d has a negative length", i + 1);
+                    return -1;
+                }
+
+                values[i] = arena_alloc(pg->arena, params[i].length ? (size_t)params[i].length : 1);
+                if (values[i])
+                    memcpy(values[i], params[i].value, (size_t)params[i].length);
+            } else {
+                values[i] = arena_strdup(pg->arena, params[i].value);
+            }
+
+            if (!values[i]) {
+                LOG_ERROR("query_queue_params: Failed to allocate a param");
+                return -1;
+            }
+        }
+    }
+
+    pg_query_t *query = queue_query(pg, sql, 0, NULL, result_cb, query_data);
+    if (!query)
+        return -1;
+
+    query->params = values;
+    query->param_count = param_count;
+    query->types = types;
+    query->lengths = lengths;
+    query->formats = formats;
+    query->result_format = (flags & PG_RESULT_BINARY) ? 1 : 0;
+    query->prepared = (flags & PG_PREPARED) ? 1 : 0;
+    return 0;
+}
+
+int query_stream_rows(PGquery *pg, int rows_per_batch)
+{
+    if (!pg || !pg->query_queue_tail || rows_per_batch < 1) {
+        LOG_ERROR("query_stream_rows: No queued query or invalid batch size");
+        return -1;
+    }
+
+    pg->query_queue_tail->rows_per_batch = rows_per_batch;
+    return 0;
+}
+
+int query_pipeline(PGquery *pg, bool enable)
+{
+    if (!pg) {
+        LOG_ERROR("query_pipeline: pg is NULL");
+        return -1;
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    pg->pipeline = enable ? 1 : 0;
+    return 0;
+#else
+    if (enable) {
+        LOG_ERROR("query_pipeline: libpq was built without pipeline support");
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+int query_pipeline_sync(PGquery *pg)
+{
+    if (!pg || !pg->query_queue_tail) {
+        LOG_ERROR("query_pipeline_sync: No queued query");
+        return -1;
+    }
+
+    pg->query_queue_tail->sync_after = 1;
+    return 0;
+}
+
+int query_set_deadline(PGquery *pg, uint32_t timeout_ms)
+{
+    if (!pg) {
+        LOG_ERROR("query_set_deadline: pg is NULL");
+        return -1;
+    }
+
+    pg->timeout_ms = timeout_ms;
+    return 0;
+}
+
+int query_set_timeout(PGquery *pg, uint32_t timeout_ms)
+{
+    if (!pg || !pg->query_queue_tail) {
+        LOG_ERROR("query_set_timeout: No queued query");
+        return -1;
+    }
+
+    pg->query_queue_tail->timeout_ms = timeout_ms;
+    return 0;
+}
+
+int query_on_timing(PGquery *pg, pg_timing_cb_t timing_cb, void *timing_data)
+{
+    if (!pg) {
+        LOG_ERROR("query_on_timing: pg is NULL");
+        return -1;
+    }
+
+    pg->timing_cb = timing_cb;
+    pg->timing_data = timing_data;
     return 0;
 }
 
@@ -443,9 +2371,30 @@ int query_execute(PGquery *pg)
         return 0;
     }
 
-    increment_async_work();
+    if (pg->pool && pg->pool->closing) {
+        LOG_ERROR("query_execute: Pool is closing");
+        return -1;
+    }
+
+    pg->timed_out = 0;
+    pg->timed_out_query = NULL;
+    pg->sent_at = 0;
+    pg->deadline = pg->timeout_ms ? uv_now(get_loop()) + pg->timeout_ms : 0;
 
+    pg_metrics_register();
+    pg->completed = 0;
+    pg->span = metrics_trace_begin(TRACE_SPAN, pg->query_queue->sql);
+    pg->traced = 1;
+
+    increment_async_work();
     pg->is_executing = 1;
+    deadline_arm(pg);
+
+    if (pg->pool) {
+        pool_acquire(pg);
+        return 0;
+    }
+
     execute_next_query(pg);
     return 0;
 }
@@ -6,11 +6,60 @@ extern "C" {
 
 #include "libpq-fe.h"
 #include "ecewo.h"
+#include <stdint.h>
 
 typedef struct pg_async_s PGquery;
 typedef struct pg_query_s pg_query_t;
+typedef struct pg_pool_s pg_pool_t;
 typedef void (*pg_result_cb_t)(PGquery *pg, PGresult *result, void *data);
 
+typedef struct
+{
+    const char *conninfo;        // libpq connection string
+    int min_size;                // connections kept open (default 0)
+    int max_size;                // upper limit (default 10)
+    uint8_t workers;             // processes sharing the limits, e.g. cluster_worker_count()
+    uint32_t idle_timeout_ms;    // close idle connections above min_size (0 = never)
+    uint32_t reconnect_delay_ms; // delay between reconnect attempts (default 1000)
+    int statement_cache_size;    // prepared statements kept per connection (default 64)
+} PGPool;
+
+typedef struct
+{
+    Oid type;          // type OID, 0 lets the server infer it
+    const char *value; // copied when queued; NULL for SQL NULL
+    int length;        // byte length, required for binary values
+    int format;        // 0 = text, 1 = binary
+} PGparam;
+
+typedef struct
+{
+    const char *sql;
+    uint64_t queue_wait_ns; // query_queue() until sent, includes waiting for a pooled connection
+    uint64_t send_ns;       // until the query was completely written to the socket
+    uint64_t first_byte_ns; // until its first result arrived
+    uint64_t total_ns;      // until its last result arrived
+    bool timed_out;
+} PGtiming;
+
+typedef void (*pg_timing_cb_t)(PGquery *pg, const PGtiming *timing, void *data);
+
+#define PG_RESULT_BINARY 0x01 // request results in binary format
+#define PG_PREPARED 0x02      // prepare the statement, see query_queue_prepared()
+
+// Create a connection pool on the current event loop
+// returns NULL on failure
+pg_pool_t *pg_pool_create(const PGPool *config);
+
+// Close every pooled connection
+// Queries still waiting for a connection receive a NULL result
+void pg_pool_destroy(pg_pool_t *pool);
+
+// Create a query context that borrows a connection from the pool
+// The connection is acquired by query_execute() and returned to the
+// pool after all queued queries complete
+PGquery *query_create_pooled(pg_pool_t *pool, Arena *arena);
+
 // Create a new query context
 // PGquery is automatically destroyed after all queries complete
 PGquery *query_create(PGconn *conn, Arena *arena);
@@ -24,6 +73,62 @@ int query_queue(PGquery *pg,
                 pg_result_cb_t result_cb,
                 void *query_data);
 
+// Queue a query with typed text/binary parameters
+// Parameter values are copied, text by strlen() and binary by length
+// flags: PG_RESULT_BINARY, PG_PREPARED
+// returns 0 on success, -1 on failure
+int query_queue_params(PGquery *pg,
+                       const char *sql,
+                       int param_count,
+                       const PGparam *params,
+                       int flags,
+                       pg_result_cb_t result_cb,
+                       void *query_data);
+
+// Deliver the rows of the last queued query in batches instead of one
+// PGresult; the callback runs per batch, then once more with an empty
+// PGRES_TUPLES_OK result. Batches larger than 1 row need libpq 17
+// returns 0 on success, -1 if nothing is queued
+int query_stream_rows(PGquery *pg, int rows_per_batch);
+
+// Send all queued queries in one batch (libpq pipeline mode)
+// instead of waiting for each result before sending the next one
+// Results are still delivered to each callback in queue order
+// returns 0 on success, -1 if libpq has no pipeline support
+int query_pipeline(PGquery *pg, bool enable);
+
+// End a pipeline segment after the last queued query
+// A failing query only aborts the rest of its own segment
+// returns 0 on success, -1 if nothing is queued
+int query_pipeline_sync(PGquery *pg);
+
+// Same as query_queue(), but the statement is prepared once per pooled
+// connection and executed by name on subsequent calls with the same SQL
+// Queries on a connection outside of a pool run unprepared
+// returns 0 on success, -1 on failure
+int query_queue_prepared(PGquery *pg,
+                         const char *sql,
+                         int param_count,
+                         const char **params,
+                         pg_result_cb_t result_cb,
+                         void *query_data);
+
+// Abort the execution if it has not completed within timeout_ms of
+// query_execute(), including the time spent waiting for a connection
+// The running query is canceled and its callback receives a NULL result
+// returns 0 on success, -1 on failure
+int query_set_deadline(PGquery *pg, uint32_t timeout_ms);
+
+// Same as query_set_deadline(), but only for the last queued query,
+// counted from the moment it is sent
+// returns 0 on success, -1 if nothing is queued
+int query_set_timeout(PGquery *pg, uint32_t timeout_ms);
+
+// Call timing_cb after each query completes, with how long it waited,
+// was sent, and took to its first and last result
+// returns 0 on success, -1 on failure
+int query_on_timing(PGquery *pg, pg_timing_cb_t timing_cb, void *timing_data);
+
 // Execute all queued queries
 // returns 0 on success, -1 on failure
 // PGquery is automatically destroyed after all queries complete
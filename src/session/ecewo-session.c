@@ -1,9 +1,14 @@
+#ifdef __linux__
+#define _GNU_SOURCE // memfd_create
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
-#include <ctype.h>
 #include "ecewo-session.h"
+#include "ecewo-metrics.h"
+#include "uv.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -14,13 +19,75 @@
 #include <errno.h>
 #endif
 
-static Session *sessions = NULL;
-static int max_sessions = 0;
-static int initialized = 0;
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SESSION_BLOCK_SHIFT 8
+#define SESSION_BLOCK_SIZE (1u << SESSION_BLOCK_SHIFT) // Sessions per block, blocks never move
+
+typedef struct
+{
+    Session session; // Must be first, Session * and session_slot_t * are interchangeable
+    uint32_t index; // Position in the slot pool
+    uint32_t hash; // Cached hash of session.id
+    uint32_t heap_index; // Position in the expiry heap
+    time_t deadline; // Expiry heap key, may lag behind session.expires
+    int max_age; // Used to slide the expiry on access
+} session_slot_t;
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t slot; // Slot index + 1, 0 means empty
+} session_bucket_t;
+
+static struct
+{
+    session_slot_t **blocks;
+    uint32_t block_count;
+
+    uint32_t *free_slots; // Stack of unused slot indexes
+    uint32_t free_count;
+
+    session_bucket_t *buckets; // Open addressing, linear probing
+    uint32_t bucket_mask;
+    uint32_t live_count;
+
+    uint32_t *heap; // Min-heap of slot indexes ordered by deadline
+    uint32_t heap_count;
+
+    uv_timer_t *timer;
+    time_t timer_deadline; // Deadline the timer is armed for, 0 if idle
+
+    SessionOptions options;
+    const SessionBackend *backend; // NULL for the in-process store
+    uint32_t seed;
+    bool initialized;
+} store = { 0 };
+
+// Registered by session_init_with(), kept across session_cleanup()
+static struct
+{
+    Metric *sessions;
+    Metric *expired;
+    Metric *sweep_time;
+    Metric *lookups;
+    Metric *misses;
+} session_metrics;
 
-#define KV_DELIMITER '\x1F' // ASCII Unit Separator - separates key from value
-#define PAIR_DELIMITER '\x1E' // ASCII Record Separator - separates key-value pairs
 #define MAX_SESSION_DATA_SIZE 4096
+#define VALUE_CAPACITY_ALIGN 8 // Slack so small value changes can be done in place
+
+// Session.data holds packed entries: [entry_header_t][key][value\0 + slack]
+typedef struct
+{
+    uint16_t key_len;
+    uint16_t value_len;
+    uint16_t value_cap; // Bytes reserved for the value, including '\0'
+} entry_header_t;
 
 static const Cookie SESSION_COOKIE_DEFAULTS = {
     .max_age = 3600, // 1 hour default
@@ -31,140 +98,43 @@ static const Cookie SESSION_COOKIE_DEFAULTS = {
     .secure = false,
 };
 
-static int is_url_safe(char c)
-{
-    return (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~');
-}
-
-static char *url_encode(const char *str)
-{
-    if (!str)
-        return NULL;
-
-    size_t len = strlen(str);
-    size_t encoded_len = len * 3 + 1; // worst case: every char becomes %XX
-    char *encoded = malloc(encoded_len);
-    if (!encoded)
-        return NULL;
-
-    size_t j = 0;
-    for (size_t i = 0; i < len && j < encoded_len - 3; i++) {
-        if (is_url_safe(str[i])) {
-            encoded[j++] = str[i];
-        } else {
-            int written = snprintf(encoded + j, encoded_len - j, "%%%02X", (unsigned char)str[i]);
-            if (written < 0 || written >= (int)(encoded_len - j)) {
-                free(encoded);
-                return NULL;
-            }
-            j += written;
-        }
-    }
-    encoded[j] = '\0';
-    return encoded;
-}
-
-static int hex_to_int(char c)
+static entry_header_t read_entry_header(const char *entry)
 {
-    if (c >= '0' && c <= '9')
-        return c - '0';
-    if (c >= 'A' && c <= 'F')
-        return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f')
-        return c - 'a' + 10;
-    return -1;
+    entry_header_t header;
+    memcpy(&header, entry, sizeof(header));
+    return header;
 }
 
-static char *url_decode(const char *str)
+static size_t entry_size(const entry_header_t *header)
 {
-    if (!str)
-        return NULL;
-
-    size_t len = strlen(str);
-    char *decoded = malloc(len + 1);
-    if (!decoded)
-        return NULL;
-
-    size_t j = 0;
-    for (size_t i = 0; i < len; i++) {
-        if (str[i] == '%' && i + 2 < len) {
-            int high = hex_to_int(str[i + 1]);
-            int low = hex_to_int(str[i + 2]);
-            if (high >= 0 && low >= 0) {
-                decoded[j++] = (char)(high * 16 + low);
-                i += 2;
-            } else {
-                decoded[j++] = str[i];
-            }
-        } else {
-            decoded[j++] = str[i];
-        }
-    }
-    decoded[j] = '\0';
-    return decoded;
+    return sizeof(entry_header_t) + header->key_len + header->value_cap;
 }
 
-static char *safe_strdup(const char *str)
+static char *find_entry(const Session *sess, const char *key, size_t key_len, entry_header_t *header)
 {
-    if (!str)
+    if (!sess->data)
         return NULL;
-    size_t len = strlen(str);
-    char *copy = malloc(len + 1);
-    if (copy) {
-        memcpy(copy, str, len + 1);
-    }
-    return copy;
-}
-
-int session_init(void)
-{
-    if (initialized)
-        return 1;
-
-    const int initial_capacity = MAX_SESSIONS_DEFAULT;
-    sessions = calloc(initial_capacity, sizeof(Session));
-    if (!sessions)
-        return 0;
-
-    max_sessions = initial_capacity;
-    initialized = 1;
-    return 1;
-}
 
-void session_cleanup(void)
-{
-    if (!initialized)
-        return;
+    char *entry = sess->data;
+    char *end = sess->data + sess->data_len;
 
-    for (int i = 0; i < max_sessions; i++) {
-        if (sessions[i].id[0] != '\0' && sessions[i].data != NULL) {
-            free(sessions[i].data);
-            sessions[i].data = NULL;
-        }
+    while (entry < end) {
+        *header = read_entry_header(entry);
+        if (header->key_len == key_len && memcmp(entry + sizeof(entry_header_t), key, key_len) == 0)
+            return entry;
+        entry += entry_size(header);
     }
 
-    free(sessions);
-    sessions = NULL;
-    max_sessions = 0;
-    initialized = 0;
+    return NULL;
 }
 
-static int resize_sessions(int new_capacity)
+static void remove_entry(Session *sess, char *entry, const entry_header_t *header)
 {
-    if (new_capacity <= max_sessions)
-        return 1;
-
-    Session *new_sessions = realloc(sessions, new_capacity * sizeof(Session));
-    if (!new_sessions)
-        return 0;
+    size_t size = entry_size(header);
+    char *next = entry + size;
 
-    for (int i = max_sessions; i < new_capacity; i++) {
-        memset(&new_sessions[i], 0, sizeof(Session));
-    }
-
-    sessions = new_sessions;
-    max_sessions = new_capacity;
-    return 1;
+    memmove(entry, next, (size_t)(sess->data + sess->data_len - next));
+    sess->data_len -= (uint32_t)size;
 }
 
 static int get_random_bytes(unsigned char *buffer, size_t length)
@@ -239,310 +209,2026 @@ static void generate_session_id(char *buffer)
     buffer[SESSION_ID_LEN] = '\0';
 }
 
-static void cleanup_expired_sessions(void)
+static uint32_t hash_id(const char *id)
 {
-    time_t now = time(NULL);
-    for (int i = 0; i < max_sessions; i++) {
-        if (sessions[i].id[0] != '\0' && sessions[i].expires < now)
-            session_free(&sessions[i]);
+    // FNV-1a, seeded per process so bucket positions can't be predicted
+    uint32_t hash = 2166136261u ^ store.seed;
+    for (size_t i = 0; i < SESSION_ID_LEN; i++) {
+        hash ^= (unsigned char)id[i];
+        hash *= 16777619u;
     }
+    return hash;
 }
 
-Session *session_create(int max_age)
+static session_slot_t *slot_at(uint32_t index)
 {
-    if (!initialized && !session_init())
-        return NULL;
+    return &store.blocks[index >> SESSION_BLOCK_SHIFT][index & (SESSION_BLOCK_SIZE - 1)];
+}
 
-    cleanup_expired_sessions();
+static uint32_t slot_capacity(void)
+{
+    return store.block_count * SESSION_BLOCK_SIZE;
+}
 
-    int slot = -1;
-    for (int i = 0; i < max_sessions; i++) {
-        if (sessions[i].id[0] == '\0') {
-            slot = i;
-            break;
-        }
-    }
+static int grow_slots(void)
+{
+    session_slot_t **new_blocks = realloc(store.blocks, (store.block_count + 1) * sizeof(session_slot_t *));
+    if (!new_blocks)
+        return 0;
+    store.blocks = new_blocks;
 
-    if (slot < 0) {
-        if (!resize_sessions(max_sessions * 2))
-            return NULL;
-        slot = max_sessions / 2;
+    uint32_t *new_free = realloc(store.free_slots, (slot_capacity() + SESSION_BLOCK_SIZE) * sizeof(uint32_t));
+    if (!new_free)
+        return 0;
+    store.free_slots = new_free;
+
+    uint32_t *new_heap = realloc(store.heap, (slot_capacity() + SESSION_BLOCK_SIZE) * sizeof(uint32_t));
+    if (!new_heap)
+        return 0;
+    store.heap = new_heap;
+
+    session_slot_t *block = calloc(SESSION_BLOCK_SIZE, sizeof(session_slot_t));
+    if (!block)
+        return 0;
+
+    uint32_t base = slot_capacity();
+    store.blocks[store.block_count++] = block;
+
+    // Push in reverse so the lowest index is handed out first
+    for (uint32_t i = SESSION_BLOCK_SIZE; i > 0; i--) {
+        block[i - 1].index = base + i - 1;
+        store.free_slots[store.free_count++] = base + i - 1;
     }
 
-    generate_session_id(sessions[slot].id);
-    sessions[slot].expires = time(NULL) + max_age;
+    return 1;
+}
+
+static void bucket_place(session_bucket_t *buckets, uint32_t mask, uint32_t hash, uint32_t slot)
+{
+    uint32_t pos = hash & mask;
+    while (buckets[pos].slot != 0)
+        pos = (pos + 1) & mask;
 
-    free(sessions[slot].data);
-    sessions[slot].data = safe_strdup("");
-    if (!sessions[slot].data) {
-        sessions[slot].id[0] = '\0';
-        return NULL;
+    buckets[pos].hash = hash;
+    buckets[pos].slot = slot;
+}
+
+static int grow_buckets(void)
+{
+    uint32_t old_capacity = store.buckets ? store.bucket_mask + 1 : 0;
+    uint32_t new_capacity = old_capacity ? old_capacity * 2 : 32;
+
+    session_bucket_t *new_buckets = calloc(new_capacity, sizeof(session_bucket_t));
+    if (!new_buckets)
+        return 0;
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (store.buckets[i].slot != 0)
+            bucket_place(new_buckets, new_capacity - 1, store.buckets[i].hash, store.buckets[i].slot);
     }
 
-    return &sessions[slot];
+    free(store.buckets);
+    store.buckets = new_buckets;
+    store.bucket_mask = new_capacity - 1;
+    return 1;
 }
 
-Session *session_find(const char *id)
+static session_slot_t *index_lookup(const char *id, uint32_t hash)
 {
-    if (!id || !initialized)
-        return NULL;
+    uint32_t pos = hash & store.bucket_mask;
 
-    time_t now = time(NULL);
-    for (int i = 0; i < max_sessions; i++) {
-        if (sessions[i].id[0] != '\0' && strcmp(sessions[i].id, id) == 0 && sessions[i].expires >= now) {
-            return &sessions[i];
+    while (store.buckets[pos].slot != 0) {
+        if (store.buckets[pos].hash == hash) {
+            session_slot_t *slot = slot_at(store.buckets[pos].slot - 1);
+            if (memcmp(slot->session.id, id, SESSION_ID_LEN) == 0)
+                return slot;
         }
+        pos = (pos + 1) & store.bucket_mask;
     }
 
     return NULL;
 }
 
-static void remove_key_from_data(char *data, const char *encoded_key)
+static void index_remove(const session_slot_t *slot)
 {
-    if (!data || !encoded_key)
-        return;
+    uint32_t mask = store.bucket_mask;
+    uint32_t hole = slot->hash & mask;
 
-    char *search_start = data;
+    while (store.buckets[hole].slot != slot->index + 1) {
+        if (store.buckets[hole].slot == 0)
+            return; // Not indexed
+        hole = (hole + 1) & mask;
+    }
 
-    while (search_start && *search_start) {
-        char *key_end = strchr(search_start, KV_DELIMITER);
-        if (!key_end)
-            break;
+    // Backward shift deletion keeps probe chains intact without tombstones
+    uint32_t next = (hole + 1) & mask;
+    while (store.buckets[next].slot != 0) {
+        uint32_t home = store.buckets[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            store.buckets[hole] = store.buckets[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
 
-        size_t key_len = key_end - search_start;
+    store.buckets[hole].slot = 0;
+    store.live_count--;
+    metrics_set(session_metrics.sessions, store.live_count);
+}
 
-        if (key_len == strlen(encoded_key) && strncmp(search_start, encoded_key, key_len) == 0) {
-            char *value_start = key_end + 1;
-            char *pair_end = strchr(value_start, PAIR_DELIMITER);
+static void heap_set(uint32_t pos, uint32_t index)
+{
+    store.heap[pos] = index;
+    slot_at(index)->heap_index = pos;
+}
 
-            if (pair_end) {
-                char *after_pair = pair_end + 1;
-                size_t remaining_len = strlen(after_pair);
-                memmove(search_start, after_pair, remaining_len + 1);
-            } else {
-                *search_start = '\0';
-            }
+static time_t heap_deadline(uint32_t pos)
+{
+    return slot_at(store.heap[pos])->deadline;
+}
+
+static void heap_sift_up(uint32_t pos)
+{
+    uint32_t index = store.heap[pos];
+    time_t deadline = slot_at(index)->deadline;
+
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (heap_deadline(parent) <= deadline)
             break;
-        }
+        heap_set(pos, store.heap[parent]);
+        pos = parent;
+    }
+
+    heap_set(pos, index);
+}
 
-        char *next_pair = strchr(search_start, PAIR_DELIMITER);
-        search_start = next_pair ? next_pair + 1 : NULL;
+static void heap_sift_down(uint32_t pos)
+{
+    uint32_t index = store.heap[pos];
+    time_t deadline = slot_at(index)->deadline;
+
+    for (;;) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= store.heap_count)
+            break;
+        if (child + 1 < store.heap_count && heap_deadline(child + 1) < heap_deadline(child))
+            child++;
+        if (deadline <= heap_deadline(child))
+            break;
+        heap_set(pos, store.heap[child]);
+        pos = child;
     }
+
+    heap_set(pos, index);
 }
 
-void session_value_set(Session *sess, const char *key, const char *value)
+static void heap_push(session_slot_t *slot)
 {
-    if (!sess || !key || !value)
-        return;
+    heap_set(store.heap_count++, slot->index);
+    heap_sift_up(slot->heap_index);
+}
+
+static void heap_remove(const session_slot_t *slot)
+{
+    uint32_t pos = slot->heap_index;
+    uint32_t last = store.heap[--store.heap_count];
 
-    char *encoded_key = url_encode(key);
-    char *encoded_value = url_encode(value);
-    if (!encoded_key || !encoded_value) {
-        if (encoded_key)
-            free(encoded_key);
-        else if (encoded_value)
-            free(encoded_value);
+    if (pos == store.heap_count)
         return;
-    }
 
-    size_t current_len = sess->data ? strlen(sess->data) : 0;
-    size_t key_len = strlen(encoded_key);
-    size_t value_len = strlen(encoded_value);
-    size_t additional_size = key_len + value_len + 2; // KV_DELIMITER + PAIR_DELIMITER
+    heap_set(pos, last);
+    heap_sift_up(pos);
+    heap_sift_down(slot_at(last)->heap_index);
+}
 
-    if (current_len + additional_size > MAX_SESSION_DATA_SIZE) {
-        fprintf(stderr, "Session data size limit exceeded\n");
-        free(encoded_key);
-        free(encoded_value);
+static void local_free(Session *sess);
+
+static void expire_due_sessions(void)
+{
+    // Only the heap root is ever inspected, so the cost is proportional
+    // to the number of sessions that actually expired
+    time_t now = time(NULL);
+
+    if (store.heap_count == 0 || slot_at(store.heap[0])->deadline >= now)
         return;
-    }
 
-    if (sess->data && strlen(sess->data) > 0)
-        remove_key_from_data(sess->data, encoded_key);
+    uint64_t start = metrics_now();
+    uint32_t expired = 0;
 
-    current_len = sess->data ? strlen(sess->data) : 0;
-    size_t new_len = current_len + key_len + value_len + 3; // key + KV_DELIM + value + PAIR_DELIM + null
+    while (store.heap_count > 0) {
+        session_slot_t *slot = slot_at(store.heap[0]);
+        if (slot->deadline >= now)
+            break;
 
-    char *new_data = malloc(new_len);
-    if (new_data) {
-        if (current_len > 0) {
-            strcpy(new_data, sess->data);
-        } else {
-            new_data[0] = '\0';
+        if (slot->session.expires >= now) {
+            // Extended since it was queued, requeue with the new expiry
+            slot->deadline = slot->session.expires;
+            heap_sift_down(0);
+            continue;
         }
 
-        strcat(new_data, encoded_key);
+        local_free(&slot->session);
+        expired++;
+    }
 
-        size_t pos = strlen(new_data);
-        new_data[pos] = KV_DELIMITER;
-        new_data[pos + 1] = '\0';
+    metrics_add(session_metrics.expired, expired);
+    metrics_observe(session_metrics.sweep_time, metrics_now() - start);
+}
 
-        strcat(new_data, encoded_value);
+static void on_expiry_timer(uv_timer_t *handle);
 
-        pos = strlen(new_data);
-        new_data[pos] = PAIR_DELIMITER;
-        new_data[pos + 1] = '\0';
+static void schedule_expiry(void)
+{
+    if (!store.timer)
+        return;
 
-        free(sess->data);
-        sess->data = new_data;
+    if (store.heap_count == 0) {
+        uv_timer_stop(store.timer);
+        store.timer_deadline = 0;
+        return;
     }
 
-    free(encoded_key);
-    free(encoded_value);
+    time_t deadline = heap_deadline(0);
+    if (store.timer_deadline != 0 && store.timer_deadline <= deadline)
+        return; // Already armed early enough
+
+    time_t now = time(NULL);
+    uint64_t timeout = deadline >= now ? (uint64_t)(deadline - now + 1) * 1000 : 0;
+
+    store.timer_deadline = deadline;
+    uv_timer_start(store.timer, on_expiry_timer, timeout, 0);
 }
 
-char *session_value_get(Session *sess, const char *key)
+static void on_expiry_timer(uv_timer_t *handle)
 {
-    if (!sess || !key || !sess->data || strlen(sess->data) == 0)
-        return NULL;
+    (void)handle;
 
-    char *encoded_key = url_encode(key);
-    if (!encoded_key)
-        return NULL;
+    store.timer_deadline = 0;
+    expire_due_sessions();
+    schedule_expiry();
+}
 
-    char *search_start = sess->data;
-    char *result = NULL;
+static void on_timer_closed(uv_handle_t *handle)
+{
+    free(handle);
+}
 
-    while (search_start && *search_start) {
-        char *key_end = strchr(search_start, KV_DELIMITER);
-        if (!key_end)
-            break;
+#ifdef __linux__
+// ============================================================================
+// SHARED MEMORY BACKEND
+// ============================================================================
+
+#define SHARED_ENV "ECEWO_SESSION_FD"
+#define SHARED_MAGIC 0x45435353u
+#define SHARED_STRIPES 64 // Independent locks, each owns 1/SHARED_STRIPES of buckets and slots
+#define SHARED_CREATE_ATTEMPTS 8
 
-        size_t key_len = key_end - search_start;
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint32_t free_head; // Slot index + 1, 0 if the stripe is full
+} shared_stripe_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t bucket_mask;
+    uint32_t seed;
+    shared_stripe_t stripes[SHARED_STRIPES];
+} shared_header_t;
+
+typedef struct
+{
+    char id[SESSION_ID_LEN + 1];
+    uint32_t hash;
+    uint32_t next; // Bucket chain or free list, slot index + 1
+    int max_age;
+    time_t expires;
+    uint32_t data_len;
+    char data[MAX_SESSION_DATA_SIZE];
+} shared_slot_t;
+
+static struct
+{
+    int fd;
+    void *base;
+    size_t size;
+    shared_header_t *header;
+    uint32_t *buckets;
+    shared_slot_t *slots;
+    Session *handles; // Process-local copies handed out to callers
+    bool owner; // Created the segment and exported SHARED_ENV
+} shared = { .fd = -1 };
+
+static size_t shared_buckets_offset(void)
+{
+    return (sizeof(shared_header_t) + 63) & ~(size_t)63;
+}
 
-        if (key_len == strlen(encoded_key) && strncmp(search_start, encoded_key, key_len) == 0) {
-            char *value_start = key_end + 1;
-            char *value_end = strchr(value_start, PAIR_DELIMITER);
+static size_t shared_slots_offset(uint32_t bucket_count)
+{
+    return (shared_buckets_offset() + bucket_count * sizeof(uint32_t) + 63) & ~(size_t)63;
+}
 
-            size_t value_len = value_end ? (size_t)(value_end - value_start) : strlen(value_start);
+static shared_stripe_t *shared_stripe(uint32_t hash)
+{
+    return &shared.header->stripes[hash & (SHARED_STRIPES - 1)];
+}
 
-            char *encoded_value = malloc(value_len + 1);
-            if (encoded_value) {
-                strncpy(encoded_value, value_start, value_len);
-                encoded_value[value_len] = '\0';
+static void shared_lock(shared_stripe_t *stripe)
+{
+    // Robust mutex: a worker that died holding the lock must not wedge the others
+    if (pthread_mutex_lock(&stripe->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&stripe->lock);
+}
 
-                result = url_decode(encoded_value);
-                free(encoded_value);
-            }
-            break;
-        }
+static void shared_unlock(shared_stripe_t *stripe)
+{
+    pthread_mutex_unlock(&stripe->lock);
+}
+
+static uint32_t *shared_bucket(uint32_t hash)
+{
+    return &shared.buckets[hash & shared.header->bucket_mask];
+}
 
-        char *next_pair = strchr(search_start, PAIR_DELIMITER);
-        search_start = next_pair ? next_pair + 1 : NULL;
+// Caller must hold the stripe lock of hash
+static shared_slot_t *shared_lookup(const char *id, uint32_t hash)
+{
+    for (uint32_t link = *shared_bucket(hash); link != 0; link = shared.slots[link - 1].next) {
+        shared_slot_t *slot = &shared.slots[link - 1];
+        if (slot->hash == hash && memcmp(slot->id, id, SESSION_ID_LEN) == 0)
+            return slot;
     }
+    return NULL;
+}
 
-    free(encoded_key);
-    return result;
+// Caller must hold the stripe lock of slot->hash
+static void shared_release(shared_slot_t *slot)
+{
+    uint32_t index = (uint32_t)(slot - shared.slots);
+    uint32_t *link = shared_bucket(slot->hash);
+
+    while (*link != 0 && *link != index + 1)
+        link = &shared.slots[*link - 1].next;
+
+    if (*link == index + 1)
+        *link = slot->next;
+
+    shared_stripe_t *stripe = shared_stripe(slot->hash);
+    slot->id[0] = '\0';
+    slot->data_len = 0;
+    slot->next = stripe->free_head;
+    stripe->free_head = index + 1;
 }
 
-void session_value_remove(Session *sess, const char *key)
+// Caller must hold the stripe lock, walks only the slots owned by the stripe
+static void shared_sweep_stripe(uint32_t stripe_index)
 {
-    if (!sess || !key || !sess->data)
-        return;
+    uint64_t start = metrics_now();
+    uint32_t expired = 0;
+    time_t now = time(NULL);
 
-    char *encoded_key = url_encode(key);
-    if (!encoded_key)
-        return;
+    for (uint32_t i = stripe_index; i < shared.header->capacity; i += SHARED_STRIPES) {
+        shared_slot_t *slot = &shared.slots[i];
+        if (slot->id[0] != '\0' && slot->expires < now) {
+            shared_release(slot);
+            expired++;
+        }
+    }
 
-    remove_key_from_data(sess->data, encoded_key);
-    free(encoded_key);
+    metrics_add(session_metrics.expired, expired);
+    metrics_observe(session_metrics.sweep_time, metrics_now() - start);
 }
 
-void session_free(Session *sess)
+static Session *shared_load(shared_slot_t *slot)
 {
-    if (!sess)
-        return;
+    Session *handle = &shared.handles[slot - shared.slots];
 
-    memset(sess->id, 0, sizeof(sess->id));
-    sess->expires = 0;
-    if (sess->data) {
-        free(sess->data);
-        sess->data = NULL;
+    if (slot->data_len > handle->data_cap) {
+        char *data = realloc(handle->data, slot->data_len);
+        if (!data)
+            return NULL;
+        handle->data = data;
+        handle->data_cap = slot->data_len;
     }
+
+    memcpy(handle->id, slot->id, sizeof(handle->id));
+    if (slot->data_len > 0)
+        memcpy(handle->data, slot->data, slot->data_len);
+    handle->data_len = slot->data_len;
+    handle->expires = slot->expires;
+    return handle;
 }
 
-Session *session_get(Req *req)
+static shared_slot_t *shared_slot_of(Session *sess)
 {
-    char *sid = cookie_get(req, "session");
-    if (!sid)
+    if (sess < shared.handles || sess >= shared.handles + shared.header->capacity)
         return NULL;
-
-    Session *sess = session_find(sid);
-    // Note: cookie_get returns arena-allocated memory, so no need to free sid
-    return sess;
+    return &shared.slots[sess - shared.handles];
 }
 
-void session_print_all(void)
+static Session *shared_create(int max_age)
 {
-    time_t now = time(NULL);
-    printf("=== Sessions ===\n");
+    for (int attempt = 0; attempt < SHARED_CREATE_ATTEMPTS; attempt++) {
+        char id[SESSION_ID_LEN + 1];
+        generate_session_id(id);
 
-    for (int i = 0; i < max_sessions; i++) {
-        Session *s = &sessions[i];
-        if (s->id[0] == '\0')
+        uint32_t hash = hash_id(id);
+        shared_stripe_t *stripe = shared_stripe(hash);
+        shared_lock(stripe);
+
+        if (stripe->free_head == 0)
+            shared_sweep_stripe(hash & (SHARED_STRIPES - 1));
+
+        if (stripe->free_head == 0 || shared_lookup(id, hash)) {
+            // Stripe full, retry with an id that lands elsewhere
+            shared_unlock(stripe);
             continue;
+        }
+
+        shared_slot_t *slot = &shared.slots[stripe->free_head - 1];
+        stripe->free_head = slot->next;
 
-        printf("[#%02d] id=%.8s..., expires in %lds\n",
-               i, s->id, (long)(s->expires - now));
+        memcpy(slot->id, id, sizeof(slot->id));
+        slot->hash = hash;
+        slot->max_age = max_age;
+        slot->expires = time(NULL) + max_age;
+        slot->data_len = 0;
 
-        if (s->data && strlen(s->data) > 0) {
-            char *data_copy = safe_strdup(s->data);
-            if (data_copy) {
-                char *pair_start = data_copy;
-                int pair_count = 0;
+        uint32_t *bucket = shared_bucket(hash);
+        slot->next = *bucket;
+        *bucket = (uint32_t)(slot - shared.slots) + 1;
+
+        Session *handle = shared_load(slot);
+        shared_unlock(stripe);
+        return handle;
+    }
+
+    fprintf(stderr, "Shared session store is full\n");
+    return NULL;
+}
 
-                while (pair_start && *pair_start) {
-                    char *key_end = strchr(pair_start, KV_DELIMITER);
-                    if (!key_end)
-                        break;
+static Session *shared_find(const char *id)
+{
+    uint32_t hash = hash_id(id);
+    shared_stripe_t *stripe = shared_stripe(hash);
+    shared_lock(stripe);
 
-                    *key_end = '\0';
-                    char *value_start = key_end + 1;
-                    char *pair_end = strchr(value_start, PAIR_DELIMITER);
+    Session *handle = NULL;
+    shared_slot_t *slot = shared_lookup(id, hash);
+    time_t now = time(NULL);
 
-                    if (pair_end)
-                        *pair_end = '\0';
+    if (slot && slot->expires < now) {
+        shared_release(slot);
+    } else if (slot) {
+        if (store.options.sliding_expiration)
+            slot->expires = now + slot->max_age;
+        handle = shared_load(slot);
+    }
 
-                    char *decoded_key = url_decode(pair_start);
-                    char *decoded_value = url_decode(value_start);
+    shared_unlock(stripe);
+    return handle;
+}
 
-                    printf("      %s = %s\n",
-                           decoded_key ? decoded_key : pair_start,
-                           decoded_value ? decoded_value : value_start);
+static void shared_free(Session *sess)
+{
+    shared_slot_t *slot = shared_slot_of(sess);
+    if (!slot)
+        return;
 
-                    free(decoded_key);
-                    free(decoded_value);
+    shared_stripe_t *stripe = shared_stripe(hash_id(sess->id));
+    shared_lock(stripe);
+    if (memcmp(slot->id, sess->id, SESSION_ID_LEN) == 0)
+        shared_release(slot);
+    shared_unlock(stripe);
 
-                    pair_start = pair_end ? pair_end + 1 : NULL;
-                    pair_count++;
-                }
+    memset(sess->id, 0, sizeof(sess->id));
+    sess->data_len = 0;
+    sess->expires = 0;
+}
 
-                if (pair_count == 0)
-                    printf("      (empty)\n");
+static void shared_save(Session *sess)
+{
+    shared_slot_t *slot = shared_slot_of(sess);
+    if (!slot)
+        return;
 
-                free(data_copy);
-            }
-        } else {
-            printf("      (empty)\n");
-        }
+    shared_stripe_t *stripe = shared_stripe(hash_id(sess->id));
+    shared_lock(stripe);
+    if (memcmp(slot->id, sess->id, SESSION_ID_LEN) == 0 && sess->data_len <= MAX_SESSION_DATA_SIZE) {
+        if (sess->data_len > 0)
+            memcpy(slot->data, sess->data, sess->data_len);
+        slot->data_len = sess->data_len;
+        slot->expires = sess->expires;
     }
-    printf("================\n");
+    shared_unlock(stripe);
 }
 
-void session_send(Res *res, Session *sess, Cookie *options)
+static void shared_cleanup(void)
 {
-    if (!res || !sess || sess->id[0] == '\0') {
-        fprintf(stderr, "Error on session sending\n");
-        return;
+    if (shared.handles) {
+        for (uint32_t i = 0; i < shared.header->capacity; i++)
+            free(shared.handles[i].data);
+        free(shared.handles);
     }
 
-    time_t now = time(NULL);
-    int max_age = (int)difftime(sess->expires, now);
-    if (max_age < 0)
-        return;
+    if (shared.base)
+        munmap(shared.base, shared.size);
 
-    Cookie opts = options ? *options : SESSION_COOKIE_DEFAULTS;
-    opts.max_age = max_age;
+    if (shared.fd >= 0)
+        close(shared.fd);
+
+    if (shared.owner)
+        unsetenv(SHARED_ENV);
+
+    memset(&shared, 0, sizeof(shared));
+    shared.fd = -1;
+}
+
+static const SessionBackend shared_backend = {
+    .create = shared_create,
+    .find = shared_find,
+    .free = shared_free,
+    .save = shared_save,
+    .cleanup = shared_cleanup,
+};
+
+static void shared_format(uint32_t capacity, uint32_t bucket_count)
+{
+    shared_header_t *header = shared.header;
+    header->capacity = capacity;
+    header->bucket_mask = bucket_count - 1;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+
+    for (uint32_t i = 0; i < SHARED_STRIPES; i++) {
+        pthread_mutex_init(&header->stripes[i].lock, &attr);
+        header->stripes[i].free_head = 0;
+    }
+    pthread_mutexattr_destroy(&attr);
+
+    // Slot i belongs to stripe i % SHARED_STRIPES, pushed in reverse so low indexes go first
+    for (uint32_t i = capacity; i > 0; i--) {
+        shared_stripe_t *stripe = &header->stripes[(i - 1) & (SHARED_STRIPES - 1)];
+        shared.slots[i - 1].next = stripe->free_head;
+        stripe->free_head = i;
+    }
+
+    header->magic = SHARED_MAGIC;
+}
+
+// The first process (the cluster master) creates the segment and exports
+// its descriptor through the environment; spawned workers inherit both
+// and map the same memory.
+static int shared_open(size_t capacity)
+{
+    if (capacity > UINT32_MAX / 2) {
+        fprintf(stderr, "Shared session capacity too large\n");
+        return 0;
+    }
+
+    uint32_t bucket_count = SHARED_STRIPES;
+    while (bucket_count < capacity)
+        bucket_count *= 2;
+
+    size_t size = shared_slots_offset(bucket_count) + capacity * sizeof(shared_slot_t);
+    const char *inherited = getenv(SHARED_ENV);
+    bool creating = inherited == NULL;
+
+    if (creating) {
+        shared.fd = memfd_create("ecewo-sessions", 0); // Not CLOEXEC, workers inherit it
+        if (shared.fd < 0 || ftruncate(shared.fd, (off_t)size) != 0) {
+            fprintf(stderr, "Shared session segment could not be created: %s\n", strerror(errno));
+            shared_cleanup();
+            return 0;
+        }
+    } else {
+        shared.fd = atoi(inherited);
+        struct stat st;
+        if (fstat(shared.fd, &st) != 0 || (size_t)st.st_size != size) {
+            fprintf(stderr, "Inherited shared session segment does not match shared_capacity\n");
+            shared.fd = -1;
+            return 0;
+        }
+    }
+
+    shared.base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shared.fd, 0);
+    if (shared.base == MAP_FAILED) {
+        shared.base = NULL;
+        fprintf(stderr, "Shared session segment could not be mapped: %s\n", strerror(errno));
+        shared_cleanup();
+        return 0;
+    }
+
+    shared.size = size;
+    shared.header = shared.base;
+    shared.buckets = (uint32_t *)((char *)shared.base + shared_buckets_offset());
+    shared.slots = (shared_slot_t *)((char *)shared.base + shared_slots_offset(bucket_count));
+
+    if (creating) {
+        shared.header->seed = store.seed;
+        shared_format((uint32_t)capacity, bucket_count);
+
+        char fd_str[16];
+        snprintf(fd_str, sizeof(fd_str), "%d", shared.fd);
+        setenv(SHARED_ENV, fd_str, 1);
+        shared.owner = true;
+    } else if (shared.header->magic != SHARED_MAGIC || shared.header->capacity != capacity) {
+        fprintf(stderr, "Inherited shared session segment is not initialized\n");
+        shared_cleanup();
+        return 0;
+    } else {
+        // Every process must hash ids the same way
+        store.seed = shared.header->seed;
+    }
+
+    shared.handles = calloc(capacity, sizeof(Session));
+    if (!shared.handles) {
+        shared_cleanup();
+        return 0;
+    }
+
+    return 1;
+}
+#endif
+
+// ============================================================================
+// COOKIE SESSIONS
+// ============================================================================
+
+// Stateless mode: the whole session travels in the cookie, authenticated with
+// HMAC-SHA256 or encrypted with ChaCha20-Poly1305, so no process keeps any
+// state and every cluster worker accepts the cookies of the others.
+//
+// Cookie: base64url([version][key id][nonce, encrypted only][payload][tag])
+// Payload: [expires, 8 bytes][max_age, 4 bytes][id][entries: key_len, key, value_len, value]
+// Integers are little endian, the entry lengths are LEB128 varints
+
+#define COOKIE_SESSION_SIGNED 1
+#define COOKIE_SESSION_ENCRYPTED 2
+#define COOKIE_SESSION_CONTEXT_KEY "ecewo-session"
+#define COOKIE_NONCE_LEN 12
+#define COOKIE_HMAC_LEN 32
+#define COOKIE_POLY_TAG_LEN 16
+#define COOKIE_FIXED_LEN (8 + 4 + SESSION_ID_LEN)
+#define COOKIE_MAX_TOKEN_LEN 3800 // Leaves room for the attributes within MAX_COOKIE_SIZE
+
+typedef struct
+{
+    Session session; // Must be first, Session * and cookie_session_t * are interchangeable
+    Arena *arena; // Owns the session and its data, NULL if both are malloc'd
+    int max_age;
+} cookie_session_t;
+
+typedef struct
+{
+    uint8_t id;
+    uint8_t mac_key[32];
+    uint8_t enc_key[32];
+} cookie_key_t;
+
+static struct
+{
+    cookie_key_t keys[SESSION_MAX_KEYS];
+    size_t key_count;
+    bool encrypt;
+} cookie_keys = { 0 };
+
+static Session *cookie_create(int max_age);
+static Session *cookie_find(const char *id);
+static void cookie_session_free(Session *sess);
+
+static const SessionBackend cookie_backend = {
+    .create = cookie_create,
+    .find = cookie_find,
+    .free = cookie_session_free,
+};
+
+static bool cookie_mode(void)
+{
+    return store.backend == &cookie_backend;
+}
+
+static uint32_t load32_le(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void store64_le(uint8_t *p, uint64_t v)
+{
+    store32_le(p, (uint32_t)v);
+    store32_le(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint64_t load64_le(const uint8_t *p)
+{
+    return (uint64_t)load32_le(p) | ((uint64_t)load32_le(p + 4) << 32);
+}
+
+// Volatile so the comparison isn't cut short by the compiler
+static bool equal_ct(const uint8_t *a, const uint8_t *b, size_t len)
+{
+    volatile uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+static void wipe(void *p, size_t len)
+{
+    volatile uint8_t *bytes = p;
+    while (len--)
+        *bytes++ = 0;
+}
+
+// SHA-256 (FIPS 180-4)
+
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t block_len;
+} sha256_t;
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_compress(sha256_t *ctx, const uint8_t *block)
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = ctx->state[0], b = ctx->state[1], c = ctx->state[2], d = ctx->state[3];
+    uint32_t e = ctx->state[4], f = ctx->state[5], g = ctx->state[6], h = ctx->state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    ctx->state[0] += a;
+    ctx->state[1] += b;
+    ctx->state[2] += c;
+    ctx->state[3] += d;
+    ctx->state[4] += e;
+    ctx->state[5] += f;
+    ctx->state[6] += g;
+    ctx->state[7] += h;
+}
+
+static void sha256_init(sha256_t *ctx)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+static void sha256_update(sha256_t *ctx, const uint8_t *data, size_t len)
+{
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t n = 64 - ctx->block_len;
+        if (n > len)
+            n = len;
+
+        memcpy(ctx->block + ctx->block_len, data, n);
+        ctx->block_len += n;
+        data += n;
+        len -= n;
+
+        if (ctx->block_len == 64) {
+            sha256_compress(ctx, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+static void sha256_final(sha256_t *ctx, uint8_t out[32])
+{
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad = 0x80;
+
+    sha256_update(ctx, &pad, 1);
+
+    pad = 0;
+    while (ctx->block_len != 56)
+        sha256_update(ctx, &pad, 1);
+
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++)
+        length[i] = (uint8_t)(bits >> (56 - i * 8));
+    sha256_update(ctx, length, 8);
+
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+
+    wipe(ctx, sizeof(*ctx));
+}
+
+// HMAC-SHA256 (RFC 2104) over the concatenation of two buffers
+static void hmac_sha256(const uint8_t *key, size_t key_len,
+                        const uint8_t *a, size_t a_len,
+                        const uint8_t *b, size_t b_len,
+                        uint8_t out[32])
+{
+    uint8_t block[64] = { 0 };
+    sha256_t ctx;
+
+    if (key_len > 64) {
+        sha256_init(&ctx);
+        sha256_update(&ctx, key, key_len);
+        sha256_final(&ctx, block);
+    } else {
+        memcpy(block, key, key_len);
+    }
+
+    uint8_t pad[64];
+    for (int i = 0; i < 64; i++)
+        pad[i] = block[i] ^ 0x36;
+
+    uint8_t inner[32];
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, 64);
+    sha256_update(&ctx, a, a_len);
+    if (b_len > 0)
+        sha256_update(&ctx, b, b_len);
+    sha256_final(&ctx, inner);
+
+    for (int i = 0; i < 64; i++)
+        pad[i] = block[i] ^ 0x5c;
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, 64);
+    sha256_update(&ctx, inner, 32);
+    sha256_final(&ctx, out);
+
+    wipe(block, sizeof(block));
+    wipe(pad, sizeof(pad));
+    wipe(inner, sizeof(inner));
+}
+
+// ChaCha20 (RFC 8439)
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define QUARTER_ROUND(a, b, c, d) \
+    a += b;                       \
+    d = ROTL32(d ^ a, 16);        \
+    c += d;                       \
+    b = ROTL32(b ^ c, 12);        \
+    a += b;                       \
+    d = ROTL32(d ^ a, 8);         \
+    c += d;                       \
+    b = ROTL32(b ^ c, 7)
+
+static void chacha20_block(const uint8_t key[32], uint32_t counter, const uint8_t nonce[12], uint8_t out[64])
+{
+    uint32_t input[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+    for (int i = 0; i < 8; i++)
+        input[4 + i] = load32_le(key + i * 4);
+
+    input[12] = counter;
+    input[13] = load32_le(nonce);
+    input[14] = load32_le(nonce + 4);
+    input[15] = load32_le(nonce + 8);
+
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; i++) {
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    for (int i = 0; i < 16; i++)
+        store32_le(out + i * 4, x[i] + input[i]);
+
+    wipe(x, sizeof(x));
+    wipe(input, sizeof(input));
+}
+
+static void chacha20_xor(const uint8_t key[32], uint32_t counter, const uint8_t nonce[12], uint8_t *data, size_t len)
+{
+    uint8_t stream[64];
+
+    for (size_t offset = 0; offset < len; offset += 64, counter++) {
+        chacha20_block(key, counter, nonce, stream);
+
+        size_t n = len - offset < 64 ? len - offset : 64;
+        for (size_t i = 0; i < n; i++)
+            data[offset + i] ^= stream[i];
+    }
+
+    wipe(stream, sizeof(stream));
+}
+
+// Poly1305 (RFC 8439) with 26-bit limbs
+
+typedef struct
+{
+    uint32_t r[5];
+    uint32_t h[5];
+    uint32_t pad[4];
+} poly1305_t;
+
+static void poly1305_init(poly1305_t *ctx, const uint8_t key[32])
+{
+    ctx->r[0] = load32_le(key) & 0x3ffffff;
+    ctx->r[1] = (load32_le(key + 3) >> 2) & 0x3ffff03;
+    ctx->r[2] = (load32_le(key + 6) >> 4) & 0x3ffc0ff;
+    ctx->r[3] = (load32_le(key + 9) >> 6) & 0x3f03fff;
+    ctx->r[4] = (load32_le(key + 12) >> 8) & 0x00fffff;
+
+    memset(ctx->h, 0, sizeof(ctx->h));
+
+    for (int i = 0; i < 4; i++)
+        ctx->pad[i] = load32_le(key + 16 + i * 4);
+}
+
+// Partial blocks are padded with zeros, as the AEAD construction requires
+static void poly1305_blocks(poly1305_t *ctx, const uint8_t *data, size_t len)
+{
+    const uint32_t r0 = ctx->r[0], r1 = ctx->r[1], r2 = ctx->r[2], r3 = ctx->r[3], r4 = ctx->r[4];
+    const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+
+    while (len > 0) {
+        uint8_t block[16] = { 0 };
+        size_t n = len < 16 ? len : 16;
+        memcpy(block, data, n);
+        data += n;
+        len -= n;
+
+        h0 += load32_le(block) & 0x3ffffff;
+        h1 += (load32_le(block + 3) >> 2) & 0x3ffffff;
+        h2 += (load32_le(block + 6) >> 4) & 0x3ffffff;
+        h3 += (load32_le(block + 9) >> 6) & 0x3ffffff;
+        h4 += (load32_le(block + 12) >> 8) | (1u << 24);
+
+        uint64_t d0 = (uint64_t)h0 * r0 + (uint64_t)h1 * s4 + (uint64_t)h2 * s3 + (uint64_t)h3 * s2 + (uint64_t)h4 * s1;
+        uint64_t d1 = (uint64_t)h0 * r1 + (uint64_t)h1 * r0 + (uint64_t)h2 * s4 + (uint64_t)h3 * s3 + (uint64_t)h4 * s2;
+        uint64_t d2 = (uint64_t)h0 * r2 + (uint64_t)h1 * r1 + (uint64_t)h2 * r0 + (uint64_t)h3 * s4 + (uint64_t)h4 * s3;
+        uint64_t d3 = (uint64_t)h0 * r3 + (uint64_t)h1 * r2 + (uint64_t)h2 * r1 + (uint64_t)h3 * r0 + (uint64_t)h4 * s4;
+        uint64_t d4 = (uint64_t)h0 * r4 + (uint64_t)h1 * r3 + (uint64_t)h2 * r2 + (uint64_t)h3 * r1 + (uint64_t)h4 * r0;
+
+        uint32_t c = (uint32_t)(d0 >> 26);
+        h0 = (uint32_t)d0 & 0x3ffffff;
+        d1 += c;
+        c = (uint32_t)(d1 >> 26);
+        h1 = (uint32_t)d1 & 0x3ffffff;
+        d2 += c;
+        c = (uint32_t)(d2 >> 26);
+        h2 = (uint32_t)d2 & 0x3ffffff;
+        d3 += c;
+        c = (uint32_t)(d3 >> 26);
+        h3 = (uint32_t)d3 & 0x3ffffff;
+        d4 += c;
+        c = (uint32_t)(d4 >> 26);
+        h4 = (uint32_t)d4 & 0x3ffffff;
+        h0 += c * 5;
+        c = h0 >> 26;
+        h0 &= 0x3ffffff;
+        h1 += c;
+    }
+
+    ctx->h[0] = h0;
+    ctx->h[1] = h1;
+    ctx->h[2] = h2;
+    ctx->h[3] = h3;
+    ctx->h[4] = h4;
+}
+
+static void poly1305_final(poly1305_t *ctx, uint8_t tag[16])
+{
+    uint32_t h0 = ctx->h[0], h1 = ctx->h[1], h2 = ctx->h[2], h3 = ctx->h[3], h4 = ctx->h[4];
+
+    uint32_t c = h1 >> 26;
+    h1 &= 0x3ffffff;
+    h2 += c;
+    c = h2 >> 26;
+    h2 &= 0x3ffffff;
+    h3 += c;
+    c = h3 >> 26;
+    h3 &= 0x3ffffff;
+    h4 += c;
+    c = h4 >> 26;
+    h4 &= 0x3ffffff;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= 0x3ffffff;
+    h1 += c;
+
+    // h - p, kept if h >= p
+    uint32_t g0 = h0 + 5;
+    c = g0 >> 26;
+    g0 &= 0x3ffffff;
+    uint32_t g1 = h1 + c;
+    c = g1 >> 26;
+    g1 &= 0x3ffffff;
+    uint32_t g2 = h2 + c;
+    c = g2 >> 26;
+    g2 &= 0x3ffffff;
+    uint32_t g3 = h3 + c;
+    c = g3 >> 26;
+    g3 &= 0x3ffffff;
+    uint32_t g4 = h4 + c - (1u << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    h0 = (h0 & ~mask) | (g0 & mask);
+    h1 = (h1 & ~mask) | (g1 & mask);
+    h2 = (h2 & ~mask) | (g2 & mask);
+    h3 = (h3 & ~mask) | (g3 & mask);
+    h4 = (h4 & ~mask) | (g4 & mask);
+
+    uint64_t f = (uint64_t)(h0 | (h1 << 26)) + ctx->pad[0];
+    store32_le(tag, (uint32_t)f);
+    f = (uint64_t)((h1 >> 6) | (h2 << 20)) + ctx->pad[1] + (f >> 32);
+    store32_le(tag + 4, (uint32_t)f);
+    f = (uint64_t)((h2 >> 12) | (h3 << 14)) + ctx->pad[2] + (f >> 32);
+    store32_le(tag + 8, (uint32_t)f);
+    f = (uint64_t)((h3 >> 18) | (h4 << 8)) + ctx->pad[3] + (f >> 32);
+    store32_le(tag + 12, (uint32_t)f);
+
+    wipe(ctx, sizeof(*ctx));
+}
+
+// ChaCha20-Poly1305 tag over aad and ciphertext (RFC 8439 2.8)
+static void aead_tag(const uint8_t key[32], const uint8_t nonce[12],
+                     const uint8_t *aad, size_t aad_len,
+                     const uint8_t *ciphertext, size_t len,
+                     uint8_t tag[16])
+{
+    uint8_t block[64];
+    chacha20_block(key, 0, nonce, block);
+
+    poly1305_t poly;
+    poly1305_init(&poly, block);
+    wipe(block, sizeof(block));
+
+    poly1305_blocks(&poly, aad, aad_len);
+    poly1305_blocks(&poly, ciphertext, len);
+
+    uint8_t lengths[16];
+    store64_le(lengths, aad_len);
+    store64_le(lengths + 8, len);
+    poly1305_blocks(&poly, lengths, 16);
+
+    poly1305_final(&poly, tag);
+}
+
+// base64url without padding
+
+static const char BASE64URL[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static size_t base64url_encode(const uint8_t *src, size_t len, char *dst)
+{
+    size_t j = 0;
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)src[i + 1] << 8;
+        if (i + 2 < len)
+            v |= src[i + 2];
+
+        dst[j++] = BASE64URL[(v >> 18) & 63];
+        dst[j++] = BASE64URL[(v >> 12) & 63];
+        if (i + 1 < len)
+            dst[j++] = BASE64URL[(v >> 6) & 63];
+        if (i + 2 < len)
+            dst[j++] = BASE64URL[v & 63];
+    }
+
+    dst[j] = '\0';
+    return j;
+}
+
+static int base64url_value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '-')
+        return 62;
+    if (c == '_')
+        return 63;
+    return -1;
+}
+
+// Returns the decoded length, or -1 on invalid input
+static long base64url_decode(const char *src, size_t len, uint8_t *dst)
+{
+    if (len % 4 == 1)
+        return -1;
+
+    size_t j = 0;
+    uint32_t v = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        int d = base64url_value(src[i]);
+        if (d < 0)
+            return -1;
+
+        v = (v << 6) | (uint32_t)d;
+        bits += 6;
+
+        if (bits >= 8) {
+            bits -= 8;
+            dst[j++] = (uint8_t)(v >> bits);
+        }
+    }
+
+    // Unused bits of the last character must be zero, one encoding per token
+    if (v & ((1u << bits) - 1))
+        return -1;
+
+    return (long)j;
+}
+
+// Keys
+
+static int cookie_keys_load(const SessionKey *keys, size_t count, bool encrypt)
+{
+    if (!keys || count == 0 || count > SESSION_MAX_KEYS) {
+        fprintf(stderr, "Session cookies need between 1 and %d keys\n", SESSION_MAX_KEYS);
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i].secret || keys[i].secret_len < SESSION_KEY_MIN_LEN) {
+            fprintf(stderr, "Session key %u must be at least %d bytes\n",
+                    (unsigned int)keys[i].id, SESSION_KEY_MIN_LEN);
+            return 0;
+        }
+
+        for (size_t j = 0; j < i; j++) {
+            if (keys[j].id == keys[i].id) {
+                fprintf(stderr, "Duplicate session key id: %u\n", (unsigned int)keys[i].id);
+                return 0;
+            }
+        }
+    }
+
+    wipe(&cookie_keys, sizeof(cookie_keys));
+
+    // Separate keys for signing and encryption, derived from each secret
+    static const char mac_label[] = "ecewo-session-mac";
+    static const char enc_label[] = "ecewo-session-enc";
+
+    for (size_t i = 0; i < count; i++) {
+        cookie_key_t *key = &cookie_keys.keys[i];
+        key->id = keys[i].id;
+        hmac_sha256(keys[i].secret, keys[i].secret_len,
+                    (const uint8_t *)mac_label, sizeof(mac_label) - 1, NULL, 0, key->mac_key);
+        hmac_sha256(keys[i].secret, keys[i].secret_len,
+                    (const uint8_t *)enc_label, sizeof(enc_label) - 1, NULL, 0, key->enc_key);
+    }
+
+    cookie_keys.key_count = count;
+    cookie_keys.encrypt = encrypt;
+    return 1;
+}
+
+int session_set_keys(const SessionKey *keys, size_t count)
+{
+    if (!cookie_mode()) {
+        fprintf(stderr, "Session keys can only be rotated in cookie mode\n");
+        return 0;
+    }
+
+    return cookie_keys_load(keys, count, cookie_keys.encrypt);
+}
+
+static const cookie_key_t *cookie_key_by_id(uint8_t id)
+{
+    for (size_t i = 0; i < cookie_keys.key_count; i++) {
+        if (cookie_keys.keys[i].id == id)
+            return &cookie_keys.keys[i];
+    }
+
+    return NULL;
+}
+
+// Sessions
+
+static char *session_grow_data(Session *sess, size_t new_cap)
+{
+    cookie_session_t *cookie = (cookie_session_t *)sess;
+
+    if (cookie_mode() && cookie->arena) {
+        // Arena memory can't be resized, the old buffer goes with the request
+        char *data = arena_alloc(cookie->arena, new_cap);
+        if (data && sess->data_len > 0)
+            memcpy(data, sess->data, sess->data_len);
+        return data;
+    }
+
+    return realloc(sess->data, new_cap);
+}
+
+static Session *cookie_session_new(Arena *arena, int max_age)
+{
+    cookie_session_t *cookie = arena ? arena_alloc(arena, sizeof(cookie_session_t)) : malloc(sizeof(cookie_session_t));
+    if (!cookie)
+        return NULL;
+
+    memset(cookie, 0, sizeof(cookie_session_t));
+    cookie->arena = arena;
+    cookie->max_age = max_age;
+
+    generate_session_id(cookie->session.id);
+    cookie->session.expires = time(NULL) + max_age;
+    return &cookie->session;
+}
+
+static Session *cookie_create(int max_age)
+{
+    return cookie_session_new(NULL, max_age);
+}
+
+// There is nothing to look up, the session comes with the request
+static Session *cookie_find(const char *id)
+{
+    (void)id;
+    return NULL;
+}
+
+static void cookie_session_free(Session *sess)
+{
+    cookie_session_t *cookie = (cookie_session_t *)sess;
+
+    if (!cookie->arena) {
+        free(sess->data);
+        free(cookie);
+        return;
+    }
+
+    memset(sess->id, 0, sizeof(sess->id));
+    sess->expires = 0;
+    sess->data_len = 0;
+}
+
+static size_t varint_put(uint8_t *p, uint32_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static bool varint_get(const uint8_t **p, const uint8_t *end, uint32_t *v)
+{
+    *v = 0;
+
+    for (int shift = 0; shift <= 14 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        *v |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+// The session as a cookie value; NULL if it doesn't fit in a cookie
+static char *cookie_session_encode(Arena *arena, const Session *sess)
+{
+    const cookie_key_t *key = &cookie_keys.keys[0];
+    size_t header_len = 2 + (cookie_keys.encrypt ? COOKIE_NONCE_LEN : 0);
+    size_t tag_len = cookie_keys.encrypt ? COOKIE_POLY_TAG_LEN : COOKIE_HMAC_LEN;
+
+    // Entries shrink: the slack goes away and each length takes at most 3 bytes
+    size_t max_len = header_len + COOKIE_FIXED_LEN + sess->data_len + tag_len;
+    uint8_t *raw = arena_alloc(arena, max_len);
+    if (!raw)
+        return NULL;
+
+    raw[0] = cookie_keys.encrypt ? COOKIE_SESSION_ENCRYPTED : COOKIE_SESSION_SIGNED;
+    raw[1] = key->id;
+
+    if (cookie_keys.encrypt && !get_random_bytes(raw + 2, COOKIE_NONCE_LEN)) {
+        fprintf(stderr, "Session cookie nonce could not be generated\n");
+        return NULL;
+    }
+
+    uint8_t *payload = raw + header_len;
+    uint8_t *p = payload;
+
+    store64_le(p, (uint64_t)(int64_t)sess->expires);
+    store32_le(p + 8, (uint32_t)((const cookie_session_t *)sess)->max_age);
+    memcpy(p + 12, sess->id, SESSION_ID_LEN);
+    p += COOKIE_FIXED_LEN;
+
+    const char *entry = sess->data;
+    const char *end = sess->data ? sess->data + sess->data_len : NULL;
+
+    while (entry && entry < end) {
+        entry_header_t header = read_entry_header(entry);
+        const char *entry_key = entry + sizeof(entry_header_t);
+
+        p += varint_put(p, header.key_len);
+        memcpy(p, entry_key, header.key_len);
+        p += header.key_len;
+        p += varint_put(p, header.value_len);
+        memcpy(p, entry_key + header.key_len, header.value_len);
+        p += header.value_len;
+
+        entry += entry_size(&header);
+    }
+
+    size_t payload_len = (size_t)(p - payload);
+
+    if (cookie_keys.encrypt) {
+        chacha20_xor(key->enc_key, 1, raw + 2, payload, payload_len);
+        aead_tag(key->enc_key, raw + 2, raw, 2, payload, payload_len, p);
+    } else {
+        hmac_sha256(key->mac_key, sizeof(key->mac_key), raw, header_len + payload_len, NULL, 0, p);
+    }
+
+    size_t raw_len = header_len + payload_len + tag_len;
+    size_t token_len = (raw_len + 2) / 3 * 4;
+
+    if (token_len > COOKIE_MAX_TOKEN_LEN) {
+        fprintf(stderr, "Session too large to be kept in a cookie: %zu bytes\n", token_len);
+        return NULL;
+    }
+
+    char *token = arena_alloc(arena, token_len + 1);
+    if (token)
+        base64url_encode(raw, raw_len, token);
+
+    return token;
+}
+
+static Session *cookie_session_decode(Arena *arena, const char *token, size_t token_len)
+{
+    if (token_len > COOKIE_MAX_TOKEN_LEN)
+        return NULL;
+
+    uint8_t *raw = arena_alloc(arena, token_len * 3 / 4 + 1);
+    if (!raw)
+        return NULL;
+
+    long decoded = base64url_decode(token, token_len, raw);
+    if (decoded < 2)
+        return NULL;
+
+    size_t raw_len = (size_t)decoded;
+    bool encrypted = raw[0] == COOKIE_SESSION_ENCRYPTED;
+
+    // A signed cookie is no substitute for an encrypted one, and vice versa
+    if (raw[0] != (cookie_keys.encrypt ? COOKIE_SESSION_ENCRYPTED : COOKIE_SESSION_SIGNED))
+        return NULL;
+
+    const cookie_key_t *key = cookie_key_by_id(raw[1]);
+    if (!key)
+        return NULL;
+
+    size_t header_len = 2 + (encrypted ? COOKIE_NONCE_LEN : 0);
+    size_t tag_len = encrypted ? COOKIE_POLY_TAG_LEN : COOKIE_HMAC_LEN;
+
+    if (raw_len < header_len + COOKIE_FIXED_LEN + tag_len)
+        return NULL;
+
+    uint8_t *payload = raw + header_len;
+    size_t payload_len = raw_len - header_len - tag_len;
+    uint8_t *tag = payload + payload_len;
+    uint8_t expected[COOKIE_HMAC_LEN];
+
+    if (encrypted) {
+        aead_tag(key->enc_key, raw + 2, raw, 2, payload, payload_len, expected);
+        if (!equal_ct(expected, tag, COOKIE_POLY_TAG_LEN))
+            return NULL;
+
+        chacha20_xor(key->enc_key, 1, raw + 2, payload, payload_len);
+    } else {
+        hmac_sha256(key->mac_key, sizeof(key->mac_key), raw, header_len + payload_len, NULL, 0, expected);
+        if (!equal_ct(expected, tag, COOKIE_HMAC_LEN))
+            return NULL;
+    }
+
+    time_t now = time(NULL);
+    time_t expires = (time_t)(int64_t)load64_le(payload);
+    int max_age = (int)load32_le(payload + 8);
+
+    if (expires < now)
+        return NULL;
+
+    // Authenticated, but still checked so a bug on the sending side can't overrun
+    const uint8_t *p = payload + COOKIE_FIXED_LEN;
+    const uint8_t *end = payload + payload_len;
+    size_t data_len = 0;
+
+    while (p < end) {
+        uint32_t key_len, value_len;
+
+        if (!varint_get(&p, end, &key_len) || key_len > (size_t)(end - p))
+            return NULL;
+        p += key_len;
+
+        if (!varint_get(&p, end, &value_len) || value_len > (size_t)(end - p) || value_len >= UINT16_MAX)
+            return NULL;
+        p += value_len;
+
+        size_t value_cap = (value_len + VALUE_CAPACITY_ALIGN) & ~(size_t)(VALUE_CAPACITY_ALIGN - 1);
+        if (value_cap > UINT16_MAX)
+            value_cap = value_len + 1;
+
+        data_len += sizeof(entry_header_t) + key_len + value_cap;
+    }
+
+    if (data_len > MAX_SESSION_DATA_SIZE)
+        return NULL;
+
+    Session *sess = cookie_session_new(arena, max_age);
+    if (!sess)
+        return NULL;
+
+    memcpy(sess->id, payload + 12, SESSION_ID_LEN);
+    sess->id[SESSION_ID_LEN] = '\0';
+    sess->expires = store.options.sliding_expiration ? now + max_age : expires;
+
+    if (data_len == 0)
+        return sess;
+
+    sess->data = arena_alloc(arena, data_len);
+    if (!sess->data)
+        return NULL;
+
+    sess->data_len = (uint32_t)data_len;
+    sess->data_cap = (uint32_t)data_len;
+
+    char *dest = sess->data;
+    p = payload + COOKIE_FIXED_LEN;
+
+    while (p < end) {
+        uint32_t key_len, value_len;
+
+        varint_get(&p, end, &key_len);
+        const uint8_t *entry_key = p;
+        p += key_len;
+        varint_get(&p, end, &value_len);
+        const uint8_t *value = p;
+        p += value_len;
+
+        size_t value_cap = (value_len + VALUE_CAPACITY_ALIGN) & ~(size_t)(VALUE_CAPACITY_ALIGN - 1);
+        if (value_cap > UINT16_MAX)
+            value_cap = value_len + 1;
+
+        entry_header_t header = {
+            .key_len = (uint16_t)key_len,
+            .value_len = (uint16_t)value_len,
+            .value_cap = (uint16_t)value_cap,
+        };
+
+        memcpy(dest, &header, sizeof(header));
+        memcpy(dest + sizeof(header), entry_key, key_len);
+        memcpy(dest + sizeof(header) + key_len, value, value_len);
+        memset(dest + sizeof(header) + key_len + value_len, 0, value_cap - value_len);
+        dest += sizeof(header) + key_len + value_cap;
+    }
+
+    return sess;
+}
+
+static Session *cookie_session_get(Req *req)
+{
+    Session *sess = get_context(req, COOKIE_SESSION_CONTEXT_KEY);
+    if (sess)
+        return sess->id[0] != '\0' ? sess : NULL;
+
+    size_t token_len = 0;
+    const char *token = cookie_get_view(req, "session", &token_len);
+    if (!token || token_len == 0)
+        return NULL;
+
+    void *span = metrics_trace_begin("session.lookup", NULL);
+    sess = cookie_session_decode(req->arena, token, token_len);
+    metrics_trace_end("session.lookup", span, sess != NULL);
+
+    metrics_inc(session_metrics.lookups);
+    if (sess)
+        set_context(req, COOKIE_SESSION_CONTEXT_KEY, sess);
+    else
+        metrics_inc(session_metrics.misses);
+
+    return sess;
+}
+
+int session_init_with(const SessionOptions *options)
+{
+    if (store.initialized)
+        return 1;
+
+    if (options)
+        store.options = *options;
+
+    session_metrics.sessions = metrics_gauge("ecewo_session_count", "Sessions in the in-process store");
+    session_metrics.expired = metrics_counter("ecewo_session_expired_total", "Sessions removed by expiry sweeps");
+    session_metrics.sweep_time = metrics_histogram("ecewo_session_sweep_seconds", "Time spent in expiry sweeps that removed sessions");
+    session_metrics.lookups = metrics_counter("ecewo_session_lookups_total", "Session lookups");
+    session_metrics.misses = metrics_counter("ecewo_session_lookup_misses_total", "Session lookups that found no valid session");
+
+    if (!get_random_bytes((unsigned char *)&store.seed, sizeof(store.seed)))
+        store.seed = (uint32_t)time(NULL);
+
+    if (!grow_slots() || !grow_buckets()) {
+        session_cleanup();
+        return 0;
+    }
+
+    store.backend = store.options.backend;
+
+    if (store.options.cookie_keys) {
+        if (!cookie_keys_load(store.options.cookie_keys, store.options.cookie_key_count, store.options.cookie_encrypt)) {
+            session_cleanup();
+            return 0;
+        }
+        store.backend = &cookie_backend;
+    }
+
+    if (!store.backend && store.options.shared_capacity > 0) {
+#ifdef __linux__
+        if (!shared_open(store.options.shared_capacity)) {
+            session_cleanup();
+            return 0;
+        }
+        store.backend = &shared_backend;
+#else
+        fprintf(stderr, "Shared sessions are supported on Linux only, using the local store\n");
+#endif
+    }
+
+    if (store.options.expiry_timer && !store.backend) {
+        store.timer = malloc(sizeof(uv_timer_t));
+        if (!store.timer || uv_timer_init(get_loop(), store.timer) != 0) {
+            fprintf(stderr, "Session expiry timer could not be started\n");
+            free(store.timer);
+            store.timer = NULL;
+        } else {
+            // Must not keep the loop alive on its own
+            uv_unref((uv_handle_t *)store.timer);
+        }
+    }
+
+    store.initialized = true;
+    return 1;
+}
+
+int session_init(void)
+{
+    return session_init_with(NULL);
+}
+
+void session_cleanup(void)
+{
+    if (store.backend && store.backend->cleanup)
+        store.backend->cleanup();
+
+    if (store.timer) {
+        uv_timer_stop(store.timer);
+        uv_close((uv_handle_t *)store.timer, on_timer_closed);
+    }
+
+    for (uint32_t i = 0; i < store.block_count; i++) {
+        for (uint32_t j = 0; j < SESSION_BLOCK_SIZE; j++)
+            free(store.blocks[i][j].session.data);
+        free(store.blocks[i]);
+    }
+
+    free(store.blocks);
+    free(store.free_slots);
+    free(store.heap);
+    free(store.buckets);
+    memset(&store, 0, sizeof(store));
+    wipe(&cookie_keys, sizeof(cookie_keys));
+    metrics_set(session_metrics.sessions, 0);
+}
+
+static Session *local_create(int max_age)
+{
+    expire_due_sessions();
+
+    if (store.free_count == 0 && !grow_slots())
+        return NULL;
+
+    if ((store.live_count + 1) * 2 > store.bucket_mask + 1 && !grow_buckets())
+        return NULL;
+
+    session_slot_t *slot = slot_at(store.free_slots[store.free_count - 1]);
+    Session *sess = &slot->session;
+
+    do {
+        generate_session_id(sess->id);
+        slot->hash = hash_id(sess->id);
+    } while (index_lookup(sess->id, slot->hash));
+
+    sess->expires = time(NULL) + max_age;
+    slot->deadline = sess->expires;
+    slot->max_age = max_age;
+    sess->data = NULL; // Allocated on first session_value_set()
+    sess->data_len = 0;
+    sess->data_cap = 0;
+
+    store.free_count--;
+    bucket_place(store.buckets, store.bucket_mask, slot->hash, slot->index + 1);
+    store.live_count++;
+    metrics_set(session_metrics.sessions, store.live_count);
+
+    heap_push(slot);
+    schedule_expiry();
+
+    return sess;
+}
+
+static Session *local_find(const char *id)
+{
+    session_slot_t *slot = index_lookup(id, hash_id(id));
+    if (!slot)
+        return NULL;
+
+    time_t now = time(NULL);
+    if (slot->session.expires < now) {
+        local_free(&slot->session);
+        return NULL;
+    }
+
+    // O(1) touch, the heap catches up lazily in expire_due_sessions()
+    if (store.options.sliding_expiration)
+        slot->session.expires = now + slot->max_age;
+
+    return &slot->session;
+}
+
+Session *session_create(int max_age)
+{
+    if (!store.initialized && !session_init())
+        return NULL;
+
+    if (store.backend)
+        return store.backend->create(max_age);
+
+    return local_create(max_age);
+}
+
+Session *session_find(const char *id)
+{
+    if (!id || !store.initialized)
+        return NULL;
+
+    size_t len = 0;
+    while (len <= SESSION_ID_LEN && id[len] != '\0')
+        len++;
+
+    if (len != SESSION_ID_LEN)
+        return NULL;
+
+    void *span = metrics_trace_begin("session.lookup", NULL);
+    Session *sess = store.backend ? store.backend->find(id) : local_find(id);
+    metrics_trace_end("session.lookup", span, sess != NULL);
+
+    metrics_inc(session_metrics.lookups);
+    if (!sess)
+        metrics_inc(session_metrics.misses);
+
+    return sess;
+}
+
+static void session_changed(Session *sess)
+{
+    if (store.backend && store.backend->save)
+        store.backend->save(sess);
+}
+
+void session_value_set(Session *sess, const char *key, const char *value)
+{
+    if (!sess || !key || !value)
+        return;
+
+    size_t key_len = strlen(key);
+    size_t value_len = strlen(value);
+    if (key_len > UINT16_MAX || value_len >= UINT16_MAX) {
+        fprintf(stderr, "Session key or value too large\n");
+        return;
+    }
+
+    entry_header_t header;
+    char *entry = find_entry(sess, key, key_len, &header);
+
+    if (entry && value_len < header.value_cap) {
+        // Fits in the existing slot, overwrite in place
+        memcpy(entry + sizeof(entry_header_t) + key_len, value, value_len + 1);
+        header.value_len = (uint16_t)value_len;
+        memcpy(entry, &header, sizeof(header));
+        session_changed(sess);
+        return;
+    }
+
+    size_t value_cap = (value_len + VALUE_CAPACITY_ALIGN) & ~(size_t)(VALUE_CAPACITY_ALIGN - 1);
+    if (value_cap > UINT16_MAX)
+        value_cap = value_len + 1;
+
+    size_t needed = sizeof(entry_header_t) + key_len + value_cap;
+    size_t new_len = sess->data_len - (entry ? entry_size(&header) : 0) + needed;
+
+    if (new_len > MAX_SESSION_DATA_SIZE) {
+        fprintf(stderr, "Session data size limit exceeded\n");
+        return;
+    }
+
+    if (new_len > sess->data_cap) {
+        size_t new_cap = sess->data_cap ? sess->data_cap * 2 : 128;
+        while (new_cap < new_len)
+            new_cap *= 2;
+        if (new_cap > MAX_SESSION_DATA_SIZE)
+            new_cap = MAX_SESSION_DATA_SIZE;
+
+        char *new_data = session_grow_data(sess, new_cap);
+        if (!new_data)
+            return;
+
+        if (entry)
+            entry = new_data + (entry - sess->data);
+        sess->data = new_data;
+        sess->data_cap = (uint32_t)new_cap;
+    }
+
+    if (entry)
+        remove_entry(sess, entry, &header);
+
+    header.key_len = (uint16_t)key_len;
+    header.value_len = (uint16_t)value_len;
+    header.value_cap = (uint16_t)value_cap;
+
+    char *dest = sess->data + sess->data_len;
+    memcpy(dest, &header, sizeof(header));
+    memcpy(dest + sizeof(header), key, key_len);
+    memcpy(dest + sizeof(header) + key_len, value, value_len + 1);
+    sess->data_len += (uint32_t)needed;
+    session_changed(sess);
+}
+
+const char *session_value_get_view(Session *sess, const char *key, size_t *len)
+{
+    if (!sess || !key)
+        return NULL;
+
+    size_t key_len = strlen(key);
+    entry_header_t header;
+    char *entry = find_entry(sess, key, key_len, &header);
+    if (!entry)
+        return NULL;
+
+    if (len)
+        *len = header.value_len;
+
+    return entry + sizeof(entry_header_t) + key_len;
+}
+
+char *session_value_get(Session *sess, const char *key)
+{
+    size_t len = 0;
+    const char *view = session_value_get_view(sess, key, &len);
+    if (!view)
+        return NULL;
+
+    char *result = malloc(len + 1);
+    if (result)
+        memcpy(result, view, len + 1);
+
+    return result;
+}
+
+void session_value_remove(Session *sess, const char *key)
+{
+    if (!sess || !key)
+        return;
+
+    entry_header_t header;
+    char *entry = find_entry(sess, key, strlen(key), &header);
+    if (entry) {
+        remove_entry(sess, entry, &header);
+        session_changed(sess);
+    }
+}
+
+static void local_free(Session *sess)
+{
+    session_slot_t *slot = (session_slot_t *)sess;
+    index_remove(slot);
+    heap_remove(slot);
+    store.free_slots[store.free_count++] = slot->index;
+
+    memset(sess->id, 0, sizeof(sess->id));
+    sess->expires = 0;
+    if (sess->data) {
+        free(sess->data);
+        sess->data = NULL;
+    }
+    sess->data_len = 0;
+    sess->data_cap = 0;
+}
+
+void session_free(Session *sess)
+{
+    if (!sess || sess->id[0] == '\0')
+        return;
+
+    if (store.backend) {
+        store.backend->free(sess);
+        return;
+    }
+
+    local_free(sess);
+}
+
+Session *session_get(Req *req)
+{
+    if (!req)
+        return NULL;
+
+    if (cookie_mode())
+        return cookie_session_get(req);
+
+    char *sid = cookie_get(req, "session");
+    if (!sid)
+        return NULL;
+
+    Session *sess = session_find(sid);
+    // Note: cookie_get returns arena-allocated memory, so no need to free sid
+    return sess;
+}
+
+Session *session_start(Req *req, int max_age)
+{
+    if (!req || (!store.initialized && !session_init()))
+        return NULL;
+
+    Session *sess = session_get(req);
+    if (sess)
+        return sess;
+
+    if (!cookie_mode())
+        return session_create(max_age);
+
+    // Owned by the request, so handlers don't need to free it
+    sess = cookie_session_new(req->arena, max_age);
+    if (sess)
+        set_context(req, COOKIE_SESSION_CONTEXT_KEY, sess);
+
+    return sess;
+}
+
+static void print_session_data(const char *data, uint32_t data_len)
+{
+    if (data_len == 0) {
+        printf("      (empty)\n");
+        return;
+    }
+
+    const char *entry = data;
+    const char *end = data + data_len;
+
+    while (entry < end) {
+        entry_header_t header = read_entry_header(entry);
+        const char *key = entry + sizeof(entry_header_t);
+
+        printf("      %.*s = %s\n", (int)header.key_len, key, key + header.key_len);
+        entry += entry_size(&header);
+    }
+}
+
+void session_print_all(void)
+{
+    time_t now = time(NULL);
+    printf("=== Sessions ===\n");
+
+    if (cookie_mode()) {
+        printf("Sessions are kept in cookies, there is nothing stored\n");
+        printf("================\n");
+        return;
+    }
+
+#ifdef __linux__
+    if (store.backend == &shared_backend) {
+        for (uint32_t i = 0; i < shared.header->capacity; i++) {
+            shared_slot_t *slot = &shared.slots[i];
+            shared_stripe_t *stripe = &shared.header->stripes[i & (SHARED_STRIPES - 1)];
+
+            shared_lock(stripe);
+            if (slot->id[0] != '\0') {
+                printf("[#%02u] id=%.8s..., expires in %lds\n",
+                       (unsigned int)i, slot->id, (long)(slot->expires - now));
+                print_session_data(slot->data, slot->data_len);
+            }
+            shared_unlock(stripe);
+        }
+        printf("================\n");
+        return;
+    }
+#endif
+
+    uint32_t capacity = slot_capacity();
+    for (uint32_t i = 0; i < capacity; i++) {
+        Session *s = &slot_at(i)->session;
+        if (s->id[0] == '\0')
+            continue;
+
+        printf("[#%02u] id=%.8s..., expires in %lds\n",
+               (unsigned int)i, s->id, (long)(s->expires - now));
+
+        print_session_data(s->data, s->data_len);
+    }
+    printf("================\n");
+}
+
+void session_send(Res *res, Session *sess, Cookie *options)
+{
+    if (!res || !sess || sess->id[0] == '\0') {
+        fprintf(stderr, "Error on session sending\n");
+        return;
+    }
+
+    time_t now = time(NULL);
+    int max_age = (int)difftime(sess->expires, now);
+    if (max_age < 0)
+        return;
+
+    Cookie opts = options ? *options : SESSION_COOKIE_DEFAULTS;
+    opts.max_age = max_age;
+
+    if (cookie_mode()) {
+        char *token = cookie_session_encode(res->arena, sess);
+        if (token)
+            cookie_set(res, "session", token, &opts);
+        return;
+    }
 
     cookie_set(res, "session", sess->id, &opts);
 }
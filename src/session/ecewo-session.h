@@ -12,16 +12,54 @@ extern "C" {
 
 #define SESSION_ID_LEN 32
 #define MAX_SESSIONS_DEFAULT 10
+#define SESSION_MAX_KEYS 8
+#define SESSION_KEY_MIN_LEN 32
 
 typedef struct
 {
     char id[SESSION_ID_LEN + 1];
-    char *data;
+    char *data; // Packed key/value entries, use the session_value_* functions
+    uint32_t data_len;
+    uint32_t data_cap;
     time_t expires;
 } Session;
 
+// Pluggable session store. Returned sessions are owned by the backend;
+// the session_value_* functions edit sess->data in place and call save()
+// afterwards so the backend can persist the change.
+typedef struct
+{
+    Session *(*create)(int max_age);
+    Session *(*find)(const char *id);
+    void (*free)(Session *sess);
+    void (*save)(Session *sess); // Optional
+    void (*cleanup)(void); // Optional, called from session_cleanup()
+} SessionBackend;
+
+// Secret for cookie sessions. The id is stored in every cookie, so a key
+// can be retired while cookies it signed are still accepted by the others.
+typedef struct
+{
+    uint8_t id;
+    const unsigned char *secret; // At least SESSION_KEY_MIN_LEN random bytes, copied on init
+    size_t secret_len;
+} SessionKey;
+
+typedef struct
+{
+    bool sliding_expiration; // Extend a session by its max_age on every lookup, default: false
+    bool expiry_timer; // Reclaim expired sessions from a timer on get_loop(), default: false
+    size_t shared_capacity; // Linux: share up to N sessions between cluster workers, default: 0 (off)
+    const SessionBackend *backend; // Custom store, overrides shared_capacity, default: NULL
+    const SessionKey *cookie_keys; // Keep sessions in signed cookies instead, overrides backend, default: NULL
+    size_t cookie_key_count; // cookie_keys[0] signs new cookies, all of them are accepted
+    bool cookie_encrypt; // Encrypt cookie sessions instead of only signing them, default: false
+} SessionOptions;
+
 int session_init(void);
 
+int session_init_with(const SessionOptions *options);
+
 void session_cleanup(void);
 
 Session *session_create(int max_age);
@@ -32,12 +70,24 @@ void session_value_set(Session *sess, const char *key, const char *value);
 
 char *session_value_get(Session *sess, const char *key);
 
+// Returns a pointer into the session store, valid until the next
+// session_value_set/remove on this session. Do not free it.
+const char *session_value_get_view(Session *sess, const char *key, size_t *len);
+
 void session_value_remove(Session *sess, const char *key);
 
 void session_free(Session *sess);
 
 Session *session_get(Req *req);
 
+// Returns the session of the request, or a new one if it has none
+// In cookie mode the new session lives in the request arena, do not free it
+Session *session_start(Req *req, int max_age);
+
+// Replace the cookie session keys, e.g. to rotate them at runtime
+// returns 1 on success, 0 on failure
+int session_set_keys(const SessionKey *keys, size_t count);
+
 void session_send(Res *res, Session *sess, Cookie *options);
 
 void session_destroy(Res *res, Session *sess, Cookie *options);
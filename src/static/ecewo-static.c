@@ -1,213 +1,1928 @@
 #include "ecewo-static.h"
 #include "ecewo-fs.h"
+#include "ecewo-metrics.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
 
-static const char *get_mime_type(const char *path)
-{
-    const char *ext = strrchr(path, '.');
-    if (!ext)
-        return "application/octet-stream";
-
-    // Common web file types
-    if (strcmp(ext, ".html") == 0 || strcmp(ext, ".htm") == 0)
-        return "text/html";
-    if (strcmp(ext, ".css") == 0)
-        return "text/css";
-    if (strcmp(ext, ".js") == 0)
-        return "application/javascript";
-    if (strcmp(ext, ".json") == 0)
-        return "application/json";
-    if (strcmp(ext, ".xml") == 0)
-        return "application/xml";
-
-    // Images
-    if (strcmp(ext, ".png") == 0)
-        return "image/png";
-    if (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0)
-        return "image/jpeg";
-    if (strcmp(ext, ".gif") == 0)
-        return "image/gif";
-    if (strcmp(ext, ".svg") == 0)
-        return "image/svg+xml";
-    if (strcmp(ext, ".ico") == 0)
-        return "image/x-icon";
-    if (strcmp(ext, ".webp") == 0)
-        return "image/webp";
-
-    // Fonts
-    if (strcmp(ext, ".woff") == 0)
-        return "font/woff";
-    if (strcmp(ext, ".woff2") == 0)
-        return "font/woff2";
-    if (strcmp(ext, ".ttf") == 0)
-        return "font/ttf";
-    if (strcmp(ext, ".otf") == 0)
-        return "font/otf";
-
-    // Documents
-    if (strcmp(ext, ".pdf") == 0)
-        return "application/pdf";
-    if (strcmp(ext, ".txt") == 0)
-        return "text/plain";
-
-    // Media
-    if (strcmp(ext, ".mp4") == 0)
-        return "video/mp4";
-    if (strcmp(ext, ".webm") == 0)
-        return "video/webm";
-    if (strcmp(ext, ".mp3") == 0)
-        return "audio/mpeg";
-    if (strcmp(ext, ".wav") == 0)
-        return "audio/wav";
-
-    return "application/octet-stream";
+#ifdef _WIN32
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef ECEWO_STATIC_ZLIB
+#include <zlib.h>
+#endif
+
+#define TRACE_SPAN "static.send_file"
+
+// Registered by the first serve_file(), hits and misses count mounts with a cache
+static struct
+{
+    bool registered;
+    Metric *hits;
+    Metric *misses;
+    Metric *bytes;
+} static_metrics;
+
+static void static_metrics_register(void)
+{
+    if (static_metrics.registered)
+        return;
+
+    static_metrics.registered = true;
+    static_metrics.hits = metrics_counter("ecewo_static_cache_hits_total", "Files served from the in-memory cache");
+    static_metrics.misses = metrics_counter("ecewo_static_cache_misses_total", "Files of cached mounts read from disk");
+    static_metrics.bytes = metrics_counter("ecewo_static_sent_bytes_total", "File bytes sent, headers excluded");
+}
+
+// ============================================================================
+// MIME TYPES
+// ============================================================================
+
+#define MIME_MAX_EXT 16
+
+typedef struct
+{
+    const char *ext; // Lowercase, without the dot
+    const char *content_type; // Final header value, charset included
+} mime_entry_t;
+
+typedef struct
+{
+    mime_entry_t *items;
+    size_t count;
+    size_t capacity;
+} mime_table_t;
+
+// Sorted by extension for bsearch()
+static const mime_entry_t builtin_mime_types[] = {
+    { "avif", "image/avif" },
+    { "css", "text/css; charset=utf-8" },
+    { "csv", "text/csv; charset=utf-8" },
+    { "gif", "image/gif" },
+    { "htm", "text/html; charset=utf-8" },
+    { "html", "text/html; charset=utf-8" },
+    { "ico", "image/x-icon" },
+    { "jpeg", "image/jpeg" },
+    { "jpg", "image/jpeg" },
+    { "js", "application/javascript; charset=utf-8" },
+    { "json", "application/json; charset=utf-8" },
+    { "map", "application/json; charset=utf-8" },
+    { "md", "text/markdown; charset=utf-8" },
+    { "mjs", "application/javascript; charset=utf-8" },
+    { "mp3", "audio/mpeg" },
+    { "mp4", "video/mp4" },
+    { "ogg", "audio/ogg" },
+    { "otf", "font/otf" },
+    { "pdf", "application/pdf" },
+    { "png", "image/png" },
+    { "svg", "image/svg+xml" },
+    { "ttf", "font/ttf" },
+    { "txt", "text/plain; charset=utf-8" },
+    { "wasm", "application/wasm" },
+    { "wav", "audio/wav" },
+    { "webm", "video/webm" },
+    { "webp", "image/webp" },
+    { "woff", "font/woff" },
+    { "woff2", "font/woff2" },
+    { "xml", "application/xml; charset=utf-8" },
+};
+
+#define DEFAULT_CONTENT_TYPE "application/octet-stream"
+
+// Added with static_add_mime_type(), consulted before the built-in table
+static mime_table_t custom_mime_types = { 0 };
+
+static int compare_mime_entry(const void *key, const void *item)
+{
+    return strcmp((const char *)key, ((const mime_entry_t *)item)->ext);
+}
+
+static const char *mime_table_find(const mime_entry_t *items, size_t count, const char *ext)
+{
+    if (count == 0)
+        return NULL;
+
+    const mime_entry_t *entry = bsearch(ext, items, count, sizeof(mime_entry_t), compare_mime_entry);
+    return entry ? entry->content_type : NULL;
+}
+
+// Lowercases the extension of path into buf, false when there is none
+static bool extract_extension(const char *path, char *buf)
+{
+    const char *dot = strrchr(path, '.');
+    const char *slash = strrchr(path, '/');
+    if (!dot || (slash && dot < slash))
+        return false;
+
+    size_t len = strlen(dot + 1);
+    if (len == 0 || len >= MIME_MAX_EXT)
+        return false;
+
+    for (size_t i = 0; i <= len; i++) {
+        char c = dot[1 + i];
+        buf[i] = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+    }
+    return true;
+}
+
+static bool normalize_extension(const char *ext, char *buf)
+{
+    if (*ext == '.')
+        ext++;
+
+    size_t len = strlen(ext);
+    if (len == 0 || len >= MIME_MAX_EXT || strchr(ext, '.') || strchr(ext, '/'))
+        return false;
+
+    for (size_t i = 0; i <= len; i++)
+        buf[i] = (ext[i] >= 'A' && ext[i] <= 'Z') ? (char)(ext[i] - 'A' + 'a') : ext[i];
+    return true;
+}
+
+// Text types get "; charset=utf-8" unless a charset is already given
+static char *make_content_type(const char *type)
+{
+    bool text = strncmp(type, "text/", 5) == 0
+        || strcmp(type, "application/javascript") == 0
+        || strcmp(type, "application/json") == 0
+        || strcmp(type, "application/xml") == 0;
+
+    if (!text || strchr(type, ';'))
+        return strdup(type);
+
+    size_t len = strlen(type) + sizeof("; charset=utf-8");
+    char *content_type = malloc(len);
+    if (content_type)
+        snprintf(content_type, len, "%s; charset=utf-8", type);
+
+    return content_type;
+}
+
+// Inserts or replaces, keeping the table sorted
+static bool mime_table_set(mime_table_t *table, const char *ext, const char *type)
+{
+    char normalized[MIME_MAX_EXT];
+    if (!ext || !type || !normalize_extension(ext, normalized))
+        return false;
+
+    char *content_type = make_content_type(type);
+    if (!content_type)
+        return false;
+
+    size_t pos = 0;
+    while (pos < table->count && strcmp(table->items[pos].ext, normalized) < 0)
+        pos++;
+
+    if (pos < table->count && strcmp(table->items[pos].ext, normalized) == 0) {
+        free((char *)table->items[pos].content_type);
+        table->items[pos].content_type = content_type;
+        return true;
+    }
+
+    if (table->count >= table->capacity) {
+        size_t new_capacity = table->capacity == 0 ? 8 : table->capacity * 2;
+        mime_entry_t *new_items = realloc(table->items, new_capacity * sizeof(mime_entry_t));
+        if (!new_items) {
+            free(content_type);
+            return false;
+        }
+        table->items = new_items;
+        table->capacity = new_capacity;
+    }
+
+    char *ext_copy = strdup(normalized);
+    if (!ext_copy) {
+        free(content_type);
+        return false;
+    }
+
+    memmove(&table->items[pos + 1], &table->items[pos], (table->count - pos) * sizeof(mime_entry_t));
+    table->items[pos].ext = ext_copy;
+    table->items[pos].content_type = content_type;
+    table->count++;
+    return true;
+}
+
+static void mime_table_free(mime_table_t *table)
+{
+    for (size_t i = 0; i < table->count; i++) {
+        free((char *)table->items[i].ext);
+        free((char *)table->items[i].content_type);
+    }
+
+    free(table->items);
+    table->items = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+// Per-mount overrides win over static_add_mime_type(), which wins over the
+// built-in table. The result is stable until static_cleanup().
+static const char *get_content_type(const mime_table_t *mount_types, const char *path)
+{
+    char ext[MIME_MAX_EXT];
+    if (!extract_extension(path, ext))
+        return DEFAULT_CONTENT_TYPE;
+
+    const char *type = NULL;
+    if (mount_types)
+        type = mime_table_find(mount_types->items, mount_types->count, ext);
+    if (!type)
+        type = mime_table_find(custom_mime_types.items, custom_mime_types.count, ext);
+    if (!type)
+        type = mime_table_find(builtin_mime_types, sizeof(builtin_mime_types) / sizeof(builtin_mime_types[0]), ext);
+
+    return type ? type : DEFAULT_CONTENT_TYPE;
+}
+
+void static_add_mime_type(const char *ext, const char *type)
+{
+    if (!mime_table_set(&custom_mime_types, ext, type))
+        fprintf(stderr, "static_add_mime_type: Invalid extension or memory allocation failed\n");
+}
+
+static bool is_safe_path(const char *path)
+{
+    if (strstr(path, "..") != NULL)
+        return false;
+
+    if (strstr(path, "//") != NULL)
+        return false;
+
+    return true;
+}
+
+typedef struct static_ctx_s static_ctx_t;
+
+typedef enum
+{
+    ENCODING_IDENTITY = 0,
+    ENCODING_GZIP,
+    ENCODING_BR,
+} content_encoding_t;
+
+#define ENCODING_BIT(e) (1u << (e))
+
+static const struct
+{
+    const char *name;
+    const char *ext;
+} encodings[] = {
+    [ENCODING_IDENTITY] = { NULL, "" },
+    [ENCODING_GZIP] = { "gzip", ".gz" },
+    [ENCODING_BR] = { "br", ".br" },
+};
+
+// Preferred first
+static const content_encoding_t encoding_order[] = { ENCODING_BR, ENCODING_GZIP };
+
+typedef struct
+{
+    char etag[48];
+    char last_modified[32];
+    int64_t mtime;
+} file_validators_t;
+
+typedef struct
+{
+    char *if_none_match;
+    int64_t if_modified_since; // -1 when absent or unparsable
+    char *range;
+    char *if_range;
+} conditional_t;
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t end; // Inclusive
+} byte_range_t;
+
+typedef struct
+{
+    Res *res;
+    const char *mime_type;
+    static_ctx_t *mount; // NULL for send_file()
+    char *path; // Requested file, the cache key
+    char *file_path; // File actually served, a precompressed sibling or path
+    content_encoding_t encoding; // Encoding of file_path
+    uint8_t accepted; // Encodings the client accepts
+    uint8_t pending; // Siblings not stat'ed yet
+    uint8_t missing; // Siblings found not to exist
+    bool cacheable;
+    file_validators_t validators;
+    conditional_t cond;
+    byte_range_t range; // Window being read by fs_read_range()
+    uint64_t file_size;
+    void *span; // Trace token, handed to the stream of large files
+    bool head;
+    bool streaming;
+    bool failed;
+} async_file_ctx_t;
+
+typedef struct
+{
+    uv_write_t req;
+    char *data;
+} write_req_t;
+
+static void on_write_complete(uv_write_t *req, int status)
+{
+    (void)status;
+    write_req_t *wr = (write_req_t *)req;
+    if (wr->data)
+        free(wr->data);
+    free(wr);
+}
+
+static void send_response_manual(uv_tcp_t *socket, int status_code, const char *content_type, const char *body, size_t body_len, bool keep_alive)
+{
+    if (!socket || uv_is_closing((uv_handle_t *)socket))
+        return;
+
+    const char *status_text = "OK";
+    if (status_code == 404)
+        status_text = "Not Found";
+    else if (status_code == 403)
+        status_text = "Forbidden";
+    else if (status_code == 500)
+        status_text = "Internal Server Error";
+
+    size_t header_size = 512;
+    size_t total_size = header_size + body_len;
+    char *response = malloc(total_size);
+    if (!response)
+        return;
+
+    int header_len = snprintf(response, header_size,
+                              "HTTP/1.1 %d %s\r\n"
+                              "Content-Type: %s\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: %s\r\n"
+                              "\r\n",
+                              status_code, status_text,
+                              content_type,
+                              body_len,
+                              keep_alive ? "keep-alive" : "close");
+
+    if (body && body_len > 0)
+        memcpy(response + header_len, body, body_len);
+
+    write_req_t *wr = malloc(sizeof(write_req_t));
+    if (!wr) {
+        free(response);
+        return;
+    }
+
+    wr->data = response;
+    uv_buf_t buf = uv_buf_init(response, header_len + body_len);
+
+    if (uv_write(&wr->req, (uv_stream_t *)socket, &buf, 1, on_write_complete) != 0) {
+        free(response);
+        free(wr);
+    }
+}
+
+static void send_error_manual(uv_tcp_t *socket, int status_code, const char *message)
+{
+    send_response_manual(socket, status_code, "text/plain", message, strlen(message), false);
+}
+
+// ============================================================================
+// FILE CACHE
+// ============================================================================
+
+#define CACHE_DEFAULT_MAX_ENTRY (1024 * 1024)
+#define CACHE_INITIAL_BUCKETS 64
+
+typedef struct static_cache_s static_cache_t;
+typedef struct static_cache_entry_s static_cache_entry_t;
+
+struct static_cache_entry_s
+{
+    uv_fs_event_t watcher; // Evicts the entry when the file changes
+    static_cache_t *cache;
+    char *path; // Requested file, with encoding forms the key
+    content_encoding_t encoding;
+    uint32_t hash;
+    char *data;
+    size_t size;
+    const char *mime_type;
+    file_validators_t validators; // Strong, content based ETag
+    uint8_t missing; // Identity only: siblings known not to exist
+    bool compressing; // Identity only: a gzip job is running
+    static_cache_entry_t *next; // Bucket chain
+    static_cache_entry_t *lru_prev;
+    static_cache_entry_t *lru_next;
+};
+
+struct static_cache_s
+{
+    static_cache_entry_t **buckets;
+    size_t bucket_count;
+    size_t entry_count;
+    static_cache_entry_t *lru_head; // Most recently used
+    static_cache_entry_t *lru_tail;
+    size_t bytes;
+    size_t max_bytes;
+    size_t max_entry;
+};
+
+struct static_ctx_s
+{
+    char *mount_path;
+    char *dir_path;
+    size_t mount_len;
+    Static options;
+    char cache_control[48];
+    mime_table_t mime_types; // From options.mime_types
+    static_cache_t *cache; // NULL unless options.cache_max_bytes > 0
+    bool compress; // options.compress, and it can actually run
+};
+
+static uint32_t hash_path(const char *path, content_encoding_t encoding)
+{
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    hash ^= (uint32_t)encoding;
+    hash *= 16777619u;
+    return hash;
+}
+
+static static_cache_t *cache_create(size_t max_bytes, size_t max_entry)
+{
+    static_cache_t *cache = calloc(1, sizeof(static_cache_t));
+    if (!cache)
+        return NULL;
+
+    cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(static_cache_entry_t *));
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->bucket_count = CACHE_INITIAL_BUCKETS;
+    cache->max_bytes = max_bytes;
+    cache->max_entry = max_entry;
+    return cache;
+}
+
+static void lru_unlink(static_cache_t *cache, static_cache_entry_t *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(static_cache_t *cache, static_cache_entry_t *entry)
+{
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = entry;
+    cache->lru_head = entry;
+    if (!cache->lru_tail)
+        cache->lru_tail = entry;
+}
+
+static void on_entry_closed(uv_handle_t *handle)
+{
+    static_cache_entry_t *entry = (static_cache_entry_t *)handle->data;
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+static void cache_evict(static_cache_entry_t *entry)
+{
+    static_cache_t *cache = entry->cache;
+
+    static_cache_entry_t **link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while (*link && *link != entry)
+        link = &(*link)->next;
+    if (*link)
+        *link = entry->next;
+
+    lru_unlink(cache, entry);
+    cache->bytes -= entry->size;
+    cache->entry_count--;
+
+    uv_fs_event_stop(&entry->watcher);
+    uv_close((uv_handle_t *)&entry->watcher, on_entry_closed);
+}
+
+static static_cache_entry_t *cache_lookup(static_cache_t *cache, const char *path, content_encoding_t encoding)
+{
+    uint32_t hash = hash_path(path, encoding);
+    static_cache_entry_t *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+
+    for (; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->encoding == encoding && strcmp(entry->path, path) == 0) {
+            lru_unlink(cache, entry);
+            lru_push_front(cache, entry);
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void cache_grow_buckets(static_cache_t *cache)
+{
+    size_t new_count = cache->bucket_count * 2;
+    static_cache_entry_t **new_buckets = calloc(new_count, sizeof(static_cache_entry_t *));
+    if (!new_buckets)
+        return; // Keep the old table, chains just get longer
+
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        static_cache_entry_t *entry = cache->buckets[i];
+        while (entry) {
+            static_cache_entry_t *next = entry->next;
+            static_cache_entry_t **bucket = &new_buckets[entry->hash & (new_count - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = new_buckets;
+    cache->bucket_count = new_count;
+}
+
+static void on_cached_file_changed(uv_fs_event_t *handle, const char *filename, int events, int status)
+{
+    (void)filename;
+    (void)events;
+    (void)status;
+
+    cache_evict((static_cache_entry_t *)handle->data);
+}
+
+// Takes ownership of data on success. watch_path is the file the bytes came
+// from, which differs from path for precompressed siblings.
+static static_cache_entry_t *cache_insert(static_cache_t *cache, const char *path, content_encoding_t encoding, const char *watch_path, char *data, size_t size, const char *mime_type, const file_validators_t *validators)
+{
+    if (size > cache->max_entry || size > cache->max_bytes || cache_lookup(cache, path, encoding))
+        return NULL;
+
+    static_cache_entry_t *entry = calloc(1, sizeof(static_cache_entry_t));
+    if (!entry)
+        return NULL;
+
+    entry->path = strdup(path);
+    if (!entry->path) {
+        free(entry);
+        return NULL;
+    }
+
+    // The watcher keeps entries valid without a stat per request
+    entry->watcher.data = entry;
+    if (uv_fs_event_init(get_loop(), &entry->watcher) != 0) {
+        free(entry->path);
+        free(entry);
+        return NULL;
+    }
+
+    if (uv_fs_event_start(&entry->watcher, on_cached_file_changed, watch_path, 0) != 0) {
+        entry->data = NULL;
+        uv_close((uv_handle_t *)&entry->watcher, on_entry_closed);
+        return NULL;
+    }
+    uv_unref((uv_handle_t *)&entry->watcher);
+
+    while (cache->lru_tail && cache->bytes + size > cache->max_bytes)
+        cache_evict(cache->lru_tail);
+
+    if (cache->entry_count >= cache->bucket_count)
+        cache_grow_buckets(cache);
+
+    entry->cache = cache;
+    entry->encoding = encoding;
+    entry->hash = hash_path(path, encoding);
+    entry->data = data;
+    entry->size = size;
+    entry->mime_type = mime_type;
+    entry->validators = *validators;
+
+    static_cache_entry_t **bucket = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    lru_push_front(cache, entry);
+
+    cache->bytes += size;
+    cache->entry_count++;
+    return entry;
+}
+
+static void cache_destroy(static_cache_t *cache)
+{
+    if (!cache)
+        return;
+
+    while (cache->lru_head)
+        cache_evict(cache->lru_head);
+
+    free(cache->buckets);
+    free(cache);
+}
+
+// ============================================================================
+// VALIDATORS
+// ============================================================================
+
+// Dates are always in English, strftime() would follow the locale
+static const char *const day_names[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+};
+
+static const char *const month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+// Metadata only, so the ETag is weak: a same-second rewrite of the same size
+// would not change it
+static void validators_from_stat(file_validators_t *v, const uv_stat_t *stat)
+{
+    snprintf(v->etag, sizeof(v->etag), "W/\"%llx-%llx-%llx\"",
+             (unsigned long long)stat->st_ino,
+             (unsigned long long)stat->st_size,
+             (unsigned long long)stat->st_mtim.tv_sec);
+
+    v->mtime = (int64_t)stat->st_mtim.tv_sec;
+
+    time_t mtime = (time_t)v->mtime;
+    struct tm *gmt = gmtime(&mtime);
+    if (gmt)
+        snprintf(v->last_modified, sizeof(v->last_modified), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+                 day_names[gmt->tm_wday], gmt->tm_mday, month_names[gmt->tm_mon],
+                 gmt->tm_year + 1900, gmt->tm_hour, gmt->tm_min, gmt->tm_sec);
+    else
+        v->last_modified[0] = '\0';
+}
+
+// Content hash for cached files, a strong ETag
+static void validators_set_content_etag(file_validators_t *v, const char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+
+    snprintf(v->etag, sizeof(v->etag), "\"%016llx\"", (unsigned long long)hash);
+}
+
+// IMF-fixdate only ("Sun, 06 Nov 1994 08:49:37 GMT"), the one format we send
+static int64_t parse_http_date(const char *value)
+{
+    if (!value)
+        return -1;
+
+    char month[4];
+    int day, year, hour, min, sec;
+    if (sscanf(value, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day, month, &year, &hour, &min, &sec) != 6)
+        return -1;
+
+    int mon = -1;
+    for (int i = 0; i < 12; i++) {
+        if (strcmp(month, month_names[i]) == 0) {
+            mon = i + 1;
+            break;
+        }
+    }
+
+    if (mon < 0 || day < 1 || day > 31 || hour > 23 || min > 59 || sec > 60)
+        return -1;
+
+    // Days from civil, avoids timegm() which Windows lacks
+    int y = year - (mon <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+
+    return days * 86400 + hour * 3600 + min * 60 + sec;
+}
+
+static const char *skip_weak_prefix(const char *tag)
+{
+    return strncmp(tag, "W/", 2) == 0 ? tag + 2 : tag;
+}
+
+// Weak comparison over a comma separated If-None-Match list
+static bool etag_list_matches(const char *list, const char *etag)
+{
+    const char *ours = skip_weak_prefix(etag);
+    size_t ours_len = strlen(ours);
+
+    const char *p = list;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (!*p)
+            break;
+
+        if (*p == '*')
+            return true;
+
+        const char *start = skip_weak_prefix(p);
+        const char *end = strchr(start, ',');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+        while (len > 0 && (start[len - 1] == ' ' || start[len - 1] == '\t'))
+            len--;
+
+        if (len == ours_len && memcmp(start, ours, len) == 0)
+            return true;
+
+        if (!end)
+            break;
+        p = end + 1;
+    }
+
+    return false;
+}
+
+static bool not_modified(const static_ctx_t *mount, const conditional_t *cond, const file_validators_t *v)
+{
+    if (!mount || !mount->options.enable_etag)
+        return false;
+
+    // If-Modified-Since is ignored when If-None-Match is present
+    if (cond->if_none_match)
+        return etag_list_matches(cond->if_none_match, v->etag);
+
+    return cond->if_modified_since >= 0 && v->mtime <= cond->if_modified_since;
+}
+
+static bool negotiates_encoding(const static_ctx_t *mount)
+{
+    return mount && (mount->options.precompressed || mount->compress);
+}
+
+static void set_validator_headers(Res *res, const static_ctx_t *mount, const file_validators_t *v, content_encoding_t encoding)
+{
+    if (!mount)
+        return;
+
+    if (encoding != ENCODING_IDENTITY)
+        set_header(res, "Content-Encoding", encodings[encoding].name);
+    if (negotiates_encoding(mount))
+        set_header(res, "Vary", "Accept-Encoding");
+
+    if (mount->options.enable_etag) {
+        set_header(res, "ETag", v->etag);
+        if (v->last_modified[0])
+            set_header(res, "Last-Modified", v->last_modified);
+    }
+
+    if (mount->options.enable_cache)
+        set_header(res, "Cache-Control", mount->cache_control);
+
+    set_header(res, "Accept-Ranges", "bytes");
+}
+
+static void send_not_modified(Res *res, const static_ctx_t *mount, const file_validators_t *v, content_encoding_t encoding)
+{
+    set_validator_headers(res, mount, v, encoding);
+    reply(res, 304, NULL, 0);
+}
+
+// ============================================================================
+// RANGES
+// ============================================================================
+
+#define MAX_RANGES 16
+
+typedef struct
+{
+    byte_range_t items[MAX_RANGES];
+    int count;
+} range_set_t;
+
+typedef enum
+{
+    RANGE_NONE, // Serve the whole file
+    RANGE_PARTIAL,
+    RANGE_UNSATISFIABLE,
+} range_result_t;
+
+// If-Range needs a strong ETag match or the exact Last-Modified date
+static bool if_range_matches(const char *if_range, const file_validators_t *v)
+{
+    if (if_range[0] == '"' || strncmp(if_range, "W/", 2) == 0)
+        return v->etag[0] == '"' && strcmp(if_range, v->etag) == 0;
+
+    int64_t date = parse_http_date(if_range);
+    return date >= 0 && date == v->mtime;
+}
+
+static range_result_t select_ranges(const static_ctx_t *mount, const conditional_t *cond, const file_validators_t *v, uint64_t size, range_set_t *out)
+{
+    out->count = 0;
+
+    if (!mount || !cond->range || strncmp(cond->range, "bytes=", 6) != 0)
+        return RANGE_NONE;
+
+    if (cond->if_range && !if_range_matches(cond->if_range, v))
+        return RANGE_NONE;
+
+    const char *p = cond->range + 6;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (!*p)
+            break;
+
+        uint64_t start, end;
+        char *next;
+
+        if (*p == '-') {
+            // Suffix range: the last N bytes
+            uint64_t suffix = strtoull(p + 1, &next, 10);
+            if (next == p + 1)
+                return RANGE_NONE;
+            if (suffix == 0 || size == 0) {
+                p = next;
+                continue;
+            }
+            start = suffix < size ? size - suffix : 0;
+            end = size - 1;
+        } else {
+            start = strtoull(p, &next, 10);
+            if (next == p || *next != '-')
+                return RANGE_NONE;
+
+            p = next + 1;
+            if (*p >= '0' && *p <= '9') {
+                end = strtoull(p, &next, 10);
+                if (end < start)
+                    return RANGE_NONE;
+            } else {
+                end = UINT64_MAX;
+                next = (char *)p;
+            }
+
+            if (start >= size) {
+                p = next;
+                continue;
+            }
+            if (end >= size)
+                end = size - 1;
+        }
+
+        p = next;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p && *p != ',')
+            return RANGE_NONE;
+
+        // Too many ranges isn't worth it, send everything once instead
+        if (out->count == MAX_RANGES)
+            return RANGE_NONE;
+
+        out->items[out->count].start = start;
+        out->items[out->count].end = end;
+        out->count++;
+    }
+
+    return out->count > 0 ? RANGE_PARTIAL : RANGE_UNSATISFIABLE;
+}
+
+static void send_unsatisfiable(Res *res, uint64_t size)
+{
+    set_header(res, "Content-Range", arena_sprintf(res->arena, "bytes */%llu", (unsigned long long)size));
+    send_text(res, 416, "Range Not Satisfiable");
+}
+
+static void send_partial(Res *res, const static_ctx_t *mount, const file_validators_t *v, const char *mime_type, const byte_range_t *range, uint64_t size, const char *data)
+{
+    set_header(res, "Content-Type", mime_type);
+    set_validator_headers(res, mount, v, ENCODING_IDENTITY);
+    set_header(res, "Content-Range", arena_sprintf(res->arena, "bytes %llu-%llu/%llu",
+                                                   (unsigned long long)range->start,
+                                                   (unsigned long long)range->end,
+                                                   (unsigned long long)size));
+    reply(res, 206, data, (size_t)(range->end - range->start + 1));
+    metrics_add(static_metrics.bytes, range->end - range->start + 1);
+}
+
+static int format_part_header(char *buf, size_t buf_size, const char *boundary, const char *mime_type, const byte_range_t *range, uint64_t size)
+{
+    return snprintf(buf, buf_size,
+                    "\r\n--%s\r\n"
+                    "Content-Type: %s\r\n"
+                    "Content-Range: bytes %llu-%llu/%llu\r\n\r\n",
+                    boundary, mime_type,
+                    (unsigned long long)range->start,
+                    (unsigned long long)range->end,
+                    (unsigned long long)size);
+}
+
+static void send_multipart(Res *res, const static_ctx_t *mount, const file_validators_t *v, const char *mime_type, const range_set_t *ranges, const char *data, uint64_t size)
+{
+    static uint32_t boundary_counter = 0;
+    char boundary[40];
+    snprintf(boundary, sizeof(boundary), "ecewo-%08x%08x", (unsigned)uv_hrtime(), ++boundary_counter);
+
+    char part[512];
+    size_t body_len = strlen(boundary) + 8; // "\r\n--" boundary "--\r\n"
+    for (int i = 0; i < ranges->count; i++) {
+        const byte_range_t *r = &ranges->items[i];
+        body_len += (size_t)format_part_header(part, sizeof(part), boundary, mime_type, r, size);
+        body_len += (size_t)(r->end - r->start + 1);
+    }
+
+    char *body = malloc(body_len + 1);
+    if (!body) {
+        send_text(res, 500, "Memory allocation failed");
+        return;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < ranges->count; i++) {
+        const byte_range_t *r = &ranges->items[i];
+        n += (size_t)format_part_header(body + n, body_len + 1 - n, boundary, mime_type, r, size);
+        memcpy(body + n, data + r->start, (size_t)(r->end - r->start + 1));
+        n += (size_t)(r->end - r->start + 1);
+    }
+    n += (size_t)snprintf(body + n, body_len + 1 - n, "\r\n--%s--\r\n", boundary);
+
+    set_header(res, "Content-Type", arena_sprintf(res->arena, "multipart/byteranges; boundary=%s", boundary));
+    set_validator_headers(res, mount, v, ENCODING_IDENTITY);
+    reply(res, 206, body, n);
+    metrics_add(static_metrics.bytes, n);
+    free(body);
+}
+
+// Answers from a complete in-memory copy of the file
+static void send_file_bytes(Res *res, const static_ctx_t *mount, const conditional_t *cond, const file_validators_t *v, content_encoding_t encoding, const char *mime_type, const char *data, size_t size)
+{
+    if (not_modified(mount, cond, v)) {
+        send_not_modified(res, mount, v, encoding);
+        return;
+    }
+
+    range_set_t ranges;
+    range_result_t result = encoding == ENCODING_IDENTITY
+        ? select_ranges(mount, cond, v, size, &ranges)
+        : RANGE_NONE;
+
+    if (result == RANGE_UNSATISFIABLE) {
+        send_unsatisfiable(res, size);
+        return;
+    }
+
+    if (result == RANGE_PARTIAL && ranges.count == 1) {
+        send_partial(res, mount, v, mime_type, &ranges.items[0], size, data + ranges.items[0].start);
+        return;
+    }
+
+    if (result == RANGE_PARTIAL) {
+        send_multipart(res, mount, v, mime_type, &ranges, data, size);
+        return;
+    }
+
+    set_header(res, "Content-Type", mime_type);
+    set_validator_headers(res, mount, v, encoding);
+    reply(res, 200, data, size);
+    metrics_add(static_metrics.bytes, size);
+}
+
+static void send_cached_entry(Res *res, const static_ctx_t *mount, const conditional_t *cond, const static_cache_entry_t *entry)
+{
+    send_file_bytes(res, mount, cond, &entry->validators, entry->encoding, entry->mime_type, entry->data, entry->size);
+}
+
+// ============================================================================
+// CONTENT ENCODING
+// ============================================================================
+
+// Returns the ENCODING_BIT mask of acceptable encodings, q=0 excluded
+static uint8_t parse_accept_encoding(const char *header)
+{
+    if (!header)
+        return 0;
+
+    uint8_t accepted = 0;
+    uint8_t rejected = 0;
+    bool wildcard = false;
+
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        if (!*p)
+            break;
+
+        const char *name = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t')
+            p++;
+        size_t name_len = (size_t)(p - name);
+
+        bool zero_q = false;
+        const char *params_end = strchr(p, ',');
+        if (!params_end)
+            params_end = p + strlen(p);
+
+        const char *q = strstr(p, "q=");
+        if (q && q < params_end)
+            zero_q = strtod(q + 2, NULL) <= 0.0;
+
+        uint8_t bit = 0;
+        if (name_len == 2 && strncasecmp(name, "br", 2) == 0)
+            bit = ENCODING_BIT(ENCODING_BR);
+        else if (name_len == 4 && strncasecmp(name, "gzip", 4) == 0)
+            bit = ENCODING_BIT(ENCODING_GZIP);
+        else if (name_len == 1 && *name == '*')
+            wildcard = !zero_q;
+
+        if (zero_q)
+            rejected |= bit;
+        else
+            accepted |= bit;
+
+        p = params_end;
+    }
+
+    if (wildcard)
+        accepted |= ENCODING_BIT(ENCODING_BR) | ENCODING_BIT(ENCODING_GZIP);
+
+    return accepted & (uint8_t)~rejected;
+}
+
+#ifdef ECEWO_STATIC_ZLIB
+// Compares a Content-Type against a bare type, ignoring parameters
+static bool mime_is(const char *content_type, const char *type)
+{
+    size_t len = strlen(type);
+    return strncmp(content_type, type, len) == 0
+        && (content_type[len] == '\0' || content_type[len] == ';');
+}
+
+static bool is_compressible(const char *mime_type)
+{
+    return strncmp(mime_type, "text/", 5) == 0
+        || mime_is(mime_type, "application/javascript")
+        || mime_is(mime_type, "application/json")
+        || mime_is(mime_type, "application/xml")
+        || mime_is(mime_type, "image/svg+xml");
+}
+
+typedef struct compress_job_s compress_job_t;
+
+struct compress_job_s
+{
+    compress_job_t *next; // Jobs not done yet
+    uv_work_t work;
+    static_cache_t *cache; // NULL once static_cleanup() freed it
+    char *path;
+    char *input;
+    size_t input_len;
+    char *output;
+    size_t output_len;
+    const char *mime_type;
+    file_validators_t validators; // Of the identity entry when the job started
+};
+
+// Counted as async work, so the server waits for them on shutdown
+static compress_job_t *compress_jobs;
+
+static void compress_work(uv_work_t *req)
+{
+    compress_job_t *job = (compress_job_t *)req->data;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    // windowBits + 16 selects the gzip wrapper
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+
+    size_t bound = deflateBound(&zs, (uLong)job->input_len);
+    job->output = malloc(bound);
+    if (!job->output) {
+        deflateEnd(&zs);
+        return;
+    }
+
+    zs.next_in = (Bytef *)job->input;
+    zs.avail_in = (uInt)job->input_len;
+    zs.next_out = (Bytef *)job->output;
+    zs.avail_out = (uInt)bound;
+
+    if (deflate(&zs, Z_FINISH) == Z_STREAM_END) {
+        job->output_len = zs.total_out;
+    } else {
+        free(job->output);
+        job->output = NULL;
+    }
+
+    deflateEnd(&zs);
+}
+
+static void compress_done(uv_work_t *req, int status)
+{
+    compress_job_t *job = (compress_job_t *)req->data;
+
+    compress_job_t **link = &compress_jobs;
+    while (*link != job)
+        link = &(*link)->next;
+    *link = job->next;
+    decrement_async_work();
+
+    static_cache_entry_t *identity = job->cache ? cache_lookup(job->cache, job->path, ENCODING_IDENTITY) : NULL;
+
+    if (identity)
+        identity->compressing = false;
+
+    // Drop the result if the file changed while compressing, or it didn't pay off
+    bool usable = status == 0 && job->output && identity
+        && strcmp(identity->validators.etag, job->validators.etag) == 0
+        && job->output_len < job->input_len;
+
+    if (usable) {
+        file_validators_t validators = job->validators;
+        validators_set_content_etag(&validators, job->output, job->output_len);
+
+        if (cache_insert(job->cache, job->path, ENCODING_GZIP, job->path, job->output, job->output_len, job->mime_type, &validators))
+            job->output = NULL;
+    }
+
+    free(job->output);
+    free(job->input);
+    free(job->path);
+    free(job);
+}
+#endif
+
+// Pays the compression cost once per asset, in the threadpool. The identity
+// bytes keep being served until the gzip entry lands in the cache.
+static void maybe_compress(const static_ctx_t *mount, static_cache_entry_t *identity, uint8_t accepted)
+{
+#ifdef ECEWO_STATIC_ZLIB
+    if (!mount->compress || identity->compressing || !(accepted & ENCODING_BIT(ENCODING_GZIP)))
+        return;
+
+    // A real .gz sibling wins over compressing ourselves
+    if (mount->options.precompressed && !(identity->missing & ENCODING_BIT(ENCODING_GZIP)))
+        return;
+
+    if (!is_compressible(identity->mime_type) || identity->size < 256)
+        return;
+
+    compress_job_t *job = calloc(1, sizeof(compress_job_t));
+    if (!job)
+        return;
+
+    job->cache = mount->cache;
+    job->path = strdup(identity->path);
+    job->input = malloc(identity->size);
+    job->input_len = identity->size;
+    job->mime_type = identity->mime_type;
+    job->validators = identity->validators;
+    job->work.data = job;
+
+    if (!job->path || !job->input) {
+        free(job->path);
+        free(job->input);
+        free(job);
+        return;
+    }
+
+    memcpy(job->input, identity->data, identity->size);
+
+    if (uv_queue_work(get_loop(), &job->work, compress_work, compress_done) != 0) {
+        free(job->path);
+        free(job->input);
+        free(job);
+        return;
+    }
+
+    increment_async_work();
+    job->next = compress_jobs;
+    compress_jobs = job;
+    identity->compressing = true;
+#else
+    (void)mount;
+    (void)identity;
+    (void)accepted;
+#endif
+}
+
+static void free_file_ctx(async_file_ctx_t *ctx)
+{
+    if (!ctx->streaming)
+        metrics_trace_end(TRACE_SPAN, ctx->span, !ctx->failed);
+
+    free(ctx->cond.if_none_match);
+    free(ctx->cond.range);
+    free(ctx->cond.if_range);
+    free(ctx->file_path);
+    free(ctx->path);
+    free(ctx);
+}
+
+// ============================================================================
+// STREAMING
+// ============================================================================
+
+#ifndef _WIN32
+
+#define STREAM_CHUNK_SIZE (256 * 1024)
+
+// Large files never go through memory as a whole: the body is sent with
+// sendfile(2) one chunk at a time. When the socket buffer is full, one chunk
+// is read with fs_pread() and written through uv_write instead, whose
+// completion tells us the socket drained, so at most one chunk is in flight
+// per download. The file is opened and read through the fs module, so that
+// part uses its io_uring backend when active; sendfile itself goes through libuv.
+//
+// ecewo has no hook for streamed responses, so a stream takes the connection
+// over. It works on its own duplicate of the client socket, which stays ours
+// however long the download takes, sends "Connection: close" and shuts the
+// connection down when it is done. Streams of pipelined requests on one
+// connection run one after another, in the order they arrived.
+typedef struct file_stream_s file_stream_t;
+
+struct file_stream_s
+{
+    file_stream_t *next; // All streams, oldest first
+    uv_tcp_t conn; // Duplicate of the client socket
+    uint64_t conn_id; // Inode of the socket, the same for every duplicate
+    uv_fs_t fs_req; // sendfile, which the fs module doesn't wrap
+    uv_write_t write_req;
+    uv_shutdown_t shutdown_req;
+    char *path;
+    fs_file_t *file;
+    int64_t offset;
+    int64_t end;
+    char *header;
+    char *buffer; // Last chunk from fs_pread()
+    size_t buffer_len;
+    bool head; // HEAD request, the header is all there is to send
+    int64_t start;
+    void *span;
+};
+
+static file_stream_t *streams;
+
+static void stream_start(file_stream_t *stream);
+static void stream_next(file_stream_t *stream);
+
+static file_stream_t *stream_ahead_of(const file_stream_t *stream)
+{
+    for (file_stream_t *s = streams; s && s != stream; s = s->next) {
+        if (s->conn_id == stream->conn_id)
+            return s;
+    }
+
+    return NULL;
+}
+
+static void stream_free(file_stream_t *stream)
+{
+    free(stream->path);
+    free(stream->header);
+    free(stream->buffer);
+    free(stream);
+}
+
+static void on_stream_closed(uv_handle_t *handle)
+{
+    stream_free((file_stream_t *)handle->data);
+}
+
+// Takes the stream off the list, starts the next one on its connection
+// and closes the duplicate socket
+static void stream_release(file_stream_t *stream)
+{
+    file_stream_t **link = &streams;
+    while (*link != stream)
+        link = &(*link)->next;
+    *link = stream->next;
+
+    for (file_stream_t *s = stream->next; s; s = s->next) {
+        if (s->conn_id == stream->conn_id) {
+            if (!stream_ahead_of(s))
+                stream_start(s);
+            break;
+        }
+    }
+
+    uv_close((uv_handle_t *)&stream->conn, on_stream_closed);
+}
+
+static void on_stream_shutdown(uv_shutdown_t *req, int status)
+{
+    (void)status;
+    stream_release((file_stream_t *)req->data);
+}
+
+static void stream_finish(file_stream_t *stream, bool ok)
+{
+    metrics_add(static_metrics.bytes, (uint64_t)(stream->offset - stream->start));
+    metrics_trace_end(TRACE_SPAN, stream->span, ok);
+
+    if (stream->file)
+        fs_close(stream->file, NULL, NULL);
+
+    decrement_async_work();
+
+    // Runs after pending writes; the client closes its side in turn, which
+    // is how ecewo learns the connection is done
+    stream->shutdown_req.data = stream;
+    if (uv_shutdown(&stream->shutdown_req, (uv_stream_t *)&stream->conn, on_stream_shutdown) != 0)
+        stream_release(stream);
+}
+
+static void on_stream_chunk_written(uv_write_t *req, int status)
+{
+    file_stream_t *stream = (file_stream_t *)req->data;
+
+    if (status < 0) {
+        stream_finish(stream, false);
+        return;
+    }
+
+    stream->offset += (int64_t)stream->buffer_len;
+    stream_next(stream);
+}
+
+static void on_stream_chunk_read(const char *error, const char *data, size_t size, void *user_data)
+{
+    file_stream_t *stream = (file_stream_t *)user_data;
+
+    if (error || size == 0) {
+        free((char *)data);
+        stream_finish(stream, false);
+        return;
+    }
+
+    free(stream->buffer);
+    stream->buffer = (char *)data;
+    stream->buffer_len = size;
+    uv_buf_t buf = uv_buf_init(stream->buffer, (unsigned int)stream->buffer_len);
+
+    stream->write_req.data = stream;
+    if (uv_write(&stream->write_req, (uv_stream_t *)&stream->conn, &buf, 1, on_stream_chunk_written) != 0)
+        stream_finish(stream, false);
+}
+
+static void stream_buffered_chunk(file_stream_t *stream)
+{
+    int64_t remaining = stream->end - stream->offset;
+    size_t len = remaining < STREAM_CHUNK_SIZE ? (size_t)remaining : STREAM_CHUNK_SIZE;
+
+    fs_pread(stream->file, stream->offset, len, on_stream_chunk_read, stream);
+}
+
+static void on_stream_chunk_sent(uv_fs_t *req)
+{
+    file_stream_t *stream = (file_stream_t *)req->data;
+    ssize_t result = req->result;
+    uv_fs_req_cleanup(req);
+
+    if (result > 0) {
+        stream->offset += result;
+        stream_next(stream);
+        return;
+    }
+
+    if (result == UV_EAGAIN) {
+        stream_buffered_chunk(stream);
+        return;
+    }
+
+    // Client went away, or the file shrank under us
+    stream_finish(stream, false);
 }
 
-static bool is_safe_path(const char *path)
+static void stream_next(file_stream_t *stream)
 {
-    if (strstr(path, "..") != NULL)
-        return false;
+    if (stream->offset >= stream->end) {
+        stream_finish(stream, true);
+        return;
+    }
 
-    if (strstr(path, "//") != NULL)
-        return false;
+    // Writes still queued would land after bytes sent past the queue
+    if (uv_stream_get_write_queue_size((uv_stream_t *)&stream->conn) > 0) {
+        stream_buffered_chunk(stream);
+        return;
+    }
 
-    return true;
+    uv_os_fd_t socket_fd;
+    if (uv_fileno((uv_handle_t *)&stream->conn, &socket_fd) != 0) {
+        stream_finish(stream, false);
+        return;
+    }
+
+    int64_t remaining = stream->end - stream->offset;
+    size_t len = remaining < STREAM_CHUNK_SIZE ? (size_t)remaining : STREAM_CHUNK_SIZE;
+
+    // The one call that bypasses the fs module: it has no sendfile, so this
+    // runs on the libuv threadpool even with the io_uring backend
+    if (uv_fs_sendfile(get_loop(), &stream->fs_req, socket_fd, fs_file_fd(stream->file), stream->offset, len, on_stream_chunk_sent) != 0)
+        stream_finish(stream, false);
 }
 
-typedef struct
+static void on_stream_header_written(uv_write_t *req, int status)
 {
-    Res *res;
-    char *mime_type;
-} async_file_ctx_t;
+    file_stream_t *stream = (file_stream_t *)req->data;
 
-typedef struct
+    if (status < 0) {
+        stream_finish(stream, false);
+        return;
+    }
+
+    stream_next(stream);
+}
+
+// range is NULL for a 200 with the whole file
+static char *build_stream_header(const char *mime_type, uint64_t size, const byte_range_t *range, const static_ctx_t *mount, const file_validators_t *v, content_encoding_t encoding)
 {
-    uv_write_t req;
-    char *data;
-} write_req_t;
+    size_t len = 256 + strlen(mime_type);
+    if (mount)
+        len += strlen(mount->cache_control) + sizeof(v->etag) + sizeof(v->last_modified) + 128;
 
-static void on_write_complete(uv_write_t *req, int status)
+    char *header = malloc(len);
+    if (!header)
+        return NULL;
+
+    uint64_t content_length = range ? range->end - range->start + 1 : size;
+    int n = snprintf(header, len,
+                     "HTTP/1.1 %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %llu\r\n",
+                     range ? "206 Partial Content" : "200 OK",
+                     mime_type, (unsigned long long)content_length);
+
+    if (range)
+        n += snprintf(header + n, len - n, "Content-Range: bytes %llu-%llu/%llu\r\n",
+                      (unsigned long long)range->start,
+                      (unsigned long long)range->end,
+                      (unsigned long long)size);
+
+    if (encoding != ENCODING_IDENTITY)
+        n += snprintf(header + n, len - n, "Content-Encoding: %s\r\n", encodings[encoding].name);
+    if (negotiates_encoding(mount))
+        n += snprintf(header + n, len - n, "Vary: Accept-Encoding\r\n");
+
+    if (mount && mount->options.enable_etag) {
+        n += snprintf(header + n, len - n, "ETag: %s\r\n", v->etag);
+        if (v->last_modified[0])
+            n += snprintf(header + n, len - n, "Last-Modified: %s\r\n", v->last_modified);
+    }
+    if (mount && mount->options.enable_cache)
+        n += snprintf(header + n, len - n, "Cache-Control: %s\r\n", mount->cache_control);
+    if (mount)
+        n += snprintf(header + n, len - n, "Accept-Ranges: bytes\r\n");
+
+    snprintf(header + n, len - n, "Connection: close\r\n\r\n");
+    return header;
+}
+
+static void stream_write_header(file_stream_t *stream)
 {
-    (void)status;
-    write_req_t *wr = (write_req_t *)req;
-    if (wr->data)
-        free(wr->data);
-    free(wr);
+    uv_buf_t buf = uv_buf_init(stream->header, (unsigned int)strlen(stream->header));
+    stream->write_req.data = stream;
+    if (uv_write(&stream->write_req, (uv_stream_t *)&stream->conn, &buf, 1, on_stream_header_written) != 0)
+        stream_finish(stream, false);
 }
 
-static void send_response_manual(uv_tcp_t *socket, int status_code, const char *content_type, const char *body, size_t body_len, bool keep_alive)
+static void on_stream_open(const char *error, fs_file_t *file, void *user_data)
 {
-    if (!socket || uv_is_closing((uv_handle_t *)socket))
+    file_stream_t *stream = (file_stream_t *)user_data;
+
+    if (error) {
+        // Nothing has been written yet, the connection is still ours to answer on
+        send_error_manual(&stream->conn, 404, "File not found");
+        stream_finish(stream, false);
         return;
+    }
 
-    const char *status_text = "OK";
-    if (status_code == 404)
-        status_text = "Not Found";
-    else if (status_code == 403)
-        status_text = "Forbidden";
-    else if (status_code == 500)
-        status_text = "Internal Server Error";
+    stream->file = file;
+    stream_write_header(stream);
+}
 
-    size_t header_size = 512;
-    size_t total_size = header_size + body_len;
-    char *response = malloc(total_size);
-    if (!response)
+// Runs once the streams ahead of it on the connection are done
+static void stream_start(file_stream_t *stream)
+{
+    if (stream->head) {
+        stream_write_header(stream);
         return;
+    }
 
-    int header_len = snprintf(response, header_size,
-                              "HTTP/1.1 %d %s\r\n"
-                              "Content-Type: %s\r\n"
-                              "Content-Length: %zu\r\n"
-                              "Connection: %s\r\n"
-                              "\r\n",
-                              status_code, status_text,
-                              content_type,
-                              body_len,
-                              keep_alive ? "keep-alive" : "close");
+    fs_open(stream->path, UV_FS_O_RDONLY, 0, on_stream_open, stream);
+}
 
-    if (body && body_len > 0)
-        memcpy(response + header_len, body, body_len);
+// Opens a duplicate of the client socket that the stream owns, close-on-exec
+// so that cluster workers don't inherit it. Returns -1 if there is no handle
+// yet, 1 if it failed after the handle was created and is now closing
+static int stream_open_conn(file_stream_t *stream, uv_tcp_t *client)
+{
+    uv_os_fd_t client_fd;
+    if (uv_fileno((uv_handle_t *)client, &client_fd) != 0)
+        return -1;
 
-    write_req_t *wr = malloc(sizeof(write_req_t));
-    if (!wr) {
-        free(response);
-        return;
+    int fd = fcntl(client_fd, F_DUPFD_CLOEXEC, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || uv_tcp_init(get_loop(), &stream->conn) != 0) {
+        if (fd >= 0)
+            close(fd);
+        return -1;
     }
 
-    wr->data = response;
-    uv_buf_t buf = uv_buf_init(response, header_len + body_len);
+    stream->conn.data = stream;
+    stream->conn_id = (uint64_t)st.st_ino;
 
-    if (uv_write(&wr->req, (uv_stream_t *)socket, &buf, 1, on_write_complete) != 0) {
-        free(response);
-        free(wr);
+    if (uv_tcp_open(&stream->conn, fd) != 0) {
+        close(fd);
+        uv_close((uv_handle_t *)&stream->conn, on_stream_closed);
+        return 1;
     }
+
+    return 0;
 }
 
-static void send_error_manual(uv_tcp_t *socket, int status_code, const char *message)
+// Returns false if the connection can't be taken over, the file is then
+// read into memory and sent with reply()
+static bool stream_file(async_file_ctx_t *ctx, uint64_t size, const byte_range_t *range)
 {
-    send_response_manual(socket, status_code, "text/plain", message, strlen(message), false);
+    uv_tcp_t *client = ctx->res->client_socket;
+
+    // A response ecewo is still writing has to go out first
+    if (!client || uv_is_closing((uv_handle_t *)client) || uv_stream_get_write_queue_size((uv_stream_t *)client) > 0)
+        return false;
+
+    file_stream_t *stream = calloc(1, sizeof(file_stream_t));
+    if (!stream)
+        return false;
+
+    stream->header = build_stream_header(ctx->mime_type, size, range, ctx->mount, &ctx->validators, ctx->encoding);
+    stream->path = stream->header && !ctx->head ? strdup(ctx->file_path) : NULL;
+
+    int opened = stream->header && (ctx->head || stream->path) ? stream_open_conn(stream, client) : -1;
+    if (opened != 0) {
+        // Once the handle exists it is freed by its close callback
+        if (opened < 0)
+            stream_free(stream);
+        return false;
+    }
+
+    stream->head = ctx->head;
+    stream->offset = range ? (int64_t)range->start : 0;
+    stream->start = stream->offset;
+    stream->end = ctx->head ? stream->offset : range ? (int64_t)range->end + 1 : (int64_t)size;
+    stream->fs_req.data = stream;
+
+    // The span now ends with the stream
+    stream->span = ctx->span;
+    ctx->streaming = true;
+    if (ctx->mount && ctx->mount->cache)
+        metrics_inc(static_metrics.misses);
+
+    increment_async_work();
+
+    file_stream_t **tail = &streams;
+    while (*tail)
+        tail = &(*tail)->next;
+    *tail = stream;
+
+    if (!stream_ahead_of(stream))
+        stream_start(stream);
+
+    return true;
+}
+
+#else
+
+// A client socket can't be duplicated on Windows, files are read into memory
+static bool stream_file(async_file_ctx_t *ctx, uint64_t size, const byte_range_t *range)
+{
+    (void)ctx;
+    (void)size;
+    (void)range;
+    return false;
 }
 
+#endif
+
 static void on_file_read(const char *error, const char *data, size_t size, void *user_data)
 {
     async_file_ctx_t *ctx = (async_file_ctx_t *)user_data;
 
     ctx->res->replied = true;
 
+    if (!error && ctx->cacheable)
+        validators_set_content_etag(&ctx->validators, data, size);
+
+    if (!error && ctx->mount && ctx->mount->cache)
+        metrics_inc(static_metrics.misses);
+
+    ctx->failed = error != NULL;
+    if (error)
+        send_text(ctx->res, 404, "File not found");
+    else
+        send_file_bytes(ctx->res, ctx->mount, &ctx->cond, &ctx->validators, ctx->encoding, ctx->mime_type, data, size);
+
+    static_cache_entry_t *entry = NULL;
+    if (!error && ctx->cacheable) {
+        entry = cache_insert(ctx->mount->cache, ctx->path, ctx->encoding, ctx->file_path,
+                             (char *)data, size, ctx->mime_type, &ctx->validators);
+
+        if (entry && ctx->encoding == ENCODING_IDENTITY) {
+            entry->missing = ctx->missing;
+            maybe_compress(ctx->mount, entry, ctx->accepted);
+        }
+    }
+
+    if (data && !entry)
+        free((void *)data);
+
+    free_file_ctx(ctx);
+}
+
+static void on_range_read(const char *error, const char *data, size_t size, void *user_data)
+{
+    async_file_ctx_t *ctx = (async_file_ctx_t *)user_data;
+
+    ctx->res->replied = true;
+    ctx->failed = error != NULL;
+
     if (error) {
         send_text(ctx->res, 404, "File not found");
+    } else if (size == 0) {
+        // Truncated since the stat
+        send_unsatisfiable(ctx->res, ctx->file_size);
     } else {
-        set_header(ctx->res, "Content-Type", ctx->mime_type);
-        reply(ctx->res, 200, data, size);
+        byte_range_t range = { ctx->range.start, ctx->range.start + size - 1 };
+        send_partial(ctx->res, ctx->mount, &ctx->validators, ctx->mime_type, &range, ctx->file_size, data);
     }
 
     if (data)
         free((void *)data);
 
-    free(ctx->mime_type);
-    free(ctx);
+    free_file_ctx(ctx);
 }
 
-void send_file(Res *res, const char *filepath)
+static void stat_next_candidate(async_file_ctx_t *ctx);
+
+static void on_file_stat(const char *error, const uv_stat_t *stat, void *user_data)
 {
-    if (!res || !filepath) {
-        if (res)
-            send_text(res, 500, "Invalid arguments");
+    async_file_ctx_t *ctx = (async_file_ctx_t *)user_data;
+    bool is_file = !error && (stat->st_mode & S_IFMT) == S_IFREG;
+
+    if (ctx->encoding != ENCODING_IDENTITY && !is_file) {
+        // No such sibling, remember that and move on
+        ctx->missing |= ENCODING_BIT(ctx->encoding);
+        stat_next_candidate(ctx);
         return;
     }
 
-    if (!is_safe_path(filepath)) {
-        send_text(res, 403, "Forbidden");
+    if (!is_file) {
+        ctx->res->replied = true;
+        ctx->failed = true;
+        send_text(ctx->res, 404, "File not found");
+        free_file_ctx(ctx);
+        return;
+    }
+
+    // 0 when streaming is off, and always for send_file()
+    size_t threshold = ctx->mount ? ctx->mount->options.stream_threshold : 0;
+    validators_from_stat(&ctx->validators, stat);
+
+    // Larger files are still served, just not kept
+    ctx->cacheable = ctx->mount && ctx->mount->cache
+        && (uint64_t)stat->st_size <= ctx->mount->cache->max_entry
+        && (threshold == 0 || (uint64_t)stat->st_size < threshold);
+
+    // Cached files carry a content ETag, known only after reading
+    if (!ctx->cacheable && not_modified(ctx->mount, &ctx->cond, &ctx->validators)) {
+        ctx->res->replied = true;
+        send_not_modified(ctx->res, ctx->mount, &ctx->validators, ctx->encoding);
+        free_file_ctx(ctx);
+        return;
+    }
+
+    uint64_t size = (uint64_t)stat->st_size;
+    bool large = threshold > 0 && size >= threshold;
+
+    // Cacheable files are read whole and ranges are cut from memory
+    if (!ctx->cacheable && ctx->encoding == ENCODING_IDENTITY) {
+        range_set_t ranges;
+        range_result_t result = select_ranges(ctx->mount, &ctx->cond, &ctx->validators, size, &ranges);
+
+        if (result == RANGE_UNSATISFIABLE) {
+            ctx->res->replied = true;
+            send_unsatisfiable(ctx->res, size);
+            free_file_ctx(ctx);
+            return;
+        }
+
+        if (result == RANGE_PARTIAL && ranges.count == 1) {
+            byte_range_t *range = &ranges.items[0];
+            uint64_t len = range->end - range->start + 1;
+
+            if (threshold > 0 && len >= threshold && stream_file(ctx, size, range)) {
+                free_file_ctx(ctx);
+                return;
+            }
+
+            // Only the requested window is read
+            ctx->range = *range;
+            ctx->file_size = size;
+            fs_read_range(ctx->file_path, (int64_t)range->start, (size_t)len, on_range_read, ctx);
+            return;
+        }
+
+        // multipart/byteranges is assembled in memory, large files get a 200 instead
+    }
+
+    if (large && stream_file(ctx, size, NULL)) {
+        free_file_ctx(ctx);
+        return;
+    }
+
+    fs_read_file(ctx->file_path, on_file_read, ctx);
+}
+
+// Tries the precompressed siblings the client accepts, then the file itself
+static void stat_next_candidate(async_file_ctx_t *ctx)
+{
+    free(ctx->file_path);
+    ctx->file_path = NULL;
+
+    for (size_t i = 0; i < sizeof(encoding_order) / sizeof(encoding_order[0]); i++) {
+        content_encoding_t encoding = encoding_order[i];
+        if (!(ctx->pending & ENCODING_BIT(encoding)))
+            continue;
+
+        ctx->pending &= (uint8_t)~ENCODING_BIT(encoding);
+
+        size_t len = strlen(ctx->path) + strlen(encodings[encoding].ext) + 1;
+        ctx->file_path = malloc(len);
+        if (!ctx->file_path)
+            break;
+
+        snprintf(ctx->file_path, len, "%s%s", ctx->path, encodings[encoding].ext);
+        ctx->encoding = encoding;
+        fs_stat(ctx->file_path, on_file_stat, ctx);
+        return;
+    }
+
+    // The identity file may be cached already, only the siblings were unknown
+    static_cache_entry_t *identity = ctx->mount && ctx->mount->cache
+        ? cache_lookup(ctx->mount->cache, ctx->path, ENCODING_IDENTITY)
+        : NULL;
+
+    if (identity) {
+        identity->missing |= ctx->missing;
+        ctx->res->replied = true;
+        metrics_inc(static_metrics.hits);
+        send_cached_entry(ctx->res, ctx->mount, &ctx->cond, identity);
+        maybe_compress(ctx->mount, identity, ctx->accepted);
+        free_file_ctx(ctx);
+        return;
+    }
+
+    ctx->encoding = ENCODING_IDENTITY;
+    ctx->file_path = strdup(ctx->path);
+    if (!ctx->file_path) {
+        ctx->res->replied = true;
+        send_text(ctx->res, 500, "Memory allocation failed");
+        free_file_ctx(ctx);
         return;
     }
 
-    async_file_ctx_t *ctx = malloc(sizeof(async_file_ctx_t));
+    // The size decides between reading into memory and streaming
+    fs_stat(ctx->file_path, on_file_stat, ctx);
+}
+
+static void serve_file(Req *req, Res *res, const char *filepath, static_ctx_t *mount)
+{
+    static_metrics_register();
+    void *span = metrics_trace_begin(TRACE_SPAN, filepath);
+
+    conditional_t cond = { NULL, -1, NULL, NULL };
+    if (req && mount && mount->options.enable_etag) {
+        cond.if_none_match = (char *)get_header(req, "If-None-Match");
+        cond.if_modified_since = parse_http_date(get_header(req, "If-Modified-Since"));
+    }
+
+    if (req && mount) {
+        cond.range = (char *)get_header(req, "Range");
+        cond.if_range = cond.range ? (char *)get_header(req, "If-Range") : NULL;
+    }
+
+    // Ranges are always served from the identity encoding
+    uint8_t accepted = req && negotiates_encoding(mount) && !cond.range
+        ? parse_accept_encoding(get_header(req, "Accept-Encoding"))
+        : 0;
+
+    // Siblings worth a stat, narrowed down by what the cache already knows
+    uint8_t pending = mount && mount->options.precompressed ? accepted : 0;
+
+    if (mount && mount->cache) {
+        // Hot path: no threadpool round trip
+        for (size_t i = 0; i < sizeof(encoding_order) / sizeof(encoding_order[0]); i++) {
+            content_encoding_t encoding = encoding_order[i];
+            if (!(accepted & ENCODING_BIT(encoding)))
+                continue;
+
+            static_cache_entry_t *entry = cache_lookup(mount->cache, filepath, encoding);
+            if (entry) {
+                metrics_inc(static_metrics.hits);
+                send_cached_entry(res, mount, &cond, entry);
+                metrics_trace_end(TRACE_SPAN, span, true);
+                return;
+            }
+        }
+
+        static_cache_entry_t *identity = cache_lookup(mount->cache, filepath, ENCODING_IDENTITY);
+        if (identity)
+            pending &= (uint8_t)~identity->missing;
+
+        if (identity && !pending) {
+            metrics_inc(static_metrics.hits);
+            send_cached_entry(res, mount, &cond, identity);
+            maybe_compress(mount, identity, accepted);
+            metrics_trace_end(TRACE_SPAN, span, true);
+            return;
+        }
+    }
+
+    async_file_ctx_t *ctx = calloc(1, sizeof(async_file_ctx_t));
     if (!ctx) {
         send_text(res, 500, "Memory allocation failed");
+        metrics_trace_end(TRACE_SPAN, span, false);
         return;
     }
 
     ctx->res = res;
-    ctx->mime_type = strdup(get_mime_type(filepath));
+    ctx->span = span;
+    ctx->head = req && strcmp(req->method, "HEAD") == 0;
+    ctx->mount = mount;
+    ctx->accepted = accepted;
+    ctx->pending = pending;
+    ctx->mime_type = get_content_type(mount ? &mount->mime_types : NULL, filepath);
 
-    if (!ctx->mime_type) {
-        free(ctx);
+    ctx->path = strdup(filepath);
+    ctx->cond.if_modified_since = cond.if_modified_since;
+    if (cond.if_none_match)
+        ctx->cond.if_none_match = strdup(cond.if_none_match);
+    if (cond.range)
+        ctx->cond.range = strdup(cond.range);
+    if (cond.if_range)
+        ctx->cond.if_range = strdup(cond.if_range);
+
+    if (!ctx->path
+        || (cond.if_none_match && !ctx->cond.if_none_match)
+        || (cond.range && !ctx->cond.range)
+        || (cond.if_range && !ctx->cond.if_range)) {
+        ctx->failed = true;
+        free_file_ctx(ctx);
         send_text(res, 500, "Memory allocation failed");
         return;
     }
 
-    fs_read_file(filepath, on_file_read, ctx);
+    stat_next_candidate(ctx);
 }
 
-typedef struct
+void send_file(Res *res, const char *filepath)
 {
-    char *mount_path;
-    char *dir_path;
-    size_t mount_len;
-    Static options;
-} static_ctx_t;
+    if (!res || !filepath) {
+        if (res)
+            send_text(res, 500, "Invalid arguments");
+        return;
+    }
+
+    if (!is_safe_path(filepath)) {
+        send_text(res, 403, "Forbidden");
+        return;
+    }
+
+    serve_file(NULL, res, filepath, NULL);
+}
 
 typedef struct
 {
@@ -233,49 +1948,60 @@ static void ensure_static_capacity(void)
     }
 }
 
-static void static_handler(Req *req, Res *res)
+// First mount whose path prefixes url_path, in registration order
+static static_ctx_t *find_mount(const char *url_path, const char **rel_path)
 {
-    const char *url_path = req->path;
-
     for (int i = 0; i < static_contexts.count; i++) {
         static_ctx_t *ctx = static_contexts.items[i];
 
         if (strncmp(url_path, ctx->mount_path, ctx->mount_len) != 0)
             continue;
 
-        const char *rel_path = url_path + ctx->mount_len;
-        if (*rel_path == '/')
-            rel_path++;
+        *rel_path = url_path + ctx->mount_len;
+        if (**rel_path == '/')
+            (*rel_path)++;
 
-        if (!ctx->options.dot_files && *rel_path == '.') {
-            send_text(res, 403, "Forbidden");
-            return;
-        }
+        return ctx;
+    }
 
-        // Check if this is a directory request (empty relative path or ends with /)
-        bool is_dir = (*rel_path == '\0' || (strlen(rel_path) > 0 && rel_path[strlen(rel_path) - 1] == '/'));
+    return NULL;
+}
 
-        char filepath[1024];
-        if (is_dir) {
-            if (strlen(rel_path) == 0) {
-                snprintf(filepath, sizeof(filepath), "%s/%s", ctx->dir_path, ctx->options.index_file);
-            } else {
-                snprintf(filepath, sizeof(filepath), "%s/%s%s", ctx->dir_path, rel_path, ctx->options.index_file);
-            }
-        } else {
-            snprintf(filepath, sizeof(filepath), "%s/%s", ctx->dir_path, rel_path);
-        }
+static void static_handler(Req *req, Res *res)
+{
+    const char *rel_path;
+    static_ctx_t *ctx = find_mount(req->path, &rel_path);
 
-        if (!is_safe_path(filepath)) {
-            send_text(res, 403, "Forbidden");
-            return;
+    if (!ctx) {
+        send_text(res, 404, "Not found");
+        return;
+    }
+
+    if (!ctx->options.dot_files && *rel_path == '.') {
+        send_text(res, 403, "Forbidden");
+        return;
+    }
+
+    // Check if this is a directory request (empty relative path or ends with /)
+    bool is_dir = (*rel_path == '\0' || (strlen(rel_path) > 0 && rel_path[strlen(rel_path) - 1] == '/'));
+
+    char filepath[1024];
+    if (is_dir) {
+        if (strlen(rel_path) == 0) {
+            snprintf(filepath, sizeof(filepath), "%s/%s", ctx->dir_path, ctx->options.index_file);
+        } else {
+            snprintf(filepath, sizeof(filepath), "%s/%s%s", ctx->dir_path, rel_path, ctx->options.index_file);
         }
+    } else {
+        snprintf(filepath, sizeof(filepath), "%s/%s", ctx->dir_path, rel_path);
+    }
 
-        send_file(res, filepath);
+    if (!is_safe_path(filepath)) {
+        send_text(res, 403, "Forbidden");
         return;
     }
 
-    send_text(res, 404, "Not found");
+    serve_file(req, res, filepath, ctx);
 }
 
 void serve_static(const char *mount_path,
@@ -290,10 +2016,17 @@ void serve_static(const char *mount_path,
     Static final_opts;
 
     final_opts.index_file = "index.html";
-    final_opts.enable_etag = false;
-    final_opts.enable_cache = false;
+    final_opts.enable_etag = true;
+    final_opts.enable_cache = true;
     final_opts.max_age = 3600;
     final_opts.dot_files = false;
+    final_opts.cache_max_bytes = 0;
+    final_opts.cache_max_entry = CACHE_DEFAULT_MAX_ENTRY;
+    final_opts.stream_threshold = 0;
+    final_opts.precompressed = false;
+    final_opts.compress = false;
+    final_opts.mime_types = NULL; // Copied into the mount's own table below
+    final_opts.mime_type_count = 0;
 
     if (options) {
         if (options->index_file)
@@ -302,6 +2035,13 @@ void serve_static(const char *mount_path,
         final_opts.enable_cache = options->enable_cache;
         final_opts.max_age = options->max_age;
         final_opts.dot_files = options->dot_files;
+        final_opts.cache_max_bytes = options->cache_max_bytes;
+        if (options->cache_max_entry > 0)
+            final_opts.cache_max_entry = options->cache_max_entry;
+        if (options->stream_threshold > 0)
+            final_opts.stream_threshold = options->stream_threshold;
+        final_opts.precompressed = options->precompressed;
+        final_opts.compress = options->compress;
     }
 
     ensure_static_capacity();
@@ -310,7 +2050,7 @@ void serve_static(const char *mount_path,
         return;
     }
 
-    static_ctx_t *ctx = malloc(sizeof(static_ctx_t));
+    static_ctx_t *ctx = calloc(1, sizeof(static_ctx_t));
     if (!ctx) {
         fprintf(stderr, "serve_static: Memory allocation failed\n");
         return;
@@ -320,6 +2060,31 @@ void serve_static(const char *mount_path,
     ctx->dir_path = strdup(dir_path);
     ctx->mount_len = strlen(mount_path);
     ctx->options = final_opts;
+    snprintf(ctx->cache_control, sizeof(ctx->cache_control), "public, max-age=%d", final_opts.max_age);
+
+    if (final_opts.cache_max_bytes > 0) {
+        ctx->cache = cache_create(final_opts.cache_max_bytes, final_opts.cache_max_entry);
+        if (!ctx->cache)
+            fprintf(stderr, "serve_static: File cache disabled, memory allocation failed\n");
+    }
+
+    // Copied, the caller's array doesn't need to outlive this call
+    if (options && options->mime_types) {
+        for (size_t i = 0; i < options->mime_type_count; i++) {
+            if (!mime_table_set(&ctx->mime_types, options->mime_types[i].ext, options->mime_types[i].type))
+                fprintf(stderr, "serve_static: Skipping invalid MIME type override\n");
+        }
+    }
+
+    if (final_opts.compress) {
+#ifdef ECEWO_STATIC_ZLIB
+        ctx->compress = ctx->cache != NULL;
+        if (!ctx->cache)
+            fprintf(stderr, "serve_static: compress needs cache_max_bytes, disabled\n");
+#else
+        fprintf(stderr, "serve_static: compress needs ECEWO_STATIC_ZLIB, disabled\n");
+#endif
+    }
 
     static_contexts.items[static_contexts.count++] = ctx;
 
@@ -340,9 +2105,20 @@ void serve_static(const char *mount_path,
 
 void static_cleanup(void)
 {
+#ifdef ECEWO_STATIC_ZLIB
+    // Jobs still queued are canceled; a running one finishes, but its
+    // result has no cache to go to anymore
+    for (compress_job_t *job = compress_jobs; job; job = job->next) {
+        uv_cancel((uv_req_t *)&job->work);
+        job->cache = NULL;
+    }
+#endif
+
     for (int i = 0; i < static_contexts.count; i++) {
         static_ctx_t *ctx = static_contexts.items[i];
         if (ctx) {
+            cache_destroy(ctx->cache);
+            mime_table_free(&ctx->mime_types);
             free(ctx->mount_path);
             free(ctx->dir_path);
             free(ctx);
@@ -355,4 +2131,6 @@ void static_cleanup(void)
     static_contexts.items = NULL;
     static_contexts.count = 0;
     static_contexts.capacity = 0;
+
+    mime_table_free(&custom_mime_types);
 }
@@ -8,6 +8,12 @@ extern "C" {
 #include "ecewo.h"
 #include <stdbool.h>
 
+typedef struct
+{
+    const char *ext; // "svg" or ".svg", case-insensitive
+    const char *type; // "image/svg+xml", text types get "; charset=utf-8"
+} StaticMimeType;
+
 typedef struct
 {
     const char *index_file; // Default: "index.html"
@@ -15,6 +21,13 @@ typedef struct
     bool enable_cache; // Enable cache headers, default: 1
     int max_age; // Cache max-age in seconds, default: 3600
     bool dot_files; // Serve .dot files? Default: 0 (no)
+    size_t cache_max_bytes; // In-memory file cache budget, default: 0 (disabled)
+    size_t cache_max_entry; // Largest file kept in the cache, default: 1 MB
+    size_t stream_threshold; // Files this large are sent with sendfile(2), default: 0 (disabled)
+    bool precompressed; // Serve file.br / file.gz siblings when accepted, default: 0
+    bool compress; // Gzip compressible files into the cache (needs zlib), default: 0
+    const StaticMimeType *mime_types; // Overrides for this mount, copied, default: NULL
+    size_t mime_type_count;
 } Static;
 
 void send_file(Res *res, const char *filepath);
@@ -23,6 +36,9 @@ void serve_static(const char *mount_path, // URL prefix (e.g., "/" or "/assets")
                   const char *dir_path, // Directory path (e.g., "./public")
                   const Static *options); // Configuration options (NULL for defaults)
 
+// Adds or replaces a MIME type for every mount, call before serving
+void static_add_mime_type(const char *ext, const char *type);
+
 void static_cleanup(void);
 
 #ifdef __cplusplus
@@ -1,8 +1,6 @@
-#include "ecewo-cluster.h"
-#include "ecewo.h"
+// Includes the module itself to reach its internal functions
+#include "ecewo-cluster.c"
 #include "tester.h"
-#include <string.h>
-#include <stdio.h>
 
 #define REQUEST_COUNT 5
 
@@ -96,3 +94,541 @@ int test_cluster_port_strategy(void)
 
     RETURN_OK();
 }
+
+int test_cluster_steering_map(void)
+{
+    static const uint16_t cpus[] = { 0, 2 };
+
+    // Fixed by worker id, whatever order the workers started listening in
+    ASSERT_EQ(0, cluster_steering_worker(cpus, 2, 3, 0));
+    ASSERT_EQ(1, cluster_steering_worker(cpus, 2, 3, 2));
+    ASSERT_EQ(-1, cluster_steering_worker(cpus, 2, 3, 1));
+
+    // Worker 2 shares CPU 0 with worker 0 and only gets hashed connections
+    for (uint16_t cpu = 0; cpu < 4; cpu++)
+        ASSERT_NE(2, cluster_steering_worker(cpus, 2, 3, cpu));
+
+    // Scaled down to one worker, CPU 2 has no one left
+    ASSERT_EQ(-1, cluster_steering_worker(cpus, 2, 1, 2));
+    ASSERT_EQ(-1, cluster_steering_worker(NULL, 0, 3, 0));
+
+    // Only workers are pinned
+    ASSERT_EQ(-1, cluster_worker_cpu());
+
+    RETURN_OK();
+}
+
+int test_cluster_scale_master_only(void)
+{
+    ClusterAutoscale policy = {
+        .min_workers = 2,
+        .max_workers = 8,
+        .target_lag_us = 20000,
+        .cooldown_ms = 10000
+    };
+
+    // Scaling is done by the master, not in a worker or before cluster_init()
+    ASSERT_FALSE(cluster_scale(4));
+    ASSERT_FALSE(cluster_autoscale(&policy));
+    ASSERT_FALSE(cluster_autoscale(NULL));
+
+    RETURN_OK();
+}
+
+// ============================================================================
+// IPC FRAMING
+// ============================================================================
+
+typedef struct
+{
+    int count;
+    uint8_t types[8];
+    uint16_t lengths[8];
+    uint8_t payloads[8][IPC_MAX_PAYLOAD];
+    bool eof;
+} ipc_record_t;
+
+static void record_message(ipc_channel_t *ch, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    ipc_record_t *rec = (ipc_record_t *)ch->data;
+
+    if (type == 0) {
+        rec->eof = true;
+        return;
+    }
+
+    if (rec->count == 8)
+        return;
+
+    rec->types[rec->count] = type;
+    rec->lengths[rec->count] = length;
+    memcpy(rec->payloads[rec->count], payload, length);
+    rec->count++;
+}
+
+// A channel reading one end of a socketpair; the test writes raw bytes
+// to the other end, *peer, to control how frames are split
+static ipc_channel_t *ipc_open_pair(uv_loop_t *loop, ipc_message_cb on_message, void *data, int *peer)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        return NULL;
+
+    ipc_channel_t *ch = ipc_create(loop, on_message, data);
+    if (!ch || uv_pipe_open(&ch->pipe, fds[0]) != 0
+        || uv_read_start((uv_stream_t *)&ch->pipe, on_ipc_alloc, on_ipc_read) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        if (ch)
+            ipc_close(ch);
+        return NULL;
+    }
+
+    *peer = fds[1];
+    return ch;
+}
+
+static void ipc_spin(uv_loop_t *loop)
+{
+    for (int i = 0; i < 10; i++)
+        uv_run(loop, UV_RUN_NOWAIT);
+}
+
+static size_t ipc_frame(uint8_t *out, uint8_t type, const void *payload, uint16_t length)
+{
+    ipc_header_t header = { .type = type, .length = length };
+    memcpy(out, &header, sizeof(header));
+    if (length)
+        memcpy(out + sizeof(header), payload, length);
+    return sizeof(header) + length;
+}
+
+static void ipc_finish(uv_loop_t *loop, ipc_channel_t *ch, int peer)
+{
+    if (ch)
+        ipc_close(ch);
+    if (peer >= 0)
+        close(peer);
+    uv_run(loop, UV_RUN_DEFAULT);
+    uv_loop_close(loop);
+}
+
+int test_cluster_ipc_partial_frames(void)
+{
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    ipc_record_t rec = { 0 };
+    int peer = -1;
+    ipc_channel_t *ch = ipc_open_pair(&loop, record_message, &rec, &peer);
+    ASSERT_NOT_NULL(ch);
+
+    uint8_t frame[sizeof(ipc_header_t) + 5];
+    size_t len = ipc_frame(frame, IPC_MSG_STATS, "hello", 5);
+
+    // Half a header, then the rest of it, then the payload
+    ASSERT_EQ(2, write(peer, frame, 2));
+    ipc_spin(&loop);
+    ASSERT_EQ(0, rec.count);
+
+    ASSERT_EQ(2, write(peer, frame + 2, 2));
+    ipc_spin(&loop);
+    ASSERT_EQ(0, rec.count);
+
+    ASSERT_EQ((ssize_t)(len - 4), write(peer, frame + 4, len - 4));
+    ipc_spin(&loop);
+    ASSERT_EQ(1, rec.count);
+    ASSERT_EQ(IPC_MSG_STATS, rec.types[0]);
+    ASSERT_EQ(5, rec.lengths[0]);
+    ASSERT_EQ(0, memcmp(rec.payloads[0], "hello", 5));
+
+    // A frame split mid-payload
+    len = ipc_frame(frame, IPC_MSG_READY, "world", 5);
+    ASSERT_EQ(6, write(peer, frame, 6));
+    ipc_spin(&loop);
+    ASSERT_EQ(1, rec.count);
+
+    ASSERT_EQ((ssize_t)(len - 6), write(peer, frame + 6, len - 6));
+    ipc_spin(&loop);
+    ASSERT_EQ(2, rec.count);
+    ASSERT_EQ(0, memcmp(rec.payloads[1], "world", 5));
+
+    ipc_finish(&loop, ch, peer);
+    RETURN_OK();
+}
+
+int test_cluster_ipc_multiple_frames(void)
+{
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    ipc_record_t rec = { 0 };
+    int peer = -1;
+    ipc_channel_t *ch = ipc_open_pair(&loop, record_message, &rec, &peer);
+    ASSERT_NOT_NULL(ch);
+
+    // Three frames and the start of a fourth in one write
+    uint8_t data[4 * (sizeof(ipc_header_t) + 3)];
+    size_t len = 0;
+    len += ipc_frame(data + len, 1, "one", 3);
+    len += ipc_frame(data + len, 2, NULL, 0);
+    len += ipc_frame(data + len, 3, "two", 3);
+    size_t last = ipc_frame(data + len, 4, "end", 3);
+
+    ASSERT_EQ((ssize_t)(len + 1), write(peer, data, len + 1));
+    ipc_spin(&loop);
+
+    ASSERT_EQ(3, rec.count);
+    ASSERT_EQ(1, rec.types[0]);
+    ASSERT_EQ(0, memcmp(rec.payloads[0], "one", 3));
+    ASSERT_EQ(2, rec.types[1]);
+    ASSERT_EQ(0, rec.lengths[1]);
+    ASSERT_EQ(3, rec.types[2]);
+    ASSERT_EQ(0, memcmp(rec.payloads[2], "two", 3));
+
+    ASSERT_EQ((ssize_t)(last - 1), write(peer, data + len + 1, last - 1));
+    ipc_spin(&loop);
+    ASSERT_EQ(4, rec.count);
+    ASSERT_EQ(0, memcmp(rec.payloads[3], "end", 3));
+
+    // The peer going away is reported as an empty message
+    close(peer);
+    ipc_spin(&loop);
+    ASSERT_TRUE(rec.eof);
+
+    // The channel closed itself on EOF
+    ipc_finish(&loop, NULL, -1);
+    RETURN_OK();
+}
+
+int test_cluster_ipc_oversize(void)
+{
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    ipc_record_t rec = { 0 };
+    int peer = -1;
+    ipc_channel_t *ch = ipc_open_pair(&loop, record_message, &rec, &peer);
+    ASSERT_NOT_NULL(ch);
+
+    static const uint8_t big[IPC_MAX_PAYLOAD + 1];
+    ASSERT_EQ(UV_EINVAL, ipc_send(ch, IPC_MSG_STATS, big, sizeof(big)));
+
+    // A valid frame, then a header claiming more than IPC_MAX_PAYLOAD,
+    // then a frame that must not be delivered
+    uint8_t data[3 * sizeof(ipc_header_t) + 2];
+    size_t len = ipc_frame(data, 1, "ok", 2);
+    ipc_header_t bad = { .type = 2, .length = IPC_MAX_PAYLOAD + 1 };
+    memcpy(data + len, &bad, sizeof(bad));
+    len += sizeof(bad);
+    len += ipc_frame(data + len, 3, NULL, 0);
+
+    ASSERT_EQ((ssize_t)len, write(peer, data, len));
+    ipc_spin(&loop);
+
+    ASSERT_EQ(1, rec.count);
+    ASSERT_EQ(1, rec.types[0]);
+
+    // The channel dropped the connection, so the peer reads EOF
+    char byte;
+    ASSERT_EQ(0, read(peer, &byte, 1));
+
+    ipc_finish(&loop, NULL, peer);
+    RETURN_OK();
+}
+
+int test_cluster_ipc_stats_exchange(void)
+{
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds));
+
+    // Master side, as spawn_worker() sets it up
+    worker_process_t worker = { .worker_id = 7 };
+    ipc_channel_t *master = ipc_create(&loop, on_master_message, &worker);
+    ASSERT_NOT_NULL(master);
+    ASSERT_EQ(0, uv_pipe_open(&master->pipe, fds[0]));
+    ASSERT_EQ(0, uv_read_start((uv_stream_t *)&master->pipe, on_ipc_alloc, on_ipc_read));
+    worker.ipc = master;
+
+    // The totals include every process on the list
+    worker_process_t *processes = cluster_state.processes;
+    cluster_state.processes = &worker;
+
+    ipc_record_t rec = { 0 };
+    ipc_channel_t *child = ipc_create(&loop, record_message, &rec);
+    ASSERT_NOT_NULL(child);
+    ASSERT_EQ(0, uv_pipe_open(&child->pipe, fds[1]));
+    ASSERT_EQ(0, uv_read_start((uv_stream_t *)&child->pipe, on_ipc_alloc, on_ipc_read));
+
+    // What on_stats_timer() sends: the metrics, then the stats
+    MetricsSample metric = { .type = METRICS_COUNTER, .value = 41 };
+    snprintf(metric.name, sizeof(metric.name), "test_ipc_exchange_total");
+
+    ipc_stats_t stats = {
+        .requests = 1234,
+        .rss_bytes = 4096,
+        .requests_per_sec = 56,
+        .events_waiting = 3,
+        .active_handles = 9,
+        .loop_lag_us = 250,
+        .cpu_permille = 125,
+    };
+
+    ASSERT_EQ(0, ipc_send(child, IPC_MSG_METRIC, &metric, sizeof(metric)));
+    ASSERT_EQ(0, ipc_send(child, IPC_MSG_STATS, &stats, sizeof(stats)));
+    ipc_spin(&loop);
+
+    ASSERT_EQ(1234, worker.stats.requests);
+    ASSERT_EQ(56, worker.stats.requests_per_sec);
+    ASSERT_EQ(3, worker.stats.events_waiting);
+    ASSERT_EQ(9, worker.stats.active_handles);
+    ASSERT_EQ(4096, worker.stats.rss_bytes);
+    ASSERT_EQ(250, worker.stats.loop_lag_us);
+    ASSERT_EQ(125, worker.stats.cpu_permille);
+    ASSERT_EQ(1, worker.metrics_count);
+
+    // The master answered the stats with the cluster totals
+    bool found = false;
+    for (int i = 0; i < rec.count; i++) {
+        MetricsSample total;
+        ASSERT_EQ(IPC_MSG_METRIC, rec.types[i]);
+        ASSERT_EQ(sizeof(MetricsSample), rec.lengths[i]);
+        memcpy(&total, rec.payloads[i], sizeof(total));
+        if (strcmp(total.name, metric.name) == 0) {
+            ASSERT_EQ(41, total.value);
+            found = true;
+        }
+    }
+    ASSERT_TRUE(found);
+
+    cluster_state.processes = processes;
+    free(worker.metrics);
+
+    ipc_close(child);
+    ipc_spin(&loop);
+    ASSERT_NULL(worker.ipc);
+
+    ipc_finish(&loop, NULL, -1);
+    RETURN_OK();
+}
+
+// ============================================================================
+// ROLLING RESTART
+// ============================================================================
+
+// Workers are real processes that only sleep; readiness is fed to the
+// master the way their IPC channel would report it
+static char *restart_argv[] = { "worker", "-c", "exec sleep 10", NULL };
+
+#define SPIN_UNTIL(cond)                                        \
+    for (int spin = 0; spin < 400 && !(cond); spin++) {         \
+        uv_run(uv_default_loop(), UV_RUN_NOWAIT);               \
+        uv_sleep(5);                                            \
+    }
+
+static void spin_loop(int rounds)
+{
+    for (int i = 0; i < rounds; i++) {
+        uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+        uv_sleep(5);
+    }
+}
+
+static int count_processes(void)
+{
+    int count = 0;
+    for (worker_process_t *w = cluster_state.processes; w; w = w->next)
+        count++;
+    return count;
+}
+
+static bool process_running(const worker_process_t *worker)
+{
+    for (worker_process_t *w = cluster_state.processes; w; w = w->next) {
+        if (w == worker)
+            return true;
+    }
+    return false;
+}
+
+static void report_ready(worker_process_t *worker)
+{
+    on_master_message(worker->ipc, IPC_MSG_READY, NULL, 0);
+}
+
+static void restart_setup(uint8_t workers, uint8_t batch)
+{
+    cluster_state.is_master = true;
+    cluster_state.worker_count = workers;
+    cluster_state.original_argc = 3;
+    cluster_state.original_argv = restart_argv;
+    snprintf(cluster_state.exe_path, sizeof(cluster_state.exe_path), "/bin/sh");
+    cluster_state.config.restart_batch = batch;
+    cluster_state.config.ready_timeout_ms = DEFAULT_READY_TIMEOUT_MS;
+
+    ASSERT_TRUE(grow_slots(workers));
+    uv_timer_init(uv_default_loop(), &cluster_state.ready_timer);
+
+    for (uint8_t i = 0; i < workers; i++) {
+        cluster_state.slots[i]->current = spawn_worker(i);
+        ASSERT_NOT_NULL(cluster_state.slots[i]->current);
+        cluster_state.slots[i]->current->ready = true;
+    }
+}
+
+static void on_test_handle_closed(uv_handle_t *handle)
+{
+    (void)handle;
+}
+
+// Stops every process and leaves the default loop empty for the next tests
+static void restart_teardown(void)
+{
+    cluster_state.shutdown_requested = true;
+    for (worker_process_t *w = cluster_state.processes; w; w = w->next)
+        uv_process_kill(&w->handle, SIGKILL);
+
+    SPIN_UNTIL(!cluster_state.processes);
+
+    uv_close((uv_handle_t *)&cluster_state.ready_timer, on_test_handle_closed);
+    for (uint8_t i = 0; i < cluster_state.slot_count; i++)
+        uv_close((uv_handle_t *)&cluster_state.slots[i]->respawn_timer, on_test_handle_closed);
+
+    SPIN_UNTIL(!uv_loop_alive(uv_default_loop()));
+
+    for (uint8_t i = 0; i < cluster_state.slot_count; i++)
+        free(cluster_state.slots[i]);
+    free(cluster_state.slots);
+    free(cluster_state.retired_metrics);
+
+    memset(&cluster_state, 0, sizeof(cluster_state));
+    cluster_state.worker_cpu = -1;
+    cluster_state.steering_fd = -1;
+}
+
+int test_cluster_restart_advance(void)
+{
+    restart_setup(3, 2);
+
+    worker_process_t *old0 = cluster_state.slots[0]->current;
+    worker_process_t *old2 = cluster_state.slots[2]->current;
+
+    on_sigusr2(NULL, SIGUSR2);
+
+    // A batch of two, the third waits for a free place
+    worker_process_t *new0 = cluster_state.slots[0]->replacement;
+    worker_process_t *new1 = cluster_state.slots[1]->replacement;
+    ASSERT_NOT_NULL(new0);
+    ASSERT_NOT_NULL(new1);
+    ASSERT_NULL(cluster_state.slots[2]->replacement);
+    ASSERT_EQ(2, cluster_state.restart_pending);
+    ASSERT_EQ(5, count_processes());
+
+    // Old processes keep serving until their replacement is ready
+    spin_loop(10);
+    ASSERT_TRUE(process_running(old0));
+
+    report_ready(new0);
+    ASSERT_TRUE(cluster_state.slots[0]->current == new0);
+    ASSERT_NULL(cluster_state.slots[0]->replacement);
+
+    worker_process_t *new2 = cluster_state.slots[2]->replacement;
+    ASSERT_NOT_NULL(new2);
+    ASSERT_EQ(2, cluster_state.restart_pending);
+
+    // Ready twice changes nothing
+    report_ready(new0);
+    ASSERT_EQ(2, cluster_state.restart_pending);
+
+    SPIN_UNTIL(!process_running(old0));
+    ASSERT_FALSE(process_running(old0));
+
+    report_ready(new1);
+    report_ready(new2);
+    ASSERT_EQ(0, cluster_state.restart_pending);
+    ASSERT_FALSE(cluster_state.graceful_restart_requested);
+    ASSERT_FALSE(cluster_state.restart_failed);
+    ASSERT_TRUE(cluster_state.slots[2]->current == new2);
+
+    SPIN_UNTIL(count_processes() == 3);
+    ASSERT_EQ(3, count_processes());
+    ASSERT_FALSE(process_running(old2));
+
+    restart_teardown();
+    RETURN_OK();
+}
+
+int test_cluster_restart_never_ready(void)
+{
+    restart_setup(2, 1);
+
+    worker_process_t *old0 = cluster_state.slots[0]->current;
+    worker_process_t *old1 = cluster_state.slots[1]->current;
+
+    on_sigusr2(NULL, SIGUSR2);
+
+    worker_process_t *new0 = cluster_state.slots[0]->replacement;
+    ASSERT_NOT_NULL(new0);
+
+    // The replacement dies during startup
+    uv_process_kill(&new0->handle, SIGKILL);
+    SPIN_UNTIL(!cluster_state.graceful_restart_requested);
+
+    ASSERT_FALSE(cluster_state.graceful_restart_requested);
+    ASSERT_TRUE(cluster_state.restart_failed);
+    ASSERT_EQ(0, cluster_state.restart_pending);
+
+    // The old workers were never stopped, and the rest wasn't replaced
+    ASSERT_TRUE(cluster_state.slots[0]->current == old0);
+    ASSERT_TRUE(cluster_state.slots[1]->current == old1);
+    ASSERT_NULL(cluster_state.slots[0]->replacement);
+    ASSERT_NULL(cluster_state.slots[1]->replacement);
+    ASSERT_TRUE(process_running(old0));
+    ASSERT_TRUE(process_running(old1));
+    ASSERT_EQ(2, count_processes());
+
+    // A later restart starts over
+    on_sigusr2(NULL, SIGUSR2);
+    ASSERT_FALSE(cluster_state.restart_failed);
+    ASSERT_NOT_NULL(cluster_state.slots[0]->replacement);
+
+    restart_teardown();
+    RETURN_OK();
+}
+
+int test_cluster_restart_ready_timeout(void)
+{
+    restart_setup(2, 1);
+
+    worker_process_t *old0 = cluster_state.slots[0]->current;
+
+    on_sigusr2(NULL, SIGUSR2);
+
+    worker_process_t *new0 = cluster_state.slots[0]->replacement;
+    ASSERT_NOT_NULL(new0);
+
+    // Within the timeout the check leaves it alone
+    on_ready_timer(&cluster_state.ready_timer);
+    spin_loop(10);
+    ASSERT_TRUE(process_running(new0));
+
+    // Past it, the replacement is killed and the restart aborted
+    cluster_state.config.ready_timeout_ms = 1;
+    uv_sleep(10);
+    uv_update_time(uv_default_loop());
+    on_ready_timer(&cluster_state.ready_timer);
+
+    SPIN_UNTIL(!cluster_state.graceful_restart_requested);
+    ASSERT_FALSE(cluster_state.graceful_restart_requested);
+    ASSERT_TRUE(cluster_state.restart_failed);
+    ASSERT_FALSE(process_running(new0));
+    ASSERT_TRUE(cluster_state.slots[0]->current == old0);
+    ASSERT_TRUE(process_running(old0));
+    ASSERT_NULL(cluster_state.slots[1]->replacement);
+
+    restart_teardown();
+    RETURN_OK();
+}
@@ -38,6 +38,28 @@ void handler_get_cookie(Req *req, Res *res)
     }
 }
 
+void handler_get_cookie_view(Req *req, Res *res)
+{
+    size_t user_len = 0;
+    size_t theme_len = 0;
+    size_t again_len = 0;
+    const char *user = cookie_get_view(req, "user", &user_len);
+    const char *theme = cookie_get_view(req, "theme", &theme_len);
+
+    if (!user || !theme) {
+        send_text(res, 404, "Cookie not found");
+        return;
+    }
+
+    // The same slice on every call, the header is parsed only once;
+    // without a length there is no view
+    send_text(res, 200, arena_sprintf(req->arena, "%.*s|%.*s|%s|%s",
+                                      (int)user_len, user,
+                                      (int)theme_len, theme,
+                                      cookie_get_view(req, "user", &again_len) == user ? "same" : "copy",
+                                      cookie_get_view(req, "user", NULL) ? "view" : "none"));
+}
+
 void handler_delete_cookie(Req *req, Res *res)
 {
     Cookie opts = {
@@ -161,6 +183,29 @@ int test_cookie_get_multiple(void)
     RETURN_OK();
 }
 
+int test_cookie_get_view(void)
+{
+    MockHeaders headers[] = {
+        { "Cookie", "theme=dark%20mode; user=plain_value" }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/get-cookie-view",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("plain_value|dark mode|same|none", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
 int test_cookie_delete(void)
 {
     MockParams params = {
@@ -212,6 +257,7 @@ void setup_cookie_routes(void)
     get("/set-simple", handler_set_simple_cookie);
     get("/set-complex", handler_set_complex_cookie);
     get("/get-cookie", handler_get_cookie);
+    get("/get-cookie-view", handler_get_cookie_view);
     get("/delete-cookie", handler_delete_cookie);
     get("/utf8-cookie", handler_utf8_cookie);
 }
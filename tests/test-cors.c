@@ -13,6 +13,80 @@ void handler_cors_test(Req *req, Res *res)
     send_text(res, 200, "CORS OK");
 }
 
+static const char *const allowed_origins[] = {
+    "https://app.test",
+    "http://localhost:3000",
+    "*.example.com",
+    "https://*.secure.test",
+};
+
+// cors_init() has to run on the server thread, between requests
+void handler_cors_config(Req *req, Res *res)
+{
+    const char *mode = get_query(req, "mode");
+
+    if (mode && strcmp(mode, "allowlist") == 0) {
+        Cors config = {
+            .methods = "GET, POST, PUT",
+            .origins = allowed_origins,
+            .origin_count = sizeof(allowed_origins) / sizeof(allowed_origins[0]),
+        };
+        cors_init(&config);
+    } else {
+        cors_init(NULL);
+    }
+
+    send_text(res, 200, "OK");
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static void cors_configure(const char *mode)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = mode,
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+    free_request(&res);
+}
+
+static MockResponse cors_get(const char *origin)
+{
+    MockHeaders headers[] = {
+        { "Origin", origin }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/api/data",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    return request(&params);
+}
+
+// Allowed origins are echoed back, others get no CORS headers
+static bool origin_allowed(const char *origin)
+{
+    MockResponse res = cors_get(origin);
+    const char *allowed = mock_get_header(&res, "Access-Control-Allow-Origin");
+    bool echoed = res.status_code == 200 && allowed && strcmp(allowed, origin) == 0;
+    bool none = !allowed;
+
+    free_request(&res);
+    ASSERT_TRUE(echoed || none);
+    return echoed;
+}
+
 // ============================================================================
 // TESTS
 // ============================================================================
@@ -35,6 +109,8 @@ int test_cors_preflight_request(void)
     MockResponse res = request(&params);
 
     ASSERT_EQ(204, res.status_code);
+    ASSERT_EQ_STR("*", mock_get_header(&res, "Access-Control-Allow-Origin"));
+    ASSERT_EQ_STR("3600", mock_get_header(&res, "Access-Control-Max-Age"));
 
     free_request(&res);
     RETURN_OK();
@@ -58,11 +134,41 @@ int test_cors_simple_request(void)
 
     ASSERT_EQ(200, res.status_code);
     ASSERT_EQ_STR("CORS OK", res.body);
+    ASSERT_EQ_STR("*", mock_get_header(&res, "Access-Control-Allow-Origin"));
+    ASSERT_EQ_STR("Content-Type", mock_get_header(&res, "Access-Control-Allow-Headers"));
 
     free_request(&res);
     RETURN_OK();
 }
 
+int test_cors_preflight_method_not_allowed(void)
+{
+    MockHeaders headers[] = {
+        { "Origin", "http://localhost:3000" },
+        { "Access-Control-Request-Method", "PROPFIND" }
+    };
+
+    MockParams params = {
+        .method = MOCK_OPTIONS,
+        .path = "/api/data",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 2
+    };
+
+    // The second one is answered from the preflight cache
+    for (int i = 0; i < 2; i++) {
+        MockResponse res = request(&params);
+
+        ASSERT_EQ(403, res.status_code);
+        ASSERT_EQ_STR("CORS: Method or headers not allowed", res.body);
+
+        free_request(&res);
+    }
+
+    RETURN_OK();
+}
+
 int test_cors_no_origin(void)
 {
     MockParams params = {
@@ -81,8 +187,125 @@ int test_cors_no_origin(void)
     RETURN_OK();
 }
 
+int test_cors_allowlist_exact(void)
+{
+    cors_configure("/cors/config?mode=allowlist");
+
+    ASSERT_TRUE(origin_allowed("https://app.test"));
+    ASSERT_TRUE(origin_allowed("http://localhost:3000"));
+
+    // Only the exact string: no prefix, extension, other scheme or port
+    ASSERT_FALSE(origin_allowed("https://app.tes"));
+    ASSERT_FALSE(origin_allowed("https://app.test.evil"));
+    ASSERT_FALSE(origin_allowed("http://app.test"));
+    ASSERT_FALSE(origin_allowed("http://localhost:3001"));
+    ASSERT_FALSE(origin_allowed("null"));
+
+    cors_configure("/cors/config?mode=default");
+    RETURN_OK();
+}
+
+int test_cors_allowlist_wildcard(void)
+{
+    cors_configure("/cors/config?mode=allowlist");
+
+    ASSERT_TRUE(origin_allowed("https://api.example.com"));
+    ASSERT_TRUE(origin_allowed("http://a.b.example.com"));
+
+    // The apex, hosts merely ending in the suffix, ports and paths don't match
+    ASSERT_FALSE(origin_allowed("https://example.com"));
+    ASSERT_FALSE(origin_allowed("https://.example.com"));
+    ASSERT_FALSE(origin_allowed("https://evilexample.com"));
+    ASSERT_FALSE(origin_allowed("https://api.example.com:8443"));
+    ASSERT_FALSE(origin_allowed("https://api.example.com.evil"));
+    ASSERT_FALSE(origin_allowed("https://evil.test/.example.com"));
+
+    // The scheme of "https://*.secure.test" is part of the pattern
+    ASSERT_TRUE(origin_allowed("https://pay.secure.test"));
+    ASSERT_FALSE(origin_allowed("http://pay.secure.test"));
+
+    cors_configure("/cors/config?mode=default");
+    RETURN_OK();
+}
+
+int test_cors_vary_origin(void)
+{
+    cors_configure("/cors/config?mode=allowlist");
+
+    MockResponse res = cors_get("https://app.test");
+    ASSERT_EQ_STR("Origin", mock_get_header(&res, "Vary"));
+    free_request(&res);
+
+    // Rejected origins get it too, the response differs by origin
+    res = cors_get("https://other.test");
+    ASSERT_NULL(mock_get_header(&res, "Access-Control-Allow-Origin"));
+    ASSERT_EQ_STR("Origin", mock_get_header(&res, "Vary"));
+    free_request(&res);
+
+    cors_configure("/cors/config?mode=default");
+
+    // With "*" the response is the same for every origin
+    res = cors_get("https://app.test");
+    ASSERT_EQ_STR("*", mock_get_header(&res, "Access-Control-Allow-Origin"));
+    ASSERT_NULL(mock_get_header(&res, "Vary"));
+    free_request(&res);
+
+    RETURN_OK();
+}
+
+int test_cors_preflight_cache_consistent(void)
+{
+    cors_configure("/cors/config?mode=allowlist");
+
+    struct
+    {
+        const char *origin;
+        const char *method;
+        int status;
+    } cases[] = {
+        { "https://api.example.com", "PUT", 204 },
+        { "https://api.example.com", "DELETE", 403 },
+        { "https://example.com", "PUT", 403 },
+        { "https://pay.secure.test", "PUT", 204 },
+    };
+
+    // The second round is answered from the preflight cache
+    for (int round = 0; round < 2; round++) {
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            MockHeaders headers[] = {
+                { "Origin", cases[i].origin },
+                { "Access-Control-Request-Method", cases[i].method }
+            };
+
+            MockParams params = {
+                .method = MOCK_OPTIONS,
+                .path = "/api/data",
+                .body = NULL,
+                .headers = headers,
+                .header_count = 2
+            };
+
+            MockResponse res = request(&params);
+            const char *allowed = mock_get_header(&res, "Access-Control-Allow-Origin");
+
+            ASSERT_EQ(cases[i].status, res.status_code);
+            if (cases[i].status == 204)
+                ASSERT_EQ_STR(cases[i].origin, allowed);
+            else
+                ASSERT_NULL(allowed);
+            ASSERT_EQ_STR("Origin", mock_get_header(&res, "Vary"));
+
+            free_request(&res);
+        }
+    }
+
+    cors_configure("/cors/config?mode=default");
+    RETURN_OK();
+}
+
 void setup_cors_routes(void)
 {
     cors_init(NULL); // Default CORS
     get("/api/data", handler_cors_test);
+    get("/cors/config", handler_cors_config);
 }
@@ -2,6 +2,7 @@
 #include "ecewo-mock.h"
 #include "ecewo-fs.h"
 #include "tester.h"
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -87,6 +88,119 @@ void handler_fs_stat(Req *req, Res *res)
     fs_stat(filepath, on_stat_complete, res);
 }
 
+typedef struct
+{
+    Res *res;
+    int64_t offset;
+    size_t length;
+    size_t streamed;
+} fs_handle_ctx_t;
+
+static void on_pread_complete(const char *error, const char *data, size_t size, void *user_data)
+{
+    fs_handle_ctx_t *ctx = (fs_handle_ctx_t *)user_data;
+
+    if (error) {
+        send_text(ctx->res, 500, error);
+        return;
+    }
+
+    reply(ctx->res, 200, data, size);
+    free((void *)data);
+}
+
+static void on_open_for_pread(const char *error, fs_file_t *file, void *user_data)
+{
+    fs_handle_ctx_t *ctx = (fs_handle_ctx_t *)user_data;
+
+    if (error) {
+        send_text(ctx->res, 404, error);
+        return;
+    }
+
+    fs_pread(file, ctx->offset, ctx->length, on_pread_complete, ctx);
+    fs_close(file, NULL, NULL);
+}
+
+static bool on_stream_chunk(const char *error, const char *data, size_t size, void *user_data)
+{
+    fs_handle_ctx_t *ctx = (fs_handle_ctx_t *)user_data;
+    (void)data;
+
+    if (error) {
+        send_text(ctx->res, 404, error);
+        return false;
+    }
+
+    if (size == 0) {
+        send_text(ctx->res, 200, arena_sprintf(ctx->res->arena, "streamed:%zu", ctx->streamed));
+        return false;
+    }
+
+    ctx->streamed += size;
+    return true;
+}
+
+void handler_fs_pread(Req *req, Res *res)
+{
+    const char *filename = get_query(req, "file");
+    const char *offset = get_query(req, "offset");
+    const char *length = get_query(req, "length");
+    if (!filename || !offset || !length) {
+        send_text(res, 400, "Missing file, offset or length");
+        return;
+    }
+
+    fs_handle_ctx_t *ctx = arena_alloc(res->arena, sizeof(fs_handle_ctx_t));
+    ctx->res = res;
+    ctx->offset = atoll(offset);
+    ctx->length = (size_t)atoll(length);
+
+    char *filepath = arena_sprintf(req->arena, "test_files/%s", filename);
+    fs_open(filepath, UV_FS_O_RDONLY, 0, on_open_for_pread, ctx);
+}
+
+void handler_fs_stream(Req *req, Res *res)
+{
+    const char *filename = get_query(req, "file");
+    if (!filename) {
+        send_text(res, 400, "Missing file parameter");
+        return;
+    }
+
+    fs_handle_ctx_t *ctx = arena_alloc(res->arena, sizeof(fs_handle_ctx_t));
+    ctx->res = res;
+    ctx->streamed = 0;
+
+    char *filepath = arena_sprintf(req->arena, "test_files/%s", filename);
+    fs_read_stream(filepath, 0, SIZE_MAX, on_stream_chunk, ctx);
+}
+
+static void on_batch_complete(fs_batch_t *batch, size_t failed, void *user_data)
+{
+    Res *res = (Res *)user_data;
+
+    const uv_stat_t *stat = fs_batch_stat_result(batch, 0);
+    bool missing = fs_batch_error(batch, 1) != NULL;
+
+    send_text(res, 200, arena_sprintf(res->arena, "failed:%zu size:%lld missing:%d",
+                                      failed, stat ? (long long)stat->st_size : -1LL, missing));
+}
+
+void handler_fs_batch(Req *req, Res *res)
+{
+    fs_batch_t *batch = fs_batch_create();
+    if (!batch) {
+        send_text(res, 500, "Batch allocation failed");
+        return;
+    }
+
+    fs_batch_stat(batch, "test_files/batch.txt");
+    fs_batch_stat(batch, "test_files/batch_missing.txt");
+    fs_batch_unlink(batch, "test_files/batch_delete.txt");
+    fs_batch_submit(batch, on_batch_complete, res);
+}
+
 // ============================================================================
 // TESTS
 // ============================================================================
@@ -204,6 +318,112 @@ int test_fs_stat_file(void)
     RETURN_OK();
 }
 
+static void write_test_file(const char *path, const char *content, size_t size)
+{
+    uv_fs_t req;
+
+    uv_file file = uv_fs_open(NULL, &req, path,
+                              UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                              0644, NULL);
+    uv_fs_req_cleanup(&req);
+
+    if (file >= 0) {
+        uv_buf_t buf = uv_buf_init((char *)content, (unsigned int)size);
+        uv_fs_write(NULL, &req, file, &buf, 1, -1, NULL);
+        uv_fs_req_cleanup(&req);
+
+        uv_fs_close(NULL, &req, file, NULL);
+        uv_fs_req_cleanup(&req);
+    }
+}
+
+int test_fs_pread_handle(void)
+{
+    const char *content = "0123456789abcdef";
+    write_test_file("test_files/pread.txt", content, strlen(content));
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/fs/pread?file=pread.txt&offset=10&length=100",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    // Stops at the end of the file
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("abcdef", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_fs_read_stream(void)
+{
+    size_t size = 200 * 1024 + 7;
+    char *content = malloc(size);
+    ASSERT_NOT_NULL(content);
+    memset(content, 'x', size);
+
+    write_test_file("test_files/stream.bin", content, size);
+    free(content);
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/fs/stream?file=stream.bin",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("streamed:204807", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_fs_batch(void)
+{
+    write_test_file("test_files/batch.txt", "123", 3);
+    write_test_file("test_files/batch_delete.txt", "x", 1);
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/fs/batch",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("failed:1 size:3 missing:1", res.body);
+
+    uv_fs_t req;
+    int exists = uv_fs_stat(NULL, &req, "test_files/batch_delete.txt", NULL);
+    uv_fs_req_cleanup(&req);
+    ASSERT_EQ(UV_ENOENT, exists);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_fs_backend(void)
+{
+    const char *backend = fs_backend();
+
+    ASSERT_NOT_NULL(backend);
+    ASSERT_TRUE(strcmp(backend, "io_uring") == 0 || strcmp(backend, "libuv") == 0);
+
+    RETURN_OK();
+}
+
 int test_fs_missing_parameter(void)
 {
     MockParams params = {
@@ -241,6 +461,9 @@ void setup_fs_routes(void)
     get("/fs/read", handler_fs_read);
     post("/fs/write", handler_fs_write);
     get("/fs/stat", handler_fs_stat);
+    get("/fs/pread", handler_fs_pread);
+    get("/fs/stream", handler_fs_stream);
+    get("/fs/batch", handler_fs_batch);
 }
 
 void cleanup_fs(void)
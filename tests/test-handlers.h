@@ -6,6 +6,15 @@ int test_cluster_cpu_count(void);
 int test_cluster_callbacks(void);
 int test_cluster_invalid_config(void);
 int test_cluster_port_strategy(void);
+int test_cluster_steering_map(void);
+int test_cluster_scale_master_only(void);
+int test_cluster_ipc_partial_frames(void);
+int test_cluster_ipc_multiple_frames(void);
+int test_cluster_ipc_oversize(void);
+int test_cluster_ipc_stats_exchange(void);
+int test_cluster_restart_advance(void);
+int test_cluster_restart_never_ready(void);
+int test_cluster_restart_ready_timeout(void);
 
 // cookie
 int test_cookie_set_simple(void);
@@ -13,6 +22,7 @@ int test_cookie_set_complex(void);
 int test_cookie_get(void);
 int test_cookie_get_not_found(void);
 int test_cookie_get_multiple(void);
+int test_cookie_get_view(void);
 int test_cookie_delete(void);
 int test_cookie_url_encoded(void);
 void setup_cookie_routes(void);
@@ -21,6 +31,11 @@ void setup_cookie_routes(void);
 int test_cors_preflight_request(void);
 int test_cors_simple_request(void);
 int test_cors_no_origin(void);
+int test_cors_preflight_method_not_allowed(void);
+int test_cors_allowlist_exact(void);
+int test_cors_allowlist_wildcard(void);
+int test_cors_vary_origin(void);
+int test_cors_preflight_cache_consistent(void);
 void setup_cors_routes(void);
 
 // helmet
@@ -28,14 +43,47 @@ int test_helmet_default_headers(void);
 int test_helmet_custom_config(void);
 void setup_helmet_routes(void);
 
+// metrics
+int test_metrics_counter_gauge(void);
+int test_metrics_histogram(void);
+int test_metrics_help_escaped(void);
+int test_metrics_cluster_totals(void);
+int test_metrics_trace_hooks(void);
+int test_metrics_endpoint(void);
+void setup_metrics_routes(void);
+
+// postgres
+int test_postgres_pool_fifo(void);
+int test_postgres_statement_lru(void);
+int test_postgres_deadline_cancels(void);
+int test_postgres_pipeline(void);
+int test_postgres_pipeline_segments(void);
+int test_postgres_binary_params(void);
+int test_postgres_param_types(void);
+int test_postgres_stream_rows(void);
+int test_postgres_stream_stop(void);
+int test_postgres_stream_error(void);
+int test_postgres_latency_pooled(void);
+int test_postgres_latency_direct(void);
+void setup_postgres_routes(void);
+
 // session
 int test_session_create(void);
 int test_session_no_session(void);
 int test_session_value_set_get(void);
 int test_session_value_overwrite(void);
 int test_session_value_remove(void);
+int test_session_value_view(void);
 int test_session_find(void);
 int test_session_utf8_values(void);
+int test_session_many(void);
+int test_session_expired(void);
+int test_session_sliding_expiration(void);
+int test_session_shared_store(void);
+int test_session_cookie_signed(void);
+int test_session_cookie_encrypted_rotation(void);
+int test_session_hmac_sha256_vectors(void);
+int test_session_aead_vector(void);
 void setup_session_routes(void);
 void cleanup_session(void);
 
@@ -44,6 +92,10 @@ int test_fs_read_existing_file(void);
 int test_fs_read_nonexistent_file(void);
 int test_fs_write_file(void);
 int test_fs_stat_file(void);
+int test_fs_pread_handle(void);
+int test_fs_read_stream(void);
+int test_fs_batch(void);
+int test_fs_backend(void);
 int test_fs_missing_parameter(void);
 void setup_fs_routes(void);
 void cleanup_fs(void);
@@ -54,6 +106,17 @@ int test_static_serve_index(void);
 int test_static_not_found(void);
 int test_static_dotfile_blocked(void);
 int test_static_path_traversal_blocked(void);
+int test_static_cache_invalidation(void);
+int test_static_large_file_streamed(void);
+int test_static_large_file_buffered(void);
+int test_static_large_file_head(void);
+int test_static_large_file_repeated(void);
+int test_static_etag_not_modified(void);
+int test_static_if_modified_since(void);
+int test_static_precompressed(void);
+int test_static_range(void);
+int test_static_multi_range(void);
+int test_static_mime_types(void);
 void setup_static_routes(void);
 void cleanup_static(void);
 
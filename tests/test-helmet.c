@@ -23,6 +23,10 @@ int test_helmet_default_headers(void)
 
     ASSERT_EQ(200, res.status_code);
     ASSERT_EQ_STR("Helmet OK", res.body);
+    ASSERT_EQ_STR("max-age=31536000", mock_get_header(&res, "Strict-Transport-Security"));
+    ASSERT_EQ_STR("SAMEORIGIN", mock_get_header(&res, "X-Frame-Options"));
+    ASSERT_EQ_STR("nosniff", mock_get_header(&res, "X-Content-Type-Options"));
+    ASSERT_EQ_STR("noopen", mock_get_header(&res, "X-Download-Options"));
 
     free_request(&res);
     RETURN_OK();
@@ -0,0 +1,202 @@
+#include "ecewo.h"
+#include "ecewo-mock.h"
+#include "ecewo-metrics.h"
+#include "ecewo-session.h"
+#include "tester.h"
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static char *render(void)
+{
+    static char copy[16384];
+    Arena *arena = arena_borrow();
+    char *text = metrics_render(arena, NULL);
+
+    copy[0] = '\0';
+    if (text)
+        snprintf(copy, sizeof(copy), "%s", text);
+
+    arena_return(arena);
+    return copy;
+}
+
+typedef struct
+{
+    int begins;
+    int ends;
+    int failures;
+    const char *last_span;
+} trace_counts_t;
+
+static void *on_trace_begin(const char *span, const char *detail, void *user_data)
+{
+    (void)detail;
+    trace_counts_t *counts = user_data;
+    counts->begins++;
+    counts->last_span = span;
+    return counts;
+}
+
+static void on_trace_end(const char *span, void *token, bool ok, void *user_data)
+{
+    trace_counts_t *counts = user_data;
+    if (token == counts && strcmp(span, counts->last_span) == 0)
+        counts->ends++;
+    if (!ok)
+        counts->failures++;
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+int test_metrics_counter_gauge(void)
+{
+    Metric *requests = metrics_counter("test_requests_total", "Requests");
+    Metric *active = metrics_gauge("test_active", NULL);
+    ASSERT_NOT_NULL(requests);
+    ASSERT_NOT_NULL(active);
+
+    // Same name, same metric; another type or a bad name is refused
+    ASSERT_TRUE(metrics_counter("test_requests_total", NULL) == requests);
+    ASSERT_NULL(metrics_gauge("test_requests_total", NULL));
+    ASSERT_NULL(metrics_counter("test-bad name", NULL));
+
+    metrics_inc(requests);
+    metrics_add(requests, 2);
+    metrics_set(active, 10);
+    metrics_gauge_add(active, -4);
+    metrics_inc(NULL);
+
+    char *text = render();
+    ASSERT_NOT_NULL(strstr(text, "# HELP test_requests_total Requests\n"
+                                 "# TYPE test_requests_total counter\n"
+                                 "test_requests_total 3\n"));
+    ASSERT_NOT_NULL(strstr(text, "# TYPE test_active gauge\ntest_active 6\n"));
+
+    RETURN_OK();
+}
+
+int test_metrics_histogram(void)
+{
+    Metric *latency = metrics_histogram("test_latency_seconds", "Latency");
+    ASSERT_NOT_NULL(latency);
+
+    metrics_observe(latency, 30000);      // 30us
+    metrics_observe(latency, 2000000);    // 2ms
+    metrics_observe(latency, 3000000000); // 3s, only in +Inf
+
+    char *text = render();
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_bucket{le=\"5e-05\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_bucket{le=\"0.001\"} 1\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_bucket{le=\"0.0025\"} 2\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_bucket{le=\"2.5\"} 2\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_bucket{le=\"+Inf\"} 3\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_sum 3.002030000\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_latency_seconds_count 3\n"));
+
+    RETURN_OK();
+}
+
+int test_metrics_help_escaped(void)
+{
+    ASSERT_NOT_NULL(metrics_counter("test_escaped_total", "Files in C:\\tmp\nor /tmp"));
+
+    // A line break would end the HELP line and break the exposition
+    char *text = render();
+    ASSERT_NOT_NULL(strstr(text, "# HELP test_escaped_total Files in C:\\\\tmp\\nor /tmp\n"
+                                 "# TYPE test_escaped_total counter\n"));
+
+    RETURN_OK();
+}
+
+int test_metrics_cluster_totals(void)
+{
+    MetricsSample sample;
+    size_t index = 0;
+    while (metrics_sample(index, &sample) && strcmp(sample.name, "test_requests_total") != 0)
+        index++;
+    ASSERT_EQ_STR("test_requests_total", sample.name);
+
+    // Totals from the master replace the local values
+    MetricsSample other = sample;
+    other.value = 40;
+    metrics_sample_merge(&sample, &other);
+    metrics_set_cluster_sample(&sample);
+
+    char *text = render();
+    ASSERT_NOT_NULL(strstr(text, "# HELP test_requests_total Requests\n"));
+    ASSERT_NOT_NULL(strstr(text, "test_requests_total 43\n"));
+    ASSERT_NULL(strstr(text, "test_active"));
+
+    RETURN_OK();
+}
+
+int test_metrics_trace_hooks(void)
+{
+    trace_counts_t counts = { 0 };
+    MetricsTracer tracer = {
+        .begin = on_trace_begin,
+        .end = on_trace_end,
+        .user_data = &counts,
+    };
+
+    session_init();
+    metrics_set_tracer(&tracer);
+
+    Session *sess = session_create(60);
+    ASSERT_NOT_NULL(sess);
+
+    char id_copy[SESSION_ID_LEN + 1];
+    strcpy(id_copy, sess->id);
+    ASSERT_TRUE(session_find(id_copy) == sess);
+
+    memset(id_copy, 'x', SESSION_ID_LEN);
+    ASSERT_NULL(session_find(id_copy));
+
+    metrics_set_tracer(NULL);
+    session_find(id_copy);
+    session_cleanup();
+
+    ASSERT_EQ(2, counts.begins);
+    ASSERT_EQ(2, counts.ends);
+    ASSERT_EQ(1, counts.failures);
+    ASSERT_EQ_STR("session.lookup", counts.last_span);
+
+    RETURN_OK();
+}
+
+int test_metrics_endpoint(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/metrics",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("text/plain; version=0.0.4; charset=utf-8", mock_get_header(&res, "Content-Type"));
+    ASSERT_NOT_NULL(strstr(res.body, "# TYPE ecewo_static_cache_hits_total counter\n"));
+    ASSERT_NOT_NULL(strstr(res.body, "# TYPE ecewo_fs_op_seconds histogram\n"));
+    ASSERT_NOT_NULL(strstr(res.body, "# TYPE ecewo_session_count gauge\n"));
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+// ============================================================================
+// SETUP
+// ============================================================================
+
+void setup_metrics_routes(void)
+{
+    get("/metrics", metrics_handler);
+}
@@ -0,0 +1,821 @@
+#include "ecewo.h"
+#include "ecewo-mock.h"
+#include "ecewo-postgres.h"
+#include "tester.h"
+#include "uv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The tests need a server: ECEWO_PG_CONNINFO="dbname=test" ./modules_test
+#define PG_SKIP_MESSAGE "ECEWO_PG_CONNINFO is not set"
+
+static pg_pool_t *pool;
+
+// ============================================================================
+// HANDLERS
+// ============================================================================
+
+typedef struct
+{
+    Res *res;
+    char order[16];
+    int pending;
+} fifo_ctx_t;
+
+static void on_fifo_result(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    fifo_ctx_t *ctx = (fifo_ctx_t *)data;
+
+    if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
+        strncat(ctx->order, PQgetvalue(result, 0, 0), sizeof(ctx->order) - strlen(ctx->order) - 1);
+
+    if (--ctx->pending == 0)
+        send_text(ctx->res, 200, ctx->order);
+}
+
+// Three executions wait for the single connection and must get it in order
+static void handler_pg_pool_fifo(Req *req, Res *res)
+{
+    fifo_ctx_t *ctx = arena_alloc(req->arena, sizeof(fifo_ctx_t));
+    if (!ctx) {
+        send_text(res, 500, "Allocation failed");
+        return;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->res = res;
+
+    static const char *values[] = { "1", "2", "3" };
+    for (int i = 0; i < 3; i++) {
+        PGquery *pg = query_create_pooled(pool, req->arena);
+        const char *params[] = { values[i] };
+
+        if (!pg || query_queue(pg, "SELECT $1::int", 1, params, on_fifo_result, ctx) != 0) {
+            send_text(res, 500, "Failed to queue query");
+            return;
+        }
+
+        ctx->pending++;
+        if (query_execute(pg) != 0) {
+            send_text(res, 500, "Failed to execute query");
+            return;
+        }
+    }
+}
+
+static void on_ignore_result(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    (void)result;
+    (void)data;
+}
+
+static void on_prepared_list(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    Res *res = (Res *)data;
+
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
+        send_text(res, 500, "Listing failed");
+        return;
+    }
+
+    char *names = arena_sprintf(res->arena, "%s", "");
+    for (int i = 0; i < PQntuples(result); i++)
+        names = arena_sprintf(res->arena, "%s%s%s", names, i ? "," : "", PQgetvalue(result, i, 0));
+
+    send_text(res, 200, names);
+}
+
+// With room for two statements, A B A C evicts B, the least recently used
+static void handler_pg_stmt_lru(Req *req, Res *res)
+{
+    PGquery *pg = query_create_pooled(pool, req->arena);
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    static const char *sql[] = { "SELECT 'a'", "SELECT 'b'", "SELECT 'a'", "SELECT 'c'" };
+    for (int i = 0; i < 4; i++)
+        query_queue_prepared(pg, sql[i], 0, NULL, on_ignore_result, NULL);
+
+    query_queue(pg, "SELECT statement FROM pg_prepared_statements ORDER BY name", 0, NULL, on_prepared_list, res);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+typedef struct
+{
+    Res *res;
+    uint64_t start;
+} deadline_ctx_t;
+
+static void on_deadline_result(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    deadline_ctx_t *ctx = (deadline_ctx_t *)data;
+    uint64_t elapsed_ms = (uv_hrtime() - ctx->start) / 1000000;
+
+    if (result) {
+        send_text(ctx->res, 500, "Query was not canceled");
+        return;
+    }
+
+    send_text(ctx->res, 200, arena_sprintf(ctx->res->arena, "%llu", (unsigned long long)elapsed_ms));
+}
+
+static void handler_pg_deadline(Req *req, Res *res)
+{
+    deadline_ctx_t *ctx = arena_alloc(req->arena, sizeof(deadline_ctx_t));
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    ctx->res = res;
+    ctx->start = uv_hrtime();
+
+    query_queue(pg, "SELECT pg_sleep(10) AS ecewo_deadline_test", 0, NULL, on_deadline_result, ctx);
+    query_set_deadline(pg, 100);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+static void on_sleepers_count(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    Res *res = (Res *)data;
+
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
+        send_text(res, 500, "Count failed");
+        return;
+    }
+
+    send_text(res, 200, PQgetvalue(result, 0, 0));
+}
+
+static void handler_pg_sleepers(Req *req, Res *res)
+{
+    PGquery *pg = query_create_pooled(pool, req->arena);
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    query_queue(pg,
+                "SELECT count(*) FROM pg_stat_activity "
+                "WHERE state = 'active' AND query = 'SELECT pg_sleep(10) AS ecewo_deadline_test'",
+                0, NULL, on_sleepers_count, res);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+typedef struct
+{
+    Res *res;
+    char order[32];
+} order_ctx_t;
+
+static order_ctx_t *order_ctx_create(Req *req, Res *res)
+{
+    order_ctx_t *ctx = arena_alloc(req->arena, sizeof(order_ctx_t));
+    if (ctx) {
+        memset(ctx, 0, sizeof(*ctx));
+        ctx->res = res;
+    }
+    return ctx;
+}
+
+static void on_ordered_result(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    order_ctx_t *ctx = (order_ctx_t *)data;
+
+    if (PQresultStatus(result) == PGRES_TUPLES_OK)
+        strncat(ctx->order, PQgetvalue(result, 0, 0), sizeof(ctx->order) - strlen(ctx->order) - 1);
+}
+
+static void on_last_result(PGquery *pg, PGresult *result, void *data)
+{
+    order_ctx_t *ctx = (order_ctx_t *)data;
+
+    on_ordered_result(pg, result, ctx);
+    send_text(ctx->res, 200, ctx->order);
+}
+
+// Queued from a result callback, so it goes out as a second batch
+static void on_pipeline_third(PGquery *pg, PGresult *result, void *data)
+{
+    on_ordered_result(pg, result, data);
+
+    if (query_queue(pg, "SELECT 4", 0, NULL, on_last_result, data) != 0)
+        send_text(((order_ctx_t *)data)->res, 500, "Failed to queue query");
+}
+
+static void handler_pg_pipeline(Req *req, Res *res)
+{
+    order_ctx_t *ctx = order_ctx_create(req, res);
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    if (query_pipeline(pg, true) != 0) {
+        send_text(res, 501, "No pipeline mode");
+        return;
+    }
+
+    query_queue(pg, "SELECT 1", 0, NULL, on_ordered_result, ctx);
+    query_queue(pg, "SELECT 2", 0, NULL, on_ordered_result, ctx);
+    query_queue(pg, "SELECT 3", 0, NULL, on_pipeline_third, ctx);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+// The division fails, which skips 'b' but neither 'x' before it nor the
+// segment after the next sync point
+static void handler_pg_pipeline_segments(Req *req, Res *res)
+{
+    order_ctx_t *ctx = order_ctx_create(req, res);
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    if (query_pipeline(pg, true) != 0) {
+        send_text(res, 501, "No pipeline mode");
+        return;
+    }
+
+    query_queue(pg, "SELECT 'a'", 0, NULL, on_ordered_result, ctx);
+    query_pipeline_sync(pg);
+    query_queue(pg, "SELECT 'x'", 0, NULL, on_ordered_result, ctx);
+    query_queue(pg, "SELECT 1 / 0", 0, NULL, on_ordered_result, ctx);
+    query_queue(pg, "SELECT 'b'", 0, NULL, on_ordered_result, ctx);
+    query_pipeline_sync(pg);
+    query_queue(pg, "SELECT 'c'", 0, NULL, on_last_result, ctx);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+static void on_binary_result(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    Res *res = (Res *)data;
+
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK || PQgetlength(result, 0, 0) != 4) {
+        send_text(res, 500, "Unexpected result");
+        return;
+    }
+
+    // int4 in binary format: 4 bytes, network byte order
+    const unsigned char *n = (const unsigned char *)PQgetvalue(result, 0, 0);
+    uint32_t value = (uint32_t)n[0] << 24 | (uint32_t)n[1] << 16 | (uint32_t)n[2] << 8 | n[3];
+
+    send_text(res, 200, arena_sprintf(res->arena, "%u:%.*s:%d",
+                                      value, PQgetlength(result, 0, 1), PQgetvalue(result, 0, 1),
+                                      PQfformat(result, 0)));
+}
+
+static void handler_pg_binary_params(Req *req, Res *res)
+{
+    PGquery *pg = query_create_pooled(pool, req->arena);
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    unsigned char id[4] = { 0, 0, 0, 41 };
+    char name[16] = "ecewo";
+    PGparam params[] = {
+        { .type = 23, .value = (const char *)id, .length = sizeof(id), .format = 1 }, // int4
+        { .type = 0, .value = name },
+    };
+
+    if (query_queue_params(pg, "SELECT $1::int4 + 1, $2::text", 2, params,
+                           PG_RESULT_BINARY | PG_PREPARED, on_binary_result, res) != 0) {
+        send_text(res, 500, "Failed to queue query");
+        return;
+    }
+
+    // The values were copied, the query must not see any of this
+    memset(id, 0xFF, sizeof(id));
+    memset(name, 'X', sizeof(name) - 1);
+    memset(params, 0, sizeof(params));
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+// The same SQL prepared for two parameter types is two statements
+static void handler_pg_param_types(Req *req, Res *res)
+{
+    order_ctx_t *ctx = order_ctx_create(req, res);
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    PGparam as_int[] = { { .type = 23, .value = "7" } };
+    PGparam as_text[] = { { .type = 25, .value = "7" } };
+
+    query_queue_params(pg, "SELECT pg_typeof($1)::text || ','", 1, as_int, PG_PREPARED, on_ordered_result, ctx);
+    query_queue_params(pg, "SELECT pg_typeof($1)::text || ','", 1, as_text, PG_PREPARED, on_last_result, ctx);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+typedef struct
+{
+    Res *res; // NULL once answered
+    Arena *arena;
+    char rows[64];
+    int count;
+    int stop_after;
+    bool done;
+} stream_ctx_t;
+
+static int stream_rows_after_stop;
+// The PGquery still runs after the reply, the test frees it once done
+static stream_ctx_t *stream_stop_ctx;
+
+static void stream_append(stream_ctx_t *ctx, const char *value)
+{
+    size_t len = strlen(ctx->rows);
+    snprintf(ctx->rows + len, sizeof(ctx->rows) - len, "%s%s", len ? "," : "", value);
+}
+
+static void on_stream_row(PGquery *pg, PGresult *result, void *data)
+{
+    (void)pg;
+    stream_ctx_t *ctx = (stream_ctx_t *)data;
+    ExecStatusType status = PQresultStatus(result);
+
+    if (status == PGRES_TUPLES_OK) {
+        // The empty result after the last row
+        if (ctx->res) {
+            stream_append(ctx, "end");
+            send_text(ctx->res, 200, ctx->rows);
+        }
+        ctx->done = true;
+        return;
+    }
+
+    if (status != PGRES_SINGLE_TUPLE || PQntuples(result) != 1)
+        stream_append(ctx, "batch");
+
+    ctx->count++;
+    if (!ctx->res) {
+        stream_rows_after_stop++;
+        return;
+    }
+
+    stream_append(ctx, PQgetvalue(result, 0, 0));
+
+    if (ctx->count == ctx->stop_after) {
+        send_text(ctx->res, 200, ctx->rows);
+        ctx->res = NULL;
+    }
+}
+
+static void handler_pg_stream_rows(Req *req, Res *res)
+{
+    stream_ctx_t *ctx = arena_alloc(req->arena, sizeof(stream_ctx_t));
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->res = res;
+
+    query_queue(pg, "SELECT i FROM generate_series(1, 5) i", 0, NULL, on_stream_row, ctx);
+    query_stream_rows(pg, 1);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+// Answers after three rows; the rest of the stream outlives the request,
+// so it runs on an arena of its own that the test returns
+static void handler_pg_stream_stop(Req *req, Res *res)
+{
+    (void)req;
+    Arena *arena = arena_borrow();
+    stream_ctx_t *ctx = arena ? calloc(1, sizeof(stream_ctx_t)) : NULL;
+    PGquery *pg = ctx ? query_create_pooled(pool, arena) : NULL;
+    if (!pg) {
+        free(ctx);
+        if (arena)
+            arena_return(arena);
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    ctx->res = res;
+    ctx->arena = arena;
+    ctx->stop_after = 3;
+    stream_rows_after_stop = 0;
+    stream_stop_ctx = ctx;
+
+    query_queue(pg, "SELECT i FROM generate_series(1, 1000) i", 0, NULL, on_stream_row, ctx);
+    query_stream_rows(pg, 1);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+// Failed queries don't reach the result callback, the error is seen as
+// the query ending without the final empty result
+static void on_stream_error_timing(PGquery *pg, const PGtiming *timing, void *data)
+{
+    (void)pg;
+    (void)timing;
+    stream_ctx_t *ctx = (stream_ctx_t *)data;
+
+    if (ctx->res) {
+        stream_append(ctx, "failed");
+        send_text(ctx->res, 200, ctx->rows);
+    }
+}
+
+static void handler_pg_stream_error(Req *req, Res *res)
+{
+    stream_ctx_t *ctx = arena_alloc(req->arena, sizeof(stream_ctx_t));
+    PGquery *pg = ctx ? query_create_pooled(pool, req->arena) : NULL;
+    if (!pg) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->res = res;
+
+    // Division by zero on the third row
+    query_queue(pg, "SELECT 10 / (3 - i) FROM generate_series(1, 5) i", 0, NULL, on_stream_row, ctx);
+    query_stream_rows(pg, 1);
+    query_on_timing(pg, on_stream_error_timing, ctx);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+// A direct connection for the paths that don't go through the pool
+static PGconn *direct_conn;
+
+#define CHAIN_QUERIES 20
+
+typedef struct
+{
+    Res *res;
+    uint64_t start;
+    int remaining;
+} chain_ctx_t;
+
+// Each query is queued only once the previous one returned, so any fixed
+// polling interval would be paid once per query
+static void on_chain_result(PGquery *pg, PGresult *result, void *data)
+{
+    chain_ctx_t *ctx = (chain_ctx_t *)data;
+
+    if (!result || PQresultStatus(result) != PGRES_TUPLES_OK) {
+        send_text(ctx->res, 500, "Query failed");
+        return;
+    }
+
+    if (--ctx->remaining > 0) {
+        if (query_queue(pg, "SELECT 1", 0, NULL, on_chain_result, ctx) != 0)
+            send_text(ctx->res, 500, "Failed to queue query");
+        return;
+    }
+
+    uint64_t elapsed_ms = (uv_hrtime() - ctx->start) / 1000000;
+    send_text(ctx->res, 200, arena_sprintf(ctx->res->arena, "%llu", (unsigned long long)elapsed_ms));
+}
+
+static void run_chain(PGquery *pg, Req *req, Res *res)
+{
+    chain_ctx_t *ctx = pg ? arena_alloc(req->arena, sizeof(chain_ctx_t)) : NULL;
+    if (!ctx) {
+        send_text(res, 500, "Failed to create query");
+        return;
+    }
+
+    ctx->res = res;
+    ctx->start = uv_hrtime();
+    ctx->remaining = CHAIN_QUERIES;
+
+    query_queue(pg, "SELECT 1", 0, NULL, on_chain_result, ctx);
+
+    if (query_execute(pg) != 0)
+        send_text(res, 500, "Failed to execute query");
+}
+
+static void handler_pg_chain_pooled(Req *req, Res *res)
+{
+    run_chain(query_create_pooled(pool, req->arena), req, res);
+}
+
+static void handler_pg_chain_direct(Req *req, Res *res)
+{
+    run_chain(query_create(direct_conn, req->arena), req, res);
+}
+
+// ============================================================================
+// TEST CASES
+// ============================================================================
+
+static MockResponse pg_get(const char *path)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = path,
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    return request(&params);
+}
+
+int test_postgres_pool_fifo(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/pool-fifo");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("123", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_statement_lru(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/stmt-lru");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("SELECT 'a',SELECT 'c'", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_deadline_cancels(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/deadline");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_LE(atoi(res.body), 2000);
+    free_request(&res);
+
+    // The cancel lands asynchronously, the sleep must not run to its end
+    bool canceled = false;
+    for (int i = 0; i < 40 && !canceled; i++) {
+        res = pg_get("/pg/sleepers");
+        ASSERT_EQ(200, res.status_code);
+        canceled = strcmp(res.body, "0") == 0;
+        free_request(&res);
+
+        if (!canceled)
+            uv_sleep(50);
+    }
+
+    ASSERT_TRUE(canceled);
+    RETURN_OK();
+}
+
+int test_postgres_pipeline(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/pipeline");
+    if (res.status_code == 501) {
+        free_request(&res);
+        RETURN_SKIP("libpq has no pipeline mode");
+    }
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("1234", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_pipeline_segments(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/pipeline-segments");
+    if (res.status_code == 501) {
+        free_request(&res);
+        RETURN_SKIP("libpq has no pipeline mode");
+    }
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("axc", res.body);
+    free_request(&res);
+
+    // The connection left pipeline mode and serves the next request
+    res = pg_get("/pg/pool-fifo");
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("123", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_binary_params(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/binary-params");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("42:ecewo:1", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_param_types(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/param-types");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("integer,text,", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_stream_rows(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/stream-rows");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("1,2,3,4,5,end", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_stream_stop(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/stream-stop");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("1,2,3", res.body);
+    free_request(&res);
+
+    // The single connection is only handed on once the stream is drained
+    res = pg_get("/pg/pool-fifo");
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("123", res.body);
+    ASSERT_EQ(997, stream_rows_after_stop);
+    ASSERT_NOT_NULL(stream_stop_ctx);
+    ASSERT_TRUE(stream_stop_ctx->done);
+
+    free_request(&res);
+    arena_return(stream_stop_ctx->arena);
+    free(stream_stop_ctx);
+    stream_stop_ctx = NULL;
+    RETURN_OK();
+}
+
+int test_postgres_stream_error(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    MockResponse res = pg_get("/pg/stream-error");
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("5,10,failed", res.body);
+    free_request(&res);
+
+    res = pg_get("/pg/pool-fifo");
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("123", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+// 20 round-trips on a local server take a few ms; waiting for a 10 ms
+// timer tick per query would add up to 200 ms
+static int assert_chain_latency(const char *path)
+{
+    MockResponse res = pg_get(path);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_LE(atoi(res.body), 50);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_postgres_latency_pooled(void)
+{
+    if (!pool)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    return assert_chain_latency("/pg/chain-pooled");
+}
+
+int test_postgres_latency_direct(void)
+{
+    if (!direct_conn)
+        RETURN_SKIP(PG_SKIP_MESSAGE);
+
+    return assert_chain_latency("/pg/chain-direct");
+}
+
+// ============================================================================
+// SETUP
+// ============================================================================
+
+static void close_pool(void)
+{
+    pg_pool_destroy(pool);
+    pool = NULL;
+
+    if (direct_conn) {
+        PQfinish(direct_conn);
+        direct_conn = NULL;
+    }
+}
+
+void setup_postgres_routes(void)
+{
+    const char *conninfo = getenv("ECEWO_PG_CONNINFO");
+    if (!conninfo || !*conninfo)
+        return;
+
+    PGPool config = {
+        .conninfo = conninfo,
+        .max_size = 1,
+        .statement_cache_size = 2,
+    };
+
+    pool = pg_pool_create(&config);
+    if (!pool)
+        return;
+
+    server_atexit(close_pool);
+
+    direct_conn = PQconnectdb(conninfo);
+    if (PQstatus(direct_conn) != CONNECTION_OK) {
+        fprintf(stderr, "Direct connection failed: %s\n", PQerrorMessage(direct_conn));
+        PQfinish(direct_conn);
+        direct_conn = NULL;
+    }
+
+    get("/pg/pool-fifo", handler_pg_pool_fifo);
+    get("/pg/stmt-lru", handler_pg_stmt_lru);
+    get("/pg/deadline", handler_pg_deadline);
+    get("/pg/sleepers", handler_pg_sleepers);
+    get("/pg/pipeline", handler_pg_pipeline);
+    get("/pg/pipeline-segments", handler_pg_pipeline_segments);
+    get("/pg/binary-params", handler_pg_binary_params);
+    get("/pg/param-types", handler_pg_param_types);
+    get("/pg/stream-rows", handler_pg_stream_rows);
+    get("/pg/stream-stop", handler_pg_stream_stop);
+    get("/pg/stream-error", handler_pg_stream_error);
+    get("/pg/chain-pooled", handler_pg_chain_pooled);
+    get("/pg/chain-direct", handler_pg_chain_direct);
+}
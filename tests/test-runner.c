@@ -12,6 +12,10 @@ void setup_all_routes(void)
     setup_session_routes();
     setup_fs_routes();
     setup_static_routes();
+    setup_metrics_routes();
+#ifdef ECEWO_POSTGRES
+    setup_postgres_routes();
+#endif
 }
 
 int main(void)
@@ -22,6 +26,15 @@ int main(void)
     RUN_TEST(test_cluster_callbacks);
     RUN_TEST(test_cluster_invalid_config);
     RUN_TEST(test_cluster_port_strategy);
+    RUN_TEST(test_cluster_steering_map);
+    RUN_TEST(test_cluster_scale_master_only);
+    RUN_TEST(test_cluster_ipc_partial_frames);
+    RUN_TEST(test_cluster_ipc_multiple_frames);
+    RUN_TEST(test_cluster_ipc_oversize);
+    RUN_TEST(test_cluster_ipc_stats_exchange);
+    RUN_TEST(test_cluster_restart_advance);
+    RUN_TEST(test_cluster_restart_never_ready);
+    RUN_TEST(test_cluster_restart_ready_timeout);
 #endif
 
     printf("\n--- Session Unit Tests ---\n");
@@ -29,10 +42,23 @@ int main(void)
     RUN_TEST(test_session_value_set_get);
     RUN_TEST(test_session_value_overwrite);
     RUN_TEST(test_session_value_remove);
+    RUN_TEST(test_session_value_view);
     RUN_TEST(test_session_find);
     RUN_TEST(test_session_utf8_values);
+    RUN_TEST(test_session_many);
+    RUN_TEST(test_session_expired);
+    RUN_TEST(test_session_sliding_expiration);
+#ifdef __linux__
+    RUN_TEST(test_session_shared_store);
+#endif
     session_cleanup();
 
+    printf("\n--- Metrics Unit Tests ---\n");
+    RUN_TEST(test_metrics_counter_gauge);
+    RUN_TEST(test_metrics_histogram);
+    RUN_TEST(test_metrics_help_escaped);
+    RUN_TEST(test_metrics_trace_hooks);
+
     printf("\n--- HTTP Integration Tests ---\n");
 
     if (mock_init(setup_all_routes) != 0) {
@@ -49,12 +75,18 @@ int main(void)
     RUN_TEST(test_cookie_get);
     RUN_TEST(test_cookie_get_not_found);
     RUN_TEST(test_cookie_get_multiple);
+    RUN_TEST(test_cookie_get_view);
     RUN_TEST(test_cookie_delete);
     RUN_TEST(test_cookie_url_encoded);
 
     printf("\n--- CORS Tests ---\n");
     RUN_TEST(test_cors_simple_request);
     RUN_TEST(test_cors_no_origin);
+    RUN_TEST(test_cors_preflight_method_not_allowed);
+    RUN_TEST(test_cors_allowlist_exact);
+    RUN_TEST(test_cors_allowlist_wildcard);
+    RUN_TEST(test_cors_vary_origin);
+    RUN_TEST(test_cors_preflight_cache_consistent);
 
     printf("\n--- Helmet Tests ---\n");
     RUN_TEST(test_helmet_default_headers);
@@ -63,6 +95,10 @@ int main(void)
     printf("\n--- Session HTTP Tests ---\n");
     RUN_TEST(test_session_create);
     RUN_TEST(test_session_no_session);
+    RUN_TEST(test_session_cookie_signed);
+    RUN_TEST(test_session_cookie_encrypted_rotation);
+    RUN_TEST(test_session_hmac_sha256_vectors);
+    RUN_TEST(test_session_aead_vector);
 
     printf("\n--- File System Tests ---\n");
     RUN_TEST(test_fs_read_existing_file);
@@ -71,6 +107,10 @@ int main(void)
     RUN_TEST(test_fs_read_nonexistent_file);
     RUN_TEST(test_fs_write_file);
     RUN_TEST(test_fs_stat_file);
+    RUN_TEST(test_fs_pread_handle);
+    RUN_TEST(test_fs_read_stream);
+    RUN_TEST(test_fs_batch);
+    RUN_TEST(test_fs_backend);
     RUN_TEST(test_fs_missing_parameter);
 
     printf("\n--- Static File Tests ---\n");
@@ -82,6 +122,38 @@ int main(void)
     RUN_TEST(test_static_not_found);
     RUN_TEST(test_static_dotfile_blocked);
     RUN_TEST(test_static_path_traversal_blocked);
+    RUN_TEST(test_static_cache_invalidation);
+    RUN_TEST(test_static_large_file_streamed);
+    RUN_TEST(test_static_large_file_buffered);
+    RUN_TEST(test_static_large_file_head);
+    RUN_TEST(test_static_large_file_repeated);
+    RUN_TEST(test_static_etag_not_modified);
+    RUN_TEST(test_static_if_modified_since);
+    RUN_TEST(test_static_precompressed);
+    RUN_TEST(test_static_range);
+    RUN_TEST(test_static_multi_range);
+    RUN_TEST(test_static_mime_types);
+
+#ifdef ECEWO_POSTGRES
+    printf("\n--- Postgres Tests ---\n");
+    RUN_TEST(test_postgres_pool_fifo);
+    RUN_TEST(test_postgres_statement_lru);
+    RUN_TEST(test_postgres_deadline_cancels);
+    RUN_TEST(test_postgres_pipeline);
+    RUN_TEST(test_postgres_pipeline_segments);
+    RUN_TEST(test_postgres_binary_params);
+    RUN_TEST(test_postgres_param_types);
+    RUN_TEST(test_postgres_stream_rows);
+    RUN_TEST(test_postgres_stream_stop);
+    RUN_TEST(test_postgres_stream_error);
+    RUN_TEST(test_postgres_latency_pooled);
+    RUN_TEST(test_postgres_latency_direct);
+#endif
+
+    printf("\n--- Metrics HTTP Tests ---\n");
+    RUN_TEST(test_metrics_endpoint);
+    // Last: switches rendering to cluster totals for the rest of the run
+    RUN_TEST(test_metrics_cluster_totals);
 
     cleanup_session();
     cleanup_fs();
@@ -1,6 +1,6 @@
-#include "ecewo.h"
+// Includes the module itself to reach its crypto primitives
+#include "ecewo-session.c"
 #include "ecewo-mock.h"
-#include "ecewo-session.h"
 #include "tester.h"
 #include <string.h>
 
@@ -49,6 +49,19 @@ void handler_session_destroy(Req *req, Res *res)
     send_text(res, 200, "Session destroyed");
 }
 
+void handler_session_start(Req *req, Res *res)
+{
+    Session *sess = session_start(req, 3600);
+    if (!sess) {
+        send_text(res, 500, "Session creation failed");
+        return;
+    }
+
+    session_value_set(sess, "user_id", "12345");
+    session_send(res, sess, NULL);
+    send_text(res, 200, "Session started");
+}
+
 // ============================================================================
 // TESTS
 // ============================================================================
@@ -155,6 +168,31 @@ int test_session_value_remove(void)
     RETURN_OK();
 }
 
+int test_session_value_view(void)
+{
+    Session *sess = session_create(3600);
+    ASSERT_NOT_NULL(sess);
+
+    session_value_set(sess, "role", "admin");
+
+    size_t len = 0;
+    const char *view = session_value_get_view(sess, "role", &len);
+    ASSERT_NOT_NULL(view);
+    ASSERT_EQ(5, len);
+    ASSERT_EQ_STR("admin", view);
+
+    // Shorter values are written in place
+    session_value_set(sess, "role", "user");
+    ASSERT_TRUE(session_value_get_view(sess, "role", &len) == view);
+    ASSERT_EQ(4, len);
+    ASSERT_EQ_STR("user", view);
+
+    ASSERT_NULL(session_value_get_view(sess, "missing", NULL));
+
+    session_free(sess);
+    RETURN_OK();
+}
+
 int test_session_find(void)
 {
     Session *sess = session_create(3600);
@@ -197,6 +235,351 @@ int test_session_utf8_values(void)
     RETURN_OK();
 }
 
+int test_session_many(void)
+{
+    enum { COUNT = 1000 };
+    static char ids[COUNT][SESSION_ID_LEN + 1];
+    static Session *sessions[COUNT];
+
+    for (int i = 0; i < COUNT; i++) {
+        sessions[i] = session_create(3600);
+        ASSERT_NOT_NULL(sessions[i]);
+        strcpy(ids[i], sessions[i]->id);
+    }
+
+    for (int i = 0; i < COUNT; i += 2)
+        session_free(sessions[i]);
+
+    for (int i = 0; i < COUNT; i++) {
+        Session *found = session_find(ids[i]);
+        if (i % 2 == 0) {
+            ASSERT_NULL(found);
+        } else {
+            ASSERT_NOT_NULL(found);
+            ASSERT_TRUE(found == sessions[i]);
+        }
+    }
+
+    for (int i = 1; i < COUNT; i += 2)
+        session_free(sessions[i]);
+
+    RETURN_OK();
+}
+
+int test_session_expired(void)
+{
+    Session *sess = session_create(-1);
+    ASSERT_NOT_NULL(sess);
+
+    char id_copy[SESSION_ID_LEN + 1];
+    strcpy(id_copy, sess->id);
+
+    ASSERT_NULL(session_find(id_copy));
+    ASSERT_EQ('\0', sess->id[0]);
+
+    RETURN_OK();
+}
+
+int test_session_sliding_expiration(void)
+{
+    session_cleanup();
+
+    SessionOptions options = { .sliding_expiration = true };
+    ASSERT_TRUE(session_init_with(&options));
+
+    Session *sess = session_create(600);
+    ASSERT_NOT_NULL(sess);
+
+    char id_copy[SESSION_ID_LEN + 1];
+    strcpy(id_copy, sess->id);
+
+    sess->expires = time(NULL) + 5;
+    ASSERT_TRUE(session_find(id_copy) == sess);
+    ASSERT_GT(sess->expires, time(NULL) + 500);
+
+    session_cleanup();
+    ASSERT_TRUE(session_init());
+    RETURN_OK();
+}
+
+#ifdef __linux__
+int test_session_shared_store(void)
+{
+    session_cleanup();
+
+    SessionOptions options = { .shared_capacity = 256 };
+    ASSERT_TRUE(session_init_with(&options));
+
+    Session *sess = session_create(3600);
+    ASSERT_NOT_NULL(sess);
+    session_value_set(sess, "user_id", "42");
+
+    char id_copy[SESSION_ID_LEN + 1];
+    strcpy(id_copy, sess->id);
+
+    Session *found = session_find(id_copy);
+    ASSERT_NOT_NULL(found);
+    ASSERT_EQ_STR("42", session_value_get_view(found, "user_id", NULL));
+
+    session_free(found);
+    ASSERT_NULL(session_find(id_copy));
+
+    session_cleanup();
+    ASSERT_TRUE(session_init());
+    RETURN_OK();
+}
+#endif
+
+static const unsigned char COOKIE_SECRET_1[] = "0123456789abcdef0123456789abcdef";
+static const unsigned char COOKIE_SECRET_2[] = "fedcba9876543210fedcba9876543210";
+
+// Starts a session and copies "session=<token>" into cookie
+static int start_cookie_session(char *cookie, size_t size)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/session/start",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+    const char *set_cookie = mock_get_header(&res, "Set-Cookie");
+    size_t len = set_cookie ? strcspn(set_cookie, ";") : 0;
+    int ok = res.status_code == 200 && len > 0 && len < size;
+
+    if (ok) {
+        memcpy(cookie, set_cookie, len);
+        cookie[len] = '\0';
+    }
+
+    free_request(&res);
+    return ok;
+}
+
+static int get_cookie_session(const char *cookie, MockResponse *res)
+{
+    MockHeaders headers[] = {
+        { "Cookie", cookie }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/session/get",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    *res = request(&params);
+    return res->status_code;
+}
+
+int test_session_cookie_signed(void)
+{
+    session_cleanup();
+
+    SessionKey keys[] = {
+        { .id = 1, .secret = COOKIE_SECRET_1, .secret_len = 32 }
+    };
+
+    SessionOptions options = { .cookie_keys = keys, .cookie_key_count = 1 };
+    ASSERT_TRUE(session_init_with(&options));
+
+    char cookie[4096];
+    ASSERT_TRUE(start_cookie_session(cookie, sizeof(cookie)));
+
+    MockResponse res;
+    ASSERT_EQ(200, get_cookie_session(cookie, &res));
+    ASSERT_EQ_STR("12345", res.body);
+    free_request(&res);
+
+    char *token = strchr(cookie, '=') + 1;
+    size_t token_len = strlen(token);
+
+    // A character in the middle carries six bits of the token
+    char *middle = token + token_len / 2;
+    char saved = *middle;
+    *middle = saved == 'A' ? 'B' : 'A';
+
+    ASSERT_EQ(401, get_cookie_session(cookie, &res));
+    free_request(&res);
+    *middle = saved;
+
+    // Setting an unused bit of the last character keeps the bytes the same
+    if (token_len % 4 != 0) {
+        static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        char *last = token + token_len - 1;
+        *last = alphabet[(strchr(alphabet, *last) - alphabet) ^ 1];
+
+        ASSERT_EQ(401, get_cookie_session(cookie, &res));
+        free_request(&res);
+    }
+
+    session_cleanup();
+    ASSERT_TRUE(session_init());
+    RETURN_OK();
+}
+
+int test_session_cookie_encrypted_rotation(void)
+{
+    session_cleanup();
+
+    SessionKey keys[] = {
+        { .id = 2, .secret = COOKIE_SECRET_2, .secret_len = 32 },
+        { .id = 1, .secret = COOKIE_SECRET_1, .secret_len = 32 }
+    };
+
+    SessionOptions options = { .cookie_keys = &keys[1], .cookie_key_count = 1, .cookie_encrypt = true };
+    ASSERT_TRUE(session_init_with(&options));
+
+    char cookie[4096];
+    ASSERT_TRUE(start_cookie_session(cookie, sizeof(cookie)));
+    ASSERT_NULL(strstr(cookie, "12345"));
+
+    // New cookies are encrypted with key 2, key 1 still decrypts the old ones
+    ASSERT_TRUE(session_set_keys(keys, 2));
+
+    MockResponse res;
+    ASSERT_EQ(200, get_cookie_session(cookie, &res));
+    ASSERT_EQ_STR("12345", res.body);
+    free_request(&res);
+
+    ASSERT_TRUE(session_set_keys(keys, 1));
+    ASSERT_EQ(401, get_cookie_session(cookie, &res));
+    free_request(&res);
+
+    session_cleanup();
+    ASSERT_TRUE(session_init());
+    RETURN_OK();
+}
+
+// ============================================================================
+// KNOWN-ANSWER TESTS
+// ============================================================================
+
+static const char *to_hex(const uint8_t *data, size_t len, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    for (size_t i = 0; i < len; i++) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 0x0f];
+    }
+    out[len * 2] = '\0';
+    return out;
+}
+
+typedef struct
+{
+    uint8_t key_byte; // 0 for the 0x01..0x19 key of case 4
+    size_t key_len;
+    uint8_t data_byte; // 0 when data is given as text
+    size_t data_len;
+    const char *data;
+    const char *mac;
+} hmac_vector_t;
+
+// RFC 4231 section 4, case 5 is truncated to 128 bits
+static const hmac_vector_t HMAC_VECTORS[] = {
+    { 0x0b, 20, 0, 0, "Hi There",
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { 0, 0, 0, 0, "what do ya want for nothing?",
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { 0xaa, 20, 0xdd, 50, NULL,
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+    { 0, 25, 0xcd, 50, NULL,
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+    { 0x0c, 20, 0, 0, "Test With Truncation",
+      "a3b6167473100ee06e0c796c2955552b" },
+    { 0xaa, 131, 0, 0, "Test Using Larger Than Block-Size Key - Hash Key First",
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { 0xaa, 131, 0, 0,
+      "This is a test using a larger than block-size key and a larger than block-size data. "
+      "The key needs to be hashed before being used by the HMAC algorithm.",
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+};
+
+int test_session_hmac_sha256_vectors(void)
+{
+    for (size_t i = 0; i < sizeof(HMAC_VECTORS) / sizeof(HMAC_VECTORS[0]); i++) {
+        const hmac_vector_t *v = &HMAC_VECTORS[i];
+
+        uint8_t key[131];
+        const uint8_t *key_ptr = key;
+        size_t key_len = v->key_len;
+        if (v->key_byte) {
+            memset(key, v->key_byte, key_len);
+        } else if (key_len) {
+            for (size_t j = 0; j < key_len; j++)
+                key[j] = (uint8_t)(j + 1);
+        } else {
+            key_ptr = (const uint8_t *)"Jefe";
+            key_len = 4;
+        }
+
+        uint8_t data_buf[50];
+        const uint8_t *data = (const uint8_t *)v->data;
+        size_t data_len = v->data ? strlen(v->data) : v->data_len;
+        if (!v->data) {
+            memset(data_buf, v->data_byte, data_len);
+            data = data_buf;
+        }
+
+        uint8_t mac[32];
+        char hex[65];
+        size_t mac_len = strlen(v->mac) / 2;
+
+        hmac_sha256(key_ptr, key_len, data, data_len, NULL, 0, mac);
+        ASSERT_EQ_STR(v->mac, to_hex(mac, mac_len, hex));
+
+        // The message may come in two parts
+        hmac_sha256(key_ptr, key_len, data, data_len / 2, data + data_len / 2, data_len - data_len / 2, mac);
+        ASSERT_EQ_STR(v->mac, to_hex(mac, mac_len, hex));
+    }
+
+    RETURN_OK();
+}
+
+// RFC 8439 section 2.8.2
+int test_session_aead_vector(void)
+{
+    static const char plaintext[] =
+        "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, "
+        "sunscreen would be it.";
+    static const uint8_t aad[] = { 0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7 };
+    static const uint8_t nonce[12] = { 0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47 };
+    static const char ciphertext[] =
+        "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+        "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+        "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+        "3ff4def08e4b7a9de576d26586cec64b6116";
+
+    uint8_t key[32];
+    for (int i = 0; i < 32; i++)
+        key[i] = (uint8_t)(0x80 + i);
+
+    size_t len = sizeof(plaintext) - 1;
+    uint8_t data[sizeof(plaintext) - 1];
+    char hex[2 * sizeof(plaintext)];
+    ASSERT_EQ(114, len);
+
+    // The payload is encrypted from block 1, block 0 gives the Poly1305 key
+    memcpy(data, plaintext, len);
+    chacha20_xor(key, 1, nonce, data, len);
+    ASSERT_EQ_STR(ciphertext, to_hex(data, len, hex));
+
+    uint8_t tag[16];
+    aead_tag(key, nonce, aad, sizeof(aad), data, len, tag);
+    ASSERT_EQ_STR("1ae10b594f09e26a7e902ecbd0600691", to_hex(tag, sizeof(tag), hex));
+
+    chacha20_xor(key, 1, nonce, data, len);
+    ASSERT_EQ(0, memcmp(data, plaintext, len));
+
+    RETURN_OK();
+}
+
 // ============================================================================
 // SETUP
 // ============================================================================
@@ -207,6 +590,7 @@ void setup_session_routes(void)
     get("/session/create", handler_session_create);
     get("/session/get", handler_session_get);
     get("/session/destroy", handler_session_destroy);
+    get("/session/start", handler_session_start);
 }
 
 void cleanup_session(void)
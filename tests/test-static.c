@@ -5,6 +5,7 @@
 #include "uv.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 // ========================================================================
 // TEST CASES
@@ -102,6 +103,375 @@ int test_static_path_traversal_blocked(void)
     RETURN_OK();
 }
 
+static void write_test_file(const char *path, const char *content)
+{
+    uv_fs_t req;
+    uv_file file = uv_fs_open(NULL, &req, path,
+                              UV_FS_O_WRONLY | UV_FS_O_CREAT | UV_FS_O_TRUNC,
+                              0644, NULL);
+    uv_fs_req_cleanup(&req);
+
+    if (file >= 0) {
+        uv_buf_t buf = uv_buf_init((char *)content, strlen(content));
+        uv_fs_write(NULL, &req, file, &buf, 1, -1, NULL);
+        uv_fs_req_cleanup(&req);
+
+        uv_fs_close(NULL, &req, file, NULL);
+        uv_fs_req_cleanup(&req);
+    }
+}
+
+int test_static_cache_invalidation(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/cached/page.html",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_NOT_NULL(strstr(res.body, "first"));
+    free_request(&res);
+
+    // Served from memory
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_NOT_NULL(strstr(res.body, "first"));
+    free_request(&res);
+
+    write_test_file("test_public/page.html", "<html>second</html>");
+
+    // The file watcher evicts the entry asynchronously
+    bool updated = false;
+    for (int i = 0; i < 50 && !updated; i++) {
+        res = request(&params);
+        updated = res.status_code == 200 && strstr(res.body, "second") != NULL;
+        free_request(&res);
+        if (!updated)
+            uv_sleep(20);
+    }
+
+    ASSERT_TRUE(updated);
+    RETURN_OK();
+}
+
+int test_static_large_file_streamed(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/stream/large.txt",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ(3 * 1024 * 1024, (int)res.body_len);
+    ASSERT_EQ('x', res.body[res.body_len - 1]);
+
+    // The stream owns the connection and ends it
+    ASSERT_EQ_STR("close", mock_get_header(&res, "Connection"));
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_large_file_buffered(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/large.txt",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    // Without stream_threshold large files go through reply() as well
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ(3 * 1024 * 1024, (int)res.body_len);
+    ASSERT_EQ('x', res.body[res.body_len - 1]);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_large_file_head(void)
+{
+    MockParams params = {
+        .method = MOCK_HEAD,
+        .path = "/stream/large.txt",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("3145728", mock_get_header(&res, "Content-Length"));
+    ASSERT_EQ(0, (int)res.body_len);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_large_file_repeated(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/stream/large.txt",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    // Each download closes its connection, the next one opens a new one
+    MockBench bench = {
+        .requests = &params,
+        .request_count = 1,
+        .connections = 1,
+        .pipeline = 1,
+        .total_requests = 4,
+    };
+
+    MockBenchResult result;
+    ASSERT_EQ(0, mock_bench(&bench, &result));
+    ASSERT_EQ(4, (int)result.requests);
+    ASSERT_EQ(0, (int)result.errors);
+    ASSERT_EQ(0, (int)result.non_2xx);
+
+    RETURN_OK();
+}
+
+int test_static_etag_not_modified(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/index.html",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+
+    const char *etag = mock_get_header(&res, "ETag");
+    ASSERT_NOT_NULL(etag);
+    ASSERT_NOT_NULL(mock_get_header(&res, "Last-Modified"));
+    ASSERT_NOT_NULL(mock_get_header(&res, "Cache-Control"));
+
+    char etag_copy[64];
+    snprintf(etag_copy, sizeof(etag_copy), "%s", etag);
+    free_request(&res);
+
+    MockHeaders headers[] = {
+        { "If-None-Match", etag_copy }
+    };
+    params.headers = headers;
+    params.header_count = 1;
+
+    res = request(&params);
+    ASSERT_EQ(304, res.status_code);
+    ASSERT_EQ(0, (int)res.body_len);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_if_modified_since(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/index.html",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    MockResponse res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+
+    const char *last_modified = mock_get_header(&res, "Last-Modified");
+    ASSERT_NOT_NULL(last_modified);
+
+    char date[64];
+    snprintf(date, sizeof(date), "%s", last_modified);
+    free_request(&res);
+
+    MockHeaders headers[] = {
+        { "If-Modified-Since", date }
+    };
+    params.headers = headers;
+    params.header_count = 1;
+
+    res = request(&params);
+    ASSERT_EQ(304, res.status_code);
+    free_request(&res);
+
+    // A date before the file existed gets the full body
+    headers[0].value = "Sun, 06 Nov 1994 08:49:37 GMT";
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_NOT_NULL(strstr(res.body, "<html>"));
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_precompressed(void)
+{
+    MockHeaders headers[] = {
+        { "Accept-Encoding", "gzip, deflate" }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/pre/app.js",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("gzip", mock_get_header(&res, "Content-Encoding"));
+    ASSERT_EQ_STR("Accept-Encoding", mock_get_header(&res, "Vary"));
+    ASSERT_EQ_STR("application/javascript; charset=utf-8", mock_get_header(&res, "Content-Type"));
+    ASSERT_EQ_STR("gzipped", res.body);
+    free_request(&res);
+
+    // Without Accept-Encoding the original file is served
+    params.headers = NULL;
+    params.header_count = 0;
+
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_NULL(mock_get_header(&res, "Content-Encoding"));
+    ASSERT_EQ_STR("console.log('plain');", res.body);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_range(void)
+{
+    MockHeaders headers[] = {
+        { "Range", "bytes=0-5" }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/index.html",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(206, res.status_code);
+    ASSERT_EQ_STR("<html>", res.body);
+    ASSERT_EQ_STR("bytes 0-5/31", mock_get_header(&res, "Content-Range"));
+    ASSERT_EQ_STR("bytes", mock_get_header(&res, "Accept-Ranges"));
+    free_request(&res);
+
+    // Suffix range
+    headers[0].value = "bytes=-7";
+    res = request(&params);
+    ASSERT_EQ(206, res.status_code);
+    ASSERT_EQ_STR("</html>", res.body);
+    free_request(&res);
+
+    headers[0].value = "bytes=100-200";
+    res = request(&params);
+    ASSERT_EQ(416, res.status_code);
+    ASSERT_EQ_STR("bytes */31", mock_get_header(&res, "Content-Range"));
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_multi_range(void)
+{
+    MockHeaders headers[] = {
+        { "Range", "bytes=0-5, 12-16" }
+    };
+
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/index.html",
+        .body = NULL,
+        .headers = headers,
+        .header_count = 1
+    };
+
+    MockResponse res = request(&params);
+
+    ASSERT_EQ(206, res.status_code);
+    ASSERT_NOT_NULL(strstr(mock_get_header(&res, "Content-Type"), "multipart/byteranges; boundary="));
+    ASSERT_NOT_NULL(strstr(res.body, "Content-Range: bytes 0-5/31"));
+    ASSERT_NOT_NULL(strstr(res.body, "Content-Range: bytes 12-16/31"));
+    ASSERT_NOT_NULL(strstr(res.body, "Hello"));
+    free_request(&res);
+
+    // A stale If-Range gets the whole file
+    MockHeaders stale[] = {
+        { "Range", "bytes=0-5" },
+        { "If-Range", "\"stale\"" }
+    };
+    params.headers = stale;
+    params.header_count = 2;
+
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ(31, (int)res.body_len);
+
+    free_request(&res);
+    RETURN_OK();
+}
+
+int test_static_mime_types(void)
+{
+    MockParams params = {
+        .method = MOCK_GET,
+        .path = "/photo.JPG",
+        .body = NULL,
+        .headers = NULL,
+        .header_count = 0
+    };
+
+    // Case-insensitive
+    MockResponse res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("image/jpeg", mock_get_header(&res, "Content-Type"));
+    free_request(&res);
+
+    // static_add_mime_type(), charset added for text types
+    params.path = "/notes.rst";
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("text/x-rst; charset=utf-8", mock_get_header(&res, "Content-Type"));
+    free_request(&res);
+
+    // Per-mount override beats the built-in table
+    params.path = "/pre/photo.JPG";
+    res = request(&params);
+    ASSERT_EQ(200, res.status_code);
+    ASSERT_EQ_STR("image/x-custom", mock_get_header(&res, "Content-Type"));
+
+    free_request(&res);
+    RETURN_OK();
+}
+
 void setup_static_routes(void)
 {
     uv_fs_t req;
@@ -144,6 +514,47 @@ void setup_static_routes(void)
         uv_fs_req_cleanup(&req);
     }
 
+    write_test_file("test_public/page.html", "<html>first</html>");
+
+    // Above the stream threshold of "/stream"
+    size_t large_size = 3 * 1024 * 1024;
+    char *large = malloc(large_size + 1);
+    if (large) {
+        memset(large, 'x', large_size);
+        large[large_size] = '\0';
+        write_test_file("test_public/large.txt", large);
+        free(large);
+    }
+
+    // Registered before "/" so its prefix is matched first
+    Static cached = {
+        .cache_max_bytes = 64 * 1024,
+    };
+    serve_static("/cached", "./test_public", &cached);
+
+    Static streamed = {
+        .stream_threshold = 1024 * 1024,
+    };
+    serve_static("/stream", "./test_public", &streamed);
+
+    write_test_file("test_public/app.js", "console.log('plain');");
+    write_test_file("test_public/app.js.gz", "gzipped");
+
+    write_test_file("test_public/photo.JPG", "jpeg");
+    write_test_file("test_public/notes.rst", "notes");
+    static_add_mime_type("rst", "text/x-rst");
+
+    StaticMimeType pre_types[] = {
+        { ".jpg", "image/x-custom" },
+    };
+
+    Static pre = {
+        .precompressed = true,
+        .mime_types = pre_types,
+        .mime_type_count = 1,
+    };
+    serve_static("/pre", "./test_public", &pre);
+
     serve_static("/", "./test_public", NULL);
 
     // Verify files exist